@@ -1,35 +1,15 @@
 #include "ethernet.h"
+#include "net_common.h"
 #include "esp_event.h"
 #include "esp_eth.h"
+#include "esp_eth_netif_glue.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
 
 static const char *TAG = "eth";
-static EventGroupHandle_t s_eth_event_group;
-static const int ETH_CONNECTED_BIT = BIT0;
 static esp_eth_handle_t s_eth_handle = NULL;
 
-static void eth_event_handler(void* arg, esp_event_base_t event_base,
-                              int32_t event_id, void* event_data) {
-    switch (event_id) {
-        case ETHERNET_EVENT_CONNECTED:
-            xEventGroupSetBits(s_eth_event_group, ETH_CONNECTED_BIT);
-            break;
-        case ETHERNET_EVENT_DISCONNECTED:
-            xEventGroupClearBits(s_eth_event_group, ETH_CONNECTED_BIT);
-            break;
-        default:
-            break;
-    }
-}
-
 esp_err_t eth_init_default(void) {
-    s_eth_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_event_handler_register(ETH_EVENT, ESP_EVENT_ANY_ID, &eth_event_handler, NULL));
-
     // Configuración genérica RMII: ajustar según placa (pines/PHY)
     eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
     eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
@@ -47,8 +27,16 @@ esp_err_t eth_init_default(void) {
     esp_eth_phy_t *phy = esp_eth_phy_new_ip101(&phy_config);
 
     esp_eth_config_t config = ETH_DEFAULT_CONFIG(mac, phy);
+    // El sondeo del PHY (2 s por defecto) marca cuánto tarda en verse un
+    // cable desconectado, y con ello el failover a Wi-Fi
+    config.check_link_period_ms = CONFIG_NET_COMMON_ETH_LINK_CHECK_MS;
     ESP_ERROR_CHECK(esp_eth_driver_install(&config, &s_eth_handle));
 
+    esp_netif_t *netif = net_common_get_netif(NET_IF_ETH);
+    if (netif) {
+        ESP_ERROR_CHECK(esp_netif_attach(netif, esp_eth_new_netif_glue(s_eth_handle)));
+    }
+
     return ESP_OK;
 }
 
@@ -65,6 +53,5 @@ void eth_stop(void) {
 }
 
 bool eth_is_connected(void) {
-    EventBits_t bits = xEventGroupGetBits(s_eth_event_group);
-    return (bits & ETH_CONNECTED_BIT) != 0;
+    return net_common_is_up(NET_IF_ETH);
 }
@@ -1,16 +1,72 @@
 #pragma once
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
+    NET_IF_NONE = -1,
     NET_IF_WIFI_STA = 0,
     NET_IF_ETH,
     NET_IF_THREAD, // placeholder (requiere SoC compatible)
+    NET_IF_MAX,
 } net_if_t;
 
+// Bits del grupo de eventos devuelto por net_common_event_group():
+// un bit por interfaz con IP, más uno que se activa en cada cambio de la
+// interfaz activa (el suscriptor que espere por él debe limpiarlo).
+#define NET_COMMON_IP_BIT(ifx) ((EventBits_t) 1 << (ifx))
+#define NET_COMMON_ANY_IP_BITS (NET_COMMON_IP_BIT(NET_IF_MAX) - 1)
+#define NET_COMMON_ACTIVE_CHANGED_BIT NET_COMMON_IP_BIT(NET_IF_MAX)
+
+// Cambio de interfaz activa (ruta por defecto). Se llama desde la tarea del
+// loop de eventos por defecto: debe ser breve (p. ej. el cliente LwM2M solo
+// programa la reconexión de su transporte).
+typedef void (*net_common_cb_t)(net_if_t active, net_if_t previous, void *arg);
+
 void net_common_init(void);
 void net_common_create_interfaces(bool enable_wifi, bool enable_eth, bool enable_thread);
+// Espera a que la interfaz tenga IP; timeout_ms < 0 espera indefinidamente
 bool net_common_wait_ip(net_if_t ifx, int timeout_ms);
+// Espera a que cualquier interfaz tenga IP
+bool net_common_wait_any_ip(int timeout_ms);
+bool net_common_is_up(net_if_t ifx);
 
 esp_netif_t* net_common_get_netif(net_if_t ifx);
+// Para aplicaciones que crean sus propias interfaces (p. ej. el aprovisionamiento
+// Wi-Fi): net_common las usa en el failover como si las hubiera creado
+void net_common_attach_netif(net_if_t ifx, esp_netif_t *netif);
+EventGroupHandle_t net_common_event_group(void);
+
+// Failover: la interfaz con IP de mayor prioridad es la ruta por defecto.
+// Prioridades iniciales de Kconfig (Ethernet > Wi-Fi > Thread). Las demás
+// interfaces siguen conectadas como respaldo en caliente, así que el cambio
+// solo depende de detectar la caída (enlace Ethernet, desconexión Wi-Fi).
+void net_common_set_priority(net_if_t ifx, int prio);
+net_if_t net_common_get_active(void);
+// Para interfaces sin eventos IP propios (Thread): informar IP arriba/abajo
+void net_common_set_link_state(net_if_t ifx, bool up);
+// Devuelve 0, o -1 si no quedan huecos (CONFIG_NET_COMMON_MAX_SUBSCRIBERS)
+int net_common_subscribe(net_common_cb_t cb, void *arg);
+void net_common_unsubscribe(net_common_cb_t cb, void *arg);
+// Último relevo de la ruta por defecto, en microsegundos: desde que se
+// notificó la caída de la interfaz activa (desconexión Wi-Fi, enlace Ethernet,
+// IP perdida o net_common_set_link_state) hasta que otra interfaz con IP pasó
+// a ser la ruta por defecto; -1 si aún no ha habido ninguno. Con un respaldo
+// ya conectado es ~0; si ninguno tenía IP incluye la espera hasta obtenerla.
+// No incluye la detección de la caída (sondeo del PHY cada
+// NET_COMMON_ETH_LINK_CHECK_MS, timeout de beacons Wi-Fi) ni la reconexión
+// de las aplicaciones, que dominan el failover total.
+int64_t net_common_last_switchover_us(void);
+// Las aplicaciones llaman a esta función tras un intercambio completado por ifx
+// (p. ej. el cliente LwM2M cuando el servidor confirma Register/Update). El
+// primer aviso por la interfaz activa tras una caída cierra la medida de
+// failover.
+void net_common_report_traffic(net_if_t ifx);
+// Último failover completo, en microsegundos: desde que se notificó la caída de
+// la interfaz activa hasta el primer tráfico confirmado por la nueva ruta; -1
+// si aún no ha habido ninguno. Incluye el relevo, la obtención de IP y la
+// reconexión de la aplicación; no incluye la detección de la caída.
+int64_t net_common_last_failover_us(void);
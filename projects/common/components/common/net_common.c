@@ -4,9 +4,12 @@
 #include "nvs_flash.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "lwip/ip4_addr.h"
+#include <string.h>
 #if CONFIG_ESP_WIFI_ENABLED
 #include "esp_wifi.h"
 #include "esp_wifi_default.h"
@@ -20,10 +23,161 @@ static esp_netif_t *s_wifi = NULL;
 static esp_netif_t *s_eth = NULL;
 static esp_netif_t *s_thread = NULL; // placeholder
 
+static EventGroupHandle_t s_events = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static int s_prio[NET_IF_MAX] = {
+    [NET_IF_WIFI_STA] = CONFIG_NET_COMMON_PRIO_WIFI,
+    [NET_IF_ETH] = CONFIG_NET_COMMON_PRIO_ETH,
+    [NET_IF_THREAD] = CONFIG_NET_COMMON_PRIO_THREAD,
+};
+static net_if_t s_active = NET_IF_NONE;
+static int64_t s_down_at_us = 0;       // caída notificada de la interfaz activa, pendiente de relevo
+static int64_t s_last_switchover_us = -1;
+static int64_t s_lost_at_us = 0;       // misma caída, pendiente de tráfico por la nueva ruta
+static int64_t s_last_failover_us = -1;
+
+typedef struct {
+    net_common_cb_t cb;
+    void *arg;
+} subscriber_t;
+
+static subscriber_t s_subs[CONFIG_NET_COMMON_MAX_SUBSCRIBERS];
+
+static const char *if_name(net_if_t ifx) {
+    switch (ifx) {
+        case NET_IF_WIFI_STA: return "Wi-Fi";
+        case NET_IF_ETH: return "Ethernet";
+        case NET_IF_THREAD: return "Thread";
+        default: return "ninguna";
+    }
+}
+
+// Elige la interfaz con IP de mayor prioridad. Llamar con s_lock tomado;
+// devuelve true (y la anterior en *prev) si la interfaz activa cambió.
+static bool reselect_locked(net_if_t *prev) {
+    const EventBits_t bits = xEventGroupGetBits(s_events);
+    net_if_t best = NET_IF_NONE;
+    for (int i = 0; i < NET_IF_MAX; ++i) {
+        if ((bits & NET_COMMON_IP_BIT(i)) && net_common_get_netif((net_if_t) i)
+                && (best == NET_IF_NONE || s_prio[i] > s_prio[best])) {
+            best = (net_if_t) i;
+        }
+    }
+    if (best == s_active) {
+        return false;
+    }
+    *prev = s_active;
+    s_active = best;
+    if (best != NET_IF_NONE) {
+        esp_netif_set_default_netif(net_common_get_netif(best));
+    }
+    const int64_t now = esp_timer_get_time();
+    if (s_down_at_us && best != NET_IF_NONE) {
+        // Con respaldo en caliente es ~0: el tiempo real lo marca la detección
+        s_last_switchover_us = now - s_down_at_us;
+        ESP_LOGW(TAG, "Relevo %s -> %s %lld ms tras la caída", if_name(*prev), if_name(best),
+                 (long long) (s_last_switchover_us / 1000));
+    } else {
+        ESP_LOGI(TAG, "Interfaz activa: %s", if_name(best));
+    }
+    // Sin interfaz: el tiempo sigue contando hasta que alguna recupere IP
+    if (best != NET_IF_NONE) {
+        s_down_at_us = 0;
+    }
+    xEventGroupSetBits(s_events, NET_COMMON_ACTIVE_CHANGED_BIT);
+    return true;
+}
+
+static void reselect_and_notify(void) {
+    net_if_t prev = NET_IF_NONE;
+    subscriber_t subs[CONFIG_NET_COMMON_MAX_SUBSCRIBERS];
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool changed = reselect_locked(&prev);
+    const net_if_t active = s_active;
+    memcpy(subs, s_subs, sizeof(subs));
+    xSemaphoreGive(s_lock);
+
+    // Fuera del lock: un suscriptor puede consultar el estado sin bloquearse
+    if (changed) {
+        for (int i = 0; i < CONFIG_NET_COMMON_MAX_SUBSCRIBERS; ++i) {
+            if (subs[i].cb) {
+                subs[i].cb(active, prev, subs[i].arg);
+            }
+        }
+    }
+}
+
+void net_common_set_link_state(net_if_t ifx, bool up) {
+    if (!s_events || ifx < 0 || ifx >= NET_IF_MAX) {
+        return;
+    }
+    const EventBits_t bit = NET_COMMON_IP_BIT(ifx);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const bool was_up = (xEventGroupGetBits(s_events) & bit) != 0;
+    if (was_up != up) {
+        if (up) {
+            xEventGroupSetBits(s_events, bit);
+        } else {
+            xEventGroupClearBits(s_events, bit);
+            if (ifx == s_active && !s_down_at_us) {
+                s_down_at_us = esp_timer_get_time();
+                if (!s_lost_at_us) {
+                    s_lost_at_us = s_down_at_us;
+                }
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+    if (was_up != up) {
+        ESP_LOGI(TAG, "%s: IP %s", if_name(ifx), up ? "arriba" : "abajo");
+        reselect_and_notify();
+    }
+}
+
+static void net_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    if (event_base == IP_EVENT) {
+        switch (event_id) {
+            case IP_EVENT_STA_GOT_IP: net_common_set_link_state(NET_IF_WIFI_STA, true); break;
+            case IP_EVENT_STA_LOST_IP: net_common_set_link_state(NET_IF_WIFI_STA, false); break;
+            case IP_EVENT_ETH_GOT_IP: net_common_set_link_state(NET_IF_ETH, true); break;
+            case IP_EVENT_ETH_LOST_IP: net_common_set_link_state(NET_IF_ETH, false); break;
+            default: break;
+        }
+    }
+    // Caída de enlace: no esperar al temporizador de IP perdida (minutos)
+#if CONFIG_ESP_WIFI_ENABLED
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        net_common_set_link_state(NET_IF_WIFI_STA, false);
+    }
+#endif
+#if CONFIG_ETH_ENABLED && CONFIG_MQTT_USE_ETH
+    else if (event_base == ETH_EVENT && event_id == ETHERNET_EVENT_DISCONNECTED) {
+        net_common_set_link_state(NET_IF_ETH, false);
+    }
+#endif
+}
+
 void net_common_init(void) {
     ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    // La aplicación puede haber creado ya el loop (p. ej. el aprovisionamiento Wi-Fi)
+    const esp_err_t err = esp_event_loop_create_default();
+    if (err != ESP_ERR_INVALID_STATE) {
+        ESP_ERROR_CHECK(err);
+    }
     ESP_ERROR_CHECK(nvs_flash_init());
+
+    if (!s_events) {
+        s_events = xEventGroupCreate();
+        s_lock = xSemaphoreCreateMutex();
+        ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &net_event_handler, NULL));
+#if CONFIG_ESP_WIFI_ENABLED
+        ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &net_event_handler, NULL));
+#endif
+#if CONFIG_ETH_ENABLED && CONFIG_MQTT_USE_ETH
+        ESP_ERROR_CHECK(esp_event_handler_register(ETH_EVENT, ETHERNET_EVENT_DISCONNECTED, &net_event_handler, NULL));
+#endif
+    }
 }
 
 void net_common_create_interfaces(bool enable_wifi, bool enable_eth, bool enable_thread) {
@@ -50,6 +204,24 @@ void net_common_create_interfaces(bool enable_wifi, bool enable_eth, bool enable
     }
 }
 
+void net_common_attach_netif(net_if_t ifx, esp_netif_t *netif) {
+    if (!s_events || !netif) {
+        return;
+    }
+    switch (ifx) {
+        case NET_IF_WIFI_STA: s_wifi = netif; break;
+        case NET_IF_ETH: s_eth = netif; break;
+        case NET_IF_THREAD: s_thread = netif; break;
+        default: return;
+    }
+    // Puede haber obtenido IP antes de adjuntarse
+    esp_netif_ip_info_t ip;
+    if (esp_netif_is_netif_up(netif) && esp_netif_get_ip_info(netif, &ip) == ESP_OK && ip.ip.addr != 0) {
+        net_common_set_link_state(ifx, true);
+    }
+    reselect_and_notify();
+}
+
 esp_netif_t* net_common_get_netif(net_if_t ifx) {
     switch (ifx) {
         case NET_IF_WIFI_STA: return s_wifi;
@@ -59,16 +231,109 @@ esp_netif_t* net_common_get_netif(net_if_t ifx) {
     }
 }
 
+EventGroupHandle_t net_common_event_group(void) {
+    return s_events;
+}
+
+static bool wait_bits(EventBits_t bits, int timeout_ms) {
+    if (!s_events) {
+        return false;
+    }
+    const TickType_t ticks = timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return (xEventGroupWaitBits(s_events, bits, pdFALSE, pdFALSE, ticks) & bits) != 0;
+}
+
 bool net_common_wait_ip(net_if_t ifx, int timeout_ms) {
     esp_netif_t *n = net_common_get_netif(ifx);
-    if (!n) return false;
-    for (int t = 0; t < timeout_ms/100; ++t) {
-        esp_netif_ip_info_t ip;
-        if (esp_netif_get_ip_info(n, &ip) == ESP_OK && ip.ip.addr != 0) {
-            ESP_LOGI(TAG, "IP obtenida: %s", ip4addr_ntoa((const ip4_addr_t*)&ip.ip));
-            return true;
+    if (!n || !wait_bits(NET_COMMON_IP_BIT(ifx), timeout_ms)) {
+        return false;
+    }
+    esp_netif_ip_info_t ip;
+    if (esp_netif_get_ip_info(n, &ip) == ESP_OK) {
+        ESP_LOGI(TAG, "IP obtenida: %s", ip4addr_ntoa((const ip4_addr_t*)&ip.ip));
+    }
+    return true;
+}
+
+bool net_common_wait_any_ip(int timeout_ms) {
+    return wait_bits(NET_COMMON_ANY_IP_BITS, timeout_ms);
+}
+
+bool net_common_is_up(net_if_t ifx) {
+    if (!s_events || ifx < 0 || ifx >= NET_IF_MAX) {
+        return false;
+    }
+    return (xEventGroupGetBits(s_events) & NET_COMMON_IP_BIT(ifx)) != 0;
+}
+
+void net_common_set_priority(net_if_t ifx, int prio) {
+    if (!s_events || ifx < 0 || ifx >= NET_IF_MAX) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_prio[ifx] = prio;
+    xSemaphoreGive(s_lock);
+    reselect_and_notify();
+}
+
+net_if_t net_common_get_active(void) {
+    return s_active;
+}
+
+int net_common_subscribe(net_common_cb_t cb, void *arg) {
+    int ret = -1;
+    if (!s_lock || !cb) {
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_NET_COMMON_MAX_SUBSCRIBERS; ++i) {
+        if (!s_subs[i].cb) {
+            s_subs[i].cb = cb;
+            s_subs[i].arg = arg;
+            ret = 0;
+            break;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
-    return false;
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+void net_common_unsubscribe(net_common_cb_t cb, void *arg) {
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_NET_COMMON_MAX_SUBSCRIBERS; ++i) {
+        if (s_subs[i].cb == cb && s_subs[i].arg == arg) {
+            s_subs[i].cb = NULL;
+            s_subs[i].arg = NULL;
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+int64_t net_common_last_switchover_us(void) {
+    return s_last_switchover_us;
+}
+
+void net_common_report_traffic(net_if_t ifx) {
+    if (!s_lock || ifx == NET_IF_NONE) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t failover = -1;
+    if (s_lost_at_us && ifx == s_active) {
+        failover = esp_timer_get_time() - s_lost_at_us;
+        s_last_failover_us = failover;
+        s_lost_at_us = 0;
+    }
+    xSemaphoreGive(s_lock);
+    if (failover >= 0) {
+        ESP_LOGW(TAG, "Failover: primer tráfico por %s %lld ms tras la caída", if_name(ifx),
+                 (long long) (failover / 1000));
+    }
+}
+
+int64_t net_common_last_failover_us(void) {
+    return s_last_failover_us;
 }
@@ -0,0 +1,399 @@
+#include "dlms_client.h"
+
+#include <string.h>
+
+// Flags, format, addresses (up to 4 + 1), control, HCS and FCS around a segment
+#define SEGMENT_OVERHEAD 14
+// References per GET-WITH-LIST request (request buffer on the stack)
+#define LIST_MAX 32
+
+void dlms_client_init(dlms_client_t *client, const dlms_port_t *port, const dlms_client_config_t *cfg) {
+    memset(client, 0, sizeof(*client));
+    client->port = *port;
+    client->cfg = *cfg;
+    client->server_addr = dlms_hdlc_server_address(cfg->server_logical, cfg->server_physical);
+    client->invoke_id = 1;
+    client->max_info_tx = 128;
+    client->window_tx = 1;
+    dlms_hdlc_rx_reset(&client->rx);
+}
+
+static int send_frame(dlms_client_t *client, uint8_t control, const uint8_t *info, size_t info_len, bool segmented) {
+    const int n = dlms_hdlc_build(client->tx, sizeof(client->tx), control, client->server_addr,
+                                  client->cfg.client_sap, info, info_len, segmented);
+    if (n < 0) {
+        return DLMS_ERR_DATA;
+    }
+    return client->port.write(client->port.ctx, client->tx, (size_t) n) == 0 ? DLMS_OK : DLMS_ERR_IO;
+}
+
+// Next frame addressed to us. Frames for other clients (shared RS-485 bus)
+// and corrupted frames are skipped by the receiver or here.
+static int recv_frame(dlms_client_t *client, dlms_hdlc_frame_t *frame) {
+    for (;;) {
+        while (client->in_off < client->in_len) {
+            size_t used = 0;
+            const int ready = dlms_hdlc_rx_feed(&client->rx, client->in + client->in_off,
+                                                client->in_len - client->in_off, &used, frame);
+            client->in_off += used;
+            if (ready && frame->dest == client->cfg.client_sap && frame->src == client->server_addr) {
+                return DLMS_OK;
+            }
+        }
+        const int n = client->port.read(client->port.ctx, client->in, sizeof(client->in), client->cfg.timeout_ms);
+        if (n < 0) {
+            return DLMS_ERR_IO;
+        }
+        if (n == 0) {
+            client->timeouts++;
+            return DLMS_ERR_TIMEOUT;
+        }
+        client->in_len = (size_t) n;
+        client->in_off = 0;
+    }
+}
+
+// Drops stale input (late answer to a timed-out request) before a new exchange
+static void flush_input(dlms_client_t *client) {
+    client->in_len = 0;
+    client->in_off = 0;
+    dlms_hdlc_rx_reset(&client->rx);
+    while (client->port.read(client->port.ctx, client->in, sizeof(client->in), 0) > 0) {
+    }
+}
+
+// Sends an APDU in as many I-frames as the information field requires and
+// reassembles the response APDU into client->apdu
+static int transact(dlms_client_t *client, const uint8_t *apdu, size_t len) {
+    dlms_hdlc_frame_t frame;
+    size_t seg_max = client->max_info_tx;
+    if (seg_max > sizeof(client->tx) - SEGMENT_OVERHEAD) {
+        seg_max = sizeof(client->tx) - SEGMENT_OVERHEAD;
+    }
+    client->requests++;
+
+    // Segments go out back to back; only the last of a window carries the poll bit
+    size_t off = 0;
+    unsigned in_window = 0;
+    for (;;) {
+        const size_t n = len - off < seg_max ? len - off : seg_max;
+        const bool more = off + n < len;
+        const bool poll = !more || ++in_window == client->window_tx;
+        uint8_t control = dlms_hdlc_i_control(client->ns, client->nr);
+        if (!poll) {
+            control &= (uint8_t) ~DLMS_HDLC_PF;
+        }
+        int err = send_frame(client, control, apdu + off, n, more);
+        if (err) {
+            return err;
+        }
+        client->ns = (client->ns + 1) & 0x07;
+        off += n;
+        if (!more) {
+            break;
+        }
+        if (poll) {
+            // Window full: the meter acknowledges with RR before we go on
+            client->round_trips++;
+            err = recv_frame(client, &frame);
+            if (err) {
+                return err;
+            }
+            if (!dlms_hdlc_is_rr(frame.control) || ((frame.control >> 5) & 0x07) != client->ns) {
+                return DLMS_ERR_PROTOCOL;
+            }
+            in_window = 0;
+        }
+    }
+
+    client->round_trips++;
+    client->apdu_len = 0;
+    for (;;) {
+        int err = recv_frame(client, &frame);
+        if (err) {
+            return err;
+        }
+        if (!dlms_hdlc_is_i_frame(frame.control) || ((frame.control >> 5) & 0x07) != client->ns
+                || ((frame.control >> 1) & 0x07) != client->nr) {
+            return DLMS_ERR_PROTOCOL;
+        }
+        client->nr = (client->nr + 1) & 0x07;
+        if (client->apdu_len + frame.info_len > sizeof(client->apdu)) {
+            return DLMS_ERR_DATA;
+        }
+        memcpy(client->apdu + client->apdu_len, frame.info, frame.info_len);
+        client->apdu_len += frame.info_len;
+        if (!frame.segmented) {
+            return DLMS_OK;
+        }
+        if (frame.control & DLMS_HDLC_PF) {
+            // End of the meter's window: ask for the next segments
+            client->round_trips++;
+            err = send_frame(client, dlms_hdlc_rr_control(client->nr), NULL, 0, false);
+            if (err) {
+                return err;
+            }
+        }
+    }
+}
+
+int dlms_client_connect(dlms_client_t *client) {
+    uint8_t info[128];
+    dlms_hdlc_frame_t frame;
+
+    client->connected = false;
+    flush_input(client);
+    size_t snrm_len = 0;
+    if (client->cfg.max_info_len) {
+        const uint8_t window = client->cfg.window < 1 ? 1 : client->cfg.window > 7 ? 7 : client->cfg.window;
+        const dlms_hdlc_params_t proposed = {
+            .max_info_tx = client->cfg.max_info_len,
+            .max_info_rx = client->cfg.max_info_len,
+            .window_tx = window,
+            .window_rx = window,
+        };
+        snrm_len = dlms_hdlc_build_params(info, &proposed);
+    }
+    int err = send_frame(client, DLMS_HDLC_SNRM, info, snrm_len, false);
+    if (!err) {
+        client->round_trips++;
+        err = recv_frame(client, &frame);
+    }
+    if (err) {
+        return err;
+    }
+    dlms_hdlc_params_t server;
+    if ((frame.control != DLMS_HDLC_UA && frame.control != (DLMS_HDLC_UA & ~DLMS_HDLC_PF))
+            || dlms_hdlc_parse_params(frame.info, frame.info_len, &server) != 0) {
+        return DLMS_ERR_PROTOCOL;
+    }
+    // UA parameters are the meter's view: its receive side is our transmit side
+    client->max_info_tx = server.max_info_rx;
+    client->window_tx = server.window_rx;
+    if (snrm_len) {
+        if (client->max_info_tx > client->cfg.max_info_len) {
+            client->max_info_tx = client->cfg.max_info_len;
+        }
+        if (client->window_tx > client->cfg.window) {
+            client->window_tx = client->cfg.window ? client->cfg.window : 1;
+        }
+    }
+    client->ns = 0;
+    client->nr = 0;
+
+    const size_t aarq_len = dlms_cosem_build_aarq(info, sizeof(info), client->cfg.password);
+    if (!aarq_len) {
+        return DLMS_ERR_DATA;
+    }
+    err = transact(client, info, aarq_len);
+    if (err) {
+        return err;
+    }
+    dlms_aare_t aare;
+    const int result = dlms_cosem_parse_aare(client->apdu, client->apdu_len, &aare);
+    if (result < 0) {
+        return DLMS_ERR_PROTOCOL;
+    }
+    if (result > 0) {
+        return DLMS_ERR_REJECTED;
+    }
+    client->conformance = aare.conformance;
+    client->server_max_pdu = aare.max_pdu;
+    client->connected = true;
+    return DLMS_OK;
+}
+
+void dlms_client_disconnect(dlms_client_t *client) {
+    dlms_hdlc_frame_t frame;
+    if (send_frame(client, DLMS_HDLC_DISC, NULL, 0, false) == DLMS_OK) {
+        (void) recv_frame(client, &frame); // UA or DM, either way the link is down
+    }
+    client->connected = false;
+}
+
+// Invoke ids 1..15 with priority/service class bits clear, as the bridge sends them
+static uint8_t next_invoke_id(dlms_client_t *client) {
+    const uint8_t invoke_id = client->invoke_id;
+    client->invoke_id = client->invoke_id >= 15 ? 1 : client->invoke_id + 1;
+    return invoke_id;
+}
+
+// Sends a GET request and follows with GET next until the last block. On
+// DLMS_OK, *dar > 0 if the meter refused the whole request, otherwise
+// *data/*data_len is the response data (valid until the next request).
+static int get_request(dlms_client_t *client, const uint8_t *apdu, size_t len, uint8_t invoke_id, uint8_t type,
+                       int *dar, const uint8_t **data, size_t *data_len) {
+    size_t blocks_len = 0;
+    uint32_t expected_block = 1;
+    int err = transact(client, apdu, len);
+    while (!err) {
+        dlms_get_response_t resp;
+        if (dlms_cosem_parse_get_response(client->apdu, client->apdu_len, &resp) != 0 || resp.invoke_id != invoke_id
+                || (resp.type != DLMS_GET_NEXT && resp.type != type)) {
+            err = DLMS_ERR_PROTOCOL;
+            break;
+        }
+        *dar = resp.dar;
+        if (resp.type == type || resp.dar > 0) {
+            *data = resp.data;
+            *data_len = resp.data_len;
+            return DLMS_OK;
+        }
+        if (resp.block_number != expected_block || blocks_len + resp.data_len > sizeof(client->blocks)) {
+            err = resp.block_number != expected_block ? DLMS_ERR_PROTOCOL : DLMS_ERR_DATA;
+            break;
+        }
+        memcpy(client->blocks + blocks_len, resp.data, resp.data_len);
+        blocks_len += resp.data_len;
+        if (resp.last_block) {
+            *data = client->blocks;
+            *data_len = blocks_len;
+            return DLMS_OK;
+        }
+        uint8_t next[16];
+        const size_t next_len = dlms_cosem_build_get_next(next, sizeof(next), invoke_id, resp.block_number);
+        expected_block++;
+        err = transact(client, next, next_len);
+    }
+    // Sequence numbers or the block stream are unknown now: reassociate
+    client->connected = false;
+    return err;
+}
+
+int dlms_client_get(dlms_client_t *client, uint16_t class_id, const uint8_t obis[6], uint8_t attribute,
+                    uint8_t *buf, size_t size, size_t *len) {
+    uint8_t apdu[32];
+    if (!client->connected) {
+        return DLMS_ERR_NOT_CONNECTED;
+    }
+    const uint8_t invoke_id = next_invoke_id(client);
+    const size_t apdu_len = dlms_cosem_build_get(apdu, sizeof(apdu), invoke_id, class_id, obis, attribute);
+    int dar;
+    const uint8_t *data;
+    size_t data_len;
+    const int err = get_request(client, apdu, apdu_len, invoke_id, DLMS_GET_NORMAL, &dar, &data, &data_len);
+    if (err) {
+        return err;
+    }
+    if (dar > 0) {
+        return DLMS_ERR_ACCESS;
+    }
+    if (data_len > size) {
+        return DLMS_ERR_DATA;
+    }
+    memcpy(buf, data, data_len);
+    *len = data_len;
+    return DLMS_OK;
+}
+
+int dlms_client_get_list(dlms_client_t *client, const dlms_attr_ref_t *refs, size_t count,
+                         dlms_get_result_t *results, uint8_t *buf, size_t size) {
+    size_t buf_used = 0;
+    if (!client->connected) {
+        return DLMS_ERR_NOT_CONNECTED;
+    }
+    if (!(client->conformance & DLMS_CONFORMANCE_MULTIPLE_REFS)) {
+        for (size_t i = 0; i < count; i++) {
+            size_t len = 0;
+            const int err = dlms_client_get(client, refs[i].class_id, refs[i].obis, refs[i].attribute,
+                                            buf + buf_used, size - buf_used, &len);
+            if (err != DLMS_OK && err != DLMS_ERR_ACCESS && err != DLMS_ERR_DATA) {
+                return err;
+            }
+            results[i].err = err;
+            results[i].data = buf + buf_used;
+            results[i].len = len;
+            buf_used += len;
+        }
+        return DLMS_OK;
+    }
+
+    // As many references per request as the meter's max PDU takes
+    size_t per_request = client->server_max_pdu > 16 ? (client->server_max_pdu - 16) / 10 : 1;
+    if (per_request > LIST_MAX) {
+        per_request = LIST_MAX;
+    }
+    for (size_t start = 0; start < count;) {
+        uint8_t req[16 + 10 * LIST_MAX];
+        const size_t batch = count - start < per_request ? count - start : per_request;
+        const uint8_t invoke_id = next_invoke_id(client);
+        const size_t req_len = dlms_cosem_build_get_list(req, sizeof(req), invoke_id, refs + start, batch);
+        int dar;
+        const uint8_t *data;
+        size_t data_len;
+        const int err = get_request(client, req, req_len, invoke_id, DLMS_GET_WITH_LIST, &dar, &data, &data_len);
+        if (err) {
+            return err;
+        }
+        size_t items = 0;
+        size_t off = dar > 0 ? 0 : dlms_axdr_length(data, data_len, &items);
+        if (dar <= 0 && (!off || items != batch)) {
+            client->connected = false;
+            return DLMS_ERR_PROTOCOL;
+        }
+        for (size_t i = start; i < start + batch; i++) {
+            dlms_get_result_t *r = &results[i];
+            r->data = buf + buf_used;
+            r->len = 0;
+            if (dar > 0) {
+                r->err = DLMS_ERR_ACCESS;
+                continue;
+            }
+            int item_dar;
+            const uint8_t *value = NULL;
+            size_t value_len = 0;
+            const size_t used = dlms_cosem_list_result(data + off, data_len - off, &item_dar, &value, &value_len);
+            if (!used) {
+                client->connected = false;
+                return DLMS_ERR_PROTOCOL;
+            }
+            off += used;
+            if (item_dar) {
+                r->err = DLMS_ERR_ACCESS;
+            } else if (value_len > size - buf_used) {
+                r->err = DLMS_ERR_DATA;
+            } else {
+                memcpy(buf + buf_used, value, value_len);
+                r->err = DLMS_OK;
+                r->len = value_len;
+                buf_used += value_len;
+            }
+        }
+        start += batch;
+    }
+    return DLMS_OK;
+}
+
+int dlms_client_get_scaler_unit(dlms_client_t *client, const uint8_t obis[6], int8_t *scaler, uint8_t *unit) {
+    uint8_t data[16];
+    size_t len;
+    const int err = dlms_client_get(client, DLMS_CLASS_REGISTER, obis, DLMS_ATTR_SCALER_UNIT, data, sizeof(data), &len);
+    if (err) {
+        return err;
+    }
+    return dlms_data_scaler_unit(data, len, scaler, unit) == 0 ? DLMS_OK : DLMS_ERR_DATA;
+}
+
+int dlms_client_get_value(dlms_client_t *client, const uint8_t obis[6], double *value) {
+    uint8_t data[16];
+    size_t len;
+    const int err = dlms_client_get(client, DLMS_CLASS_REGISTER, obis, DLMS_ATTR_VALUE, data, sizeof(data), &len);
+    if (err) {
+        return err;
+    }
+    return dlms_data_to_double(data, len, value, NULL) == 0 ? DLMS_OK : DLMS_ERR_DATA;
+}
+
+const char *dlms_err_str(int err) {
+    switch (err) {
+        case DLMS_OK: return "ok";
+        case DLMS_ERR_IO: return "I/O error";
+        case DLMS_ERR_TIMEOUT: return "timeout";
+        case DLMS_ERR_PROTOCOL: return "protocol error";
+        case DLMS_ERR_REJECTED: return "association rejected";
+        case DLMS_ERR_ACCESS: return "access refused";
+        case DLMS_ERR_DATA: return "bad data";
+        case DLMS_ERR_NOT_CONNECTED: return "not connected";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,474 @@
+#include "dlms_cosem.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG_AARQ 0x60
+#define TAG_AARE 0x61
+#define TAG_GET_REQUEST 0xC0
+#define TAG_GET_RESPONSE 0xC4
+#define TAG_INITIATE_RESPONSE 0x08
+
+static const uint8_t LLC_REQUEST[3] = { 0xE6, 0xE6, 0x00 };
+static const uint8_t LLC_RESPONSE[3] = { 0xE6, 0xE7, 0x00 };
+
+// A-XDR data types
+#define DT_NULL 0x00
+#define DT_ARRAY 0x01
+#define DT_BIT_STRING 0x04
+#define DT_OCTET_STRING 0x09
+#define DT_VISIBLE_STRING 0x0A
+#define DT_UTF8_STRING 0x0C
+#define DT_BCD 0x0D
+#define DT_DATE_TIME 0x19
+#define DT_DATE 0x1A
+#define DT_TIME 0x1B
+#define DT_BOOLEAN 0x03
+#define DT_DOUBLE_LONG 0x05
+#define DT_DOUBLE_LONG_UNSIGNED 0x06
+#define DT_INTEGER 0x0F
+#define DT_LONG 0x10
+#define DT_UNSIGNED 0x11
+#define DT_LONG_UNSIGNED 0x12
+#define DT_STRUCTURE 0x02
+#define DT_LONG64 0x14
+#define DT_LONG64_UNSIGNED 0x15
+#define DT_ENUM 0x16
+#define DT_FLOAT32 0x17
+#define DT_FLOAT64 0x18
+
+int dlms_obis_parse(const char *text, uint8_t obis[6]) {
+    unsigned v[6] = { 0, 0, 0, 0, 0, 255 };
+    int n = 0;
+    char tail;
+    if (sscanf(text, "%u-%u:%u.%u.%u%n", &v[0], &v[1], &v[2], &v[3], &v[4], &n) == 5) {
+        if (text[n] == '*' && sscanf(text + n + 1, "%u%c", &v[5], &tail) != 1) {
+            return -1;
+        }
+        if (text[n] != '*' && text[n] != '\0') {
+            return -1;
+        }
+    } else if (sscanf(text, "%u.%u.%u.%u.%u.%u%c", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &tail) != 6) {
+        return -1;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (v[i] > 255) {
+            return -1;
+        }
+        obis[i] = (uint8_t) v[i];
+    }
+    return 0;
+}
+
+size_t dlms_cosem_build_aarq(uint8_t *out, size_t size, const char *password) {
+    static const uint8_t context_and_mechanism[] = {
+        0xA1, 0x09, 0x06, 0x07, 0x60, 0x85, 0x74, 0x05, 0x08, 0x01, 0x01, // LN referencing, no ciphering
+        0x8A, 0x02, 0x07, 0x80,                                           // ACSE requirements: authentication
+        0x8B, 0x07, 0x60, 0x85, 0x74, 0x05, 0x08, 0x02, 0x01,             // mechanism: low level security
+    };
+    static const uint8_t user_information[] = {
+        0xBE, 0x10, 0x04, 0x0E,
+        0x01, 0x00, 0x00, 0x00, 0x06, 0x5F, 0x1F, 0x04, 0x00, // InitiateRequest, DLMS version 6
+        0x00, 0x7E, 0x1F,                                     // proposed conformance, incl. block
+                                                              // transfer with GET and multiple references
+        0x04, 0xB0,                                           // client max receive PDU size (1200)
+    };
+    const size_t pw_len = password ? strlen(password) : 0;
+    const size_t body_len = sizeof(context_and_mechanism) + 4 + pw_len + sizeof(user_information);
+    if (pw_len < 1 || pw_len > 16 || sizeof(LLC_REQUEST) + 2 + body_len > size) {
+        return 0;
+    }
+    size_t n = 0;
+    memcpy(out + n, LLC_REQUEST, sizeof(LLC_REQUEST));
+    n += sizeof(LLC_REQUEST);
+    out[n++] = TAG_AARQ;
+    out[n++] = (uint8_t) body_len;
+    memcpy(out + n, context_and_mechanism, sizeof(context_and_mechanism));
+    n += sizeof(context_and_mechanism);
+    out[n++] = 0xAC; // calling authentication value
+    out[n++] = (uint8_t) (pw_len + 2);
+    out[n++] = 0x80;
+    out[n++] = (uint8_t) pw_len;
+    memcpy(out + n, password, pw_len);
+    n += pw_len;
+    memcpy(out + n, user_information, sizeof(user_information));
+    n += sizeof(user_information);
+    return n;
+}
+
+// BER length at p[0]; short form or 0x81/0x82 long form
+static size_t ber_length(const uint8_t *p, size_t avail, size_t *len) {
+    if (avail < 1) {
+        return 0;
+    }
+    if (p[0] < 0x80) {
+        *len = p[0];
+        return 1;
+    }
+    if (p[0] == 0x81 && avail >= 2) {
+        *len = p[1];
+        return 2;
+    }
+    if (p[0] == 0x82 && avail >= 3) {
+        *len = ((size_t) p[1] << 8) | p[2];
+        return 3;
+    }
+    return 0;
+}
+
+// InitiateResponse inside the AARE user-information (BE 04 <len> 08 ...)
+static int parse_initiate_response(const uint8_t *p, size_t len, dlms_aare_t *aare) {
+    // p[1] counts the InitiateResponse tag plus at least the QoS flag
+    if (len < 4 || p[0] != 0x04 || p[1] < 2 || (size_t) p[1] + 2 > len || p[2] != TAG_INITIATE_RESPONSE) {
+        return -1;
+    }
+    const uint8_t *r = p + 3;
+    const size_t n = p[1] - 1u;
+    // negotiated-quality-of-service OPTIONAL
+    size_t idx = r[0] ? 2 : 1;
+    // version, then conformance [APPLICATION 31] 5F 1F 04 00 xx xx xx, then max PDU
+    if (n < idx + 1 + 7 + 2 || r[idx + 1] != 0x5F || r[idx + 2] != 0x1F || r[idx + 3] != 0x04) {
+        return -1;
+    }
+    idx += 5;
+    aare->conformance = ((uint32_t) r[idx] << 16) | ((uint32_t) r[idx + 1] << 8) | r[idx + 2];
+    aare->max_pdu = (uint16_t) ((r[idx + 3] << 8) | r[idx + 4]);
+    return 0;
+}
+
+int dlms_cosem_parse_aare(const uint8_t *info, size_t len, dlms_aare_t *aare) {
+    if (len < 5 || memcmp(info, LLC_RESPONSE, sizeof(LLC_RESPONSE)) != 0 || info[3] != TAG_AARE) {
+        return -1;
+    }
+    size_t body_len;
+    size_t idx = 4;
+    size_t used = ber_length(info + idx, len - idx, &body_len);
+    if (!used || idx + used + body_len > len) {
+        return -1;
+    }
+    idx += used;
+    const size_t end = idx + body_len;
+    int result = -1;
+    dlms_aare_t negotiated = { .conformance = 0, .max_pdu = 0 };
+    while (idx + 2 <= end) {
+        const uint8_t tag = info[idx++];
+        size_t field_len;
+        used = ber_length(info + idx, end - idx, &field_len);
+        if (!used || idx + used + field_len > end) {
+            return -1;
+        }
+        idx += used;
+        // association-result [2]: INTEGER
+        if (tag == 0xA2 && field_len == 3 && info[idx] == 0x02 && info[idx + 1] == 0x01) {
+            result = info[idx + 2];
+        } else if (tag == 0xBE) {
+            (void) parse_initiate_response(info + idx, field_len, &negotiated);
+        }
+        idx += field_len;
+    }
+    if (result == 0 && aare) {
+        // Servers that omit the InitiateResponse get the basic GET service only
+        *aare = negotiated.max_pdu ? negotiated : (dlms_aare_t) { DLMS_CONFORMANCE_GET, 0 };
+    }
+    return result;
+}
+
+size_t dlms_cosem_build_get(uint8_t *out, size_t size, uint8_t invoke_id, uint16_t class_id,
+                            const uint8_t obis[6], uint8_t attribute) {
+    if (size < 16) {
+        return 0;
+    }
+    size_t n = 0;
+    memcpy(out + n, LLC_REQUEST, sizeof(LLC_REQUEST));
+    n += sizeof(LLC_REQUEST);
+    out[n++] = TAG_GET_REQUEST;
+    out[n++] = DLMS_GET_NORMAL;
+    out[n++] = invoke_id;
+    out[n++] = (uint8_t) (class_id >> 8);
+    out[n++] = (uint8_t) class_id;
+    memcpy(out + n, obis, 6);
+    n += 6;
+    out[n++] = attribute;
+    out[n++] = 0x00; // no selective access
+    return n;
+}
+
+static size_t put_axdr_length(uint8_t *out, size_t value) {
+    if (value < 0x80) {
+        out[0] = (uint8_t) value;
+        return 1;
+    }
+    if (value < 0x100) {
+        out[0] = 0x81;
+        out[1] = (uint8_t) value;
+        return 2;
+    }
+    out[0] = 0x82;
+    out[1] = (uint8_t) (value >> 8);
+    out[2] = (uint8_t) value;
+    return 3;
+}
+
+size_t dlms_axdr_length(const uint8_t *p, size_t len, size_t *value) {
+    if (len < 1) {
+        return 0;
+    }
+    if (p[0] < 0x80) {
+        *value = p[0];
+        return 1;
+    }
+    const size_t n = p[0] & 0x7F;
+    if (n == 0 || n > 4 || len < 1 + n) {
+        return 0;
+    }
+    size_t v = 0;
+    for (size_t i = 0; i < n; i++) {
+        v = (v << 8) | p[1 + i];
+    }
+    *value = v;
+    return 1 + n;
+}
+
+size_t dlms_cosem_build_get_list(uint8_t *out, size_t size, uint8_t invoke_id, const dlms_attr_ref_t *refs,
+                                 size_t count) {
+    if (count == 0 || size < sizeof(LLC_REQUEST) + 3 + 3 + 10 * count) {
+        return 0;
+    }
+    size_t n = 0;
+    memcpy(out + n, LLC_REQUEST, sizeof(LLC_REQUEST));
+    n += sizeof(LLC_REQUEST);
+    out[n++] = TAG_GET_REQUEST;
+    out[n++] = DLMS_GET_WITH_LIST;
+    out[n++] = invoke_id;
+    n += put_axdr_length(out + n, count);
+    for (size_t i = 0; i < count; i++) {
+        out[n++] = (uint8_t) (refs[i].class_id >> 8);
+        out[n++] = (uint8_t) refs[i].class_id;
+        memcpy(out + n, refs[i].obis, 6);
+        n += 6;
+        out[n++] = refs[i].attribute;
+        out[n++] = 0x00; // no selective access
+    }
+    return n;
+}
+
+size_t dlms_cosem_build_get_next(uint8_t *out, size_t size, uint8_t invoke_id, uint32_t block_number) {
+    if (size < 10) {
+        return 0;
+    }
+    size_t n = 0;
+    memcpy(out + n, LLC_REQUEST, sizeof(LLC_REQUEST));
+    n += sizeof(LLC_REQUEST);
+    out[n++] = TAG_GET_REQUEST;
+    out[n++] = DLMS_GET_NEXT;
+    out[n++] = invoke_id;
+    out[n++] = (uint8_t) (block_number >> 24);
+    out[n++] = (uint8_t) (block_number >> 16);
+    out[n++] = (uint8_t) (block_number >> 8);
+    out[n++] = (uint8_t) block_number;
+    return n;
+}
+
+int dlms_cosem_parse_get_response(const uint8_t *apdu, size_t len, dlms_get_response_t *resp) {
+    if (len < 7 || memcmp(apdu, LLC_RESPONSE, sizeof(LLC_RESPONSE)) != 0 || apdu[3] != TAG_GET_RESPONSE) {
+        return -1;
+    }
+    memset(resp, 0, sizeof(*resp));
+    resp->type = apdu[4];
+    resp->invoke_id = apdu[5];
+    const uint8_t *p = apdu + 6;
+    size_t n = len - 6;
+    switch (resp->type) {
+        case DLMS_GET_NORMAL:
+            if (p[0] != 0x00) {
+                resp->dar = n >= 2 && p[1] ? p[1] : -1;
+                return resp->dar > 0 ? 0 : -1;
+            }
+            resp->data = p + 1;
+            resp->data_len = n - 1;
+            return 0;
+        case DLMS_GET_NEXT: {
+            if (n < 6) {
+                return -1;
+            }
+            resp->last_block = p[0] != 0;
+            resp->block_number = ((uint32_t) p[1] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 8) | p[4];
+            if (p[5] != 0x00) {
+                resp->dar = n >= 7 && p[6] ? p[6] : -1;
+                return resp->dar > 0 ? 0 : -1;
+            }
+            size_t raw_len;
+            const size_t used = dlms_axdr_length(p + 6, n - 6, &raw_len);
+            if (!used || 6 + used + raw_len > n) {
+                return -1;
+            }
+            resp->data = p + 6 + used;
+            resp->data_len = raw_len;
+            return 0;
+        }
+        case DLMS_GET_WITH_LIST:
+            resp->data = p;
+            resp->data_len = n;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+size_t dlms_cosem_list_result(const uint8_t *p, size_t len, int *dar, const uint8_t **data, size_t *data_len) {
+    if (len < 2) {
+        return 0;
+    }
+    if (p[0] != 0x00) {
+        *dar = p[1] ? p[1] : -1;
+        return 2;
+    }
+    const size_t size = dlms_data_size(p + 1, len - 1);
+    if (!size) {
+        return 0;
+    }
+    *dar = 0;
+    *data = p + 1;
+    *data_len = size;
+    return 1 + size;
+}
+
+static size_t data_size(const uint8_t *data, size_t len, int depth) {
+    if (len < 1 || depth > 8) {
+        return 0;
+    }
+    size_t fixed;
+    switch (data[0]) {
+        case DT_NULL: return 1;
+        case DT_BOOLEAN:
+        case DT_INTEGER:
+        case DT_UNSIGNED:
+        case DT_ENUM:
+        case DT_BCD: fixed = 1; break;
+        case DT_LONG:
+        case DT_LONG_UNSIGNED: fixed = 2; break;
+        case DT_DOUBLE_LONG:
+        case DT_DOUBLE_LONG_UNSIGNED:
+        case DT_FLOAT32:
+        case DT_TIME: fixed = 4; break;
+        case DT_DATE: fixed = 5; break;
+        case DT_LONG64:
+        case DT_LONG64_UNSIGNED:
+        case DT_FLOAT64: fixed = 8; break;
+        case DT_DATE_TIME: fixed = 12; break;
+        case DT_OCTET_STRING:
+        case DT_VISIBLE_STRING:
+        case DT_UTF8_STRING:
+        case DT_BIT_STRING: {
+            size_t n;
+            const size_t used = dlms_axdr_length(data + 1, len - 1, &n);
+            if (!used) {
+                return 0;
+            }
+            if (data[0] == DT_BIT_STRING) {
+                n = (n + 7) / 8;
+            }
+            return 1 + used + n <= len ? 1 + used + n : 0;
+        }
+        case DT_ARRAY:
+        case DT_STRUCTURE: {
+            size_t count;
+            size_t off = dlms_axdr_length(data + 1, len - 1, &count);
+            if (!off) {
+                return 0;
+            }
+            off += 1;
+            for (size_t i = 0; i < count; i++) {
+                const size_t item = data_size(data + off, len - off, depth + 1);
+                if (!item) {
+                    return 0;
+                }
+                off += item;
+            }
+            return off;
+        }
+        default: return 0;
+    }
+    return 1 + fixed <= len ? 1 + fixed : 0;
+}
+
+size_t dlms_data_size(const uint8_t *data, size_t len) {
+    return data_size(data, len, 0);
+}
+
+static uint64_t get_be(const uint8_t *p, size_t n) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+int dlms_data_to_double(const uint8_t *data, size_t len, double *value, size_t *used) {
+    if (len < 2) {
+        return -1;
+    }
+    size_t size;
+    switch (data[0]) {
+        case DT_BOOLEAN:
+        case DT_INTEGER:
+        case DT_UNSIGNED:
+        case DT_ENUM:
+            size = 1;
+            break;
+        case DT_LONG:
+        case DT_LONG_UNSIGNED:
+            size = 2;
+            break;
+        case DT_DOUBLE_LONG:
+        case DT_DOUBLE_LONG_UNSIGNED:
+        case DT_FLOAT32:
+            size = 4;
+            break;
+        case DT_LONG64:
+        case DT_LONG64_UNSIGNED:
+        case DT_FLOAT64:
+            size = 8;
+            break;
+        default:
+            return -1;
+    }
+    if (len < 1 + size) {
+        return -1;
+    }
+    const uint64_t raw = get_be(data + 1, size);
+    switch (data[0]) {
+        case DT_INTEGER: *value = (int8_t) raw; break;
+        case DT_LONG: *value = (int16_t) raw; break;
+        case DT_DOUBLE_LONG: *value = (int32_t) raw; break;
+        case DT_LONG64: *value = (double) (int64_t) raw; break;
+        case DT_FLOAT32: {
+            const uint32_t bits = (uint32_t) raw;
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            *value = f;
+            break;
+        }
+        case DT_FLOAT64: {
+            double d;
+            memcpy(&d, &raw, sizeof(d));
+            *value = d;
+            break;
+        }
+        default: *value = (double) raw; break;
+    }
+    if (used) {
+        *used = 1 + size;
+    }
+    return 0;
+}
+
+int dlms_data_scaler_unit(const uint8_t *data, size_t len, int8_t *scaler, uint8_t *unit) {
+    if (len < 6 || data[0] != DT_STRUCTURE || data[1] != 2 || data[2] != DT_INTEGER || data[4] != DT_ENUM) {
+        return -1;
+    }
+    *scaler = (int8_t) data[3];
+    *unit = data[5];
+    return 0;
+}
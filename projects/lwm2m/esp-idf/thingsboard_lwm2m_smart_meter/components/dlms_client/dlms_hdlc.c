@@ -0,0 +1,252 @@
+#include "dlms_hdlc.h"
+
+#include <string.h>
+
+#define FORMAT_TYPE_3 0xA000
+#define FORMAT_SEGMENTED 0x0800
+#define FORMAT_LEN_MASK 0x07FF
+
+uint16_t dlms_hdlc_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (uint16_t) ((crc >> 1) ^ 0x8408) : (uint16_t) (crc >> 1);
+        }
+    }
+    return (uint16_t) ~crc;
+}
+
+uint32_t dlms_hdlc_server_address(uint16_t logical, uint16_t physical) {
+    if (logical < 0x80 && physical < 0x80) {
+        return ((uint32_t) logical << 7) | physical;
+    }
+    // Four bytes: 14 bits each, marked by dlms_hdlc_build() with the length
+    return 0x80000000u | ((uint32_t) (logical & 0x3FFF) << 14) | (physical & 0x3FFF);
+}
+
+// Encoded byte count is implied: < 0x80 one byte, < 0x4000 two, flagged four
+static size_t encode_address(uint32_t value, uint8_t *out) {
+    if (value & 0x80000000u) {
+        const uint32_t upper = (value >> 14) & 0x3FFF;
+        const uint32_t lower = value & 0x3FFF;
+        out[0] = (uint8_t) (((upper >> 7) & 0x7F) << 1);
+        out[1] = (uint8_t) ((upper & 0x7F) << 1);
+        out[2] = (uint8_t) (((lower >> 7) & 0x7F) << 1);
+        out[3] = (uint8_t) (((lower & 0x7F) << 1) | 1);
+        return 4;
+    }
+    if (value < 0x80) {
+        out[0] = (uint8_t) ((value << 1) | 1);
+        return 1;
+    }
+    out[0] = (uint8_t) (((value >> 7) & 0x7F) << 1);
+    out[1] = (uint8_t) (((value & 0x7F) << 1) | 1);
+    return 2;
+}
+
+// Returns the bytes used (1, 2 or 4), or 0 if malformed/truncated
+static size_t decode_address(const uint8_t *p, size_t avail, uint32_t *value) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < avail && i < 4; i++) {
+        v = (v << 7) | (p[i] >> 1);
+        if (p[i] & 1) {
+            if (i == 2) {
+                return 0; // 3-byte addresses do not exist
+            }
+            *value = i == 3 ? 0x80000000u | v : v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+int dlms_hdlc_build(uint8_t *out, size_t size, uint8_t control, uint32_t dest, uint32_t src,
+                    const uint8_t *info, size_t info_len, bool segmented) {
+    uint8_t addr[8];
+    const size_t dest_len = encode_address(dest, addr);
+    const size_t src_len = encode_address(src, addr + dest_len);
+    const size_t header_len = 2 + dest_len + src_len + 1;
+    const size_t body_len = header_len + (info_len ? 2 + info_len : 0) + 2;
+    if (body_len > FORMAT_LEN_MASK || body_len + 2 > size) {
+        return -1;
+    }
+    const uint16_t format = (uint16_t) (FORMAT_TYPE_3 | (segmented ? FORMAT_SEGMENTED : 0) | body_len);
+    size_t n = 0;
+    out[n++] = DLMS_HDLC_FLAG;
+    out[n++] = (uint8_t) (format >> 8);
+    out[n++] = (uint8_t) format;
+    memcpy(out + n, addr, dest_len + src_len);
+    n += dest_len + src_len;
+    out[n++] = control;
+    if (info_len) {
+        const uint16_t hcs = dlms_hdlc_crc16(out + 1, header_len);
+        out[n++] = (uint8_t) hcs;
+        out[n++] = (uint8_t) (hcs >> 8);
+        memcpy(out + n, info, info_len);
+        n += info_len;
+    }
+    const uint16_t fcs = dlms_hdlc_crc16(out + 1, n - 1);
+    out[n++] = (uint8_t) fcs;
+    out[n++] = (uint8_t) (fcs >> 8);
+    out[n++] = DLMS_HDLC_FLAG;
+    return (int) n;
+}
+
+int dlms_hdlc_parse(const uint8_t *raw, size_t len, dlms_hdlc_frame_t *frame) {
+    if (len < 9 || raw[0] != DLMS_HDLC_FLAG || raw[len - 1] != DLMS_HDLC_FLAG) {
+        return -1;
+    }
+    const uint16_t format = (uint16_t) ((raw[1] << 8) | raw[2]);
+    if ((format & 0xF000) != FORMAT_TYPE_3 || (size_t) (format & FORMAT_LEN_MASK) != len - 2) {
+        return -1;
+    }
+    const uint8_t *body = raw + 1;
+    const size_t body_len = len - 2;
+    size_t idx = 2;
+    size_t used = decode_address(body + idx, body_len - idx, &frame->dest);
+    if (!used) {
+        return -1;
+    }
+    idx += used;
+    used = decode_address(body + idx, body_len - idx, &frame->src);
+    if (!used) {
+        return -1;
+    }
+    idx += used;
+    if (idx + 1 + 2 > body_len) {
+        return -1;
+    }
+    frame->control = body[idx++];
+    const size_t header_len = idx;
+
+    const uint16_t fcs = (uint16_t) (body[body_len - 2] | (body[body_len - 1] << 8));
+    if (dlms_hdlc_crc16(body, body_len - 2) != fcs) {
+        return -1;
+    }
+    frame->segmented = (format & FORMAT_SEGMENTED) != 0;
+    frame->info = NULL;
+    frame->info_len = 0;
+    if (body_len - 2 > header_len) {
+        if (body_len - 2 < header_len + 2) {
+            return -1;
+        }
+        const uint16_t hcs = (uint16_t) (body[header_len] | (body[header_len + 1] << 8));
+        if (dlms_hdlc_crc16(body, header_len) != hcs) {
+            return -1;
+        }
+        frame->info = body + header_len + 2;
+        frame->info_len = body_len - 2 - header_len - 2;
+    }
+    return 0;
+}
+
+#define PARAM_FORMAT 0x81
+#define PARAM_GROUP 0x80
+#define PARAM_MAX_INFO_TX 0x05
+#define PARAM_MAX_INFO_RX 0x06
+#define PARAM_WINDOW_TX 0x07
+#define PARAM_WINDOW_RX 0x08
+
+size_t dlms_hdlc_build_params(uint8_t *out, const dlms_hdlc_params_t *params) {
+    const uint8_t info[] = {
+        PARAM_FORMAT, PARAM_GROUP, 0x14,
+        PARAM_MAX_INFO_TX, 0x02, (uint8_t) (params->max_info_tx >> 8), (uint8_t) params->max_info_tx,
+        PARAM_MAX_INFO_RX, 0x02, (uint8_t) (params->max_info_rx >> 8), (uint8_t) params->max_info_rx,
+        PARAM_WINDOW_TX, 0x04, 0x00, 0x00, 0x00, params->window_tx,
+        PARAM_WINDOW_RX, 0x04, 0x00, 0x00, 0x00, params->window_rx,
+    };
+    memcpy(out, info, sizeof(info));
+    return sizeof(info);
+}
+
+int dlms_hdlc_parse_params(const uint8_t *info, size_t info_len, dlms_hdlc_params_t *params) {
+    params->max_info_tx = 128;
+    params->max_info_rx = 128;
+    params->window_tx = 1;
+    params->window_rx = 1;
+    if (info_len == 0) {
+        return 0;
+    }
+    if (info_len < 3 || info[0] != PARAM_FORMAT || info[1] != PARAM_GROUP || (size_t) info[2] + 3 > info_len) {
+        return -1;
+    }
+    // Up to the end of the field: dlms-bridge sends group length 0x12 for 20 bytes
+    const size_t end = info_len;
+    for (size_t i = 3; i + 2 <= end;) {
+        const uint8_t id = info[i];
+        const size_t len = info[i + 1];
+        if (len > 4 || i + 2 + len > end) {
+            return -1;
+        }
+        uint32_t v = 0;
+        for (size_t k = 0; k < len; k++) {
+            v = (v << 8) | info[i + 2 + k];
+        }
+        switch (id) {
+            case PARAM_MAX_INFO_TX: params->max_info_tx = (uint16_t) v; break;
+            case PARAM_MAX_INFO_RX: params->max_info_rx = (uint16_t) v; break;
+            case PARAM_WINDOW_TX: params->window_tx = (uint8_t) (v < 1 ? 1 : v > 7 ? 7 : v); break;
+            case PARAM_WINDOW_RX: params->window_rx = (uint8_t) (v < 1 ? 1 : v > 7 ? 7 : v); break;
+            default: break;
+        }
+        i += 2 + len;
+    }
+    return 0;
+}
+
+void dlms_hdlc_rx_reset(dlms_hdlc_rx_t *rx) {
+    rx->len = 0;
+    rx->frame_len = 0;
+}
+
+int dlms_hdlc_rx_feed(dlms_hdlc_rx_t *rx, const uint8_t *data, size_t len, size_t *consumed,
+                      dlms_hdlc_frame_t *frame) {
+    size_t i = 0;
+    while (i < len) {
+        const uint8_t byte = data[i++];
+        if (rx->len == 0) {
+            // Hunting for the opening flag
+            if (byte == DLMS_HDLC_FLAG) {
+                rx->buf[rx->len++] = byte;
+            } else {
+                rx->dropped_bytes++;
+            }
+            continue;
+        }
+        if (rx->len == 1 && byte == DLMS_HDLC_FLAG) {
+            continue; // closing flag of the previous frame or idle fill
+        }
+        rx->buf[rx->len++] = byte;
+        if (rx->len == 3) {
+            const uint16_t format = (uint16_t) ((rx->buf[1] << 8) | rx->buf[2]);
+            const size_t body_len = format & FORMAT_LEN_MASK;
+            if ((format & 0xF000) != FORMAT_TYPE_3 || body_len < 7) {
+                // Not a frame start: resync on this byte if it is a flag
+                rx->dropped_bytes += 2;
+                dlms_hdlc_rx_reset(rx);
+                if (byte == DLMS_HDLC_FLAG) {
+                    rx->buf[rx->len++] = byte;
+                    rx->dropped_bytes--;
+                }
+                continue;
+            }
+            rx->frame_len = body_len + 2;
+        }
+        if (rx->frame_len && rx->len == rx->frame_len) {
+            const size_t frame_len = rx->frame_len;
+            dlms_hdlc_rx_reset(rx);
+            // The closing flag may also open the next frame
+            if (byte == DLMS_HDLC_FLAG) {
+                rx->len = 1;
+            }
+            if (dlms_hdlc_parse(rx->buf, frame_len, frame) == 0) {
+                *consumed = i;
+                return 1;
+            }
+            rx->crc_errors++;
+        }
+    }
+    *consumed = i;
+    return 0;
+}
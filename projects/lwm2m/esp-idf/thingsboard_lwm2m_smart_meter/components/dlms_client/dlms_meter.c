@@ -0,0 +1,324 @@
+#include "dlms_meter.h"
+
+#include <string.h>
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "dlms_client.h"
+
+#ifndef CONFIG_DLMS_METER_UART_NUM
+#define CONFIG_DLMS_METER_UART_NUM 1
+#endif
+#ifndef CONFIG_DLMS_METER_TX_GPIO
+#define CONFIG_DLMS_METER_TX_GPIO 5
+#endif
+#ifndef CONFIG_DLMS_METER_RX_GPIO
+#define CONFIG_DLMS_METER_RX_GPIO 4
+#endif
+#ifndef CONFIG_DLMS_METER_DE_GPIO
+#define CONFIG_DLMS_METER_DE_GPIO -1
+#endif
+#ifndef CONFIG_DLMS_METER_BAUD
+#define CONFIG_DLMS_METER_BAUD 9600
+#endif
+#ifndef CONFIG_DLMS_METER_SERVER_LOGICAL
+#define CONFIG_DLMS_METER_SERVER_LOGICAL 1
+#endif
+#ifndef CONFIG_DLMS_METER_SERVER_PHYSICAL
+#define CONFIG_DLMS_METER_SERVER_PHYSICAL 1
+#endif
+#ifndef CONFIG_DLMS_METER_CLIENT_SAP
+#define CONFIG_DLMS_METER_CLIENT_SAP 16
+#endif
+#ifndef CONFIG_DLMS_METER_PASSWORD
+#define CONFIG_DLMS_METER_PASSWORD "22222222"
+#endif
+#ifndef CONFIG_DLMS_METER_MAX_INFO_LEN
+#define CONFIG_DLMS_METER_MAX_INFO_LEN 128
+#endif
+#ifndef CONFIG_DLMS_METER_WINDOW
+#define CONFIG_DLMS_METER_WINDOW 7
+#endif
+#ifndef CONFIG_DLMS_METER_RESPONSE_TIMEOUT_MS
+#define CONFIG_DLMS_METER_RESPONSE_TIMEOUT_MS 1000
+#endif
+#ifndef CONFIG_DLMS_METER_POLL_MS
+#define CONFIG_DLMS_METER_POLL_MS 1000
+#endif
+#ifndef CONFIG_DLMS_METER_STALE_S
+#define CONFIG_DLMS_METER_STALE_S 10
+#endif
+#ifndef CONFIG_DLMS_METER_TASK_PRIORITY
+#define CONFIG_DLMS_METER_TASK_PRIORITY 2
+#endif
+
+#define METER_UART ((uart_port_t) CONFIG_DLMS_METER_UART_NUM)
+#define UART_RX_BUF 1024
+#define RECONNECT_MIN_MS 1000
+#define RECONNECT_MAX_MS 30000
+
+static const char *TAG = "dlms_meter";
+
+typedef struct {
+    const char *obis_text;
+    uint8_t unit;   // expected COSEM unit, DLMS_UNIT_NONE for power factor
+    float to_sm;    // factor from the base unit to the Object 10243 unit
+    uint8_t obis[6];
+    int8_t scaler;
+    bool supported; // scaler read and value not refused
+} meter_reg_t;
+
+// Channel B=1 as in the Microstar register list read by dlms-bridge
+static meter_reg_t s_regs[DLMS_METER_COUNT] = {
+    [DLMS_METER_VOLTAGE] = { "1-1:32.7.0", DLMS_UNIT_V, 1.0f },
+    [DLMS_METER_CURRENT] = { "1-1:31.7.0", DLMS_UNIT_A, 1.0f },
+    [DLMS_METER_FREQUENCY] = { "1-1:14.7.0", DLMS_UNIT_HZ, 1.0f },
+    [DLMS_METER_ACTIVE_POWER] = { "1-1:1.7.0", DLMS_UNIT_W, 0.001f },
+    [DLMS_METER_REACTIVE_POWER] = { "1-1:3.7.0", DLMS_UNIT_VAR, 0.001f },
+    [DLMS_METER_APPARENT_POWER] = { "1-1:9.7.0", DLMS_UNIT_VA, 0.001f },
+    [DLMS_METER_POWER_FACTOR] = { "1-1:13.7.0", DLMS_UNIT_NONE, 1.0f },
+    [DLMS_METER_ACTIVE_ENERGY] = { "1-1:1.8.0", DLMS_UNIT_WH, 0.001f },
+    [DLMS_METER_REACTIVE_ENERGY] = { "1-1:3.8.0", DLMS_UNIT_VARH, 0.001f },
+    [DLMS_METER_APPARENT_ENERGY] = { "1-1:9.8.0", DLMS_UNIT_VAH, 0.001f },
+};
+
+static TaskHandle_t s_task;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static dlms_meter_readings_t s_latest;
+static TickType_t s_latest_at;
+
+static int uart_port_write(void *ctx, const uint8_t *data, size_t len) {
+    return uart_write_bytes(METER_UART, data, len) == (int) len ? 0 : -1;
+}
+
+// Waits for the first byte only, then takes whatever the driver has already
+// buffered: the HDLC receiver assembles frames from partial reads
+static int uart_port_read(void *ctx, uint8_t *buf, size_t size, int timeout_ms) {
+    int n = uart_read_bytes(METER_UART, buf, 1, pdMS_TO_TICKS(timeout_ms));
+    if (n <= 0) {
+        return n;
+    }
+    size_t avail = 0;
+    uart_get_buffered_data_len(METER_UART, &avail);
+    if (avail > size - 1) {
+        avail = size - 1;
+    }
+    if (avail) {
+        const int more = uart_read_bytes(METER_UART, buf + 1, avail, 0);
+        if (more > 0) {
+            n += more;
+        }
+    }
+    return n;
+}
+
+static int uart_setup(void) {
+    const uart_config_t cfg = {
+        .baud_rate = CONFIG_DLMS_METER_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    esp_err_t err = uart_driver_install(METER_UART, UART_RX_BUF, 0, 0, NULL, 0);
+    if (err == ESP_OK) {
+        err = uart_param_config(METER_UART, &cfg);
+    }
+    if (err == ESP_OK) {
+        err = uart_set_pin(METER_UART, CONFIG_DLMS_METER_TX_GPIO, CONFIG_DLMS_METER_RX_GPIO,
+                           CONFIG_DLMS_METER_DE_GPIO, UART_PIN_NO_CHANGE);
+    }
+#if CONFIG_DLMS_METER_DE_GPIO >= 0
+    // RS-485 transceiver: the driver drives DE (RTS) while transmitting
+    if (err == ESP_OK) {
+        err = uart_set_mode(METER_UART, UART_MODE_RS485_HALF_DUPLEX);
+    }
+#endif
+    if (err == ESP_OK) {
+        // Interrupt once per burst rather than per byte: FIFO threshold plus
+        // an idle timeout of a few characters ends each frame
+        uart_set_rx_full_threshold(METER_UART, 64);
+        err = uart_set_rx_timeout(METER_UART, 3);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "UART%d setup failed: %s", CONFIG_DLMS_METER_UART_NUM, esp_err_to_name(err));
+        return -1;
+    }
+    return 0;
+}
+
+// Attribute references of the supported registers; map[k] is the register of refs[k]
+static size_t build_refs(uint8_t attribute, bool all, dlms_attr_ref_t *refs, int *map) {
+    size_t n = 0;
+    for (int i = 0; i < DLMS_METER_COUNT; i++) {
+        if (!all && !s_regs[i].supported) {
+            continue;
+        }
+        refs[n].class_id = DLMS_CLASS_REGISTER;
+        memcpy(refs[n].obis, s_regs[i].obis, sizeof(refs[n].obis));
+        refs[n].attribute = attribute;
+        map[n++] = i;
+    }
+    return n;
+}
+
+// Scaler and unit of every register in one GET-WITH-LIST request
+static void read_scalers(dlms_client_t *client) {
+    dlms_attr_ref_t refs[DLMS_METER_COUNT];
+    dlms_get_result_t results[DLMS_METER_COUNT];
+    int map[DLMS_METER_COUNT];
+    uint8_t buf[DLMS_METER_COUNT * 8];
+    const size_t n = build_refs(DLMS_ATTR_SCALER_UNIT, true, refs, map);
+    const int err = dlms_client_get_list(client, refs, n, results, buf, sizeof(buf));
+    for (size_t k = 0; k < n; k++) {
+        meter_reg_t *r = &s_regs[map[k]];
+        uint8_t unit = DLMS_UNIT_NONE;
+        const int item_err = err ? err
+            : results[k].err ? results[k].err
+            : dlms_data_scaler_unit(results[k].data, results[k].len, &r->scaler, &unit) == 0 ? DLMS_OK
+            : DLMS_ERR_DATA;
+        r->supported = item_err == DLMS_OK;
+        if (item_err == DLMS_OK && r->unit != DLMS_UNIT_NONE && unit != r->unit) {
+            ESP_LOGW(TAG, "%s reports unit %u, expected %u", r->obis_text, unit, r->unit);
+        } else if (item_err != DLMS_OK) {
+            ESP_LOGW(TAG, "%s not available: %s", r->obis_text, dlms_err_str(item_err));
+        }
+    }
+}
+
+// Values of the supported registers, batched; false if the association was lost
+static bool poll_once(dlms_client_t *client, dlms_meter_readings_t *out) {
+    dlms_attr_ref_t refs[DLMS_METER_COUNT];
+    dlms_get_result_t results[DLMS_METER_COUNT];
+    int map[DLMS_METER_COUNT];
+    uint8_t buf[DLMS_METER_COUNT * 16];
+    out->valid = 0;
+    const size_t n = build_refs(DLMS_ATTR_VALUE, false, refs, map);
+    if (!n) {
+        return true;
+    }
+    const uint32_t round_trips = client->round_trips;
+    const int err = dlms_client_get_list(client, refs, n, results, buf, sizeof(buf));
+    out->round_trips = client->round_trips - round_trips;
+    if (err) {
+        ESP_LOGW(TAG, "Register read failed: %s", dlms_err_str(err));
+        return false;
+    }
+    for (size_t k = 0; k < n; k++) {
+        meter_reg_t *r = &s_regs[map[k]];
+        double raw;
+        if (results[k].err || dlms_data_to_double(results[k].data, results[k].len, &raw, NULL) != 0) {
+            r->supported = false;
+            ESP_LOGW(TAG, "%s skipped: %s", r->obis_text,
+                     dlms_err_str(results[k].err ? results[k].err : DLMS_ERR_DATA));
+            continue;
+        }
+        double v = raw;
+        for (int s = r->scaler; s > 0; s--) {
+            v *= 10.0;
+        }
+        for (int s = r->scaler; s < 0; s++) {
+            v /= 10.0;
+        }
+        out->value[map[k]] = (float) v * r->to_sm;
+        out->valid |= 1u << map[k];
+    }
+    return true;
+}
+
+static void dlms_meter_task(void *arg) {
+    static dlms_client_t client;
+    const dlms_port_t port = { .write = uart_port_write, .read = uart_port_read, .ctx = NULL };
+    const dlms_client_config_t cfg = {
+        .server_logical = CONFIG_DLMS_METER_SERVER_LOGICAL,
+        .server_physical = CONFIG_DLMS_METER_SERVER_PHYSICAL,
+        .client_sap = CONFIG_DLMS_METER_CLIENT_SAP,
+        .password = CONFIG_DLMS_METER_PASSWORD,
+        .max_info_len = CONFIG_DLMS_METER_MAX_INFO_LEN,
+        .window = CONFIG_DLMS_METER_WINDOW,
+        .timeout_ms = CONFIG_DLMS_METER_RESPONSE_TIMEOUT_MS,
+    };
+    dlms_client_init(&client, &port, &cfg);
+
+    uint32_t backoff_ms = RECONNECT_MIN_MS;
+    dlms_meter_readings_t readings = { 0 };
+    TickType_t wake = xTaskGetTickCount();
+    for (;;) {
+        if (!client.connected) {
+            const int err = dlms_client_connect(&client);
+            if (err != DLMS_OK) {
+                ESP_LOGW(TAG, "Association failed: %s, retry in %u ms", dlms_err_str(err), (unsigned) backoff_ms);
+                vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+                backoff_ms = backoff_ms * 2 > RECONNECT_MAX_MS ? RECONNECT_MAX_MS : backoff_ms * 2;
+                continue;
+            }
+            backoff_ms = RECONNECT_MIN_MS;
+            read_scalers(&client);
+            ESP_LOGI(TAG, "Associated with meter %u/%u (info %u, window %u, PDU %u, %s)",
+                     CONFIG_DLMS_METER_SERVER_LOGICAL, CONFIG_DLMS_METER_SERVER_PHYSICAL,
+                     (unsigned) client.max_info_tx, (unsigned) client.window_tx, (unsigned) client.server_max_pdu,
+                     (client.conformance & DLMS_CONFORMANCE_MULTIPLE_REFS) ? "GET-WITH-LIST" : "one GET per register");
+            wake = xTaskGetTickCount();
+        }
+
+        const TickType_t start = xTaskGetTickCount();
+        const bool ok = poll_once(&client, &readings);
+        if (readings.valid) {
+            readings.polls++;
+            readings.cycle_ms = (uint32_t) pdTICKS_TO_MS(xTaskGetTickCount() - start);
+            ESP_LOGD(TAG, "Poll %u: %u round trip(s), %u ms", (unsigned) readings.polls,
+                     (unsigned) readings.round_trips, (unsigned) readings.cycle_ms);
+            portENTER_CRITICAL(&s_lock);
+            s_latest = readings;
+            s_latest_at = xTaskGetTickCount();
+            portEXIT_CRITICAL(&s_lock);
+        }
+        if (!ok) {
+            dlms_client_disconnect(&client);
+            continue;
+        }
+        // A slow meter stretches the cycle instead of queueing polls
+        if (xTaskGetTickCount() - wake >= pdMS_TO_TICKS(CONFIG_DLMS_METER_POLL_MS)) {
+            wake = xTaskGetTickCount();
+        } else {
+            vTaskDelayUntil(&wake, pdMS_TO_TICKS(CONFIG_DLMS_METER_POLL_MS));
+        }
+    }
+}
+
+int dlms_meter_start(void) {
+    if (s_task) {
+        return 0;
+    }
+    for (int i = 0; i < DLMS_METER_COUNT; i++) {
+        if (dlms_obis_parse(s_regs[i].obis_text, s_regs[i].obis) != 0) {
+            ESP_LOGE(TAG, "Bad OBIS code %s", s_regs[i].obis_text);
+            return -1;
+        }
+    }
+    if (uart_setup() != 0) {
+        return -1;
+    }
+    if (xTaskCreate(dlms_meter_task, "dlms_meter", 4096, NULL, CONFIG_DLMS_METER_TASK_PRIORITY, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create meter task");
+        s_task = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+bool dlms_meter_latest(dlms_meter_readings_t *out) {
+    portENTER_CRITICAL(&s_lock);
+    const bool fresh = s_latest.polls
+        && (xTaskGetTickCount() - s_latest_at) <= pdMS_TO_TICKS(CONFIG_DLMS_METER_STALE_S * 1000);
+    if (fresh) {
+        *out = s_latest;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return fresh;
+}
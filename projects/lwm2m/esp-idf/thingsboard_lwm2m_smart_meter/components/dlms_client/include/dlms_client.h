@@ -0,0 +1,123 @@
+#pragma once
+
+// DLMS/COSEM client over HDLC: SNRM/UA, AARQ/AARE (low level security),
+// GET normal and GET-WITH-LIST, and DISC. Same exchange as
+// dlms-bridge/dlms_reader.py, but byte I/O goes through a dlms_port_t so the
+// client runs on a UART on the ESP32 and on a pty in the host tests.
+// Responses are assembled by the non-blocking HDLC receiver from whatever
+// chunks the port returns.
+//
+// One round trip is one poll to the meter and the frames it sends back.
+// Requests longer than the negotiated information field are segmented and
+// sent back to back within the negotiated window. Segmented responses are
+// acknowledged with RR once per window. Responses above the max PDU size
+// come as blocks (with-datablock), which are fetched with GET next. A
+// snapshot of n registers therefore costs one round trip when the list
+// fits in one PDU, where the bridge needs 2n.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dlms_cosem.h"
+#include "dlms_hdlc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DLMS_OK = 0,
+    DLMS_ERR_IO = -1,          // port write/read failed
+    DLMS_ERR_TIMEOUT = -2,     // no response within timeout_ms
+    DLMS_ERR_PROTOCOL = -3,    // unexpected frame, sequence or APDU
+    DLMS_ERR_REJECTED = -4,    // association rejected (wrong password/SAP)
+    DLMS_ERR_ACCESS = -5,      // meter refused the attribute (data-access-result)
+    DLMS_ERR_DATA = -6,        // value not numeric or does not fit
+    DLMS_ERR_NOT_CONNECTED = -7,
+} dlms_err_t;
+
+// Byte transport. read() waits at most timeout_ms for the first byte and
+// returns what is available (may be a partial frame): bytes read, 0 on
+// timeout, -1 on error. write() returns 0 or -1.
+typedef struct {
+    int (*write)(void *ctx, const uint8_t *data, size_t len);
+    int (*read)(void *ctx, uint8_t *buf, size_t size, int timeout_ms);
+    void *ctx;
+} dlms_port_t;
+
+typedef struct {
+    uint16_t server_logical;  // upper HDLC address, usually 1 (management)
+    uint16_t server_physical; // lower HDLC address
+    uint8_t client_sap;       // 16 public client, 1 management
+    const char *password;     // LLS, 1..16 characters
+    uint16_t max_info_len;    // proposed in SNRM; 0 sends SNRM without parameters
+    uint8_t window;           // proposed HDLC window, 1..7 (ignored without SNRM parameters)
+    int timeout_ms;           // per response
+} dlms_client_config_t;
+
+// One result of dlms_client_get_list()
+typedef struct {
+    int err;             // DLMS_OK, DLMS_ERR_ACCESS or DLMS_ERR_DATA
+    const uint8_t *data; // A-XDR Data inside the caller's buffer
+    size_t len;
+} dlms_get_result_t;
+
+#define DLMS_CLIENT_APDU_MAX DLMS_CLIENT_MAX_PDU
+
+typedef struct {
+    dlms_port_t port;
+    dlms_client_config_t cfg;
+    uint32_t server_addr;
+    uint8_t ns; // N(S) of the next I-frame we send
+    uint8_t nr; // N(R): next I-frame expected from the meter
+    uint8_t invoke_id;
+    bool connected;
+    // Negotiated at association
+    uint16_t max_info_tx;
+    uint8_t window_tx;
+    uint16_t server_max_pdu;
+    uint32_t conformance;
+    dlms_hdlc_rx_t rx;
+    uint8_t in[64]; // bytes read past the end of the last frame
+    size_t in_len;
+    size_t in_off;
+    uint8_t tx[256];
+    uint8_t apdu[DLMS_CLIENT_APDU_MAX];  // response APDU reassembled from HDLC segments
+    size_t apdu_len;
+    uint8_t blocks[DLMS_CLIENT_APDU_MAX]; // GET data reassembled from blocks
+    uint32_t requests;    // APDUs sent
+    uint32_t round_trips; // polls sent to the meter
+    uint32_t timeouts;
+} dlms_client_t;
+
+void dlms_client_init(dlms_client_t *client, const dlms_port_t *port, const dlms_client_config_t *cfg);
+
+// SNRM + AARQ. Returns DLMS_OK or a dlms_err_t.
+int dlms_client_connect(dlms_client_t *client);
+
+// DISC; best effort, the client is disconnected afterwards in any case
+void dlms_client_disconnect(dlms_client_t *client);
+
+// GET of one attribute: A-XDR encoded value copied to buf, length in *len
+int dlms_client_get(dlms_client_t *client, uint16_t class_id, const uint8_t obis[6], uint8_t attribute,
+                    uint8_t *buf, size_t size, size_t *len);
+
+// GET of several attributes with GET-WITH-LIST, split into as few requests as
+// the server max PDU allows. Falls back to one GET per attribute if the meter
+// did not grant multiple references. Values are copied into buf. Returns
+// DLMS_OK when every attribute got an answer (refused or not), with
+// results[i].err per attribute, or the dlms_err_t that broke the exchange.
+int dlms_client_get_list(dlms_client_t *client, const dlms_attr_ref_t *refs, size_t count,
+                         dlms_get_result_t *results, uint8_t *buf, size_t size);
+
+// Register (class 3) helpers
+int dlms_client_get_scaler_unit(dlms_client_t *client, const uint8_t obis[6], int8_t *scaler, uint8_t *unit);
+// Raw register value, without the scaler applied
+int dlms_client_get_value(dlms_client_t *client, const uint8_t obis[6], double *value);
+
+const char *dlms_err_str(int err);
+
+#ifdef __cplusplus
+}
+#endif
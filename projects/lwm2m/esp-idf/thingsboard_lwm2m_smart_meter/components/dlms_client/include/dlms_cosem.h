@@ -0,0 +1,112 @@
+#pragma once
+
+// COSEM application layer subset for a client reading registers: AARQ with
+// low level security, GET.request normal / next / with-list, the matching
+// responses (including with-datablock) and A-XDR data decoding. APDUs are
+// built with the LLC header (E6 E6 00) and parsed with it (E6 E7 00).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DLMS_CLASS_REGISTER 3
+#define DLMS_ATTR_VALUE 2
+#define DLMS_ATTR_SCALER_UNIT 3
+
+// COSEM unit codes (subset, Blue Book enumeration)
+#define DLMS_UNIT_W 27
+#define DLMS_UNIT_VA 28
+#define DLMS_UNIT_VAR 29
+#define DLMS_UNIT_WH 30
+#define DLMS_UNIT_VAH 31
+#define DLMS_UNIT_VARH 32
+#define DLMS_UNIT_A 33
+#define DLMS_UNIT_V 35
+#define DLMS_UNIT_HZ 44
+#define DLMS_UNIT_NONE 255
+
+// Conformance block bits (bit 0 is the most significant of the 24)
+#define DLMS_CONFORMANCE_BIT(n) (1u << (23 - (n)))
+#define DLMS_CONFORMANCE_BLOCK_GET DLMS_CONFORMANCE_BIT(11)
+#define DLMS_CONFORMANCE_MULTIPLE_REFS DLMS_CONFORMANCE_BIT(14)
+#define DLMS_CONFORMANCE_GET DLMS_CONFORMANCE_BIT(19)
+
+// Client max receive PDU size proposed in the AARQ
+#define DLMS_CLIENT_MAX_PDU 1200
+
+typedef struct {
+    uint32_t conformance; // negotiated
+    uint16_t max_pdu;     // server max receive PDU size
+} dlms_aare_t;
+
+typedef struct {
+    uint16_t class_id;
+    uint8_t obis[6];
+    uint8_t attribute;
+} dlms_attr_ref_t;
+
+#define DLMS_GET_NORMAL 0x01
+#define DLMS_GET_NEXT 0x02 // request: next block; response: with-datablock
+#define DLMS_GET_WITH_LIST 0x03
+
+typedef struct {
+    uint8_t type; // DLMS_GET_*
+    uint8_t invoke_id;
+    int dar;      // > 0: data-access-result (normal or block)
+    bool last_block;
+    uint32_t block_number;
+    // normal: the Data; with-datablock: the raw block; with-list: the
+    // result count followed by the Get-Data-Results
+    const uint8_t *data;
+    size_t data_len;
+} dlms_get_response_t;
+
+// "A-B:C.D.E*F" (F defaults to 255) or "A.B.C.D.E.F". Returns 0 or -1.
+int dlms_obis_parse(const char *text, uint8_t obis[6]);
+
+// AARQ, LN referencing, LLS password (1..16 bytes). Returns the length or 0.
+size_t dlms_cosem_build_aarq(uint8_t *out, size_t size, const char *password);
+
+// Returns 0 if the association was accepted, the association result (> 0)
+// if it was rejected, -1 if the AARE is malformed. aare (may be NULL) gets
+// the negotiated conformance and max PDU size of an accepted association.
+int dlms_cosem_parse_aare(const uint8_t *info, size_t len, dlms_aare_t *aare);
+
+// GET.request normal without selective access. Returns the length or 0.
+size_t dlms_cosem_build_get(uint8_t *out, size_t size, uint8_t invoke_id, uint16_t class_id,
+                            const uint8_t obis[6], uint8_t attribute);
+
+// GET.request with-list; the request for count references is 10 * count + 7 bytes
+size_t dlms_cosem_build_get_list(uint8_t *out, size_t size, uint8_t invoke_id, const dlms_attr_ref_t *refs,
+                                 size_t count);
+
+// GET.request next, acknowledging block block_number
+size_t dlms_cosem_build_get_next(uint8_t *out, size_t size, uint8_t invoke_id, uint32_t block_number);
+
+// Any GET.response. Returns 0, or -1 if malformed.
+int dlms_cosem_parse_get_response(const uint8_t *apdu, size_t len, dlms_get_response_t *resp);
+
+// Next Get-Data-Result of a with-list body: *dar > 0 for a refused
+// attribute, otherwise *data/*data_len is the Data. Returns the bytes used, 0 if malformed.
+size_t dlms_cosem_list_result(const uint8_t *p, size_t len, int *dar, const uint8_t **data, size_t *data_len);
+
+// A-XDR length (counts, octet-string sizes). Returns the bytes used, 0 if malformed.
+size_t dlms_axdr_length(const uint8_t *p, size_t len, size_t *value);
+
+// Size of one encoded Data (any type, nested structures included), 0 if malformed
+size_t dlms_data_size(const uint8_t *data, size_t len);
+
+// Numeric A-XDR value (integers of any width, enum, float32/64). Returns 0
+// and the bytes used, or -1 for other types or truncated data.
+int dlms_data_to_double(const uint8_t *data, size_t len, double *value, size_t *used);
+
+// Register scaler_unit structure {integer scaler, enum unit}
+int dlms_data_scaler_unit(const uint8_t *data, size_t len, int8_t *scaler, uint8_t *unit);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+
+// HDLC framing for DLMS/COSEM (IEC 62056-46), frame format type 3.
+// Frames are delimited by the length in the format field, not by the 0x7E
+// flags: DLMS HDLC does no byte stuffing, so 0x7E may appear inside a frame.
+// No dynamic memory and no platform calls; the receiver is fed whatever
+// bytes the port has and never blocks.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DLMS_HDLC_FLAG 0x7E
+// Largest frame accepted: 11-bit length field plus the two flags
+#define DLMS_HDLC_MAX_FRAME 2050
+
+// Control field values (poll/final bit set)
+#define DLMS_HDLC_SNRM 0x93
+#define DLMS_HDLC_DISC 0x53
+#define DLMS_HDLC_UA 0x73
+#define DLMS_HDLC_DM 0x1F
+#define DLMS_HDLC_PF 0x10 // poll/final bit
+
+// Link parameters carried by SNRM and UA, each from the sender's view.
+// Absent parameters default to 128 bytes and window 1.
+typedef struct {
+    uint16_t max_info_tx;
+    uint16_t max_info_rx;
+    uint8_t window_tx;
+    uint8_t window_rx;
+} dlms_hdlc_params_t;
+
+typedef struct {
+    uint32_t dest;
+    uint32_t src;
+    uint8_t control;
+    bool segmented;      // S bit: more segments of this APDU follow
+    const uint8_t *info; // points into the receiver buffer
+    size_t info_len;
+} dlms_hdlc_frame_t;
+
+// Incremental receiver. Keep one per port; the frame returned by
+// dlms_hdlc_rx_feed() stays valid until the next feed or reset.
+typedef struct {
+    uint8_t buf[DLMS_HDLC_MAX_FRAME];
+    size_t len;
+    size_t frame_len; // total length incl. flags once the format field is in
+    uint32_t crc_errors;
+    uint32_t dropped_bytes;
+} dlms_hdlc_rx_t;
+
+// CRC-16/X.25 as used for HCS and FCS; transmitted low byte first
+uint16_t dlms_hdlc_crc16(const uint8_t *data, size_t len);
+
+// Server address from upper (logical) and lower (physical) HDLC address:
+// one byte each when both are below 128, two each otherwise
+uint32_t dlms_hdlc_server_address(uint16_t logical, uint16_t physical);
+
+// Builds a complete frame (flags, format, addresses, HCS, FCS). Addresses
+// are the encoded values: client SAP, or dlms_hdlc_server_address().
+// Returns the frame length, or -1 if it does not fit in size.
+int dlms_hdlc_build(uint8_t *out, size_t size, uint8_t control, uint32_t dest, uint32_t src,
+                    const uint8_t *info, size_t info_len, bool segmented);
+
+// Parses one complete frame (flags included)
+int dlms_hdlc_parse(const uint8_t *raw, size_t len, dlms_hdlc_frame_t *frame);
+
+void dlms_hdlc_rx_reset(dlms_hdlc_rx_t *rx);
+
+// Consumes bytes from data until a frame is complete or data runs out.
+// Returns 1 with *frame filled when a valid frame is complete, 0 otherwise;
+// *consumed tells how many bytes were used (the rest belongs to later frames).
+// Garbage between frames and frames with a bad HCS/FCS are skipped.
+int dlms_hdlc_rx_feed(dlms_hdlc_rx_t *rx, const uint8_t *data, size_t len, size_t *consumed,
+                      dlms_hdlc_frame_t *frame);
+
+// SNRM/UA information field with all four parameters
+size_t dlms_hdlc_build_params(uint8_t *out, const dlms_hdlc_params_t *params);
+// Fills *params from an information field (defaults if info_len is 0)
+int dlms_hdlc_parse_params(const uint8_t *info, size_t info_len, dlms_hdlc_params_t *params);
+
+// I-frame control helpers
+static inline bool dlms_hdlc_is_i_frame(uint8_t control) {
+    return (control & 0x01) == 0;
+}
+
+static inline uint8_t dlms_hdlc_i_control(uint8_t ns, uint8_t nr) {
+    return (uint8_t) (((nr & 0x07) << 5) | DLMS_HDLC_PF | ((ns & 0x07) << 1));
+}
+
+// Receive Ready acknowledging up to N(R), poll bit set
+static inline uint8_t dlms_hdlc_rr_control(uint8_t nr) {
+    return (uint8_t) (((nr & 0x07) << 5) | DLMS_HDLC_PF | 0x01);
+}
+
+static inline bool dlms_hdlc_is_rr(uint8_t control) {
+    return (control & 0x0F) == 0x01;
+}
+
+#ifdef __cplusplus
+}
+#endif
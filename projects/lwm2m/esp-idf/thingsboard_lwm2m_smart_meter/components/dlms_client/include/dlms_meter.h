@@ -0,0 +1,51 @@
+#pragma once
+
+// Local meter reading over the optical/RS-485 port with dlms_client: one
+// task associates with the meter, reads the scaler_unit of every register
+// once, then polls the register values every CONFIG_DLMS_METER_POLL_MS (all
+// of them batched in GET-WITH-LIST requests when the meter supports it) and
+// publishes them in the units of Object 10243. Registers the meter refuses
+// are skipped until the next association.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DLMS_METER_VOLTAGE,         // V       1-1:32.7.0
+    DLMS_METER_CURRENT,         // A       1-1:31.7.0
+    DLMS_METER_FREQUENCY,       // Hz      1-1:14.7.0
+    DLMS_METER_ACTIVE_POWER,    // kW      1-1:1.7.0
+    DLMS_METER_REACTIVE_POWER,  // kvar    1-1:3.7.0
+    DLMS_METER_APPARENT_POWER,  // kVA     1-1:9.7.0
+    DLMS_METER_POWER_FACTOR,    // -1..1   1-1:13.7.0
+    DLMS_METER_ACTIVE_ENERGY,   // kWh     1-1:1.8.0
+    DLMS_METER_REACTIVE_ENERGY, // kvarh   1-1:3.8.0
+    DLMS_METER_APPARENT_ENERGY, // kVAh    1-1:9.8.0
+    DLMS_METER_COUNT
+} dlms_meter_quantity_t;
+
+typedef struct {
+    float value[DLMS_METER_COUNT];
+    uint32_t valid;  // bit per dlms_meter_quantity_t read in the last poll
+    uint32_t polls;  // completed poll cycles since boot
+    uint32_t cycle_ms; // duration of the last poll cycle
+    uint32_t round_trips; // request/response round trips of the last poll cycle
+} dlms_meter_readings_t;
+
+static inline bool dlms_meter_has(const dlms_meter_readings_t *r, dlms_meter_quantity_t q) {
+    return (r->valid & (1u << q)) != 0;
+}
+
+// Starts the polling task (idempotent). Returns 0 on success, -1 on error.
+int dlms_meter_start(void);
+
+// Latest readings; false if none or older than CONFIG_DLMS_METER_STALE_S
+bool dlms_meter_latest(dlms_meter_readings_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,675 @@
+// Host-side tests for the dlms_client component (HDLC framing, COSEM APDUs
+// and the client against a simulated meter on a pseudo terminal, including
+// HDLC segmentation, GET-WITH-LIST and block transfer).
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "dlms_client.h"
+
+// Frames produced by dlms-bridge/dlms_reader.py (client SAP 16, server 1/1)
+static const uint8_t SNRM_FRAME[] = { 0x7E, 0xA0, 0x08, 0x02, 0x03, 0x21, 0x93, 0x86, 0x67, 0x7E };
+static const uint8_t DISC_FRAME[] = { 0x7E, 0xA0, 0x08, 0x02, 0x03, 0x21, 0x53, 0x8A, 0xA1, 0x7E };
+static const uint8_t SNRM_128_FRAME[] = {
+    0x7E, 0xA0, 0x21, 0x02, 0x03, 0x21, 0x93, 0x73, 0x56, 0x81, 0x80, 0x12, 0x05, 0x02, 0x00, 0x80, 0x06,
+    0x02, 0x00, 0x80, 0x07, 0x04, 0x00, 0x00, 0x00, 0x01, 0x08, 0x04, 0x00, 0x00, 0x00, 0x01, 0xA6, 0xD9, 0x7E,
+};
+static const uint8_t AARQ_FRAME[] = {
+    0x7E, 0xA0, 0x45, 0x02, 0x03, 0x21, 0x10, 0x43, 0x6C, 0xE6, 0xE6, 0x00, 0x60, 0x36, 0xA1, 0x09, 0x06, 0x07,
+    0x60, 0x85, 0x74, 0x05, 0x08, 0x01, 0x01, 0x8A, 0x02, 0x07, 0x80, 0x8B, 0x07, 0x60, 0x85, 0x74, 0x05, 0x08,
+    0x02, 0x01, 0xAC, 0x0A, 0x80, 0x08, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0xBE, 0x10, 0x04, 0x0E,
+    0x01, 0x00, 0x00, 0x00, 0x06, 0x5F, 0x1F, 0x04, 0x00, 0x00, 0x7E, 0x1F, 0x04, 0xB0, 0x52, 0x68, 0x7E,
+};
+static const uint8_t GET_FRAME[] = {
+    0x7E, 0xA0, 0x1A, 0x02, 0x03, 0x21, 0x32, 0xCD, 0x71, 0xE6, 0xE6, 0x00, 0xC0, 0x01, 0x01, 0x00,
+    0x03, 0x01, 0x01, 0x20, 0x07, 0x00, 0xFF, 0x02, 0x00, 0x4E, 0x43, 0x7E,
+};
+
+static const uint32_t SERVER_1_1 = (1 << 7) | 1;
+
+static void test_crc_and_build(void) {
+    uint8_t out[128];
+    uint8_t info[128];
+    CHECK(dlms_hdlc_crc16((const uint8_t *) "123456789", 9) == 0x906E);
+    CHECK(dlms_hdlc_server_address(1, 1) == SERVER_1_1);
+
+    int n = dlms_hdlc_build(out, sizeof(out), DLMS_HDLC_SNRM, SERVER_1_1, 16, NULL, 0, false);
+    CHECK(n == (int) sizeof(SNRM_FRAME) && memcmp(out, SNRM_FRAME, sizeof(SNRM_FRAME)) == 0);
+    n = dlms_hdlc_build(out, sizeof(out), DLMS_HDLC_DISC, SERVER_1_1, 16, NULL, 0, false);
+    CHECK(n == (int) sizeof(DISC_FRAME) && memcmp(out, DISC_FRAME, sizeof(DISC_FRAME)) == 0);
+
+    const dlms_hdlc_params_t params = { 128, 128, 1, 1 };
+    size_t len = dlms_hdlc_build_params(info, &params);
+    // Same parameters as the bridge, but with the group length of 20 bytes
+    // of parameters (the bridge sends 0x12)
+    CHECK(len == 23 && info[2] == 0x14);
+    CHECK(memcmp(info + 3, SNRM_128_FRAME + 12, len - 3) == 0);
+    dlms_hdlc_params_t parsed;
+    CHECK(dlms_hdlc_parse_params(info, len, &parsed) == 0 && parsed.max_info_rx == 128 && parsed.window_tx == 1);
+    CHECK(dlms_hdlc_parse_params(SNRM_128_FRAME + 9, 23, &parsed) == 0 && parsed.window_rx == 1);
+    // Meters may send one-byte values and leave parameters out
+    const uint8_t ua_info[] = { 0x81, 0x80, 0x06, 0x05, 0x01, 0x40, 0x08, 0x01, 0x03 };
+    CHECK(dlms_hdlc_parse_params(ua_info, sizeof(ua_info), &parsed) == 0);
+    CHECK(parsed.max_info_tx == 64 && parsed.max_info_rx == 128 && parsed.window_tx == 1 && parsed.window_rx == 3);
+    CHECK(dlms_hdlc_parse_params(NULL, 0, &parsed) == 0 && parsed.max_info_tx == 128 && parsed.window_rx == 1);
+    CHECK(dlms_hdlc_parse_params(ua_info, 5, &parsed) == -1);
+    CHECK(dlms_hdlc_is_rr(dlms_hdlc_rr_control(3)) && !dlms_hdlc_is_i_frame(dlms_hdlc_rr_control(3)));
+
+    len = dlms_cosem_build_aarq(info, sizeof(info), "22222222");
+    n = dlms_hdlc_build(out, sizeof(out), dlms_hdlc_i_control(0, 0), SERVER_1_1, 16, info, len, false);
+    CHECK(n == (int) sizeof(AARQ_FRAME) && memcmp(out, AARQ_FRAME, sizeof(AARQ_FRAME)) == 0);
+    CHECK(dlms_cosem_build_aarq(info, sizeof(info), "") == 0);
+    CHECK(dlms_cosem_build_aarq(info, sizeof(info), "0123456789abcdefg") == 0);
+    // The AARQ length follows the password (the bridge hardcodes 0x36)
+    len = dlms_cosem_build_aarq(info, sizeof(info), "abc");
+    CHECK(info[4] == 0x36 - 5 && len == 3 + 2 + (size_t) info[4]);
+
+    const uint8_t voltage[6] = { 1, 1, 32, 7, 0, 255 };
+    len = dlms_cosem_build_get(info, sizeof(info), 1, DLMS_CLASS_REGISTER, voltage, DLMS_ATTR_VALUE);
+    n = dlms_hdlc_build(out, sizeof(out), dlms_hdlc_i_control(1, 1), SERVER_1_1, 16, info, len, false);
+    CHECK(n == (int) sizeof(GET_FRAME) && memcmp(out, GET_FRAME, sizeof(GET_FRAME)) == 0);
+
+    // Four-byte server address (physical > 127) survives a round trip
+    const uint32_t far = dlms_hdlc_server_address(1, 1234);
+    n = dlms_hdlc_build(out, sizeof(out), DLMS_HDLC_UA, 16, far, NULL, 0, false);
+    CHECK(n == 12 && out[3] == 0x21);
+    dlms_hdlc_frame_t f;
+    CHECK(dlms_hdlc_parse(out, (size_t) n, &f) == 0 && f.src == far && f.dest == 16 && f.info_len == 0);
+    CHECK(dlms_hdlc_build(out, 20, DLMS_HDLC_UA, 16, far, info, 10, false) == -1);
+}
+
+static void test_rx(void) {
+    static dlms_hdlc_rx_t rx;
+    dlms_hdlc_frame_t f;
+    size_t used;
+    dlms_hdlc_rx_reset(&rx);
+
+    // Byte by byte; the AARQ carries 0x7E inside the information field
+    int ready = 0;
+    for (size_t i = 0; i < sizeof(AARQ_FRAME); i++) {
+        ready = dlms_hdlc_rx_feed(&rx, &AARQ_FRAME[i], 1, &used, &f);
+        CHECK(used == 1);
+        CHECK(ready == (i == sizeof(AARQ_FRAME) - 1));
+    }
+    CHECK(ready && f.control == 0x10 && f.dest == SERVER_1_1 && f.src == 16 && f.info_len == 0x45 - 10);
+    CHECK(f.info[0] == 0xE6 && f.info[f.info_len - 1] == 0xB0 && !f.segmented);
+
+    // Line noise, then two frames sharing one flag, in one chunk
+    uint8_t stream[64];
+    size_t len = 0;
+    stream[len++] = 0x00;
+    stream[len++] = 0x55;
+    memcpy(stream + len, SNRM_FRAME, sizeof(SNRM_FRAME));
+    len += sizeof(SNRM_FRAME);
+    memcpy(stream + len, DISC_FRAME + 1, sizeof(DISC_FRAME) - 1);
+    len += sizeof(DISC_FRAME) - 1;
+    CHECK(dlms_hdlc_rx_feed(&rx, stream, len, &used, &f) == 1 && f.control == DLMS_HDLC_SNRM);
+    CHECK(used == 2 + sizeof(SNRM_FRAME));
+    CHECK(rx.dropped_bytes == 2);
+    size_t off = used;
+    CHECK(dlms_hdlc_rx_feed(&rx, stream + off, len - off, &used, &f) == 1 && f.control == DLMS_HDLC_DISC);
+    CHECK(off + used == len);
+
+    // A corrupted frame is dropped and counted; the next one still parses
+    uint8_t bad[sizeof(GET_FRAME)];
+    memcpy(bad, GET_FRAME, sizeof(bad));
+    bad[15] ^= 0x01;
+    CHECK(dlms_hdlc_rx_feed(&rx, bad, sizeof(bad), &used, &f) == 0 && used == sizeof(bad));
+    CHECK(rx.crc_errors == 1);
+    CHECK(dlms_hdlc_rx_feed(&rx, GET_FRAME, sizeof(GET_FRAME), &used, &f) == 1 && f.info_len == 16);
+}
+
+static void test_cosem(void) {
+    uint8_t obis[6];
+    CHECK(dlms_obis_parse("1-1:32.7.0", obis) == 0 && obis[2] == 32 && obis[5] == 255);
+    CHECK(dlms_obis_parse("1-0:1.8.0*101", obis) == 0 && obis[1] == 0 && obis[5] == 101);
+    CHECK(dlms_obis_parse("0.0.96.1.0.255", obis) == 0 && obis[3] == 1 && obis[4] == 0);
+    CHECK(dlms_obis_parse("1-1:32.7", obis) == -1);
+    CHECK(dlms_obis_parse("1-1:32.7.0x", obis) == -1);
+    CHECK(dlms_obis_parse("1-1:256.7.0", obis) == -1);
+
+    double v;
+    size_t used;
+    const uint8_t u16[] = { 0x12, 0x5A, 0x0A };
+    CHECK(dlms_data_to_double(u16, sizeof(u16), &v, &used) == 0 && v == 23050.0 && used == 3);
+    const uint8_t i16[] = { 0x10, 0xFF, 0x38 };
+    CHECK(dlms_data_to_double(i16, sizeof(i16), &v, &used) == 0 && v == -200.0);
+    const uint8_t f32[] = { 0x17, 0x43, 0x66, 0x80, 0x00 }; // 230.5
+    CHECK(dlms_data_to_double(f32, sizeof(f32), &v, &used) == 0 && v == 230.5 && used == 5);
+    const uint8_t u32_short[] = { 0x06, 0x00, 0x01 };
+    CHECK(dlms_data_to_double(u32_short, sizeof(u32_short), &v, &used) == -1);
+    const uint8_t text[] = { 0x0A, 0x01, 'x' };
+    CHECK(dlms_data_to_double(text, sizeof(text), &v, &used) == -1);
+
+    int8_t scaler;
+    uint8_t unit;
+    const uint8_t su[] = { 0x02, 0x02, 0x0F, 0xFE, 0x16, DLMS_UNIT_V };
+    CHECK(dlms_data_scaler_unit(su, sizeof(su), &scaler, &unit) == 0 && scaler == -2 && unit == DLMS_UNIT_V);
+
+    dlms_get_response_t resp;
+    const uint8_t normal[] = { 0xE6, 0xE7, 0x00, 0xC4, 0x01, 0x05, 0x00, 0x12, 0x00, 0x01 };
+    CHECK(dlms_cosem_parse_get_response(normal, sizeof(normal), &resp) == 0);
+    CHECK(resp.type == DLMS_GET_NORMAL && resp.invoke_id == 5 && resp.dar == 0);
+    CHECK(resp.data_len == 3 && resp.data[0] == 0x12);
+    const uint8_t refused[] = { 0xE6, 0xE7, 0x00, 0xC4, 0x01, 0x05, 0x01, 0x04 };
+    CHECK(dlms_cosem_parse_get_response(refused, sizeof(refused), &resp) == 0 && resp.dar == 4);
+    CHECK(dlms_cosem_parse_get_response(refused, 6, &resp) == -1);
+    const uint8_t block[] = { 0xE6, 0xE7, 0x00, 0xC4, 0x02, 0x07, 0x01, 0x00, 0x00, 0x00, 0x02,
+                              0x00, 0x03, 0xAA, 0xBB, 0xCC };
+    CHECK(dlms_cosem_parse_get_response(block, sizeof(block), &resp) == 0 && resp.type == DLMS_GET_NEXT);
+    CHECK(resp.last_block && resp.block_number == 2 && resp.data_len == 3 && resp.data[2] == 0xCC);
+    CHECK(dlms_cosem_parse_get_response(block, sizeof(block) - 1, &resp) == -1);
+
+    // With-list: two results, the second refused
+    const uint8_t list[] = { 0xE6, 0xE7, 0x00, 0xC4, 0x03, 0x02, 0x02,
+                             0x00, 0x02, 0x02, 0x0F, 0xFE, 0x16, DLMS_UNIT_V, 0x01, 0x04 };
+    CHECK(dlms_cosem_parse_get_response(list, sizeof(list), &resp) == 0 && resp.type == DLMS_GET_WITH_LIST);
+    size_t count = 0;
+    size_t off = dlms_axdr_length(resp.data, resp.data_len, &count);
+    CHECK(off == 1 && count == 2);
+    int dar = -1;
+    const uint8_t *data = NULL;
+    size_t data_len = 0;
+    used = dlms_cosem_list_result(resp.data + off, resp.data_len - off, &dar, &data, &data_len);
+    CHECK(used == 7 && dar == 0 && data_len == 6 && data[0] == 0x02);
+    off += used;
+    CHECK(dlms_cosem_list_result(resp.data + off, resp.data_len - off, &dar, &data, &data_len) == 2 && dar == 4);
+    const uint8_t nested[] = { 0x01, 0x02, 0x02, 0x02, 0x09, 0x02, 0x41, 0x42, 0x03, 0x01, 0x00 };
+    CHECK(dlms_data_size(nested, sizeof(nested)) == 11 && dlms_data_size(nested, 10) == 0);
+
+    dlms_attr_ref_t refs[2] = { { DLMS_CLASS_REGISTER, { 1, 1, 32, 7, 0, 255 }, DLMS_ATTR_VALUE },
+                                { DLMS_CLASS_REGISTER, { 1, 1, 1, 8, 0, 255 }, DLMS_ATTR_SCALER_UNIT } };
+    uint8_t req[64];
+    CHECK(dlms_cosem_build_get_list(req, sizeof(req), 3, refs, 2) == 10 * 2 + 7);
+    CHECK(req[3] == 0xC0 && req[4] == DLMS_GET_WITH_LIST && req[5] == 3 && req[6] == 2 && req[9] == 1);
+    CHECK(req[15] == DLMS_ATTR_VALUE && req[25] == DLMS_ATTR_SCALER_UNIT);
+    CHECK(dlms_cosem_build_get_list(req, 20, 3, refs, 2) == 0);
+    CHECK(dlms_cosem_build_get_next(req, sizeof(req), 3, 0x01020304) == 10 && req[4] == DLMS_GET_NEXT && req[9] == 4);
+
+    const uint8_t aare_ok[] = { 0xE6, 0xE7, 0x00, 0x61, 0x0C, 0xA1, 0x03, 0x06, 0x01, 0x00,
+                                0xA2, 0x03, 0x02, 0x01, 0x00, 0x88, 0x00 };
+    dlms_aare_t aare;
+    CHECK(dlms_cosem_parse_aare(aare_ok, sizeof(aare_ok), &aare) == 0);
+    CHECK(aare.conformance == DLMS_CONFORMANCE_GET && aare.max_pdu == 0);
+    uint8_t aare_rej[sizeof(aare_ok)];
+    memcpy(aare_rej, aare_ok, sizeof(aare_rej));
+    aare_rej[14] = 0x01;
+    CHECK(dlms_cosem_parse_aare(aare_rej, sizeof(aare_rej), NULL) == 1);
+    CHECK(dlms_cosem_parse_aare(aare_ok, 8, NULL) == -1);
+    const uint8_t aare_init[] = { 0xE6, 0xE7, 0x00, 0x61, 0x17, 0xA2, 0x03, 0x02, 0x01, 0x00,
+                                  0xBE, 0x10, 0x04, 0x0E, 0x08, 0x00, 0x06, 0x5F, 0x1F, 0x04,
+                                  0x00, 0x00, 0x50, 0x1F, 0x01, 0xF4, 0x00, 0x07 };
+    CHECK(dlms_cosem_parse_aare(aare_init, sizeof(aare_init), &aare) == 0);
+    CHECK(aare.conformance == 0x501F && aare.max_pdu == 500);
+    CHECK((aare.conformance & DLMS_CONFORMANCE_MULTIPLE_REFS) == 0 && (aare.conformance & DLMS_CONFORMANCE_BLOCK_GET));
+    // Empty OCTET STRING around the InitiateResponse: the conformance block that
+    // follows the AARE must not be read as part of it
+    const uint8_t aare_empty[] = { 0xE6, 0xE7, 0x00, 0x61, 0x0B, 0xA2, 0x03, 0x02, 0x01, 0x00,
+                                   0xBE, 0x04, 0x04, 0x00, 0x08, 0x00,
+                                   0x06, 0x5F, 0x1F, 0x04, 0x00, 0x00, 0x50, 0x1F, 0x01, 0xF4 };
+    CHECK(dlms_cosem_parse_aare(aare_empty, sizeof(aare_empty), &aare) == 0);
+    CHECK(aare.conformance == DLMS_CONFORMANCE_GET && aare.max_pdu == 0);
+}
+
+// --- Simulated meter on the master side of a pty ---------------------------
+
+typedef struct {
+    uint8_t obis[6];
+    uint8_t scaler_unit[6];
+    uint8_t value[5];
+} sim_reg_t;
+
+// The ten registers of an Object 10243 snapshot
+static const struct {
+    uint8_t c, d;
+    int8_t scaler;
+    uint8_t unit;
+    uint32_t value;
+} SIM_TABLE[] = {
+    { 32, 7, -2, DLMS_UNIT_V, 23050 }, { 1, 8, 0, DLMS_UNIT_WH, 1234567 },
+    { 31, 7, -3, DLMS_UNIT_A, 5120 },  { 14, 7, -2, DLMS_UNIT_HZ, 5998 },
+    { 1, 7, 0, DLMS_UNIT_W, 1180 },    { 3, 7, 0, DLMS_UNIT_VAR, 210 },
+    { 9, 7, 0, DLMS_UNIT_VA, 1200 },   { 13, 7, -3, DLMS_UNIT_NONE, 983 },
+    { 3, 8, 0, DLMS_UNIT_VARH, 45678 }, { 9, 8, 0, DLMS_UNIT_VAH, 1300000 },
+};
+#define SIM_COUNT (sizeof(SIM_TABLE) / sizeof(SIM_TABLE[0]))
+
+static sim_reg_t SIM_REGS[SIM_COUNT];
+
+static void sim_regs_init(void) {
+    for (size_t i = 0; i < SIM_COUNT; i++) {
+        const uint8_t obis[6] = { 1, 1, SIM_TABLE[i].c, SIM_TABLE[i].d, 0, 255 };
+        const uint8_t su[6] = { 0x02, 0x02, 0x0F, (uint8_t) SIM_TABLE[i].scaler, 0x16, SIM_TABLE[i].unit };
+        const uint32_t v = SIM_TABLE[i].value;
+        const uint8_t value[5] = { 0x06, (uint8_t) (v >> 24), (uint8_t) (v >> 16), (uint8_t) (v >> 8), (uint8_t) v };
+        memcpy(SIM_REGS[i].obis, obis, 6);
+        memcpy(SIM_REGS[i].scaler_unit, su, 6);
+        memcpy(SIM_REGS[i].value, value, 5);
+    }
+}
+
+typedef struct {
+    int fd;
+    volatile int stop;
+    const char *password;
+    // Link and association parameters the meter answers with
+    uint16_t max_info;   // both directions
+    uint8_t window;      // both directions
+    uint32_t conformance;
+    uint16_t max_pdu;
+    size_t block_size;   // 0: never answer with data blocks
+    dlms_hdlc_params_t proposed; // client's SNRM parameters
+    uint8_t ns;
+    uint8_t nr;
+    uint32_t frames;
+    uint32_t apdus;
+    uint32_t rr_sent;
+    uint32_t rr_received;
+    uint8_t req[512];    // APDU being received
+    size_t req_len;
+    uint8_t resp[512];   // APDU being sent, one window per RR
+    size_t resp_len;
+    size_t resp_off;
+    uint8_t blocks[512]; // raw data answered in blocks
+    size_t blocks_len;
+    size_t blocks_off;
+    uint32_t block_number;
+} sim_t;
+
+// Replies in 5-byte pieces with a pause, so the client sees partial frames
+static void sim_send(sim_t *sim, uint8_t control, const uint8_t *info, size_t info_len, bool segmented) {
+    uint8_t out[256];
+    const int n = dlms_hdlc_build(out, sizeof(out), control, 16, SERVER_1_1, info, info_len, segmented);
+    for (int off = 0; off < n; off += 5) {
+        const int chunk = n - off < 5 ? n - off : 5;
+        if (write(sim->fd, out + off, (size_t) chunk) != chunk) {
+            return;
+        }
+        usleep(300);
+    }
+}
+
+static void sim_send_window(sim_t *sim) {
+    for (uint8_t k = 0; k < sim->window && sim->resp_off < sim->resp_len; k++) {
+        const size_t left = sim->resp_len - sim->resp_off;
+        const size_t n = left < sim->max_info ? left : sim->max_info;
+        const bool more = n < left;
+        uint8_t control = dlms_hdlc_i_control(sim->ns, sim->nr);
+        if (more && k + 1 < sim->window) {
+            control &= (uint8_t) ~DLMS_HDLC_PF;
+        }
+        sim_send(sim, control, sim->resp + sim->resp_off, n, more);
+        sim->resp_off += n;
+        sim->ns = (sim->ns + 1) & 0x07;
+    }
+}
+
+static void sim_reply(sim_t *sim, const uint8_t *apdu, size_t len) {
+    memcpy(sim->resp, apdu, len);
+    sim->resp_len = len;
+    sim->resp_off = 0;
+    sim_send_window(sim);
+}
+
+// Next data block of sim->blocks as a GET.response with-datablock
+static size_t sim_next_block(sim_t *sim, uint8_t invoke_id, uint8_t *out) {
+    size_t n = 0;
+    const size_t left = sim->blocks_len - sim->blocks_off;
+    const size_t chunk = left < sim->block_size ? left : sim->block_size;
+    sim->block_number++;
+    out[n++] = 0xC4;
+    out[n++] = DLMS_GET_NEXT;
+    out[n++] = invoke_id;
+    out[n++] = chunk == left;
+    out[n++] = 0;
+    out[n++] = 0;
+    out[n++] = 0;
+    out[n++] = (uint8_t) sim->block_number;
+    out[n++] = 0x00;
+    out[n++] = (uint8_t) chunk;
+    memcpy(out + n, sim->blocks + sim->blocks_off, chunk);
+    sim->blocks_off += chunk;
+    return n + chunk;
+}
+
+// Get-Data-Result of one attribute
+static size_t sim_result(const uint8_t *obis, uint8_t attr, uint8_t *out) {
+    const sim_reg_t *reg = NULL;
+    for (size_t i = 0; i < SIM_COUNT; i++) {
+        if (memcmp(SIM_REGS[i].obis, obis, 6) == 0) {
+            reg = &SIM_REGS[i];
+        }
+    }
+    if (!reg || (attr != 2 && attr != 3)) {
+        out[0] = 0x01;
+        out[1] = 0x04; // object-undefined
+        return 2;
+    }
+    out[0] = 0x00;
+    memcpy(out + 1, attr == 3 ? reg->scaler_unit : reg->value, attr == 3 ? 6 : 5);
+    return attr == 3 ? 7 : 6;
+}
+
+static void sim_apdu(sim_t *sim, const uint8_t *apdu, size_t len) {
+    uint8_t info[512];
+    size_t n = 0;
+    sim->apdus++;
+    if (len < 4) {
+        return;
+    }
+    info[n++] = 0xE6;
+    info[n++] = 0xE7;
+    info[n++] = 0x00;
+    if (apdu[3] == 0x60) {
+        // AARQ: check the password in the calling-authentication-value
+        const uint8_t *pw = NULL;
+        for (size_t i = 5; i + 4 < len; i++) {
+            if (apdu[i] == 0xAC && apdu[i + 2] == 0x80) {
+                pw = &apdu[i + 3];
+                break;
+            }
+        }
+        const int ok = pw && *pw == strlen(sim->password) && memcmp(pw + 1, sim->password, *pw) == 0;
+        const uint8_t aare[] = { 0x61, 0x1C, 0xA2, 0x03, 0x02, 0x01, ok ? 0x00 : 0x01,
+                                 0xA3, 0x03, 0xA1, 0x01, ok ? 0x00 : 0x0D,
+                                 0xBE, 0x10, 0x04, 0x0E, 0x08, 0x00, 0x06, 0x5F, 0x1F, 0x04, 0x00,
+                                 (uint8_t) (sim->conformance >> 16), (uint8_t) (sim->conformance >> 8),
+                                 (uint8_t) sim->conformance, (uint8_t) (sim->max_pdu >> 8), (uint8_t) sim->max_pdu,
+                                 0x00, 0x07 };
+        memcpy(info + n, aare, sizeof(aare));
+        n += sizeof(aare);
+    } else if (apdu[3] == 0xC0 && len >= 6) {
+        const uint8_t type = apdu[4];
+        const uint8_t invoke_id = apdu[5];
+        uint8_t raw[512];
+        size_t raw_len = 0;
+        if (type == DLMS_GET_NEXT && len >= 10) {
+            if (apdu[9] != (uint8_t) sim->block_number || sim->blocks_off >= sim->blocks_len) {
+                return;
+            }
+            n += sim_next_block(sim, invoke_id, info + n);
+            sim_reply(sim, info, n);
+            return;
+        }
+        if (type == DLMS_GET_NORMAL && len >= 16) {
+            raw_len = sim_result(&apdu[8], apdu[14], raw);
+        } else if (type == DLMS_GET_WITH_LIST && len >= 7 && len >= 7 + 10u * apdu[6]) {
+            raw[raw_len++] = apdu[6];
+            for (size_t i = 0; i < apdu[6]; i++) {
+                raw_len += sim_result(&apdu[7 + 10 * i + 2], apdu[7 + 10 * i + 8], raw + raw_len);
+            }
+        } else {
+            return;
+        }
+        // Normal responses carry the Data in blocks without the result choice
+        const size_t skip = type == DLMS_GET_NORMAL && raw[0] == 0x00;
+        if (sim->block_size && raw_len - skip > sim->block_size) {
+            memcpy(sim->blocks, raw + skip, raw_len - skip);
+            sim->blocks_len = raw_len - skip;
+            sim->blocks_off = 0;
+            sim->block_number = 0;
+            n += sim_next_block(sim, invoke_id, info + n);
+        } else {
+            info[n++] = 0xC4;
+            info[n++] = type;
+            info[n++] = invoke_id;
+            memcpy(info + n, raw, raw_len);
+            n += raw_len;
+        }
+    } else {
+        return;
+    }
+    sim_reply(sim, info, n);
+}
+
+static void sim_handle(sim_t *sim, const dlms_hdlc_frame_t *f) {
+    sim->frames++;
+    if (f->control == DLMS_HDLC_SNRM || f->control == DLMS_HDLC_DISC) {
+        uint8_t info[32];
+        size_t n = 0;
+        sim->ns = 0;
+        sim->nr = 0;
+        sim->req_len = 0;
+        sim->resp_len = 0;
+        sim->resp_off = 0;
+        if (f->control == DLMS_HDLC_SNRM) {
+            (void) dlms_hdlc_parse_params(f->info, f->info_len, &sim->proposed);
+            const dlms_hdlc_params_t ua = { sim->max_info, sim->max_info, sim->window, sim->window };
+            n = dlms_hdlc_build_params(info, &ua);
+        }
+        sim_send(sim, DLMS_HDLC_UA, info, n, false);
+        return;
+    }
+    if (dlms_hdlc_is_rr(f->control)) {
+        sim->rr_received++;
+        sim_send_window(sim);
+        return;
+    }
+    if (!dlms_hdlc_is_i_frame(f->control) || sim->req_len + f->info_len > sizeof(sim->req)) {
+        return;
+    }
+    sim->nr = (uint8_t) (((f->control >> 1) + 1) & 0x07);
+    memcpy(sim->req + sim->req_len, f->info, f->info_len);
+    sim->req_len += f->info_len;
+    if (f->segmented) {
+        if (f->control & DLMS_HDLC_PF) {
+            sim->rr_sent++;
+            sim_send(sim, dlms_hdlc_rr_control(sim->nr), NULL, 0, false);
+        }
+        return;
+    }
+    const size_t len = sim->req_len;
+    sim->req_len = 0;
+    sim_apdu(sim, sim->req, len);
+}
+
+static void *sim_thread(void *arg) {
+    sim_t *sim = arg;
+    static dlms_hdlc_rx_t rx;
+    dlms_hdlc_rx_reset(&rx);
+    uint8_t buf[64];
+    while (!sim->stop) {
+        struct pollfd p = { .fd = sim->fd, .events = POLLIN };
+        if (poll(&p, 1, 20) <= 0) {
+            continue;
+        }
+        const ssize_t n = read(sim->fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        size_t off = 0;
+        while (off < (size_t) n) {
+            dlms_hdlc_frame_t f;
+            size_t used;
+            if (dlms_hdlc_rx_feed(&rx, buf + off, (size_t) n - off, &used, &f)) {
+                sim_handle(sim, &f);
+            }
+            off += used;
+        }
+    }
+    return NULL;
+}
+
+static int pty_write(void *ctx, const uint8_t *data, size_t len) {
+    const int fd = *(int *) ctx;
+    return write(fd, data, len) == (ssize_t) len ? 0 : -1;
+}
+
+static int pty_read(void *ctx, uint8_t *buf, size_t size, int timeout_ms) {
+    const int fd = *(int *) ctx;
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    const int r = poll(&p, 1, timeout_ms);
+    if (r <= 0) {
+        return r;
+    }
+    const ssize_t n = read(fd, buf, size);
+    return n < 0 ? -1 : (int) n;
+}
+
+static void make_raw(int fd) {
+    struct termios t;
+    tcgetattr(fd, &t);
+    cfmakeraw(&t);
+    tcsetattr(fd, TCSANOW, &t);
+}
+
+// Reads the ten registers in one call and checks every value; returns the
+// round trips it took
+static uint32_t read_snapshot(dlms_client_t *client) {
+    dlms_attr_ref_t refs[SIM_COUNT];
+    dlms_get_result_t results[SIM_COUNT];
+    uint8_t buf[SIM_COUNT * 8];
+    for (size_t i = 0; i < SIM_COUNT; i++) {
+        refs[i].class_id = DLMS_CLASS_REGISTER;
+        memcpy(refs[i].obis, SIM_REGS[i].obis, 6);
+        refs[i].attribute = DLMS_ATTR_VALUE;
+    }
+    const uint32_t before = client->round_trips;
+    if (dlms_client_get_list(client, refs, SIM_COUNT, results, buf, sizeof(buf)) != DLMS_OK) {
+        CHECK(!"snapshot read failed");
+        return 0;
+    }
+    for (size_t i = 0; i < SIM_COUNT; i++) {
+        double v = -1;
+        CHECK(results[i].err == DLMS_OK);
+        CHECK(dlms_data_to_double(results[i].data, results[i].len, &v, NULL) == 0 && v == SIM_TABLE[i].value);
+    }
+    return client->round_trips - before;
+}
+
+static void test_client_over_pty(void) {
+    int master, slave;
+    if (openpty(&master, &slave, NULL, NULL, NULL) != 0) {
+        fprintf(stderr, "openpty failed, skipping pty test\n");
+        return;
+    }
+    make_raw(master);
+    make_raw(slave);
+    sim_regs_init();
+    sim_t sim = {
+        .fd = master, .password = "22222222", .max_info = 128, .window = 1,
+        .conformance = DLMS_CONFORMANCE_GET | DLMS_CONFORMANCE_BLOCK_GET | DLMS_CONFORMANCE_MULTIPLE_REFS,
+        .max_pdu = 500,
+    };
+    pthread_t th;
+    pthread_create(&th, NULL, sim_thread, &sim);
+
+    const dlms_port_t port = { .write = pty_write, .read = pty_read, .ctx = &slave };
+    dlms_client_config_t cfg = {
+        .server_logical = 1, .server_physical = 1, .client_sap = 16,
+        .password = "22222222", .max_info_len = 128, .window = 7, .timeout_ms = 500,
+    };
+    static dlms_client_t client;
+    dlms_client_init(&client, &port, &cfg);
+
+    CHECK(dlms_client_get_value(&client, SIM_REGS[0].obis, &(double) { 0 }) == DLMS_ERR_NOT_CONNECTED);
+    CHECK(dlms_client_connect(&client) == DLMS_OK);
+    CHECK(client.connected);
+    CHECK(sim.proposed.window_rx == 7 && sim.proposed.max_info_rx == 128);
+    CHECK(client.window_tx == 1 && client.max_info_tx == 128 && client.server_max_pdu == 500);
+
+    int8_t scaler;
+    uint8_t unit;
+    double raw;
+    CHECK(dlms_client_get_scaler_unit(&client, SIM_REGS[0].obis, &scaler, &unit) == DLMS_OK);
+    CHECK(scaler == -2 && unit == DLMS_UNIT_V);
+    CHECK(dlms_client_get_value(&client, SIM_REGS[0].obis, &raw) == DLMS_OK && raw == 23050.0);
+    CHECK(dlms_client_get_value(&client, SIM_REGS[1].obis, &raw) == DLMS_OK && raw == 1234567.0);
+    const uint8_t missing[6] = { 1, 1, 99, 7, 0, 255 };
+    CHECK(dlms_client_get_value(&client, missing, &raw) == DLMS_ERR_ACCESS);
+    // Refused attributes keep the association; sequence numbers stay in step
+    for (int i = 0; i < 20; i++) {
+        CHECK(dlms_client_get_value(&client, SIM_REGS[i & 1].obis, &raw) == DLMS_OK);
+    }
+
+    // Full snapshot in one GET-WITH-LIST round trip instead of one per register
+    uint32_t apdus = sim.apdus;
+    CHECK(read_snapshot(&client) == 1 && sim.apdus == apdus + 1);
+
+    // A refused item in the list does not spoil the others
+    dlms_attr_ref_t refs[3] = { { DLMS_CLASS_REGISTER, { 0 }, DLMS_ATTR_SCALER_UNIT },
+                                { DLMS_CLASS_REGISTER, { 0 }, DLMS_ATTR_VALUE },
+                                { DLMS_CLASS_REGISTER, { 0 }, DLMS_ATTR_VALUE } };
+    memcpy(refs[0].obis, SIM_REGS[2].obis, 6);
+    memcpy(refs[1].obis, missing, 6);
+    memcpy(refs[2].obis, SIM_REGS[3].obis, 6);
+    dlms_get_result_t results[3];
+    uint8_t buf[32];
+    CHECK(dlms_client_get_list(&client, refs, 3, results, buf, sizeof(buf)) == DLMS_OK);
+    CHECK(results[0].err == DLMS_OK && dlms_data_scaler_unit(results[0].data, results[0].len, &scaler, &unit) == 0);
+    CHECK(scaler == -3 && unit == DLMS_UNIT_A);
+    CHECK(results[1].err == DLMS_ERR_ACCESS && results[1].len == 0);
+    CHECK(results[2].err == DLMS_OK && dlms_data_to_double(results[2].data, results[2].len, &raw, NULL) == 0);
+    CHECK(raw == 5998.0);
+    // Results that do not fit the caller's buffer are flagged, not truncated
+    CHECK(dlms_client_get_list(&client, refs, 3, results, buf, 8) == DLMS_OK);
+    CHECK(results[0].err == DLMS_OK && results[2].err == DLMS_ERR_DATA);
+    CHECK(client.connected && client.timeouts == 0);
+    dlms_client_disconnect(&client);
+    CHECK(!client.connected);
+
+    // Small frames, window 2: the AARQ and the list request go out in
+    // segments with an RR per window, the response comes back the same way
+    sim.max_info = 32;
+    sim.window = 2;
+    CHECK(dlms_client_connect(&client) == DLMS_OK);
+    CHECK(client.max_info_tx == 32 && client.window_tx == 2);
+    const uint32_t rr_sent = sim.rr_sent;
+    const uint32_t rr_received = sim.rr_received;
+    // 107-byte request: 2 + 2 segments, 67-byte response: 2 + 1 segments
+    CHECK(read_snapshot(&client) == 3);
+    CHECK(sim.rr_sent == rr_sent + 1 && sim.rr_received == rr_received + 1);
+    CHECK(dlms_client_get_value(&client, SIM_REGS[4].obis, &raw) == DLMS_OK && raw == 1180.0);
+
+    // Block transfer: the list response comes in 24-byte data blocks
+    sim.max_info = 128;
+    sim.window = 1;
+    sim.block_size = 24;
+    CHECK(dlms_client_connect(&client) == DLMS_OK);
+    apdus = sim.apdus;
+    CHECK(read_snapshot(&client) == 3 && sim.apdus == apdus + 3);
+    CHECK(dlms_client_get_value(&client, SIM_REGS[1].obis, &raw) == DLMS_OK && raw == 1234567.0);
+    sim.block_size = 0;
+
+    // A small server PDU splits the list; without multiple references the
+    // client falls back to one GET per register
+    sim.max_pdu = 60;
+    CHECK(dlms_client_connect(&client) == DLMS_OK);
+    CHECK(read_snapshot(&client) == 3);
+    sim.conformance = DLMS_CONFORMANCE_GET;
+    CHECK(dlms_client_connect(&client) == DLMS_OK);
+    CHECK(read_snapshot(&client) == SIM_COUNT);
+    CHECK(client.connected && client.timeouts == 0);
+
+    // Wrong password: AARE rejects
+    cfg.password = "11111111";
+    dlms_client_init(&client, &port, &cfg);
+    CHECK(dlms_client_connect(&client) == DLMS_ERR_REJECTED);
+
+    // Meter silent: the request times out and the association is dropped
+    cfg.password = "22222222";
+    dlms_client_init(&client, &port, &cfg);
+    CHECK(dlms_client_connect(&client) == DLMS_OK);
+    sim.stop = 1;
+    pthread_join(th, NULL);
+    CHECK(dlms_client_get_value(&client, SIM_REGS[0].obis, &raw) == DLMS_ERR_TIMEOUT);
+    CHECK(!client.connected && client.timeouts == 1);
+
+    close(master);
+    close(slave);
+}
+
+int main(void) {
+    test_crc_and_build();
+    test_rx();
+    test_cosem();
+    test_client_over_pty();
+    return check_report("dlms_client");
+}
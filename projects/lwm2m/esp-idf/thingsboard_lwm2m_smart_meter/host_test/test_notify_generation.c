@@ -0,0 +1,55 @@
+// Host-side tests for notify_generation.c (when cached gt/lt/st attribute sets
+// are reloaded while the Attribute Storage modified flag stays set).
+#include <stdio.h>
+
+#include "check.h"
+#include "notify_generation.h"
+
+static void test_initial(void) {
+    notify_generation_t g = NOTIFY_GENERATION_INIT;
+    // Zero-initialized caches never match the starting generation
+    CHECK(g.value != 0);
+    CHECK(!notify_generation_poll(&g, false));
+    CHECK(g.value == 1);
+}
+
+static void test_sticky_flag(void) {
+    notify_generation_t g = NOTIFY_GENERATION_INIT;
+    // Write-Attributes: one reload, then none while storage is not persisted
+    CHECK(notify_generation_poll(&g, true));
+    uint32_t after_write = g.value;
+    int bumps = 0;
+    for (int i = 0; i < 1000; i++) {
+        bumps += notify_generation_poll(&g, true);
+    }
+    CHECK(bumps == 0);
+    CHECK(g.value == after_write);
+    // Persisting clears the flag: one more reload picks up writes made meanwhile
+    CHECK(notify_generation_poll(&g, false));
+    CHECK(g.value != after_write);
+    CHECK(!notify_generation_poll(&g, false));
+}
+
+static void test_local_write(void) {
+    notify_generation_t g = NOTIFY_GENERATION_INIT;
+    CHECK(notify_generation_poll(&g, true));
+    uint32_t before = g.value;
+    // The client's own attribute writes bump even with the flag already set
+    notify_generation_bump(&g);
+    CHECK(g.value != before);
+    CHECK(!notify_generation_poll(&g, true));
+}
+
+static void test_wrap(void) {
+    notify_generation_t g = { UINT32_MAX, false };
+    notify_generation_bump(&g);
+    CHECK(g.value == 1);
+}
+
+int main(void) {
+    test_initial();
+    test_sticky_flag();
+    test_local_write();
+    test_wrap();
+    return check_report("notify_generation");
+}
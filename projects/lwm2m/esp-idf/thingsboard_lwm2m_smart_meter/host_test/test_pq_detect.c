@@ -0,0 +1,252 @@
+// Host-side tests for pq_detect.c (half-cycle RMS sag/swell/interruption
+// detection, pre/post-trigger capture, aggregation RMS/THD, record encoding).
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "pq_detect.h"
+
+#define SPC 64
+#define PRE 4
+#define POST 8
+#define VPC 0.2f // volts per count
+
+static const pq_config_t CFG = {
+    .samples_per_cycle = SPC,
+    .nominal_hz = 60,
+    .volts_per_count = VPC,
+    .nominal_v = 230.0f,
+    .sag_pct = 90,
+    .swell_pct = 110,
+    .interruption_pct = 5,
+    .hysteresis_pct = 2,
+    .pre_cycles = PRE,
+    .post_cycles = POST,
+    .aggregate_cycles = 12,
+};
+
+static int16_t g_ring[PRE * SPC];
+static int16_t g_capture[(PRE + POST) * SPC];
+
+#define MAX_EVENTS 8
+static pq_event_t g_events[MAX_EVENTS];
+static int16_t g_waves[MAX_EVENTS][(PRE + POST) * SPC];
+static int g_event_count;
+
+static void on_event(const pq_event_t *ev, void *arg) {
+    (void) arg;
+    if (g_event_count < MAX_EVENTS) {
+        g_events[g_event_count] = *ev;
+        memcpy(g_waves[g_event_count], ev->waveform, ev->waveform_len * sizeof(int16_t));
+    }
+    g_event_count++;
+}
+
+// Sample k of a 230 V sine scaled by level(half cycle), optional 3rd harmonic
+typedef float level_fn(uint64_t half);
+
+static int16_t sample(uint64_t k, level_fn *level, float h3) {
+    const double w = 2.0 * M_PI * (double) (k % SPC) / SPC;
+    const double peak = 230.0 * sqrt(2.0) * level(k / (SPC / 2)) / VPC;
+    return (int16_t) lrint(peak * (sin(w) + h3 * sin(3.0 * w)));
+}
+
+static void run(pq_detect_t *d, uint64_t *k, uint64_t count, level_fn *level, float h3) {
+    int16_t block[SPC / 4];
+    for (uint64_t n = 0; n < count; n += SPC / 4) {
+        for (size_t i = 0; i < SPC / 4; i++) {
+            block[i] = sample((*k)++, level, h3);
+        }
+        pq_detect_feed(d, block, SPC / 4);
+    }
+}
+
+static float nominal(uint64_t half) { (void) half; return 1.0f; }
+// 50 % sag over half cycles [100, 110)
+static float sag10(uint64_t half) { return half >= 100 && half < 110 ? 0.5f : 1.0f; }
+static float swell(uint64_t half) { return half >= 100 && half < 120 ? 1.2f : 1.0f; }
+static float outage(uint64_t half) { return half >= 100 && half < 160 ? 0.0f : 1.0f; }
+static float dip_1half(uint64_t half) { return half == 101 ? 0.0f : 1.0f; }
+// Two sags 4 half cycles apart: the second falls inside the first's post window
+static float two_sags(uint64_t half) { return (half >= 100 && half < 104) || (half >= 108 && half < 112) ? 0.6f : 1.0f; }
+// Within the hysteresis band: 89 % then 91 % (< 92 %) keeps one event
+static float sag_band(uint64_t half) { return half >= 100 && half < 104 ? 0.89f : half >= 104 && half < 130 ? 0.91f : 1.0f; }
+
+static void reset(pq_detect_t *d) {
+    CHECK(pq_detect_init(d, &CFG, g_ring, g_capture, on_event, NULL) == 0);
+    g_event_count = 0;
+}
+
+static void test_config(void) {
+    pq_detect_t d;
+    pq_config_t bad = CFG;
+    bad.samples_per_cycle = 63;
+    CHECK(pq_detect_init(&d, &bad, g_ring, g_capture, NULL, NULL) == -1);
+    bad = CFG;
+    bad.samples_per_cycle = PQ_MAX_SAMPLES_PER_CYCLE + 2;
+    CHECK(pq_detect_init(&d, &bad, g_ring, g_capture, NULL, NULL) == -1);
+    bad = CFG;
+    bad.swell_pct = 100;
+    CHECK(pq_detect_init(&d, &bad, g_ring, g_capture, NULL, NULL) == -1);
+    bad = CFG;
+    bad.pre_cycles = 0;
+    CHECK(pq_detect_init(&d, &bad, g_ring, g_capture, NULL, NULL) == -1);
+    CHECK(pq_record_size(&CFG) == PQ_RECORD_HEADER_SIZE + (PRE + POST) * SPC * 2);
+}
+
+static void test_steady(void) {
+    pq_detect_t d;
+    reset(&d);
+    uint64_t k = 0;
+    pq_aggregate_t agg;
+    CHECK(!pq_detect_aggregate(&d, &agg));
+    run(&d, &k, 60 * SPC, nominal, 0.0f);
+    CHECK(g_event_count == 0);
+    CHECK(pq_detect_aggregate(&d, &agg));
+    CHECK(agg.windows == 5);
+    CHECK(fabsf(agg.rms_v - 230.0f) < 0.3f);
+    CHECK(fabsf(agg.urms_half_v - 230.0f) < 0.3f);
+    CHECK(agg.thd < 0.005f);
+
+    // 5 % third harmonic
+    reset(&d);
+    k = 0;
+    run(&d, &k, 24 * SPC, nominal, 0.05f);
+    CHECK(pq_detect_aggregate(&d, &agg));
+    CHECK(fabsf(agg.thd - 0.05f) < 0.003f);
+    CHECK(fabsf(agg.rms_v - 230.0f * sqrtf(1.0f + 0.05f * 0.05f)) < 0.3f);
+    CHECK(g_event_count == 0);
+}
+
+static void test_sag(void) {
+    pq_detect_t d;
+    reset(&d);
+    uint64_t k = 0;
+    run(&d, &k, 80 * SPC, sag10, 0.0f);
+    CHECK(g_event_count == 1);
+    const pq_event_t *ev = &g_events[0];
+    CHECK(ev->type == PQ_EVENT_SAG);
+    // Urms(1/2) over a full cycle lags by one half cycle at both edges
+    CHECK(ev->duration_half_cycles >= 10 && ev->duration_half_cycles <= 11);
+    CHECK(fabsf(ev->extreme_v - 115.0f) < 1.0f);
+    CHECK(ev->start_sample == 100 * SPC / 2);
+    CHECK(ev->waveform_len == (PRE + POST) * SPC);
+    // The capture is the waveform itself: triggering half cycle ends at PRE * SPC
+    const uint64_t first = ev->start_sample + SPC / 2 - PRE * SPC;
+    int mismatches = 0;
+    for (size_t i = 0; i < ev->waveform_len; i++) {
+        mismatches += g_waves[0][i] != sample(first + i, sag10, 0.0f);
+    }
+    CHECK(mismatches == 0);
+}
+
+static void test_swell_and_interruption(void) {
+    pq_detect_t d;
+    reset(&d);
+    uint64_t k = 0;
+    run(&d, &k, 80 * SPC, swell, 0.0f);
+    CHECK(g_event_count == 1);
+    CHECK(g_events[0].type == PQ_EVENT_SWELL);
+    CHECK(fabsf(g_events[0].extreme_v - 276.0f) < 1.0f);
+    CHECK(g_events[0].duration_half_cycles >= 20 && g_events[0].duration_half_cycles <= 21);
+
+    reset(&d);
+    k = 0;
+    run(&d, &k, 100 * SPC, outage, 0.0f);
+    CHECK(g_event_count == 1);
+    CHECK(g_events[0].type == PQ_EVENT_INTERRUPTION);
+    CHECK(g_events[0].extreme_v < 1.0f);
+    CHECK(g_events[0].duration_half_cycles >= 60 && g_events[0].duration_half_cycles <= 61);
+
+    // One missing half cycle leaves 71 % over the cycle: a sag, not an interruption
+    reset(&d);
+    k = 0;
+    run(&d, &k, 80 * SPC, dip_1half, 0.0f);
+    CHECK(g_event_count == 1);
+    CHECK(g_events[0].type == PQ_EVENT_SAG);
+    CHECK(fabsf(g_events[0].extreme_v - 230.0f / sqrtf(2.0f)) < 1.0f);
+    CHECK(g_events[0].duration_half_cycles == 2);
+}
+
+static void test_merge_and_hysteresis(void) {
+    pq_detect_t d;
+    reset(&d);
+    uint64_t k = 0;
+    run(&d, &k, 100 * SPC, two_sags, 0.0f);
+    CHECK(g_event_count == 1);
+    CHECK(g_events[0].type == PQ_EVENT_SAG);
+    CHECK(g_events[0].duration_half_cycles >= 8 && g_events[0].duration_half_cycles <= 10);
+
+    reset(&d);
+    k = 0;
+    run(&d, &k, 100 * SPC, sag_band, 0.0f);
+    CHECK(g_event_count == 1);
+    // The first 89 % half cycle averages above 90 % with the nominal one before it
+    CHECK(g_events[0].duration_half_cycles == 29);
+
+    // No event before the pre-trigger ring is full, even without voltage
+    reset(&d);
+    k = 0;
+    run(&d, &k, 40 * SPC, outage, 0.0f);
+    CHECK(g_event_count == 0);
+}
+
+static void test_encode(void) {
+    static int16_t wave[(PRE + POST) * SPC];
+    for (size_t i = 0; i < sizeof(wave) / sizeof(wave[0]); i++) {
+        wave[i] = (int16_t) (i * 37 - 5000);
+    }
+    const pq_event_t ev = { PQ_EVENT_SWELL, 1234, 0x01020304u, 253.27f, wave, sizeof(wave) / sizeof(wave[0]) };
+    static uint8_t buf[PQ_RECORD_HEADER_SIZE + sizeof(wave)];
+    CHECK(pq_record_encode(&CFG, &ev, 0x1122334455667788ull, true, buf, sizeof(buf) - 1) == 0);
+    CHECK(pq_record_encode(&CFG, &ev, 0x1122334455667788ull, true, buf, sizeof(buf)) == sizeof(buf));
+    CHECK(buf[0] == PQ_RECORD_VERSION && buf[1] == PQ_EVENT_SWELL && buf[2] == PRE && buf[3] == POST);
+    CHECK(buf[4] == SPC && buf[5] == 0);
+    CHECK((buf[6] | buf[7] << 8) == SPC * 60);
+    CHECK(buf[8] == 0x88 && buf[15] == 0x11);
+    CHECK(buf[16] == 0x04 && buf[19] == 0x01);
+    CHECK((buf[20] | buf[21] << 8) == 25327);
+    CHECK(buf[22] == 1);
+    float scale;
+    memcpy(&scale, &buf[24], sizeof(scale));
+    CHECK(scale == VPC);
+    CHECK((int16_t) (buf[28] | buf[29] << 8) == -5000);
+    CHECK((int16_t) (buf[sizeof(buf) - 2] | buf[sizeof(buf) - 1] << 8) == wave[sizeof(wave) / sizeof(wave[0]) - 1]);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// ns per sample through pq_detect_feed() on a steady waveform
+static void test_benchmark(void) {
+    enum { CYCLES = 20000 };
+    pq_detect_t d;
+    reset(&d);
+    static int16_t wave[SPC];
+    for (uint64_t k = 0; k < SPC; k++) {
+        wave[k] = sample(k, nominal, 0.05f);
+    }
+    const double start = now_ns();
+    for (int c = 0; c < CYCLES; c++) {
+        pq_detect_feed(&d, wave, SPC);
+    }
+    const double ns = (now_ns() - start) / ((double) CYCLES * SPC);
+    CHECK(g_event_count == 0);
+    printf("pq_detect_feed: %.2f ns/sample (%d samples/s at %d spc, 60 Hz)\n", ns, SPC * 60, SPC);
+}
+
+int main(void) {
+    test_config();
+    test_steady();
+    test_sag();
+    test_swell_and_interruption();
+    test_merge_and_hysteresis();
+    test_encode();
+    test_benchmark();
+    return check_report("pq_detect");
+}
@@ -0,0 +1,198 @@
+// Host-side tests for rule_engine.c (rule compilation, hysteresis/hold
+// semantics) and a per-sample evaluation benchmark.
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "rule_engine.h"
+
+enum { SIG_VOLTAGE, SIG_CURRENT, SIG_PF, SIG_TEMPERATURE };
+
+static rule_def_t rule(uint8_t signal, rule_op_t op, float threshold, float hysteresis, uint8_t hold) {
+    rule_def_t d = { true, signal, (uint8_t) op, hold, threshold, hysteresis };
+    return d;
+}
+
+static void test_compile(void) {
+    rule_table_t t;
+    rule_def_t defs[RULE_ENGINE_MAX_RULES + 1];
+    defs[0] = rule(SIG_CURRENT, RULE_ABOVE, 10.0f, 0.5f, 1);
+    defs[1] = rule(SIG_VOLTAGE, RULE_BELOW, 207.0f, 2.0f, 3);  // sag
+    defs[2] = rule(SIG_VOLTAGE, RULE_ABOVE, 253.0f, 2.0f, 3);  // swell
+    defs[3] = rule(SIG_PF, RULE_BELOW, 0.85f, 0.02f, 1);
+    defs[4] = rule(SIG_PF, RULE_BELOW, 0.5f, 0.0f, 1);
+    defs[4].enabled = false;
+    defs[5] = rule(RULE_ENGINE_MAX_SIGNALS, RULE_ABOVE, 1.0f, 0.0f, 1); // unknown signal
+    defs[6] = rule(SIG_CURRENT, RULE_ABOVE, 1.0f, 0.0f, 0);          // hold 0
+    defs[7] = rule(SIG_CURRENT, RULE_ABOVE, NAN, 0.0f, 1);
+    defs[8] = rule(SIG_CURRENT, RULE_ABOVE, 1.0f, -1.0f, 1);
+    defs[9] = rule(SIG_CURRENT, 7, 1.0f, 0.0f, 1);
+    CHECK(rule_engine_compile(&t, defs, 10) == 4);
+    // Grouped by signal, definition order kept inside a group
+    CHECK(t.first[SIG_VOLTAGE] == 0 && t.first[SIG_CURRENT] == 2 && t.first[SIG_PF] == 3);
+    CHECK(t.first[SIG_TEMPERATURE] == 4 && t.first[RULE_ENGINE_MAX_SIGNALS] == 4);
+    CHECK(t.rule[0] == 1 && t.rule[1] == 2 && t.rule[2] == 0 && t.rule[3] == 3);
+    CHECK(t.active == 0);
+    CHECK(rule_engine_compile(&t, defs, RULE_ENGINE_MAX_RULES + 1) == -1);
+    CHECK(rule_engine_compile(&t, defs, 0) == 0);
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 100.0f) == 0);
+}
+
+static void test_above_with_hysteresis(void) {
+    rule_table_t t;
+    const rule_def_t defs[] = { rule(SIG_CURRENT, RULE_ABOVE, 10.0f, 0.5f, 1) };
+    CHECK(rule_engine_compile(&t, defs, 1) == 1);
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 9.9f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 10.0f) == 0); // strictly above
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 10.1f) == 1u);
+    CHECK(rule_engine_active(&t, 0));
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 12.0f) == 0); // already active
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 9.6f) == 0);  // inside the hysteresis band
+    CHECK(rule_engine_active(&t, 0));
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 9.4f) == 1u);
+    CHECK(!rule_engine_active(&t, 0));
+    // Other signals never touch it
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 1000.0f) == 0);
+    CHECK(rule_engine_eval(&t, RULE_ENGINE_MAX_SIGNALS, 1000.0f) == 0);
+    CHECK(rule_engine_eval(&t, 0xFF, 1000.0f) == 0);
+}
+
+static void test_sag_swell_hold(void) {
+    rule_table_t t;
+    const rule_def_t defs[] = {
+        rule(SIG_VOLTAGE, RULE_BELOW, 207.0f, 2.0f, 3),
+        rule(SIG_VOLTAGE, RULE_ABOVE, 253.0f, 2.0f, 3),
+    };
+    CHECK(rule_engine_compile(&t, defs, 2) == 2);
+    // A two-sample dip does not make a sag
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 201.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 230.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 1u);
+    CHECK(t.active == 1u);
+    // NaN neither clears nor counts
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, NAN) == 0);
+    CHECK(t.active == 1u);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 208.0f) == 0); // 207 + 2 hysteresis not reached
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 209.5f) == 1u);
+    CHECK(t.active == 0);
+    // Swell straight from normal; a NaN in the run restarts the hold count
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 260.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, NAN) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 260.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 260.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 260.0f) == 2u);
+    CHECK(t.active == 2u);
+    // Recompiling restarts every rule inactive
+    CHECK(rule_engine_compile(&t, defs, 2) == 2);
+    CHECK(t.active == 0);
+}
+
+static void test_below_power_factor(void) {
+    rule_table_t t;
+    rule_def_t defs[RULE_ENGINE_MAX_RULES];
+    memset(defs, 0, sizeof(defs));
+    defs[5] = rule(SIG_PF, RULE_BELOW, 0.85f, 0.02f, 1);
+    defs[9] = rule(SIG_TEMPERATURE, RULE_ABOVE, 30.0f, 1.0f, 2);
+    CHECK(rule_engine_compile(&t, defs, RULE_ENGINE_MAX_RULES) == 2);
+    CHECK(rule_engine_eval(&t, SIG_PF, 0.86f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_PF, 0.84f) == (1u << 5));
+    CHECK(rule_engine_eval(&t, SIG_PF, 0.86f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_PF, 0.875f) == (1u << 5));
+    CHECK(rule_engine_eval(&t, SIG_TEMPERATURE, 31.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_TEMPERATURE, 31.0f) == (1u << 9));
+    CHECK(t.active == (1u << 9));
+    // Negative thresholds mirror correctly
+    const rule_def_t cold[] = { rule(SIG_TEMPERATURE, RULE_BELOW, -5.0f, 1.0f, 1) };
+    CHECK(rule_engine_compile(&t, cold, 1) == 1);
+    CHECK(rule_engine_eval(&t, SIG_TEMPERATURE, -5.5f) == 1u);
+    CHECK(rule_engine_eval(&t, SIG_TEMPERATURE, -4.5f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_TEMPERATURE, -3.9f) == 1u);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// ns per rule_engine_eval() call over a slowly varying signal
+static double bench(rule_table_t *t, uint8_t signal, float base) {
+    enum { N = 2000000 };
+    volatile uint32_t sink = 0;
+    const double start = now_ns();
+    for (int i = 0; i < N; i++) {
+        sink ^= rule_engine_eval(t, signal, base + (float) (i & 1023) * 0.01f);
+    }
+    (void) sink;
+    return (now_ns() - start) / N;
+}
+
+// Recompiling after an edit keeps the state of the rules that did not change
+static void test_carry_state(void) {
+    rule_table_t t;
+    rule_def_t defs[3];
+    defs[0] = rule(SIG_CURRENT, RULE_ABOVE, 10.0f, 0.5f, 1);
+    defs[1] = rule(SIG_VOLTAGE, RULE_BELOW, 207.0f, 2.0f, 3);
+    defs[2] = rule(SIG_PF, RULE_BELOW, 0.85f, 0.02f, 1);
+    CHECK(rule_engine_compile(&t, defs, 3) == 3);
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 11.0f) == 1u);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 0); // 2 of 3 samples held
+    CHECK(rule_engine_eval(&t, SIG_PF, 0.5f) == 4u);
+
+    // Rule 2 edited, and a new rule on the voltage moves the conditions around
+    const rule_table_t old = t;
+    rule_def_t edited[4] = { defs[0], defs[1], defs[2], rule(SIG_VOLTAGE, RULE_ABOVE, 253.0f, 2.0f, 1) };
+    edited[2].threshold = 0.9f;
+    CHECK(rule_engine_compile(&t, edited, 4) == 4);
+    rule_engine_carry_state(&t, &old, 1u | 2u);
+    CHECK(t.active == 1u);
+    // Rule 0 does not fire again, rule 1 completes its hold, rule 2 starts over
+    CHECK(rule_engine_eval(&t, SIG_CURRENT, 12.0f) == 0);
+    CHECK(rule_engine_eval(&t, SIG_VOLTAGE, 200.0f) == 2u);
+    CHECK(rule_engine_eval(&t, SIG_PF, 0.5f) == 4u);
+
+    // Disabled rules carry nothing, not even when kept
+    const rule_table_t before = t;
+    edited[0].enabled = false;
+    CHECK(rule_engine_compile(&t, edited, 4) == 3);
+    rule_engine_carry_state(&t, &before, 0xFu);
+    CHECK(t.active == (2u | 4u));
+}
+
+static void test_benchmark(void) {
+    rule_table_t t;
+    rule_def_t defs[RULE_ENGINE_MAX_RULES];
+    defs[0] = rule(SIG_CURRENT, RULE_ABOVE, 5.0f, 0.5f, 1);
+    CHECK(rule_engine_compile(&t, defs, 1) == 1);
+    const double one = bench(&t, SIG_CURRENT, 0.0f);
+    const double none = bench(&t, SIG_VOLTAGE, 0.0f);
+
+    // Worst case: every rule on the sampled signal, half of them toggling
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        defs[i] = rule(SIG_VOLTAGE, i & 1 ? RULE_BELOW : RULE_ABOVE, 200.0f + (float) i, 0.5f, 2);
+    }
+    CHECK(rule_engine_compile(&t, defs, RULE_ENGINE_MAX_RULES) == RULE_ENGINE_MAX_RULES);
+    const double full = bench(&t, SIG_VOLTAGE, 200.0f);
+    const double other = bench(&t, SIG_CURRENT, 0.0f);
+
+    printf("rule_engine_eval: %.1f ns (no rule), %.1f ns (1 rule), %.1f ns (%d rules), %.1f ns (other signal)\n",
+           none, one, full, RULE_ENGINE_MAX_RULES, other);
+    // Loose bound: the cost is a short fixed loop, far below any sample period
+    CHECK(full < 2000.0);
+}
+
+int main(void) {
+    test_compile();
+    test_above_with_hysteresis();
+    test_sag_swell_hold();
+    test_below_power_factor();
+    test_carry_state();
+    test_benchmark();
+    return check_report("rule_engine");
+}
@@ -4,6 +4,10 @@
 #include <esp_log.h>
 #include <anjay/io.h>
 #include <stdint.h>
+#include "sdkconfig.h"
+#if CONFIG_PQ_CAPTURE_ENABLE
+#include "pq_capture.h"
+#endif
 
 #define OID_BAC 19
 #define RID_DATA 0
@@ -12,11 +16,18 @@
 #define RID_DATA_FMT 4
 #define RID_APP_ID 5
 
+#define IID_PQ 0
 #define IID_FW 65533
 #define IID_SW 65534
 
 static const char *TAG_BAC = "bac19";
 
+#if CONFIG_PQ_CAPTURE_ENABLE
+#define PQ_MIN_VALID_EPOCH_MS 1609459200000LL // 2021-01-01
+// Newest record returned by the last read of /19/0/0
+static uint32_t s_pq_served;
+#endif
+
 typedef struct blob_buf_s {
     uint8_t *ptr;
     size_t size;
@@ -41,6 +52,9 @@ typedef struct {
 static int list_instances(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                           anjay_dm_list_ctx_t *ctx) {
     (void) anjay; (void) def;
+#if CONFIG_PQ_CAPTURE_ENABLE
+    anjay_dm_emit(ctx, IID_PQ);
+#endif
     anjay_dm_emit(ctx, IID_FW);
     anjay_dm_emit(ctx, IID_SW);
     return 0;
@@ -58,7 +72,18 @@ static const entry_t *find_entry_const(const bac_ctx_t *ctx, anjay_iid_t iid) {
 
 static int list_resources(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                           anjay_iid_t iid, anjay_dm_resource_list_ctx_t *ctx) {
-    (void) anjay; (void) def; (void) iid;
+    (void) anjay; (void) def;
+#if CONFIG_PQ_CAPTURE_ENABLE
+    if (iid == IID_PQ) {
+        // Writing Data acknowledges the records last read
+        anjay_dm_emit_res(ctx, RID_DATA, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+        anjay_dm_emit_res(ctx, RID_DATA_CT, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+        anjay_dm_emit_res(ctx, RID_DATA_DESC, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+        anjay_dm_emit_res(ctx, RID_DATA_FMT, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+        anjay_dm_emit_res(ctx, RID_APP_ID, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+        return 0;
+    }
+#endif
     anjay_dm_emit_res(ctx, RID_DATA, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
     anjay_dm_emit_res(ctx, RID_DATA_CT, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
     anjay_dm_emit_res(ctx, RID_DATA_DESC, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
@@ -67,9 +92,52 @@ static int list_resources(anjay_t *anjay, const anjay_dm_object_def_t *const *de
     return 0;
 }
 
+#if CONFIG_PQ_CAPTURE_ENABLE
+// Power-quality events: the stored pq_detect records back to back, oldest first
+static int pq_read(anjay_rid_t rid, anjay_output_ctx_t *ctx) {
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    uint32_t seq = 0;
+    uint64_t newest_ms = 0;
+    switch (rid) {
+    case RID_DATA: {
+        pq_capture_records(&buf, &len, &seq, &newest_ms);
+        const int res = anjay_ret_bytes(ctx, buf ? buf : (const uint8_t *) "", len);
+        if (!res && buf) {
+            s_pq_served = seq;
+        }
+        free(buf);
+        return res;
+    }
+    case RID_DATA_CT:
+        pq_capture_records(&buf, &len, &seq, &newest_ms);
+        free(buf);
+        // Records stamped with uptime (no time sync yet) have no creation time
+        return anjay_ret_i64(ctx, (int64_t) newest_ms >= PQ_MIN_VALID_EPOCH_MS ? (int64_t) (newest_ms / 1000) : 0);
+    case RID_DATA_DESC:
+        return anjay_ret_string(ctx, "Power quality events");
+    case RID_DATA_FMT:
+        return anjay_ret_string(ctx, "pq_detect record v1, little-endian, see pq_detect.h");
+    case RID_APP_ID:
+        return anjay_ret_string(ctx, "pq");
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+}
+
+uint32_t bac19_pq_served_seq(void) {
+    return s_pq_served;
+}
+#endif
+
 static int bac_read(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                 anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid, anjay_output_ctx_t *ctx) {
     (void) anjay; (void) riid;
+#if CONFIG_PQ_CAPTURE_ENABLE
+    if (iid == IID_PQ) {
+        return pq_read(rid, ctx);
+    }
+#endif
     const bac_ctx_t *obj = AVS_CONTAINER_OF(def, bac_ctx_t, def);
     const entry_t *e = find_entry_const(obj, iid);
     if (!e) return ANJAY_ERR_NOT_FOUND;
@@ -94,6 +162,15 @@ static int bac_write(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                  anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
                  anjay_input_ctx_t *ctx) {
     (void) anjay; (void) riid;
+#if CONFIG_PQ_CAPTURE_ENABLE
+    if (iid == IID_PQ) {
+        if (rid != RID_DATA) return ANJAY_ERR_METHOD_NOT_ALLOWED;
+        // The payload is ignored: any write clears what the server has read
+        pq_capture_ack(s_pq_served);
+        ESP_LOGI(TAG_BAC, "BAC19[%u]: events up to #%u acknowledged", (unsigned) iid, (unsigned) s_pq_served);
+        return 0;
+    }
+#endif
     bac_ctx_t *obj = AVS_CONTAINER_OF(def, bac_ctx_t, def);
     entry_t *e = find_entry(obj, iid);
     if (!e) return ANJAY_ERR_NOT_FOUND;
@@ -1,7 +1,10 @@
 ﻿#pragma once
 #include <anjay/anjay.h>
 
-// BinaryAppDataContainer (Object 19) with 2 instances used (FW/SW metadata)
+// BinaryAppDataContainer (Object 19) with 2 instances used (FW/SW metadata),
+// plus instance 0 holding the power-quality event records when
+// CONFIG_PQ_CAPTURE_ENABLE is set (read-only metadata; a write to its Data
+// acknowledges the records returned by the last read)
 // Resources:
 //  0: Data (opaque, R/W)
 //  2: Data Creation Time (time, R/W)
@@ -16,6 +19,10 @@ extern "C" {
 const anjay_dm_object_def_t **bac19_object_create(void);
 void bac19_object_release(const anjay_dm_object_def_t *const *def);
 
+// Sequence number of the newest power-quality record returned by the last
+// read of /19/0/0 (for pq_capture_ack() after a Send)
+uint32_t bac19_pq_served_seq(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,386 @@
+#include "cfg_store.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#define CFG_NVS_NAMESPACE "cfg"
+#define CFG_NVS_KEY "img"
+#define CFG_MAGIC 0x53474643u // "CFGS"
+#define CFG_VERSION 1
+
+// Image: header, then records of { u16 key, u8 type, u8 reserved, u16 len, data[len] }
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t len; // record bytes after the header
+    uint32_t crc; // CRC-32 of those bytes
+} cfg_header_t;
+
+#define CFG_HDR_SIZE sizeof(cfg_header_t)
+#define CFG_REC_HDR_SIZE 6
+
+enum { CFG_T_U8 = 1, CFG_T_U16, CFG_T_I32, CFG_T_F32, CFG_T_F64, CFG_T_STR, CFG_T_BLOB };
+
+static const char *TAG = "cfg_store";
+
+static uint8_t s_img[CFG_STORE_CAPACITY];
+static size_t s_len = CFG_HDR_SIZE;
+static bool s_dirty;
+static SemaphoreHandle_t s_lock;
+
+static void lock(void) {
+    if (s_lock) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+}
+
+static void unlock(void) {
+    if (s_lock) {
+        xSemaphoreGive(s_lock);
+    }
+}
+
+static uint16_t rec_key(size_t off) {
+    return (uint16_t) (s_img[off] | (s_img[off + 1] << 8));
+}
+
+static uint16_t rec_len(size_t off) {
+    return (uint16_t) (s_img[off + 4] | (s_img[off + 5] << 8));
+}
+
+// Offset of the record for key, or -1
+static int find(uint16_t key) {
+    for (size_t off = CFG_HDR_SIZE; off + CFG_REC_HDR_SIZE <= s_len; off += CFG_REC_HDR_SIZE + rec_len(off)) {
+        if (rec_key(off) == key) {
+            return (int) off;
+        }
+    }
+    return -1;
+}
+
+static void remove_at(size_t off) {
+    size_t size = CFG_REC_HDR_SIZE + rec_len(off);
+    memmove(&s_img[off], &s_img[off + size], s_len - off - size);
+    s_len -= size;
+    s_dirty = true;
+}
+
+static int put(uint16_t key, uint8_t type, const void *data, size_t len) {
+    int result = 0;
+    lock();
+    int off = find(key);
+    if (off >= 0 && s_img[off + 2] == type && rec_len(off) == len) {
+        if (memcmp(&s_img[off + CFG_REC_HDR_SIZE], data, len) != 0) {
+            memcpy(&s_img[off + CFG_REC_HDR_SIZE], data, len);
+            s_dirty = true;
+        }
+        unlock();
+        return 0;
+    }
+    // The old record is only dropped once the new one is known to fit
+    size_t old_size = off >= 0 ? CFG_REC_HDR_SIZE + rec_len(off) : 0;
+    if (len > UINT16_MAX || s_len - old_size + CFG_REC_HDR_SIZE + len > sizeof(s_img)) {
+        ESP_LOGE(TAG, "No room for key 0x%04x (%u bytes)", key, (unsigned) len);
+        result = -1;
+    } else {
+        if (off >= 0) {
+            remove_at((size_t) off);
+        }
+        uint8_t *rec = &s_img[s_len];
+        rec[0] = (uint8_t) key;
+        rec[1] = (uint8_t) (key >> 8);
+        rec[2] = type;
+        rec[3] = 0;
+        rec[4] = (uint8_t) len;
+        rec[5] = (uint8_t) (len >> 8);
+        memcpy(&rec[CFG_REC_HDR_SIZE], data, len);
+        s_len += CFG_REC_HDR_SIZE + len;
+        s_dirty = true;
+    }
+    unlock();
+    return result;
+}
+
+// Copies the value of key into out; exact_len requires a fixed-size value
+static int get(uint16_t key, uint8_t type, void *out, size_t size, size_t *len, bool exact_len) {
+    int result = -1;
+    lock();
+    int off = find(key);
+    if (off >= 0 && s_img[off + 2] == type) {
+        size_t n = rec_len(off);
+        if (len) {
+            *len = n;
+        }
+        if (exact_len ? n == size : n <= size) {
+            if (out) {
+                memcpy(out, &s_img[off + CFG_REC_HDR_SIZE], n);
+            }
+            result = 0;
+        }
+    }
+    unlock();
+    return result;
+}
+
+int cfg_store_get_u8(cfg_key_t key, uint8_t *out) {
+    return get(key, CFG_T_U8, out, sizeof(*out), NULL, true);
+}
+
+int cfg_store_get_u16(cfg_key_t key, uint16_t *out) {
+    return get(key, CFG_T_U16, out, sizeof(*out), NULL, true);
+}
+
+int cfg_store_get_i32(cfg_key_t key, int32_t *out) {
+    return get(key, CFG_T_I32, out, sizeof(*out), NULL, true);
+}
+
+int cfg_store_get_f32(cfg_key_t key, float *out) {
+    return get(key, CFG_T_F32, out, sizeof(*out), NULL, true);
+}
+
+int cfg_store_get_f64(cfg_key_t key, double *out) {
+    return get(key, CFG_T_F64, out, sizeof(*out), NULL, true);
+}
+
+int cfg_store_get_str(cfg_key_t key, char *buf, size_t size) {
+    size_t len = 0;
+    if (size == 0 || get(key, CFG_T_STR, buf, size - 1, &len, false)) {
+        return -1;
+    }
+    buf[len] = '\0';
+    return 0;
+}
+
+int cfg_store_get_blob(cfg_key_t key, void *buf, size_t size, size_t *len) {
+    return get(key, CFG_T_BLOB, buf, buf ? size : SIZE_MAX, len, false);
+}
+
+int cfg_store_set_u8(cfg_key_t key, uint8_t value) {
+    return put(key, CFG_T_U8, &value, sizeof(value));
+}
+
+int cfg_store_set_u16(cfg_key_t key, uint16_t value) {
+    return put(key, CFG_T_U16, &value, sizeof(value));
+}
+
+int cfg_store_set_i32(cfg_key_t key, int32_t value) {
+    return put(key, CFG_T_I32, &value, sizeof(value));
+}
+
+int cfg_store_set_f32(cfg_key_t key, float value) {
+    return put(key, CFG_T_F32, &value, sizeof(value));
+}
+
+int cfg_store_set_f64(cfg_key_t key, double value) {
+    return put(key, CFG_T_F64, &value, sizeof(value));
+}
+
+int cfg_store_set_str(cfg_key_t key, const char *value) {
+    return put(key, CFG_T_STR, value, strlen(value));
+}
+
+int cfg_store_set_blob(cfg_key_t key, const void *data, size_t len) {
+    return put(key, CFG_T_BLOB, data, len);
+}
+
+void cfg_store_erase(cfg_key_t key) {
+    lock();
+    int off = find(key);
+    if (off >= 0) {
+        remove_at((size_t) off);
+    }
+    unlock();
+}
+
+void cfg_store_erase_group(uint8_t group) {
+    lock();
+    size_t off = CFG_HDR_SIZE;
+    while (off + CFG_REC_HDR_SIZE <= s_len) {
+        if ((rec_key(off) >> 8) == group) {
+            remove_at(off);
+        } else {
+            off += CFG_REC_HDR_SIZE + rec_len(off);
+        }
+    }
+    unlock();
+}
+
+int cfg_store_commit(void) {
+    lock();
+    if (!s_dirty) {
+        unlock();
+        return 0;
+    }
+    cfg_header_t hdr = {
+        .magic = CFG_MAGIC,
+        .version = CFG_VERSION,
+        .count = 0,
+        .len = (uint32_t) (s_len - CFG_HDR_SIZE),
+        .crc = esp_rom_crc32_le(0, &s_img[CFG_HDR_SIZE], (uint32_t) (s_len - CFG_HDR_SIZE)),
+    };
+    for (size_t off = CFG_HDR_SIZE; off < s_len; off += CFG_REC_HDR_SIZE + rec_len(off)) {
+        hdr.count++;
+    }
+    memcpy(s_img, &hdr, sizeof(hdr));
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, CFG_NVS_KEY, s_img, s_len);
+        if (err == ESP_OK) {
+            err = nvs_commit(h);
+        }
+        nvs_close(h);
+    }
+    if (err == ESP_OK) {
+        s_dirty = false;
+        ESP_LOGD(TAG, "Committed %u records, %u bytes", (unsigned) hdr.count, (unsigned) s_len);
+    } else {
+        ESP_LOGE(TAG, "Commit failed: %s", esp_err_to_name(err));
+    }
+    unlock();
+    return err == ESP_OK ? 0 : -1;
+}
+
+static bool image_valid(size_t size) {
+    cfg_header_t hdr;
+    if (size < CFG_HDR_SIZE) {
+        return false;
+    }
+    memcpy(&hdr, s_img, sizeof(hdr));
+    if (hdr.magic != CFG_MAGIC || hdr.version != CFG_VERSION || hdr.len != size - CFG_HDR_SIZE
+            || hdr.crc != esp_rom_crc32_le(0, &s_img[CFG_HDR_SIZE], hdr.len)) {
+        return false;
+    }
+    // The record chain must end exactly at the end of the image
+    size_t off = CFG_HDR_SIZE;
+    while (off + CFG_REC_HDR_SIZE <= size) {
+        off += CFG_REC_HDR_SIZE + rec_len(off);
+    }
+    return off == size;
+}
+
+static bool import_str(nvs_handle_t h, const char *nvs_key, cfg_key_t key) {
+    char buf[128];
+    size_t size = sizeof(buf);
+    return nvs_get_str(h, nvs_key, buf, &size) == ESP_OK && cfg_store_set_str(key, buf) == 0;
+}
+
+static bool import_f32(nvs_handle_t h, const char *nvs_key, cfg_key_t key) {
+    float value = 0;
+    size_t size = sizeof(value);
+    return nvs_get_blob(h, nvs_key, &value, &size) == ESP_OK && size == sizeof(value)
+           && cfg_store_set_f32(key, value) == 0;
+}
+
+static void erase_legacy(const char *ns, const char *nvs_key) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READWRITE, &h) == ESP_OK) {
+        if (nvs_key) {
+            nvs_erase_key(h, nvs_key);
+        } else {
+            nvs_erase_all(h);
+        }
+        nvs_commit(h);
+        nvs_close(h);
+    }
+}
+
+// Pulls values from the per-module namespaces used before this store existed
+static void import_legacy(void) {
+    nvs_handle_t h;
+    bool tb = false, loc = false, attr = false;
+    if (nvs_open("tb_lwm2m", NVS_READONLY, &h) == ESP_OK) {
+        uint8_t provisioned;
+        uint16_t ssid;
+        int32_t sec_mode;
+        if (nvs_get_u8(h, "provisioned", &provisioned) == ESP_OK) {
+            tb = cfg_store_set_u8(CFG_KEY_TB_PROVISIONED, provisioned) == 0;
+        }
+        if (nvs_get_u16(h, "ssid", &ssid) == ESP_OK) {
+            cfg_store_set_u16(CFG_KEY_TB_SSID, ssid);
+        }
+        if (nvs_get_i32(h, "sec_mode", &sec_mode) == ESP_OK) {
+            cfg_store_set_i32(CFG_KEY_TB_SEC_MODE, sec_mode);
+        }
+        import_str(h, "server_uri", CFG_KEY_TB_SERVER_URI);
+        import_str(h, "psk_id", CFG_KEY_TB_PSK_ID);
+        import_str(h, "psk_key", CFG_KEY_TB_PSK_KEY);
+        nvs_close(h);
+    }
+    if (nvs_open("loc", NVS_READONLY, &h) == ESP_OK) {
+        loc = import_f32(h, "lat", CFG_KEY_LOC_LAT) && import_f32(h, "lon", CFG_KEY_LOC_LON);
+        nvs_close(h);
+    }
+    if (nvs_open("lwm2m", NVS_READONLY, &h) == ESP_OK) {
+        size_t size = 0;
+        if (nvs_get_blob(h, "attr", NULL, &size) == ESP_OK && size > 0 && size < CFG_STORE_CAPACITY) {
+            void *buf = malloc(size);
+            if (buf) {
+                attr = nvs_get_blob(h, "attr", buf, &size) == ESP_OK
+                       && cfg_store_set_blob(CFG_KEY_ATTR_STORAGE, buf, size) == 0;
+                free(buf);
+            }
+        }
+        nvs_close(h);
+    }
+    if (!(tb || loc || attr)) {
+        return;
+    }
+    // Old copies go only once the image holding them is durable
+    if (cfg_store_commit() == 0) {
+        if (tb) {
+            erase_legacy("tb_lwm2m", NULL);
+        }
+        if (loc) {
+            erase_legacy("loc", NULL);
+        }
+        if (attr) {
+            erase_legacy("lwm2m", "attr");
+        }
+        ESP_LOGI(TAG, "Imported legacy NVS namespaces (tb=%d loc=%d attr=%d)", tb, loc, attr);
+    }
+}
+
+int cfg_store_init(void) {
+    if (s_lock) {
+        return 0;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return -1;
+    }
+    int64_t t0 = esp_timer_get_time();
+    size_t size = sizeof(s_img);
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(CFG_NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(h, CFG_NVS_KEY, s_img, &size);
+        nvs_close(h);
+    }
+    if (err == ESP_OK && image_valid(size)) {
+        s_len = size;
+        cfg_header_t hdr;
+        memcpy(&hdr, s_img, sizeof(hdr));
+        ESP_LOGI(TAG, "Loaded %u records (%u bytes) in %lld us", (unsigned) hdr.count, (unsigned) size,
+                 (long long) (esp_timer_get_time() - t0));
+        return 0;
+    }
+    s_len = CFG_HDR_SIZE;
+    if (err == ESP_OK) {
+        ESP_LOGW(TAG, "Stored image is corrupt or of another version, starting empty");
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        import_legacy();
+    } else {
+        ESP_LOGW(TAG, "Cannot read image: %s", esp_err_to_name(err));
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Typed, versioned configuration store shared by all modules.
+// The whole configuration is one image of tagged records kept in RAM: it is
+// read from NVS once at boot (one open, one blob read, CRC checked) and getters
+// never touch flash. Setters only change the RAM image; cfg_store_commit()
+// writes it back as a single NVS blob, so several keys changed together land in
+// one atomic append instead of one NVS entry per key. Setting a value equal to
+// the stored one does not mark the image dirty.
+//
+// On the first boot with this store, values from the former per-module NVS
+// namespaces (tb_lwm2m, loc, lwm2m/attr) are imported and those namespaces
+// erased.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper byte: owning module, see cfg_store_erase_group()
+typedef enum {
+    CFG_KEY_TB_PROVISIONED = 0x0101, // u8
+    CFG_KEY_TB_SERVER_URI = 0x0102,  // str
+    CFG_KEY_TB_SSID = 0x0103,        // u16
+    CFG_KEY_TB_SEC_MODE = 0x0104,    // i32
+    CFG_KEY_TB_PSK_ID = 0x0105,      // str
+    CFG_KEY_TB_PSK_KEY = 0x0106,     // str
+    CFG_KEY_LOC_LAT = 0x0201,        // f32
+    CFG_KEY_LOC_LON = 0x0202,        // f32
+    CFG_KEY_ATTR_STORAGE = 0x0301,   // blob (anjay_attr_storage_persist)
+    // Energy counters live in their own NVS key now (energy_accumulator.c);
+    // these are only read once to carry over older images
+    CFG_KEY_ENERGY_IMPORT = 0x0401,  // f64, kWh
+    CFG_KEY_ENERGY_EXPORT = 0x0402,  // f64, kWh
+    CFG_KEY_RULES = 0x0501,          // blob (Threshold Rules definitions)
+} cfg_key_t;
+
+#define CFG_GROUP_TB 0x01
+#define CFG_GROUP_LOC 0x02
+#define CFG_GROUP_LWM2M 0x03
+#define CFG_GROUP_ENERGY 0x04
+#define CFG_GROUP_RULES 0x05
+
+// Serialized image limit (header + records)
+#define CFG_STORE_CAPACITY 4096
+
+// Needs nvs_flash_init() first. Returns 0 also when nothing is stored yet.
+int cfg_store_init(void);
+
+// Getters return 0, or -1 if the key is absent or has another type
+int cfg_store_get_u8(cfg_key_t key, uint8_t *out);
+int cfg_store_get_u16(cfg_key_t key, uint16_t *out);
+int cfg_store_get_i32(cfg_key_t key, int32_t *out);
+int cfg_store_get_f32(cfg_key_t key, float *out);
+int cfg_store_get_f64(cfg_key_t key, double *out);
+// Copies and NUL-terminates; -1 if it does not fit
+int cfg_store_get_str(cfg_key_t key, char *buf, size_t size);
+// Copies the blob into buf (if not NULL); *len is its size on return
+int cfg_store_get_blob(cfg_key_t key, void *buf, size_t size, size_t *len);
+
+// Setters return -1 only if the image would exceed CFG_STORE_CAPACITY; the
+// previous value of the key is then left in place
+int cfg_store_set_u8(cfg_key_t key, uint8_t value);
+int cfg_store_set_u16(cfg_key_t key, uint16_t value);
+int cfg_store_set_i32(cfg_key_t key, int32_t value);
+int cfg_store_set_f32(cfg_key_t key, float value);
+int cfg_store_set_f64(cfg_key_t key, double value);
+int cfg_store_set_str(cfg_key_t key, const char *value);
+int cfg_store_set_blob(cfg_key_t key, const void *data, size_t len);
+
+void cfg_store_erase(cfg_key_t key);
+// Erases every key of a module (upper key byte == group)
+void cfg_store_erase_group(uint8_t group);
+
+// Writes the image if anything changed since the last commit
+int cfg_store_commit(void);
+
+#ifdef __cplusplus
+}
+#endif
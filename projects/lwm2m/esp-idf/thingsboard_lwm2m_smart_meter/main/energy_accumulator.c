@@ -1,72 +1,73 @@
 #include "energy_accumulator.h"
-#include <stdio.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <errno.h>
 #include <esp_log.h>
-#include <cJSON.h>
-#include <esp_vfs.h>
+#include <nvs.h>
 
-static const char *TAG_EACC = "EnergyAcc";
+#include "cfg_store.h"
 
-// Path inside SPIFFS or LittleFS; adjust to actual mounted FS path
-#ifndef ENERGY_ACCUMULATOR_PATH
-#define ENERGY_ACCUMULATOR_PATH "/spiffs/energy_acc.json"
-#endif
+static const char *TAG_EACC = "EnergyAcc";
 
 #define PERSIST_INTERVAL_S 30.0
 
+// Counters change every persist interval, so they get their own small NVS entry
+// instead of a cfg_store commit, which would rewrite the whole config image
+#define ENERGY_NVS_NAMESPACE "energy"
+#define ENERGY_NVS_KEY "kwh"
+
+typedef struct {
+    double kwh_import;
+    double kwh_export;
+} energy_record_t;
+
+// Both counters go into one blob write
 static void persist(const EnergyAccumulator *acc) {
-    FILE *f = fopen(ENERGY_ACCUMULATOR_PATH, "w");
-    if (!f) {
-        ESP_LOGE(TAG_EACC, "persist fopen(%s) failed: %s", ENERGY_ACCUMULATOR_PATH, strerror(errno));
-        return;
+    const energy_record_t rec = { acc->kwh_import, acc->kwh_export };
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(ENERGY_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, ENERGY_NVS_KEY, &rec, sizeof(rec));
+        if (err == ESP_OK) {
+            err = nvs_commit(h);
+        }
+        nvs_close(h);
     }
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "kwh_import", acc->kwh_import);
-    cJSON_AddNumberToObject(root, "kwh_export", acc->kwh_export);
-    char *json = cJSON_PrintUnformatted(root);
-    if (json) {
-        fprintf(f, "%s", json);
-        cJSON_free(json);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_EACC, "Failed to persist energy counters: %s", esp_err_to_name(err));
+        return;
     }
-    cJSON_Delete(root);
-    fclose(f);
     ESP_LOGI(TAG_EACC, "Persisted energy import=%.6f export=%.6f", acc->kwh_import, acc->kwh_export);
 }
 
-static void load(EnergyAccumulator *acc) {
-    FILE *f = fopen(ENERGY_ACCUMULATOR_PATH, "r");
-    if (!f) {
-        ESP_LOGW(TAG_EACC, "No existing energy file %s (errno=%d)", ENERGY_ACCUMULATOR_PATH, errno);
-        return;
+// Counters stored in the config image by earlier firmware move to NVS once
+static bool import_from_cfg_store(EnergyAccumulator *acc) {
+    if (cfg_store_get_f64(CFG_KEY_ENERGY_IMPORT, &acc->kwh_import)
+            || cfg_store_get_f64(CFG_KEY_ENERGY_EXPORT, &acc->kwh_export)) {
+        return false;
     }
-    fseek(f, 0, SEEK_END);
-    long sz = ftell(f);
-    if (sz < 0 || sz > 4096) {
-        fclose(f);
-        ESP_LOGW(TAG_EACC, "Invalid energy file size %ld", sz);
-        return;
-    }
-    rewind(f);
-    char buf[4096];
-    size_t n = fread(buf, 1, (size_t)sz, f);
-    fclose(f);
-    if (n != (size_t)sz) {
-        ESP_LOGW(TAG_EACC, "Short read energy file");
-        return;
+    persist(acc);
+    cfg_store_erase_group(CFG_GROUP_ENERGY);
+    (void) cfg_store_commit();
+    return true;
+}
+
+static void load(EnergyAccumulator *acc) {
+    energy_record_t rec;
+    size_t size = sizeof(rec);
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(ENERGY_NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(h, ENERGY_NVS_KEY, &rec, &size);
+        nvs_close(h);
     }
-    buf[n] = '\0';
-    cJSON *root = cJSON_Parse(buf);
-    if (!root) {
-        ESP_LOGW(TAG_EACC, "JSON parse error for energy file");
+    if (err == ESP_OK && size == sizeof(rec)) {
+        acc->kwh_import = rec.kwh_import;
+        acc->kwh_export = rec.kwh_export;
+    } else if (!import_from_cfg_store(acc)) {
+        acc->kwh_import = 0.0;
+        acc->kwh_export = 0.0;
+        ESP_LOGW(TAG_EACC, "No stored energy counters");
         return;
     }
-    cJSON *ji = cJSON_GetObjectItem(root, "kwh_import");
-    cJSON *je = cJSON_GetObjectItem(root, "kwh_export");
-    if (cJSON_IsNumber(ji)) acc->kwh_import = ji->valuedouble;
-    if (cJSON_IsNumber(je)) acc->kwh_export = je->valuedouble;
-    cJSON_Delete(root);
     ESP_LOGI(TAG_EACC, "Loaded energy import=%.6f export=%.6f", acc->kwh_import, acc->kwh_export);
 }
 
@@ -6,71 +6,341 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <avsystem/commons/avs_log.h>
 
 #include <anjay/anjay.h>
 #include <anjay/fw_update.h>
 
+#include "sdkconfig.h"
+
 #include <esp_err.h>
+#include <esp_event.h>
+#include <esp_image_format.h>
+#include <esp_netif.h>
+#include <esp_ota_ops.h>
 #include <esp_partition.h>
 #include <esp_system.h>
-
-// Minimal forward declarations for OTA APIs to decouple from esp_ota_ops.h
-// NOTE: Linkage is provided by the app_update component.
-typedef int esp_ota_handle_t;
-typedef enum {
-    ESP_OTA_IMG_UNDEFINED = 0,
-    ESP_OTA_IMG_NEW = 1,
-    ESP_OTA_IMG_PENDING_VERIFY = 2,
-    ESP_OTA_IMG_VALID = 3,
-    ESP_OTA_IMG_INVALID = 4
-} esp_ota_img_states_t;
-// esp_ota_ops.h defines OTA_SIZE_UNKNOWN as 0; define locally if missing
-#ifndef OTA_SIZE_UNKNOWN
-#define OTA_SIZE_UNKNOWN 0
+#include <esp_wifi.h>
+#include <mbedtls/sha256.h>
+#if CONFIG_FW_MANIFEST_VERIFY
+#include <mbedtls/pk.h>
 #endif
-esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
-esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
-esp_err_t esp_ota_end(esp_ota_handle_t handle);
-esp_err_t esp_ota_abort(esp_ota_handle_t handle);
-esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
-const esp_partition_t *esp_ota_get_running_partition(void);
-esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *out_state);
-esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
-const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
 
 #include "firmware_update.h"
-#include "sdkconfig.h"
+#include "fw_image.h"
+#include "fw_package.h"
+#include "fw_resume.h"
+#include "ota_writer.h"
+
+#ifndef CONFIG_FW_RESUME_CHECKPOINT_KB
+#define CONFIG_FW_RESUME_CHECKPOINT_KB 64
+#endif
+#ifndef CONFIG_FW_DOWNLOAD_TCP_TIMEOUT_S
+#define CONFIG_FW_DOWNLOAD_TCP_TIMEOUT_S 20
+#endif
+
+// First byte of every ESP-IDF app image (ESP_IMAGE_HEADER_MAGIC)
+#define FW_IMAGE_MAGIC 0xE9
+#define FW_CHECKPOINT_BYTES ((uint32_t) CONFIG_FW_RESUME_CHECKPOINT_KB * 1024)
+#define FW_HASH_CHUNK 4096
+
+enum { FW_FORMAT_UNKNOWN, FW_FORMAT_IMAGE, FW_FORMAT_PACKAGE };
 
 static struct {
     anjay_t *anjay;
-    esp_ota_handle_t update_handle;
     const esp_partition_t *update_partition;
     atomic_bool update_requested;
+    // Download format, decided by the first bytes received
+    uint8_t format;             // FW_FORMAT_*
+    uint8_t hdr[FW_PKG_HEADER_SIZE];
+    size_t hdr_len;
+    fw_pkg_decoder_t *pkg;      // FW_FORMAT_PACKAGE only
+    uint32_t received;          // downloaded bytes
+    // Image verification while streaming
+    fw_image_parser_t image;    // layout of the app image written to flash
+    mbedtls_sha256_context image_sha; // over its hashed region
+    bool image_sha_active;
+    // Download resumption
+    mbedtls_sha256_context sha; // over downloaded bytes [0, received)
+    bool sha_active;
+    bool checkpoints;           // package identity stored, positions are saved
+    uint32_t next_checkpoint;
+    uint32_t saved_offset;      // last position in NVS
+    fw_resume_pos_t pending;    // snapshot waiting for flash to catch up
+    bool pending_valid;
+    fw_resume_id_t resume_id;   // also backs persisted_uri after a reboot
+    anjay_etag_t *resume_etag;
+    // Pull download held by fw_update_poll() while the link is down
+    bool pull_active;
+    bool pull_suspended;
 } fw_state;
 
-static int fw_stream_open(void *user_ptr,
-                          const char *package_uri,
-                          const struct anjay_etag *package_etag) {
-    (void) user_ptr;
-    (void) package_uri;
-    (void) package_etag;
+// ota_writer erases ahead of itself, so blocks go straight to the partition; an
+// esp_ota handle would insist on erasing through its own bookkeeping
+static int fw_program(void *ctx, uint32_t offset, const void *data, size_t len) {
+    (void) ctx;
+    return esp_partition_write(fw_state.update_partition, offset, data, len) == ESP_OK ? 0 : -1;
+}
 
-    assert(!fw_state.update_partition);
+static void image_release(void) {
+    if (fw_state.image_sha_active) {
+        mbedtls_sha256_free(&fw_state.image_sha);
+        fw_state.image_sha_active = false;
+    }
+}
+
+static void image_start(void) {
+    image_release();
+    fw_image_init(&fw_state.image);
+    mbedtls_sha256_init(&fw_state.image_sha);
+    mbedtls_sha256_starts(&fw_state.image_sha, 0);
+    fw_state.image_sha_active = true;
+}
+
+// Hashes the image bytes on their way to flash (hardware SHA), so the digest is
+// ready as soon as the last block has been queued
+static int write_image(const uint8_t *data, size_t len) {
+    int hashed = fw_image_feed(&fw_state.image, data, len);
+    if (hashed < 0) {
+        avs_log(fw_update, ERROR, "Malformed app image near offset %u", (unsigned) fw_state.image.offset);
+        return ANJAY_FW_UPDATE_ERR_UNSUPPORTED_PACKAGE_TYPE;
+    }
+    mbedtls_sha256_update(&fw_state.image_sha, data, (size_t) hashed);
+    // Copies into a staging buffer; blocks only while flash is behind
+    return ota_writer_write(data, len) ? -1 : 0;
+}
+
+static int pkg_sink(void *ctx, const uint8_t *data, size_t len) {
+    (void) ctx;
+    return write_image(data, len);
+}
+
+static int pkg_base_read(void *ctx, uint32_t offset, void *dst, size_t len) {
+    return esp_partition_read((const esp_partition_t *) ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static void release_package(void) {
+    if (fw_state.pkg) {
+        fw_pkg_decoder_free(fw_state.pkg);
+        free(fw_state.pkg);
+        fw_state.pkg = NULL;
+    }
+}
 
+static int open_stream(uint32_t offset) {
     fw_state.update_partition = esp_ota_get_next_update_partition(NULL);
     if (!fw_state.update_partition) {
         avs_log(fw_update, ERROR, "Cannot obtain update partition");
         return -1;
     }
 
-    if (esp_ota_begin(fw_state.update_partition, OTA_SIZE_UNKNOWN,
-                      &fw_state.update_handle)) {
-        avs_log(fw_update, ERROR, "OTA begin failed");
+    // No up-front erase of the whole partition: the writer task erases ahead of
+    // the download while the link is idle
+    if (ota_writer_start(fw_state.update_partition, offset, fw_program, NULL)) {
+        avs_log(fw_update, ERROR, "OTA writer start failed");
         fw_state.update_partition = NULL;
         return -1;
     }
+    release_package();
+    // A resumed stream is always a plain image, packages are not checkpointed
+    fw_state.format = offset ? FW_FORMAT_IMAGE : FW_FORMAT_UNKNOWN;
+    fw_state.hdr_len = 0;
+    fw_state.received = offset;
+    return 0;
+}
+
+static bool partition_matches(const esp_partition_t *part, uint32_t len, const uint8_t *sha256) {
+    if (len > part->size) {
+        return false;
+    }
+    uint8_t *buf = (uint8_t *) malloc(FW_HASH_CHUNK);
+    if (!buf) {
+        return false;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    bool ok = mbedtls_sha256_starts(&sha, 0) == 0;
+    for (uint32_t off = 0; ok && off < len; off += FW_HASH_CHUNK) {
+        size_t n = len - off < FW_HASH_CHUNK ? len - off : FW_HASH_CHUNK;
+        ok = esp_partition_read(part, off, buf, n) == ESP_OK && mbedtls_sha256_update(&sha, buf, n) == 0;
+    }
+    free(buf);
+    ok = ok && mbedtls_sha256_finish(&sha, digest) == 0 && memcmp(digest, sha256, sizeof(digest)) == 0;
+    mbedtls_sha256_free(&sha);
+    return ok;
+}
+
+// Validates the FWPK header collected in fw_state.hdr and sets up its decoder
+static int open_package(void) {
+    fw_pkg_header_t hdr;
+    if (fw_pkg_parse_header(fw_state.hdr, &hdr)) {
+        avs_log(fw_update, ERROR, "Malformed or unsupported firmware package header");
+        return ANJAY_FW_UPDATE_ERR_UNSUPPORTED_PACKAGE_TYPE;
+    }
+    if (hdr.image_size > fw_state.update_partition->size) {
+        avs_log(fw_update, ERROR, "Image of %u bytes does not fit the update partition",
+                (unsigned) hdr.image_size);
+        return ANJAY_FW_UPDATE_ERR_NOT_ENOUGH_SPACE;
+    }
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if ((hdr.flags & FW_PKG_FLAG_DELTA) && !partition_matches(running, hdr.base_size, hdr.base_sha256)) {
+        avs_log(fw_update, ERROR, "Delta package was built against a different base image");
+        return ANJAY_FW_UPDATE_ERR_UNSUPPORTED_PACKAGE_TYPE;
+    }
+    fw_state.pkg = (fw_pkg_decoder_t *) malloc(sizeof(*fw_state.pkg));
+    if (!fw_state.pkg
+            || fw_pkg_decoder_init(fw_state.pkg, &hdr, pkg_sink, NULL, pkg_base_read, (void *) running)) {
+        avs_log(fw_update, ERROR, "Out of memory for package decoder");
+        release_package();
+        return ANJAY_FW_UPDATE_ERR_OUT_OF_MEMORY;
+    }
+    avs_log(fw_update, INFO, "Firmware package:%s%s, image %u bytes",
+            (hdr.flags & FW_PKG_FLAG_COMPRESSED) ? " compressed" : "",
+            (hdr.flags & FW_PKG_FLAG_DELTA) ? " delta" : "", (unsigned) hdr.image_size);
+    // Download offsets no longer map to flash offsets; resuming would need the
+    // decoder state as well
+    if (fw_state.checkpoints) {
+        fw_state.checkpoints = false;
+        fw_resume_clear();
+    }
+    return 0;
+}
+
+// Routes downloaded bytes to flash directly (app image) or through the package
+// decoder (FWPK container), depending on the first bytes of the download
+static int fw_input(const uint8_t *p, size_t n) {
+    if (fw_state.format == FW_FORMAT_UNKNOWN) {
+        if (fw_state.hdr_len == 0 && p[0] == FW_IMAGE_MAGIC) {
+            fw_state.format = FW_FORMAT_IMAGE;
+        } else {
+            size_t take = FW_PKG_HEADER_SIZE - fw_state.hdr_len;
+            if (take > n) {
+                take = n;
+            }
+            memcpy(&fw_state.hdr[fw_state.hdr_len], p, take);
+            fw_state.hdr_len += take;
+            p += take;
+            n -= take;
+            // esp_ota_write() used to reject non-images on the first block; keep that
+            if (memcmp(fw_state.hdr, FW_PKG_MAGIC, fw_state.hdr_len < 4 ? fw_state.hdr_len : 4)) {
+                avs_log(fw_update, ERROR, "Not an ESP-IDF app image or package (magic 0x%02x)",
+                        fw_state.hdr[0]);
+                return ANJAY_FW_UPDATE_ERR_UNSUPPORTED_PACKAGE_TYPE;
+            }
+            if (fw_state.hdr_len < FW_PKG_HEADER_SIZE) {
+                return 0;
+            }
+            int result = open_package();
+            if (result) {
+                return result;
+            }
+            fw_state.format = FW_FORMAT_PACKAGE;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (fw_state.format == FW_FORMAT_IMAGE) {
+        return write_image(p, n);
+    }
+    int result = fw_pkg_decoder_feed(fw_state.pkg, p, n);
+    if (result) {
+        avs_log(fw_update, ERROR, "Package decoding failed (%d)", result);
+        return result == FW_PKG_ERR_FORMAT ? ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE : -1;
+    }
+    return 0;
+}
+
+static void hash_reset(void) {
+    if (fw_state.sha_active) {
+        mbedtls_sha256_free(&fw_state.sha);
+        fw_state.sha_active = false;
+    }
+    fw_state.pending_valid = false;
+}
+
+// Stores the package identity so positions saved later can be resumed from.
+// Push-mode transfers have no URI to resume from and are not checkpointed.
+static void start_checkpoints(const char *uri, const struct anjay_etag *etag) {
+    fw_resume_id_t *id = &fw_state.resume_id;
+
+    fw_state.checkpoints = false;
+    fw_state.saved_offset = 0;
+    fw_state.next_checkpoint = FW_CHECKPOINT_BYTES;
+    fw_state.pending_valid = false;
+    if (!uri) {
+        avs_log(fw_update, INFO, "Push-mode download cannot be resumed");
+        fw_resume_clear();
+        return;
+    }
+    if (strlen(uri) >= sizeof(id->uri) || (etag && etag->size > sizeof(id->etag))) {
+        avs_log(fw_update, WARNING, "Package URI/ETag too long to persist, download cannot be resumed");
+        fw_resume_clear();
+        return;
+    }
+    memset(id, 0, sizeof(*id));
+    strcpy(id->uri, uri);
+    if (etag) {
+        id->etag_len = etag->size;
+        memcpy(id->etag, etag->value, etag->size);
+    }
+    fw_state.checkpoints = fw_resume_begin(id) == 0;
+}
+
+// Freezes the running hash at a checkpoint boundary. The position is only stored
+// once the writer task has programmed that far, so NVS never points past flash.
+static void snapshot_checkpoint(void) {
+    mbedtls_sha256_context tmp;
+    mbedtls_sha256_init(&tmp);
+    mbedtls_sha256_clone(&tmp, &fw_state.sha);
+    if (mbedtls_sha256_finish(&tmp, fw_state.pending.digest) == 0) {
+        fw_state.pending.offset = fw_state.next_checkpoint;
+        fw_state.pending_valid = true;
+    }
+    mbedtls_sha256_free(&tmp);
+    fw_state.next_checkpoint += FW_CHECKPOINT_BYTES;
+}
+
+static void flush_checkpoint(void) {
+    if (fw_state.pending_valid && ota_writer_committed() >= fw_state.pending.offset) {
+        fw_state.pending_valid = false;
+        if (!fw_resume_save(&fw_state.pending)) {
+            fw_state.saved_offset = fw_state.pending.offset;
+        }
+    }
+}
+
+static bool link_is_up(void) {
+    esp_netif_t *netif = esp_netif_get_default_netif();
+    return netif && esp_netif_is_netif_up(netif);
+}
+
+static int fw_stream_open(void *user_ptr,
+                          const char *package_uri,
+                          const struct anjay_etag *package_etag) {
+    (void) user_ptr;
+
+    assert(!fw_state.update_partition);
+
+    if (package_uri) {
+        avs_log(fw_update, INFO, "Pull download from %s", package_uri);
+    }
+    if (open_stream(0)) {
+        return -1;
+    }
+    hash_reset();
+    mbedtls_sha256_init(&fw_state.sha);
+    mbedtls_sha256_starts(&fw_state.sha, 0);
+    fw_state.sha_active = true;
+    image_start();
+    start_checkpoints(package_uri, package_etag);
+    fw_state.pull_active = package_uri != NULL;
+    fw_state.pull_suspended = false;
     return 0;
 }
 
@@ -79,17 +349,88 @@ static int fw_stream_write(void *user_ptr, const void *data, size_t length) {
 
     assert(fw_state.update_partition);
 
-    int result = esp_ota_write(fw_state.update_handle, data, length);
-    if (result) {
-        avs_log(fw_update, ERROR, "OTA write failed");
-#ifdef ESP_ERR_OTA_VALIDATE_FAILED
-        return result == ESP_ERR_OTA_VALIDATE_FAILED
-                       ? ANJAY_FW_UPDATE_ERR_UNSUPPORTED_PACKAGE_TYPE
-                       : -1;
-#else
+    const uint8_t *p = (const uint8_t *) data;
+    while (length > 0) {
+        // Split at the checkpoint boundary so the snapshot hash ends exactly there
+        size_t n = length;
+        if (fw_state.checkpoints && fw_state.received + n >= fw_state.next_checkpoint) {
+            n = fw_state.next_checkpoint - fw_state.received;
+        }
+        mbedtls_sha256_update(&fw_state.sha, p, n);
+        int result = fw_input(p, n);
+        if (result) {
+            if (result == -1) {
+                avs_log(fw_update, ERROR, "OTA write failed");
+            }
+            return result;
+        }
+        fw_state.received += n;
+        p += n;
+        length -= n;
+        if (fw_state.checkpoints && fw_state.received == fw_state.next_checkpoint) {
+            snapshot_checkpoint();
+        }
+    }
+    flush_checkpoint();
+    return 0;
+}
+
+#if CONFIG_FW_MANIFEST_VERIFY
+extern const uint8_t fw_sign_pub_pem_start[] asm("_binary_fw_sign_pub_pem_start");
+extern const uint8_t fw_sign_pub_pem_end[] asm("_binary_fw_sign_pub_pem_end");
+
+// Checks the manifest appended by tools/fw_package.py --sign: a signature over the
+// image SHA-256 with the key embedded from fw_sign_pub.pem
+static int verify_manifest(const uint8_t *digest) {
+    const uint8_t *sig;
+    size_t sig_len;
+    if (fw_image_manifest_signature(&fw_state.image, &sig, &sig_len)) {
+        avs_log(fw_update, ERROR, "Image has no signed manifest, rejected");
         return -1;
+    }
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+    int ret = mbedtls_pk_parse_public_key(&pk, fw_sign_pub_pem_start,
+                                          (size_t) (fw_sign_pub_pem_end - fw_sign_pub_pem_start));
+    if (!ret) {
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, FW_IMAGE_DIGEST_SIZE, sig, sig_len);
+    }
+    mbedtls_pk_free(&pk);
+    if (ret) {
+        avs_log(fw_update, ERROR, "Manifest signature check failed (-0x%04x)", (unsigned) -ret);
+        return -1;
+    }
+    avs_log(fw_update, INFO, "Manifest signature valid");
+    return 0;
+}
 #endif
+
+// Returns 0 if the streamed image matched its appended SHA-256 (and manifest, if
+// required), 1 if it carries no digest and has to be verified from flash, or an
+// Anjay error code
+static int verify_image(void) {
+    fw_image_parser_t *img = &fw_state.image;
+    uint8_t digest[FW_IMAGE_DIGEST_SIZE];
+
+    if (!fw_image_hashed_complete(img) || mbedtls_sha256_finish(&fw_state.image_sha, digest)) {
+        avs_log(fw_update, ERROR, "Image truncated at %u bytes", (unsigned) img->offset);
+        return ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE;
     }
+    if (img->hash_appended
+            && (!fw_image_digest_complete(img) || memcmp(digest, img->digest, sizeof(digest)) != 0)) {
+        avs_log(fw_update, ERROR, "Image SHA-256 mismatch");
+        return ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE;
+    }
+#if CONFIG_FW_MANIFEST_VERIFY
+    if (verify_manifest(digest)) {
+        return ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE;
+    }
+#endif
+    if (!img->hash_appended) {
+        avs_log(fw_update, INFO, "Image has no appended SHA-256, verifying from flash");
+        return 1;
+    }
+    avs_log(fw_update, INFO, "Image SHA-256 verified while streaming");
     return 0;
 }
 
@@ -98,17 +439,50 @@ static int fw_stream_finish(void *user_ptr) {
 
     assert(fw_state.update_partition);
 
-    int result = esp_ota_end(fw_state.update_handle);
+    fw_state.pull_active = false;
+    int result = 0;
+    if (fw_state.pkg) {
+        // Flushes decoded output into the writer; a short package is corrupt
+        result = fw_pkg_decoder_finish(fw_state.pkg);
+        release_package();
+        if (result) {
+            avs_log(fw_update, ERROR, "Package ended before the whole image was decoded");
+            ota_writer_stop();
+            fw_state.update_partition = NULL;
+            return result == FW_PKG_ERR_FORMAT ? ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE : -1;
+        }
+    }
+    result = ota_writer_finish();
+    ota_writer_stop();
     if (result) {
-        avs_log(fw_update, ERROR, "OTA end failed");
+        avs_log(fw_update, ERROR, "OTA flush failed");
         fw_state.update_partition = NULL;
-#ifdef ESP_ERR_OTA_VALIDATE_FAILED
-        return result == ESP_ERR_OTA_VALIDATE_FAILED
-                       ? ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE
-                       : -1;
-#else
         return -1;
-#endif
+    }
+    // Whole image is in flash: nothing left to resume
+    hash_reset();
+    if (fw_state.checkpoints) {
+        fw_state.checkpoints = false;
+        fw_resume_clear();
+    }
+    result = verify_image();
+    image_release();
+    if (result < 0) {
+        fw_state.update_partition = NULL;
+        return result;
+    }
+    if (result == 0) {
+        // Corruption is caught here, while the server can still be told. The
+        // only full read-back left is the one esp_ota_set_boot_partition()
+        // always does on Update; the one esp_ota_end() would add is skipped.
+        return 0;
+    }
+    const esp_partition_pos_t pos = { fw_state.update_partition->address, fw_state.update_partition->size };
+    esp_image_metadata_t meta;
+    if (esp_image_verify(ESP_IMAGE_VERIFY, &pos, &meta) != ESP_OK) {
+        avs_log(fw_update, ERROR, "Image verification from flash failed");
+        fw_state.update_partition = NULL;
+        return ANJAY_FW_UPDATE_ERR_INTEGRITY_FAILURE;
     }
     return 0;
 }
@@ -116,15 +490,32 @@ static int fw_stream_finish(void *user_ptr) {
 static void fw_reset(void *user_ptr) {
     (void) user_ptr;
 
+    fw_state.pull_active = false;
+    fw_state.pull_suspended = false;
     if (fw_state.update_partition) {
-        esp_ota_abort(fw_state.update_handle);
+        ota_writer_stop();
         fw_state.update_partition = NULL;
     }
+    release_package();
+    image_release();
+    hash_reset();
+    // Anjay gave up before fw_update_poll() could hold the download: keep what
+    // is in flash so the next boot continues from it
+    if (fw_state.checkpoints && fw_state.saved_offset > 0 && !link_is_up()) {
+        avs_log(fw_update, INFO, "Download interrupted at %u bytes, keeping checkpoint",
+                (unsigned) fw_state.saved_offset);
+    } else {
+        fw_resume_clear();
+    }
+    fw_state.checkpoints = false;
 }
 
 static int fw_perform_upgrade(void *user_ptr) {
     (void) user_ptr;
 
+    // Reads the whole image back and verifies it (esp_image_verify()); IDF has
+    // no public way to activate a partition from the digest checked while
+    // streaming
     int result = esp_ota_set_boot_partition(fw_state.update_partition);
     if (result) {
         fw_state.update_partition = NULL;
@@ -146,12 +537,92 @@ static int fw_perform_upgrade(void *user_ptr) {
     return 0;
 }
 
+// HTTP(S) Package URIs are fetched by Anjay's downloader as one streaming GET over a
+// keep-alive TCP connection (resumed with a Range request from a checkpoint); this
+// bounds how long a silent server or a dead link holds the download open
+static avs_time_duration_t fw_get_tcp_request_timeout(void *user_ptr, const char *download_uri) {
+    (void) user_ptr;
+    (void) download_uri;
+    return avs_time_duration_from_scalar(CONFIG_FW_DOWNLOAD_TCP_TIMEOUT_S, AVS_TIME_S);
+}
+
+// Wakes the LwM2M task so fw_update_poll() sees a link change without waiting
+static void fw_link_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    (void) arg;
+    (void) base;
+    (void) id;
+    (void) data;
+
+    if (fw_state.anjay) {
+        anjay_event_loop_interrupt(fw_state.anjay);
+    }
+}
+
+static void replay_image(void *ctx, const uint8_t *data, size_t len) {
+    (void) ctx;
+    int hashed = fw_image_feed(&fw_state.image, data, len);
+    if (hashed >= 0) {
+        mbedtls_sha256_update(&fw_state.image_sha, data, (size_t) hashed);
+    }
+}
+
+// Validates a stored checkpoint against flash and, if it holds, reopens the stream
+// at that offset so Anjay continues the download instead of starting over
+static void resume_from_checkpoint(anjay_fw_update_initial_state_t *state) {
+    fw_resume_id_t *id = &fw_state.resume_id;
+    fw_resume_pos_t pos;
+
+    if (!fw_resume_load(id, &pos)) {
+        return;
+    }
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    // The same read rebuilds the image parser and hash for the remaining bytes
+    image_start();
+    if (!part || !fw_resume_validate(part, &pos, &fw_state.sha, replay_image, NULL)) {
+        image_release();
+        fw_resume_clear();
+        return;
+    }
+    fw_state.sha_active = true;
+    if (fw_state.image.offset != pos.offset) {
+        avs_log(fw_update, WARNING, "Checkpointed data is not an app image prefix");
+        goto abandon;
+    }
+    if (id->etag_len) {
+        fw_state.resume_etag = anjay_etag_new(id->etag_len);
+        if (!fw_state.resume_etag) {
+            goto abandon;
+        }
+        memcpy(fw_state.resume_etag->value, id->etag, id->etag_len);
+    }
+    if (open_stream(pos.offset)) {
+        goto abandon;
+    }
+    fw_state.checkpoints = true;
+    fw_state.saved_offset = pos.offset;
+    fw_state.next_checkpoint = pos.offset + FW_CHECKPOINT_BYTES;
+    fw_state.pull_active = true;
+
+    state->result = ANJAY_FW_UPDATE_INITIAL_DOWNLOADING;
+    state->persisted_uri = id->uri;
+    state->resume_offset = pos.offset;
+    state->resume_etag = fw_state.resume_etag;
+    avs_log(fw_update, INFO, "Resuming firmware download at %u bytes", (unsigned) pos.offset);
+    return;
+
+abandon:
+    hash_reset();
+    image_release();
+    fw_resume_clear();
+}
+
 static const anjay_fw_update_handlers_t HANDLERS = {
     .stream_open = fw_stream_open,
     .stream_write = fw_stream_write,
     .stream_finish = fw_stream_finish,
     .reset = fw_reset,
     .perform_upgrade = fw_perform_upgrade,
+    .get_tcp_request_timeout = fw_get_tcp_request_timeout,
 };
 
 int fw_update_install(anjay_t *anjay) {
@@ -165,15 +636,42 @@ int fw_update_install(anjay_t *anjay) {
         avs_log(fw_update, INFO, "First boot from partition with new firmware");
         esp_ota_mark_app_valid_cancel_rollback();
         state.result = ANJAY_FW_UPDATE_INITIAL_SUCCESS;
+        fw_resume_clear();
+    } else {
+        resume_from_checkpoint(&state);
     }
 
     // make sure this module is installed for single Anjay instance only
     assert(!fw_state.anjay);
     fw_state.anjay = anjay;
 
+    esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, fw_link_event_handler, NULL, NULL);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, fw_link_event_handler, NULL, NULL);
+
     return anjay_fw_update_install(anjay, &HANDLERS, NULL, &state);
 }
 
+// A failed transfer would reset the object and lose the download, so it is held
+// while the link is down. Anjay keeps the offset and ETag and continues over
+// whichever interface is up next, without restarting the client.
+void fw_update_poll(anjay_t *anjay) {
+    if (!fw_state.pull_active) {
+        return;
+    }
+    bool up = link_is_up();
+    if (!up && !fw_state.pull_suspended) {
+        avs_log(fw_update, INFO, "Link lost at %u bytes, holding the download", (unsigned) fw_state.received);
+        anjay_fw_update_pull_suspend(anjay);
+        fw_state.pull_suspended = true;
+    } else if (up && fw_state.pull_suspended) {
+        avs_log(fw_update, INFO, "Link back, continuing the download at %u bytes", (unsigned) fw_state.received);
+        fw_state.pull_suspended = false;
+        if (anjay_fw_update_pull_reconnect(anjay)) {
+            avs_log(fw_update, ERROR, "Could not reconnect the download");
+        }
+    }
+}
+
 bool fw_update_requested(void) {
     return atomic_load(&fw_state.update_requested);
 }
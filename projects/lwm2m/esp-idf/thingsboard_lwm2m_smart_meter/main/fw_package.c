@@ -0,0 +1,239 @@
+#include "fw_package.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { LZ_TAG, LZ_LITERAL, LZ_INDEX, LZ_COUNT };
+enum { D_SEEK, D_DIFF_LEN, D_EXTRA_LEN, D_DIFF, D_EXTRA };
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+int fw_pkg_parse_header(const uint8_t *buf, fw_pkg_header_t *out) {
+    if (memcmp(buf, FW_PKG_MAGIC, 4) != 0 || buf[4] != FW_PKG_VERSION) {
+        return FW_PKG_ERR_FORMAT;
+    }
+    memset(out, 0, sizeof(*out));
+    out->flags = buf[5];
+    out->window_bits = buf[6];
+    out->lookahead_bits = buf[7];
+    out->image_size = get_le32(&buf[8]);
+    out->base_size = get_le32(&buf[12]);
+    memcpy(out->base_sha256, &buf[16], sizeof(out->base_sha256));
+    if ((out->flags & ~(FW_PKG_FLAG_COMPRESSED | FW_PKG_FLAG_DELTA)) || out->image_size == 0) {
+        return FW_PKG_ERR_FORMAT;
+    }
+    if ((out->flags & FW_PKG_FLAG_COMPRESSED)
+            && (out->window_bits < FW_PKG_MIN_WINDOW_BITS || out->window_bits > FW_PKG_MAX_WINDOW_BITS
+                || out->lookahead_bits < 3 || out->lookahead_bits >= out->window_bits)) {
+        return FW_PKG_ERR_FORMAT;
+    }
+    if ((out->flags & FW_PKG_FLAG_DELTA) && out->base_size == 0) {
+        return FW_PKG_ERR_FORMAT;
+    }
+    return FW_PKG_OK;
+}
+
+int fw_pkg_decoder_init(fw_pkg_decoder_t *d, const fw_pkg_header_t *hdr,
+                        fw_pkg_sink_fn *sink, void *sink_ctx,
+                        fw_pkg_base_read_fn *base_read, void *base_ctx) {
+    memset(d, 0, sizeof(*d));
+    d->hdr = *hdr;
+    d->sink = sink;
+    d->sink_ctx = sink_ctx;
+    d->base_read = base_read;
+    d->base_ctx = base_ctx;
+    if ((hdr->flags & FW_PKG_FLAG_DELTA) && !base_read) {
+        return FW_PKG_ERR_FORMAT;
+    }
+    if (hdr->flags & FW_PKG_FLAG_COMPRESSED) {
+        // Zeroed like heatshrink's, so references before the start decode identically
+        d->window = (uint8_t *) calloc(1, (size_t) 1 << hdr->window_bits);
+        if (!d->window) {
+            return FW_PKG_ERR_NOMEM;
+        }
+    }
+    return FW_PKG_OK;
+}
+
+void fw_pkg_decoder_free(fw_pkg_decoder_t *d) {
+    free(d->window);
+    d->window = NULL;
+}
+
+static int flush_out(fw_pkg_decoder_t *d) {
+    if (d->out_len > 0) {
+        if (d->sink(d->sink_ctx, d->out, d->out_len)) {
+            return FW_PKG_ERR_SINK;
+        }
+        d->out_len = 0;
+    }
+    return FW_PKG_OK;
+}
+
+static int put_out(fw_pkg_decoder_t *d, uint8_t c) {
+    if (d->produced >= d->hdr.image_size) {
+        return FW_PKG_ERR_FORMAT;
+    }
+    d->out[d->out_len++] = c;
+    d->produced++;
+    return d->out_len == FW_PKG_CHUNK ? flush_out(d) : FW_PKG_OK;
+}
+
+static int base_byte(fw_pkg_decoder_t *d, uint8_t *c) {
+    if (d->base_pos >= d->hdr.base_size) {
+        return FW_PKG_ERR_BASE;
+    }
+    // Unsigned compare also catches base_pos below the cached chunk (backward seek)
+    if (d->base_pos - d->base_buf_pos >= d->base_buf_len) {
+        uint32_t n = d->hdr.base_size - d->base_pos;
+        if (n > FW_PKG_CHUNK) {
+            n = FW_PKG_CHUNK;
+        }
+        if (d->base_read(d->base_ctx, d->base_pos, d->base_buf, n)) {
+            d->base_buf_len = 0;
+            return FW_PKG_ERR_BASE;
+        }
+        d->base_buf_pos = d->base_pos;
+        d->base_buf_len = (uint16_t) n;
+    }
+    *c = d->base_buf[d->base_pos - d->base_buf_pos];
+    d->base_pos++;
+    return FW_PKG_OK;
+}
+
+static uint8_t next_data_state(const fw_pkg_decoder_t *d) {
+    return d->diff_left ? D_DIFF : d->extra_left ? D_EXTRA : D_SEEK;
+}
+
+static int delta_byte(fw_pkg_decoder_t *d, uint8_t c) {
+    switch (d->d_state) {
+    case D_SEEK:
+    case D_DIFF_LEN:
+    case D_EXTRA_LEN: {
+        if (d->d_shift > 28) {
+            return FW_PKG_ERR_FORMAT;
+        }
+        d->d_value |= (uint32_t) (c & 0x7F) << d->d_shift;
+        if (c & 0x80) {
+            d->d_shift += 7;
+            return FW_PKG_OK;
+        }
+        uint32_t v = d->d_value;
+        d->d_value = 0;
+        d->d_shift = 0;
+        if (d->d_state == D_SEEK) {
+            // zigzag: wraps like the int32 it encodes, range is checked on read
+            d->base_pos += (v >> 1) ^ (0u - (v & 1));
+            d->d_state = D_DIFF_LEN;
+        } else if (d->d_state == D_DIFF_LEN) {
+            d->diff_left = v;
+            d->d_state = D_EXTRA_LEN;
+        } else {
+            d->extra_left = v;
+            d->d_state = next_data_state(d);
+        }
+        return FW_PKG_OK;
+    }
+    case D_DIFF: {
+        uint8_t b;
+        int result = base_byte(d, &b);
+        if (result) {
+            return result;
+        }
+        d->diff_left--;
+        d->d_state = next_data_state(d);
+        return put_out(d, (uint8_t) (b + c));
+    }
+    default:
+        d->extra_left--;
+        d->d_state = next_data_state(d);
+        return put_out(d, c);
+    }
+}
+
+static int emit(fw_pkg_decoder_t *d, uint8_t c) {
+    return (d->hdr.flags & FW_PKG_FLAG_DELTA) ? delta_byte(d, c) : put_out(d, c);
+}
+
+static int lz_push(fw_pkg_decoder_t *d, uint8_t c) {
+    d->window[d->head & ((1u << d->hdr.window_bits) - 1)] = c;
+    d->head++;
+    return emit(d, c);
+}
+
+static uint32_t take_bits(fw_pkg_decoder_t *d, uint8_t n) {
+    d->bit_count -= n;
+    return (d->bits >> d->bit_count) & ((1u << n) - 1);
+}
+
+// heatshrink bit stream, MSB first: 1 + 8-bit literal, or 0 + (distance - 1) in
+// window_bits + (length - 1) in lookahead_bits
+static int lz_byte(fw_pkg_decoder_t *d, uint8_t in) {
+    const uint32_t mask = (1u << d->hdr.window_bits) - 1;
+    d->bits = (d->bits << 8) | in;
+    d->bit_count += 8;
+    for (;;) {
+        switch (d->lz_state) {
+        case LZ_TAG:
+            if (d->bit_count < 1) {
+                return FW_PKG_OK;
+            }
+            d->lz_state = take_bits(d, 1) ? LZ_LITERAL : LZ_INDEX;
+            break;
+        case LZ_LITERAL: {
+            if (d->bit_count < 8) {
+                return FW_PKG_OK;
+            }
+            int result = lz_push(d, (uint8_t) take_bits(d, 8));
+            if (result) {
+                return result;
+            }
+            d->lz_state = LZ_TAG;
+            break;
+        }
+        case LZ_INDEX:
+            if (d->bit_count < d->hdr.window_bits) {
+                return FW_PKG_OK;
+            }
+            d->lz_index = (uint16_t) (take_bits(d, d->hdr.window_bits) + 1);
+            d->lz_state = LZ_COUNT;
+            break;
+        default: {
+            if (d->bit_count < d->hdr.lookahead_bits) {
+                return FW_PKG_OK;
+            }
+            uint32_t count = take_bits(d, d->hdr.lookahead_bits) + 1;
+            for (uint32_t i = 0; i < count; i++) {
+                int result = lz_push(d, d->window[(uint16_t) (d->head - d->lz_index) & mask]);
+                if (result) {
+                    return result;
+                }
+            }
+            d->lz_state = LZ_TAG;
+            break;
+        }
+        }
+    }
+}
+
+int fw_pkg_decoder_feed(fw_pkg_decoder_t *d, const uint8_t *data, size_t len) {
+    const bool compressed = (d->hdr.flags & FW_PKG_FLAG_COMPRESSED) != 0;
+    for (size_t i = 0; i < len; i++) {
+        int result = compressed ? lz_byte(d, data[i]) : emit(d, data[i]);
+        if (result) {
+            return result;
+        }
+    }
+    return FW_PKG_OK;
+}
+
+int fw_pkg_decoder_finish(fw_pkg_decoder_t *d) {
+    int result = flush_out(d);
+    if (result) {
+        return result;
+    }
+    return d->produced == d->hdr.image_size ? FW_PKG_OK : FW_PKG_ERR_FORMAT;
+}
@@ -0,0 +1,110 @@
+#include "fw_resume.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#define FW_RESUME_NVS_NAMESPACE "fw_resume"
+#define FW_RESUME_READ_CHUNK 4096
+
+static const char *TAG = "fw_resume";
+
+bool fw_resume_load(fw_resume_id_t *id, fw_resume_pos_t *pos) {
+    nvs_handle_t h;
+    if (nvs_open(FW_RESUME_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        return false;
+    }
+    size_t id_sz = sizeof(*id);
+    size_t pos_sz = sizeof(*pos);
+    bool ok = nvs_get_blob(h, "id", id, &id_sz) == ESP_OK && id_sz == sizeof(*id)
+              && nvs_get_blob(h, "pos", pos, &pos_sz) == ESP_OK && pos_sz == sizeof(*pos);
+    nvs_close(h);
+    if (!ok) {
+        return false;
+    }
+    id->uri[FW_RESUME_URI_MAX - 1] = '\0';
+    return id->uri[0] && id->etag_len <= FW_RESUME_ETAG_MAX && pos->offset > 0;
+}
+
+int fw_resume_begin(const fw_resume_id_t *id) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(FW_RESUME_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        nvs_erase_key(h, "pos"); // may not exist
+        err = nvs_set_blob(h, "id", id, sizeof(*id));
+        if (err == ESP_OK) {
+            err = nvs_commit(h);
+        }
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot store package identity: %s", esp_err_to_name(err));
+        return -1;
+    }
+    return 0;
+}
+
+int fw_resume_save(const fw_resume_pos_t *pos) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(FW_RESUME_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, "pos", pos, sizeof(*pos));
+        if (err == ESP_OK) {
+            err = nvs_commit(h);
+        }
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot store checkpoint at %u: %s", (unsigned) pos->offset, esp_err_to_name(err));
+        return -1;
+    }
+    ESP_LOGD(TAG, "Checkpoint at %u bytes", (unsigned) pos->offset);
+    return 0;
+}
+
+void fw_resume_clear(void) {
+    nvs_handle_t h;
+    if (nvs_open(FW_RESUME_NVS_NAMESPACE, NVS_READWRITE, &h) == ESP_OK) {
+        nvs_erase_all(h);
+        nvs_commit(h);
+        nvs_close(h);
+    }
+}
+
+bool fw_resume_validate(const esp_partition_t *part, const fw_resume_pos_t *pos,
+                        mbedtls_sha256_context *sha, fw_resume_chunk_fn *on_chunk, void *ctx) {
+    if (pos->offset > part->size) {
+        return false;
+    }
+    uint8_t *buf = (uint8_t *) malloc(FW_RESUME_READ_CHUNK);
+    if (!buf) {
+        return false;
+    }
+    mbedtls_sha256_init(sha);
+    mbedtls_sha256_starts(sha, 0);
+    bool ok = true;
+    for (uint32_t off = 0; ok && off < pos->offset; off += FW_RESUME_READ_CHUNK) {
+        size_t n = pos->offset - off < FW_RESUME_READ_CHUNK ? pos->offset - off : FW_RESUME_READ_CHUNK;
+        ok = esp_partition_read(part, off, buf, n) == ESP_OK && mbedtls_sha256_update(sha, buf, n) == 0;
+        if (ok && on_chunk) {
+            on_chunk(ctx, buf, n);
+        }
+    }
+    free(buf);
+    if (ok) {
+        // Compare on a copy: sha keeps running for the continued download
+        uint8_t digest[32];
+        mbedtls_sha256_context tmp;
+        mbedtls_sha256_init(&tmp);
+        mbedtls_sha256_clone(&tmp, sha);
+        ok = mbedtls_sha256_finish(&tmp, digest) == 0 && memcmp(digest, pos->digest, sizeof(digest)) == 0;
+        mbedtls_sha256_free(&tmp);
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "Flash contents do not match the checkpoint at %u bytes", (unsigned) pos->offset);
+        mbedtls_sha256_free(sha);
+    }
+    return ok;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// NVS checkpoints for resumable firmware downloads.
+// The package identity (URI + ETag) is stored once when a pull download starts; the
+// offset of durably programmed bytes and the SHA-256 over [0, offset) are updated
+// periodically. After a reboot the already written flash is re-hashed and compared
+// before Anjay is told to continue from that offset.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FW_RESUME_URI_MAX 256
+#define FW_RESUME_ETAG_MAX 64
+
+typedef struct {
+    char uri[FW_RESUME_URI_MAX];
+    uint8_t etag_len; // 0: server sent no ETag
+    uint8_t etag[FW_RESUME_ETAG_MAX];
+} fw_resume_id_t;
+
+typedef struct {
+    uint32_t offset;    // image bytes programmed to the update partition
+    uint8_t digest[32]; // SHA-256 over image bytes [0, offset)
+} fw_resume_pos_t;
+
+// Both return false if nothing (or something malformed) is stored
+bool fw_resume_load(fw_resume_id_t *id, fw_resume_pos_t *pos);
+
+// Starts a new checkpoint chain for id, dropping any previous position
+int fw_resume_begin(const fw_resume_id_t *id);
+int fw_resume_save(const fw_resume_pos_t *pos);
+void fw_resume_clear(void);
+
+// Receives each chunk re-read from flash during validation, in order
+typedef void fw_resume_chunk_fn(void *ctx, const uint8_t *data, size_t len);
+
+// Re-hashes part over [0, pos->offset) and compares with pos->digest. On a match
+// sha holds the running hash of those bytes so the download can continue it.
+// on_chunk (optional) sees the same bytes, e.g. to rebuild other stream state.
+bool fw_resume_validate(const esp_partition_t *part, const fw_resume_pos_t *pos,
+                        mbedtls_sha256_context *sha, fw_resume_chunk_fn *on_chunk, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
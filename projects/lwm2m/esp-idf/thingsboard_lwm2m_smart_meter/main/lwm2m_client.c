@@ -1,4 +1,5 @@
-// Anjay client registering Device(3), Location(6) and Smart Meter (10243)
+// Anjay client registering Device(3), Location(6), Smart Meter (10243), Threshold Rules (26241)
+// and, with power-quality capture, Binary App Data Container (19)
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -20,6 +21,14 @@
 #include "firmware_update.h"
 #include "location_object.h"
 #include "smart_meter_object.h"
+#include "rule_object.h"
+#include "notify_filter.h"
+#include "cfg_store.h"
+#include "mem_budget.h"
+#if CONFIG_PQ_CAPTURE_ENABLE
+#include "bac19_object.h"
+#include "pq_capture.h"
+#endif
 
 #include <anjay/anjay.h>
 #include <anjay/security.h>
@@ -225,22 +234,145 @@ static int setup_server(anjay_t *anjay) {
 #endif
 }
 
+#if CONFIG_PQ_CAPTURE_ENABLE
+// Newest power-quality event already announced to the server
+static uint32_t s_pq_notified;
+
+#ifdef ANJAY_WITH_SEND
+// pq_capture_seq() when the last Send was built, and whether it is in flight
+static uint32_t s_pq_sent;
+static bool s_pq_send_pending;
+
+static void pq_send_finished(anjay_t *anjay, anjay_ssid_t ssid, const anjay_send_batch_t *batch,
+                             int result, void *data) {
+    (void) anjay; (void) batch;
+    s_pq_send_pending = false;
+    if (result == ANJAY_SEND_SUCCESS) {
+        pq_capture_ack((uint32_t) (uintptr_t) data);
+    } else {
+        ESP_LOGW(TAG, "Power-quality Send to SSID %u finished with %d; records kept in /19/0/0",
+                 (unsigned) ssid, result);
+    }
+}
+
+// Pushes /19/0/0 (every record up to at least captured); the records it
+// carried are dropped once the server confirms
+static void pq_send(anjay_t *anjay, uint32_t captured) {
+    anjay_send_batch_builder_t *builder = anjay_send_batch_builder_new();
+    if (!builder) {
+        return;
+    }
+    s_pq_sent = captured;
+    bool ok = !anjay_send_batch_data_add_current(builder, anjay, 19, 0, 0);
+    const uint32_t seq = bac19_pq_served_seq();
+    anjay_send_batch_t *batch = anjay_send_batch_builder_compile(&builder);
+    anjay_send_batch_builder_cleanup(&builder);
+    if (ok && batch) {
+        anjay_send_result_t res = anjay_send(anjay, CONFIG_LWM2M_SERVER_SHORT_ID, batch, pq_send_finished,
+                                             (void *) (uintptr_t) seq);
+        if (res == ANJAY_SEND_OK) {
+            s_pq_send_pending = true;
+        } else {
+            ESP_LOGW(TAG, "anjay_send() rejected: %d; relying on Observe of /19/0/0", (int) res);
+        }
+    }
+    anjay_send_batch_release(&batch);
+}
+#endif // ANJAY_WITH_SEND
+
+// New events: notify observers of /19/0/0 and push them with Send if available
+static void pq_events_update(anjay_t *anjay) {
+    const uint32_t seq = pq_capture_seq();
+    if (seq != s_pq_notified) {
+        s_pq_notified = seq;
+        (void) anjay_notify_changed(anjay, 19, 0, 0);
+    }
+#ifdef ANJAY_WITH_SEND
+    // One Send in flight: each would carry every stored record again. Events
+    // captured meanwhile go out once it finishes.
+    if (!s_pq_send_pending && seq != s_pq_sent) {
+        pq_send(anjay, seq);
+    }
+#endif
+}
+#endif // CONFIG_PQ_CAPTURE_ENABLE
+
+#ifdef ANJAY_WITH_ATTR_STORAGE
+// Serializes Write-Attributes into the config image; an empty set drops the key.
+// Persisting also clears the storage's modified flag, which notify_filter_poll()
+// relies on to see the next Write-Attributes.
+static void persist_attributes(anjay_t *anjay) {
+    avs_stream_t *membuf = avs_stream_membuf_create();
+    if (!membuf) {
+        return;
+    }
+    if (avs_is_ok(anjay_attr_storage_persist(anjay, membuf))) {
+        void *data_ptr = NULL;
+        size_t data_size = 0;
+        (void) avs_stream_membuf_fit(membuf);
+        if (avs_is_ok(avs_stream_membuf_take_ownership(membuf, &data_ptr, &data_size))) {
+            if (data_ptr && data_size > 0) {
+                (void) cfg_store_set_blob(CFG_KEY_ATTR_STORAGE, data_ptr, data_size);
+            } else {
+                cfg_store_erase(CFG_KEY_ATTR_STORAGE);
+            }
+            if (cfg_store_commit() == 0) {
+                ESP_LOGD(TAG, "Persisted %u bytes of attributes", (unsigned) data_size);
+            } else {
+                ESP_LOGW(TAG, "Failed to persist attributes");
+            }
+            free(data_ptr);
+        }
+    }
+    (void) avs_stream_cleanup(&membuf);
+}
+
+static void restore_attributes(anjay_t *anjay) {
+    size_t blob_size = 0;
+    if (cfg_store_get_blob(CFG_KEY_ATTR_STORAGE, NULL, 0, &blob_size) || blob_size == 0) {
+        ESP_LOGI(TAG, "No stored attributes");
+        return;
+    }
+    void *buf = malloc(blob_size);
+    if (!buf) {
+        ESP_LOGE(TAG, "OOM allocating %u bytes for attr restore", (unsigned) blob_size);
+        return;
+    }
+    if (cfg_store_get_blob(CFG_KEY_ATTR_STORAGE, buf, blob_size, &blob_size) == 0) {
+        avs_stream_inbuf_t in = AVS_STREAM_INBUF_STATIC_INITIALIZER;
+        avs_stream_inbuf_set_buffer(&in, buf, blob_size);
+        if (avs_is_err(anjay_attr_storage_restore(anjay, (avs_stream_t *) &in))) {
+            ESP_LOGW(TAG, "Attr storage restore failed; starting clean");
+        } else {
+            ESP_LOGI(TAG, "Restored %u bytes of LwM2M attributes", (unsigned) blob_size);
+        }
+    }
+    free(buf);
+}
+#endif // ANJAY_WITH_ATTR_STORAGE
+
 static void lwm2m_client_task(void *arg) {
     avs_log_set_default_level(AVS_LOG_DEBUG);
     const anjay_dm_object_def_t *const *dev_obj = NULL;
     const anjay_dm_object_def_t *const *loc_obj = NULL;
     const anjay_dm_object_def_t *const *sm_obj = NULL;
+    const anjay_dm_object_def_t *const *rule_obj = NULL;
+    const anjay_dm_object_def_t *const *bac_obj = NULL;
     if (CONFIG_LWM2M_START_DELAY_MS > 0) {
         vTaskDelay(pdMS_TO_TICKS(CONFIG_LWM2M_START_DELAY_MS));
     }
     resolve_endpoint_name();
     ESP_LOGI(TAG, "Endpoint: %s", g_endpoint_name);
 
+    // Buffers take what the heap can spare (more after BLE memory was released)
+    size_t in_buffer_size, out_buffer_size, msg_cache_size;
+    mem_budget_log("Before Anjay");
+    mem_budget_lwm2m_buffers(&in_buffer_size, &out_buffer_size, &msg_cache_size);
     anjay_configuration_t cfg = {
         .endpoint_name = g_endpoint_name,
-        .in_buffer_size = CONFIG_LWM2M_IN_BUFFER_SIZE,
-        .out_buffer_size = CONFIG_LWM2M_OUT_BUFFER_SIZE,
-        .msg_cache_size = CONFIG_LWM2M_MSG_CACHE_SIZE,
+        .in_buffer_size = in_buffer_size,
+        .out_buffer_size = out_buffer_size,
+        .msg_cache_size = msg_cache_size,
     };
 
     anjay_t *anjay = anjay_new(&cfg);
@@ -248,6 +380,7 @@ static void lwm2m_client_task(void *arg) {
         ESP_LOGE(TAG, "Could not create Anjay instance");
         vTaskDelete(NULL);
     }
+    mem_budget_log("After Anjay");
 
     if (anjay_security_object_install(anjay)
         || anjay_server_object_install(anjay)) {
@@ -273,25 +406,70 @@ static void lwm2m_client_task(void *arg) {
         ESP_LOGE(TAG, "Could not register Smart Meter (10243) object");
         goto cleanup;
     }
+#if CONFIG_LWM2M_RULES_ENABLE
+    rule_obj = rule_object_create();
+    if (!rule_obj || anjay_register_object(anjay, rule_obj)) {
+        ESP_LOGE(TAG, "Could not register Threshold Rules (26241) object");
+        goto cleanup;
+    }
+#endif
+#if CONFIG_PQ_CAPTURE_ENABLE
+    bac_obj = (const anjay_dm_object_def_t *const *) bac19_object_create();
+    if (!bac_obj || anjay_register_object(anjay, bac_obj)) {
+        ESP_LOGE(TAG, "Could not register Binary App Data Container (19) object");
+        goto cleanup;
+    }
+#endif
 
     if (fw_update_install(anjay)) {
         ESP_LOGE(TAG, "Could not install Firmware Update object");
         goto cleanup;
     }
+#ifdef ANJAY_WITH_ATTR_STORAGE
+    // After all objects are registered
+    restore_attributes(anjay);
+    uint32_t attr_persist_ticks = 0;
+#endif
 
     const avs_time_duration_t max_wait = avs_time_duration_from_scalar(100, AVS_TIME_MS);
     while (1) {
         (void) anjay_event_loop_run(anjay, max_wait);
+        // Pick up Write-Attributes (gt/lt/st) before objects decide what to notify
+        notify_filter_poll(anjay);
+        // Hold or continue a firmware download as the link goes down and comes back
+        fw_update_poll(anjay);
         device_object_update(anjay, dev_obj);
         location_object_update(anjay, loc_obj);
         smart_meter_object_update(anjay, sm_obj);
+        rule_object_update(anjay);
+#if CONFIG_PQ_CAPTURE_ENABLE
+        pq_events_update(anjay);
+#endif
+#ifdef ANJAY_WITH_ATTR_STORAGE
+        // Persist modified attributes about every 5 s (50 * 100 ms)
+        if (++attr_persist_ticks >= 50) {
+            attr_persist_ticks = 0;
+            if (anjay_attr_storage_is_modified(anjay)) {
+                persist_attributes(anjay);
+            }
+        }
+#endif
         if (fw_update_requested()) { break; }
     }
 
 cleanup:
+#ifdef ANJAY_WITH_ATTR_STORAGE
+    if (anjay && anjay_attr_storage_is_modified(anjay)) {
+        persist_attributes(anjay);
+    }
+#endif
     device_object_release(dev_obj);
     location_object_release(loc_obj);
     smart_meter_object_release(sm_obj);
+    rule_object_release(rule_obj);
+#if CONFIG_PQ_CAPTURE_ENABLE
+    bac19_object_release(bac_obj);
+#endif
     anjay_delete(anjay);
     if (fw_update_requested()) {
         fw_update_reboot();
@@ -0,0 +1,98 @@
+#include "mem_budget.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#if CONFIG_BT_ENABLED
+#include "esp_bt.h"
+#endif
+
+#ifndef CONFIG_LWM2M_IN_BUFFER_SIZE
+#define CONFIG_LWM2M_IN_BUFFER_SIZE 4000
+#endif
+#ifndef CONFIG_LWM2M_OUT_BUFFER_SIZE
+#define CONFIG_LWM2M_OUT_BUFFER_SIZE 4000
+#endif
+#ifndef CONFIG_LWM2M_MSG_CACHE_SIZE
+#define CONFIG_LWM2M_MSG_CACHE_SIZE 4000
+#endif
+
+static const char *TAG = "mem_budget";
+
+static size_t s_bt_reclaimed;
+
+static size_t free_heap(void) {
+    return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+void mem_budget_log(const char *phase) {
+    ESP_LOGI(TAG, "%s: free %u, min free %u, largest block %u", phase, (unsigned) free_heap(),
+             (unsigned) heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+             (unsigned) heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+size_t mem_budget_release_bt(void) {
+#if CONFIG_BT_ENABLED
+    static bool released;
+    if (released) {
+        return s_bt_reclaimed;
+    }
+    if (esp_bt_controller_get_status() != ESP_BT_CONTROLLER_STATUS_IDLE) {
+        ESP_LOGW(TAG, "BT controller still initialized, memory kept");
+        return 0;
+    }
+    size_t before = free_heap();
+    esp_err_t err = esp_bt_mem_release(ESP_BT_MODE_BLE);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_bt_mem_release failed: %s", esp_err_to_name(err));
+        return 0;
+    }
+    released = true;
+    size_t after = free_heap();
+    s_bt_reclaimed = after > before ? after - before : 0;
+    ESP_LOGI(TAG, "BT controller/host memory released: +%u bytes (free %u -> %u)",
+             (unsigned) s_bt_reclaimed, (unsigned) before, (unsigned) after);
+    return s_bt_reclaimed;
+#else
+    return 0;
+#endif
+}
+
+void mem_budget_lwm2m_buffers(size_t *in_buffer_size, size_t *out_buffer_size, size_t *msg_cache_size) {
+    *in_buffer_size = CONFIG_LWM2M_IN_BUFFER_SIZE;
+    *out_buffer_size = CONFIG_LWM2M_OUT_BUFFER_SIZE;
+    *msg_cache_size = CONFIG_LWM2M_MSG_CACHE_SIZE;
+#if CONFIG_LWM2M_BUFFER_GROW
+    size_t *sizes[3] = { in_buffer_size, out_buffer_size, msg_cache_size };
+    const size_t max[3] = { CONFIG_LWM2M_IN_BUFFER_MAX_SIZE, CONFIG_LWM2M_OUT_BUFFER_MAX_SIZE,
+                            CONFIG_LWM2M_MSG_CACHE_MAX_SIZE };
+    size_t extra[3];
+    size_t wanted = 0;
+    for (int i = 0; i < 3; i++) {
+        extra[i] = max[i] > *sizes[i] ? max[i] - *sizes[i] : 0;
+        wanted += extra[i];
+    }
+    size_t free_now = free_heap();
+    size_t reserve = (size_t) CONFIG_LWM2M_HEAP_RESERVE_KB * 1024;
+    size_t avail = free_now > reserve ? free_now - reserve : 0;
+    // Each buffer is one allocation: none may outgrow half the largest block
+    size_t block_cap = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) / 2;
+    for (int i = 0; i < 3 && wanted; i++) {
+        size_t grant = avail >= wanted ? extra[i] : (size_t) ((uint64_t) extra[i] * avail / wanted);
+        size_t size = *sizes[i] + grant;
+        if (size > block_cap && block_cap > *sizes[i]) {
+            size = block_cap;
+        } else if (size > block_cap) {
+            size = *sizes[i];
+        }
+        *sizes[i] = size;
+    }
+    ESP_LOGI(TAG, "Anjay buffers in %u->%u, out %u->%u, cache %u->%u (free %u, reserve %u, BT reclaimed %u)",
+             CONFIG_LWM2M_IN_BUFFER_SIZE, (unsigned) *in_buffer_size, CONFIG_LWM2M_OUT_BUFFER_SIZE,
+             (unsigned) *out_buffer_size, CONFIG_LWM2M_MSG_CACHE_SIZE, (unsigned) *msg_cache_size,
+             (unsigned) free_now, (unsigned) reserve, (unsigned) s_bt_reclaimed);
+#endif
+}
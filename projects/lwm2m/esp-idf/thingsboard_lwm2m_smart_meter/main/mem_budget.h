@@ -0,0 +1,29 @@
+#pragma once
+
+// Heap budget across boot phases.
+// BLE is only needed for Wi-Fi provisioning. Once that is over for this boot,
+// the BT controller and NimBLE host memory (static sections included) is handed
+// back to the heap, and the Anjay buffers are sized from what is then free
+// instead of fixed Kconfig values.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Logs free / minimum free / largest free block of the 8-bit heap
+void mem_budget_log(const char *phase);
+
+// Returns the BT controller and host memory to the heap. The BT stack must be
+// deinitialized; it cannot be started again until reboot. Returns the number of
+// bytes reclaimed (0 if nothing was released or BT is not built in).
+size_t mem_budget_release_bt(void);
+
+// Anjay in/out buffer and message cache sizes: the Kconfig base values, grown
+// towards the configured maximums within the heap left above the reserve
+void mem_budget_lwm2m_buffers(size_t *in_buffer_size, size_t *out_buffer_size, size_t *msg_cache_size);
+
+#ifdef __cplusplus
+}
+#endif
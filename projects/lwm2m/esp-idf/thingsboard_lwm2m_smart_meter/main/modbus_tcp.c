@@ -0,0 +1,388 @@
+#include "modbus_tcp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+
+#include "smart_meter_object.h"
+
+#ifndef CONFIG_MODBUS_TCP_PORT
+#define CONFIG_MODBUS_TCP_PORT 502
+#endif
+#ifndef CONFIG_MODBUS_TCP_UNIT_ID
+#define CONFIG_MODBUS_TCP_UNIT_ID 0
+#endif
+#ifndef CONFIG_MODBUS_TCP_MAX_CONNECTIONS
+#define CONFIG_MODBUS_TCP_MAX_CONNECTIONS 4
+#endif
+#ifndef CONFIG_MODBUS_TCP_IDLE_TIMEOUT_S
+#define CONFIG_MODBUS_TCP_IDLE_TIMEOUT_S 60
+#endif
+#ifndef CONFIG_MODBUS_TCP_TASK_PRIORITY
+#define CONFIG_MODBUS_TCP_TASK_PRIORITY 1
+#endif
+
+#define MAX_CONNECTIONS CONFIG_MODBUS_TCP_MAX_CONNECTIONS
+#define IDLE_TIMEOUT_MS (CONFIG_MODBUS_TCP_IDLE_TIMEOUT_S * 1000)
+
+#define MBAP_LEN 7
+#define ADU_MAX 260
+#define MAX_READ_REGS 125
+
+#define FC_READ_HOLDING 0x03
+#define FC_READ_INPUT 0x04
+
+#define EX_ILLEGAL_FUNCTION 0x01
+#define EX_ILLEGAL_ADDRESS 0x02
+#define EX_ILLEGAL_VALUE 0x03
+#define EX_DEVICE_FAILURE 0x04
+#define EX_GATEWAY_NO_RESPONSE 0x0B
+
+static const char *TAG = "modbus_tcp";
+
+// One master. A request is answered before the next one is read, so the
+// response buffer never holds more than one ADU.
+typedef struct {
+    int sock; // -1: slot free
+    TickType_t last_activity;
+    size_t rx_len;
+    size_t tx_len;
+    size_t tx_off;
+    uint32_t requests;
+    uint8_t rx[ADU_MAX];
+    uint8_t tx[ADU_MAX];
+} mb_conn_t;
+
+static TaskHandle_t s_task;
+
+static inline uint16_t get_be16(const uint8_t *p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline void put_be16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t) (v >> 8);
+    p[1] = (uint8_t) v;
+}
+
+static void put_u32(uint16_t *regs, int addr, uint32_t v) {
+    regs[addr] = (uint16_t) (v >> 16);
+    regs[addr + 1] = (uint16_t) v;
+}
+
+static void put_float(uint16_t *regs, int addr, float v) {
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    put_u32(regs, addr, u);
+}
+
+static void fill_registers(const sm_snapshot_t *s, uint16_t *regs) {
+    put_float(regs, MODBUS_REG_VOLTAGE, s->voltage_v);
+    put_float(regs, MODBUS_REG_CURRENT, s->current_a);
+    put_float(regs, MODBUS_REG_ACTIVE_POWER, s->active_power_kw);
+    put_float(regs, MODBUS_REG_REACTIVE_POWER, s->reactive_power_kvar);
+    put_float(regs, MODBUS_REG_INDUCTIVE_REACTIVE_POWER, s->inductive_reactive_power_kvar);
+    put_float(regs, MODBUS_REG_CAPACITIVE_REACTIVE_POWER, s->capacitive_reactive_power_kvar);
+    put_float(regs, MODBUS_REG_APPARENT_POWER, s->apparent_power_kva);
+    put_float(regs, MODBUS_REG_POWER_FACTOR, s->power_factor);
+    put_float(regs, MODBUS_REG_THD_V, s->thd_v);
+    put_float(regs, MODBUS_REG_THD_A, s->thd_a);
+    put_float(regs, MODBUS_REG_FREQUENCY, s->frequency_hz);
+    put_float(regs, MODBUS_REG_ACTIVE_ENERGY, s->active_energy_kwh);
+    put_float(regs, MODBUS_REG_REACTIVE_ENERGY, s->reactive_energy_kvarh);
+    put_float(regs, MODBUS_REG_APPARENT_ENERGY, s->apparent_energy_kvah);
+    put_u32(regs, MODBUS_REG_UPDATE_COUNT, s->update_count);
+}
+
+// Answers one request ADU (MBAP + PDU) into rsp; returns the response length
+static size_t handle_request(const uint8_t *req, size_t len, uint8_t *rsp) {
+    const uint8_t unit = req[6];
+    const uint8_t fc = len > MBAP_LEN ? req[MBAP_LEN] : 0;
+    uint8_t exception = 0;
+    size_t pdu_len = 0;
+
+    // Transaction id, protocol id and unit id are echoed back
+    memcpy(rsp, req, MBAP_LEN);
+    if (CONFIG_MODBUS_TCP_UNIT_ID && unit != CONFIG_MODBUS_TCP_UNIT_ID && unit != 0xFF) {
+        exception = EX_GATEWAY_NO_RESPONSE;
+    } else if (fc != FC_READ_HOLDING && fc != FC_READ_INPUT) {
+        exception = EX_ILLEGAL_FUNCTION;
+    } else if (len != MBAP_LEN + 5) {
+        exception = EX_ILLEGAL_VALUE;
+    } else {
+        const uint16_t addr = get_be16(&req[MBAP_LEN + 1]);
+        const uint16_t qty = get_be16(&req[MBAP_LEN + 3]);
+        sm_snapshot_t snap;
+        uint16_t regs[MODBUS_REG_COUNT];
+        if (qty == 0 || qty > MAX_READ_REGS) {
+            exception = EX_ILLEGAL_VALUE;
+        } else if ((uint32_t) addr + qty > MODBUS_REG_COUNT) {
+            exception = EX_ILLEGAL_ADDRESS;
+        } else if (!smart_meter_snapshot(&snap)) {
+            exception = EX_DEVICE_FAILURE;
+        } else {
+            fill_registers(&snap, regs);
+            rsp[MBAP_LEN] = fc;
+            rsp[MBAP_LEN + 1] = (uint8_t) (qty * 2);
+            for (uint16_t i = 0; i < qty; i++) {
+                put_be16(&rsp[MBAP_LEN + 2 + 2 * i], regs[addr + i]);
+            }
+            pdu_len = 2 + (size_t) qty * 2;
+        }
+    }
+    if (exception) {
+        rsp[MBAP_LEN] = (uint8_t) (fc | 0x80);
+        rsp[MBAP_LEN + 1] = exception;
+        pdu_len = 2;
+    }
+    put_be16(&rsp[4], (uint16_t) (pdu_len + 1)); // unit id + PDU
+    return MBAP_LEN + pdu_len;
+}
+
+static void conn_close(mb_conn_t *c, const char *reason) {
+    ESP_LOGI(TAG, "Master on socket %d closed (%s) after %u requests", c->sock, reason, (unsigned) c->requests);
+    shutdown(c->sock, 0);
+    close(c->sock);
+    c->sock = -1;
+}
+
+// Answers the next complete request in rx, if any and no response is pending
+static void conn_process(mb_conn_t *c) {
+    if (c->tx_len || c->rx_len < MBAP_LEN) {
+        return;
+    }
+    const uint16_t protocol = get_be16(&c->rx[2]);
+    const uint16_t length = get_be16(&c->rx[4]);
+    if (protocol != 0 || length < 2 || length > ADU_MAX - 6) {
+        conn_close(c, "not Modbus TCP");
+        return;
+    }
+    const size_t frame = 6 + (size_t) length;
+    if (c->rx_len < frame) {
+        return;
+    }
+    c->tx_len = handle_request(c->rx, frame, c->tx);
+    c->tx_off = 0;
+    c->requests++;
+    c->rx_len -= frame;
+    memmove(c->rx, c->rx + frame, c->rx_len);
+}
+
+// Sends what the socket takes now; the rest waits for the next writable event
+static void conn_flush(mb_conn_t *c, TickType_t now) {
+    int written = send(c->sock, c->tx + c->tx_off, c->tx_len - c->tx_off, 0);
+    if (written < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            conn_close(c, "send error");
+        }
+        return;
+    }
+    c->tx_off += written;
+    if (c->tx_off == c->tx_len) {
+        c->tx_len = 0;
+        c->tx_off = 0;
+        // Pipelined request already buffered
+        conn_process(c);
+    }
+    c->last_activity = now;
+}
+
+static void conn_receive(mb_conn_t *c, TickType_t now) {
+    int len = recv(c->sock, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+    if (len < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            conn_close(c, "recv error");
+        }
+        return;
+    }
+    if (len == 0) {
+        conn_close(c, "peer closed");
+        return;
+    }
+    c->rx_len += len;
+    c->last_activity = now;
+    conn_process(c);
+}
+
+static void accept_masters(int listen_sock, mb_conn_t *conns, int *active, TickType_t now) {
+    const int one = 1;
+    while (*active < MAX_CONNECTIONS) {
+        struct sockaddr_in source_addr;
+        socklen_t addr_len = sizeof(source_addr);
+        int sock = accept(listen_sock, (struct sockaddr *) &source_addr, &addr_len);
+        if (sock < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGE(TAG, "accept failed: errno %d", errno);
+            }
+            return;
+        }
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+        // Responses are one small segment each: do not let Nagle hold them back
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            if (conns[i].sock < 0) {
+                memset(&conns[i], 0, sizeof(conns[i]));
+                conns[i].sock = sock;
+                conns[i].last_activity = now;
+                break;
+            }
+        }
+        (*active)++;
+        char addr_str[16];
+        inet_ntoa_r(source_addr.sin_addr, addr_str, sizeof(addr_str));
+        ESP_LOGI(TAG, "Master %s connected on socket %d (%d/%d)", addr_str, sock, *active, MAX_CONNECTIONS);
+    }
+}
+
+// select() timeout until the next idle deadline, NULL to wait for traffic only
+static struct timeval *idle_timeout(const mb_conn_t *conns, TickType_t now, struct timeval *tv) {
+#if CONFIG_MODBUS_TCP_IDLE_TIMEOUT_S > 0
+    const TickType_t idle = pdMS_TO_TICKS(IDLE_TIMEOUT_MS);
+    TickType_t wait = portMAX_DELAY;
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (conns[i].sock < 0) {
+            continue;
+        }
+        TickType_t elapsed = now - conns[i].last_activity;
+        wait = MIN(wait, elapsed >= idle ? 0 : idle - elapsed);
+    }
+    if (wait != portMAX_DELAY) {
+        uint32_t ms = (uint32_t) wait * portTICK_PERIOD_MS + 1;
+        tv->tv_sec = ms / 1000;
+        tv->tv_usec = (ms % 1000) * 1000;
+        return tv;
+    }
+#endif
+    return NULL;
+}
+
+static void serve_masters(int listen_sock, mb_conn_t *conns) {
+    int active = 0;
+    while (1) {
+        fd_set rfds;
+        fd_set wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        int max_fd = -1;
+        // When all slots are taken new masters wait in the listen backlog
+        if (active < MAX_CONNECTIONS) {
+            FD_SET(listen_sock, &rfds);
+            max_fd = listen_sock;
+        }
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            const mb_conn_t *c = &conns[i];
+            if (c->sock < 0) {
+                continue;
+            }
+            if (c->tx_len) {
+                FD_SET(c->sock, &wfds);
+            } else if (c->rx_len < sizeof(c->rx)) {
+                FD_SET(c->sock, &rfds);
+            }
+            max_fd = MAX(max_fd, c->sock);
+        }
+
+        struct timeval tv;
+        int ready = select(max_fd + 1, &rfds, &wfds, NULL, idle_timeout(conns, xTaskGetTickCount(), &tv));
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            return;
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (FD_ISSET(listen_sock, &rfds)) {
+            accept_masters(listen_sock, conns, &active, now);
+        }
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            mb_conn_t *c = &conns[i];
+            if (c->sock < 0) {
+                continue;
+            }
+            if (FD_ISSET(c->sock, &wfds)) {
+                conn_flush(c, now);
+            }
+            if (c->sock >= 0 && FD_ISSET(c->sock, &rfds)) {
+                conn_receive(c, now);
+            }
+#if CONFIG_MODBUS_TCP_IDLE_TIMEOUT_S > 0
+            if (c->sock >= 0 && now - c->last_activity >= pdMS_TO_TICKS(IDLE_TIMEOUT_MS)) {
+                conn_close(c, "idle timeout");
+            }
+#endif
+            if (c->sock < 0) {
+                active--;
+            }
+        }
+    }
+}
+
+static void modbus_task(void *arg) {
+    (void) arg;
+    mb_conn_t *conns = calloc(MAX_CONNECTIONS, sizeof(mb_conn_t));
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (!conns || listen_sock < 0) {
+        ESP_LOGE(TAG, "Could not allocate server resources");
+        goto out;
+    }
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        conns[i].sock = -1;
+    }
+    int opt = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    fcntl(listen_sock, F_SETFL, fcntl(listen_sock, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_MODBUS_TCP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(listen_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0
+            || listen(listen_sock, MAX_CONNECTIONS) != 0) {
+        ESP_LOGE(TAG, "Could not listen on port %d: errno %d", CONFIG_MODBUS_TCP_PORT, errno);
+        goto out;
+    }
+    ESP_LOGI(TAG, "Listening on port %d (unit id %d, up to %d masters)", CONFIG_MODBUS_TCP_PORT,
+             CONFIG_MODBUS_TCP_UNIT_ID, MAX_CONNECTIONS);
+    serve_masters(listen_sock, conns);
+
+out:
+    if (conns) {
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            if (conns[i].sock >= 0) {
+                conn_close(&conns[i], "server stopped");
+            }
+        }
+        free(conns);
+    }
+    if (listen_sock >= 0) {
+        close(listen_sock);
+    }
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+int modbus_tcp_start(void) {
+    if (s_task) {
+        return 0;
+    }
+    // Below the LwM2M task: SCADA polling yields to LwM2M processing
+    if (xTaskCreate(modbus_task, "modbus_tcp", 4096, NULL, CONFIG_MODBUS_TCP_TASK_PRIORITY, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Could not create Modbus TCP task");
+        s_task = NULL;
+        return -1;
+    }
+    return 0;
+}
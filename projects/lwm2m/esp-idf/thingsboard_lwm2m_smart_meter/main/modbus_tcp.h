@@ -0,0 +1,50 @@
+#pragma once
+
+// Modbus TCP server for local SCADA polling of the smart meter (Object 10243).
+// One task multiplexes up to CONFIG_MODBUS_TCP_MAX_CONNECTIONS masters with
+// select(). Registers are filled from smart_meter_snapshot(), so polling never
+// takes a lock shared with the LwM2M task.
+//
+// The same read-only map answers Read Holding Registers (0x03) and Read Input
+// Registers (0x04). Values are IEEE-754 float32 in two registers, high word
+// first (ABCD); addresses are 0-based protocol addresses.
+//
+//   0  Voltage (V)               16  THD voltage (fraction)
+//   2  Current (A)               18  THD current (fraction)
+//   4  Active power (kW)         20  Frequency (Hz)
+//   6  Reactive power (kvar)     22  Active energy (kWh)
+//   8  Inductive reactive (kvar) 24  Reactive energy (kvarh)
+//  10  Capacitive reactive (kvar)26  Apparent energy (kVAh)
+//  12  Apparent power (kVA)      28  Update counter (uint32, high word first)
+//  14  Power factor
+//
+// Exceptions: 01 other function codes, 02 range outside the map, 03 bad
+// quantity, 04 no measurement published yet, 0B unit id not served.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MODBUS_REG_VOLTAGE 0
+#define MODBUS_REG_CURRENT 2
+#define MODBUS_REG_ACTIVE_POWER 4
+#define MODBUS_REG_REACTIVE_POWER 6
+#define MODBUS_REG_INDUCTIVE_REACTIVE_POWER 8
+#define MODBUS_REG_CAPACITIVE_REACTIVE_POWER 10
+#define MODBUS_REG_APPARENT_POWER 12
+#define MODBUS_REG_POWER_FACTOR 14
+#define MODBUS_REG_THD_V 16
+#define MODBUS_REG_THD_A 18
+#define MODBUS_REG_FREQUENCY 20
+#define MODBUS_REG_ACTIVE_ENERGY 22
+#define MODBUS_REG_REACTIVE_ENERGY 24
+#define MODBUS_REG_APPARENT_ENERGY 26
+#define MODBUS_REG_UPDATE_COUNT 28
+#define MODBUS_REG_COUNT 30
+
+// Starts the server task (idempotent). Needs the network up. Returns 0 on success, -1 on error.
+int modbus_tcp_start(void);
+
+#ifdef __cplusplus
+}
+#endif
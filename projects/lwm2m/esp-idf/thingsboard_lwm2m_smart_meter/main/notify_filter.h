@@ -0,0 +1,57 @@
+#pragma once
+
+// Client-side evaluation of LwM2M change attributes (gt / lt / st).
+// Objects ask notify_filter_should_notify() before anjay_notify_changed(), so a
+// sample that cannot satisfy the server's attributes is dropped before Anjay ever
+// evaluates its observations. Attributes are read from Attribute Storage once and
+// cached until storage reports a modification (Write-Attributes from the server)
+// or the client changes them itself and calls notify_filter_invalidate_all().
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <anjay/anjay.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    anjay_oid_t oid;
+    anjay_iid_t iid;
+    anjay_rid_t rid;
+    double fallback_step; // step used when the server set none of gt/lt/st
+    // Cached effective attributes (NAN = not set)
+    uint32_t generation;
+    double gt;
+    double lt;
+    double st;
+    // Last value that was allowed through
+    bool have_last;
+    double last;
+} notify_filter_t;
+
+#define NOTIFY_FILTER_INIT(Oid, Iid, Rid, FallbackStep) \
+    { (Oid), (Iid), (Rid), (FallbackStep), 0, 0.0, 0.0, 0.0, false, 0.0 }
+
+void notify_filter_init(notify_filter_t *f, anjay_oid_t oid, anjay_iid_t iid, anjay_rid_t rid, double fallback_step);
+
+// Short Server ID whose attributes are evaluated (default CONFIG_LWM2M_SERVER_SHORT_ID)
+void notify_filter_set_ssid(anjay_ssid_t ssid);
+
+// Drops every cached attribute set; they are reloaded lazily on next use
+void notify_filter_invalidate_all(void);
+
+// Call from the main loop: invalidates caches when the Attribute Storage modified
+// flag is raised or cleared (see notify_generation.h)
+void notify_filter_poll(anjay_t *anjay);
+
+// True if value satisfies st or crosses gt/lt relative to the last value let
+// through (always true for the first value). Records value as notified when true.
+bool notify_filter_should_notify(anjay_t *anjay, notify_filter_t *f, double value);
+
+// Records value as notified without evaluating (e.g. after a forced notify)
+void notify_filter_mark(notify_filter_t *f, double value);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// Generation of the attribute sets cached by notify_filter. A cache is current
+// while its generation matches; anything that may have changed attributes bumps
+// it. Kept free of Anjay so it can be unit-tested on the host.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t value;        // never 0, so zero-initialized caches always load
+    bool storage_modified; // Attribute Storage flag seen by the last poll
+} notify_generation_t;
+
+#define NOTIFY_GENERATION_INIT { 1, false }
+
+void notify_generation_bump(notify_generation_t *g);
+
+// Feeds anjay_attr_storage_is_modified(). The flag stays set until storage is
+// persisted, so only its edges count: setting it means a Write-Attributes
+// arrived, clearing it covers writes made while it was already set.
+// Returns true if the generation was bumped.
+bool notify_generation_poll(notify_generation_t *g, bool storage_modified);
+
+#ifdef __cplusplus
+}
+#endif
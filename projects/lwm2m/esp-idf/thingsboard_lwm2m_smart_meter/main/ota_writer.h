@@ -0,0 +1,44 @@
+#pragma once
+
+// Asynchronous, sector-aligned flash writer for firmware downloads.
+// Incoming blocks are copied into one of two 4 KB staging buffers; full buffers are
+// programmed by a dedicated task which also pre-erases the next sectors while idle.
+// ota_writer_write() only blocks when both buffers are in flight, which stalls the
+// caller (the Anjay download callback) and so pauses the CoAP transfer until flash
+// catches up.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_WRITER_SECTOR_SIZE 4096
+
+// Programs len bytes at offset (already erased). Returns 0 on success.
+typedef int ota_writer_program_fn(void *ctx, uint32_t offset, const void *data, size_t len);
+
+// Starts the writer for part; the first byte written lands at start_offset. Sectors
+// from start_offset (rounded up) onwards are erased by the writer as needed.
+int ota_writer_start(const esp_partition_t *part, uint32_t start_offset,
+                     ota_writer_program_fn *program, void *program_ctx);
+
+// Queues data; returns -1 once the writer has failed (erase/program error, overflow)
+int ota_writer_write(const void *data, size_t len);
+
+// Flushes the partial tail buffer and waits until everything is programmed
+int ota_writer_finish(void);
+
+// Stops the task, discarding anything not yet programmed. Safe to call when idle.
+void ota_writer_stop(void);
+
+// Bytes accepted so far / bytes durably programmed (offsets in the partition)
+uint32_t ota_writer_accepted(void);
+uint32_t ota_writer_committed(void);
+
+#ifdef __cplusplus
+}
+#endif
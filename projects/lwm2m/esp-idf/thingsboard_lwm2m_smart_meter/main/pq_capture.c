@@ -0,0 +1,385 @@
+#include "pq_capture.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_PQ_SOURCE_ADC
+#include "esp_adc/adc_continuous.h"
+#else
+#include "esp_random.h"
+#endif
+
+#ifndef CONFIG_PQ_SAMPLES_PER_CYCLE
+#define CONFIG_PQ_SAMPLES_PER_CYCLE 64
+#endif
+#ifndef CONFIG_PQ_NOMINAL_FREQUENCY
+#define CONFIG_PQ_NOMINAL_FREQUENCY 60
+#endif
+#ifndef CONFIG_PQ_NOMINAL_VOLTAGE
+#define CONFIG_PQ_NOMINAL_VOLTAGE 230
+#endif
+#ifndef CONFIG_PQ_SCALE_MV_PER_COUNT
+#define CONFIG_PQ_SCALE_MV_PER_COUNT 200
+#endif
+#ifndef CONFIG_PQ_SAG_PCT
+#define CONFIG_PQ_SAG_PCT 90
+#endif
+#ifndef CONFIG_PQ_SWELL_PCT
+#define CONFIG_PQ_SWELL_PCT 110
+#endif
+#ifndef CONFIG_PQ_INTERRUPTION_PCT
+#define CONFIG_PQ_INTERRUPTION_PCT 5
+#endif
+#ifndef CONFIG_PQ_HYSTERESIS_PCT
+#define CONFIG_PQ_HYSTERESIS_PCT 2
+#endif
+#ifndef CONFIG_PQ_PRE_CYCLES
+#define CONFIG_PQ_PRE_CYCLES 4
+#endif
+#ifndef CONFIG_PQ_POST_CYCLES
+#define CONFIG_PQ_POST_CYCLES 8
+#endif
+#ifndef CONFIG_PQ_EVENT_SLOTS
+#define CONFIG_PQ_EVENT_SLOTS 4
+#endif
+#ifndef CONFIG_PQ_TASK_PRIORITY
+#define CONFIG_PQ_TASK_PRIORITY 4
+#endif
+
+#define SPC CONFIG_PQ_SAMPLES_PER_CYCLE
+#define SAMPLE_RATE_HZ (SPC * CONFIG_PQ_NOMINAL_FREQUENCY)
+// Samples handed to the detector per wake-up: half a cycle
+#define BLOCK (SPC / 2)
+// Aggregates older than this are not reported (task stalled or stopped)
+#define AGGREGATE_STALE_MS 2000
+#define MIN_VALID_EPOCH 1609459200 // 2021-01-01
+
+static const char *TAG = "pq_capture";
+
+static TaskHandle_t s_task;
+static pq_detect_t s_det;
+static int16_t *s_ring;
+static int16_t *s_capture;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static pq_aggregate_t s_latest;
+static TickType_t s_latest_at;
+
+// Event records, s_count of them starting at s_head (oldest)
+static SemaphoreHandle_t s_slots_mutex;
+static uint8_t *s_slots;
+static size_t s_record_size;
+static uint32_t s_slot_seq[CONFIG_PQ_EVENT_SLOTS];
+static uint64_t s_slot_ms[CONFIG_PQ_EVENT_SLOTS];
+static size_t s_head;
+static size_t s_count;
+static uint32_t s_seq;
+
+static const char *event_name(pq_event_type_t type) {
+    switch (type) {
+    case PQ_EVENT_SAG: return "Sag";
+    case PQ_EVENT_SWELL: return "Swell";
+    case PQ_EVENT_INTERRUPTION: return "Interruption";
+    }
+    return "?";
+}
+
+// Detector callback, in the capture task. The start time is taken back from
+// the sample count, so the latency of the post-trigger window is not in it.
+static void on_event(const pq_event_t *ev, void *arg) {
+    (void) arg;
+    const int64_t age_ms = (int64_t) ((s_det.samples - ev->start_sample) * 1000u / SAMPLE_RATE_HZ);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    const bool uptime = tv.tv_sec < MIN_VALID_EPOCH;
+    const int64_t now_ms = uptime ? esp_timer_get_time() / 1000
+                                  : (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    const uint64_t start_ms = (uint64_t) (now_ms - age_ms);
+
+    xSemaphoreTake(s_slots_mutex, portMAX_DELAY);
+    size_t slot;
+    if (s_count == CONFIG_PQ_EVENT_SLOTS) {
+        // Not acknowledged in time: the oldest record is lost
+        slot = s_head;
+        s_head = (s_head + 1) % CONFIG_PQ_EVENT_SLOTS;
+    } else {
+        slot = (s_head + s_count++) % CONFIG_PQ_EVENT_SLOTS;
+    }
+    pq_record_encode(&s_det.cfg, ev, start_ms, uptime, s_slots + slot * s_record_size, s_record_size);
+    s_slot_seq[slot] = ++s_seq;
+    s_slot_ms[slot] = start_ms;
+    xSemaphoreGive(s_slots_mutex);
+
+    ESP_LOGW(TAG, "%s #%u: %u half cycle(s), %.1f V", event_name(ev->type), (unsigned) s_seq,
+             (unsigned) ev->duration_half_cycles, (double) ev->extreme_v);
+}
+
+static void feed(const int16_t *samples, size_t n) {
+    const uint32_t windows = s_det.aggregate.windows;
+    pq_detect_feed(&s_det, samples, n);
+    if (s_det.aggregate.windows != windows) {
+        portENTER_CRITICAL(&s_lock);
+        s_latest = s_det.aggregate;
+        s_latest_at = xTaskGetTickCount();
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+#if CONFIG_PQ_SOURCE_ADC
+
+#define FRAME_BYTES (BLOCK * SOC_ADC_DIGI_RESULT_BYTES)
+
+static adc_continuous_handle_t s_adc;
+static volatile uint32_t s_overflows;
+
+static bool IRAM_ATTR on_conv_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                   void *user_data) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    return woken == pdTRUE;
+}
+
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                  void *user_data) {
+    s_overflows++;
+    return false;
+}
+
+static int source_init(void) {
+    const adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = 8 * FRAME_BYTES,
+        .conv_frame_size = FRAME_BYTES,
+    };
+    adc_digi_pattern_config_t pattern = {
+        .atten = ADC_ATTEN_DB_12,
+        .channel = CONFIG_PQ_ADC_CHANNEL,
+        .unit = ADC_UNIT_1,
+        .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+    const adc_continuous_config_t cfg = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = SAMPLE_RATE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+    const adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = on_conv_done,
+        .on_pool_ovf = on_pool_ovf,
+    };
+    if (adc_continuous_new_handle(&handle_cfg, &s_adc) != ESP_OK) {
+        return -1;
+    }
+    if (adc_continuous_config(s_adc, &cfg) != ESP_OK
+            || adc_continuous_register_event_callbacks(s_adc, &cbs, NULL) != ESP_OK
+            || adc_continuous_start(s_adc) != ESP_OK) {
+        adc_continuous_deinit(s_adc);
+        s_adc = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Drains the DMA pool; each frame is half a cycle of raw conversions
+static void source_run(void) {
+    static uint8_t raw[FRAME_BYTES];
+    static int16_t samples[BLOCK];
+    uint32_t overflows = 0;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        uint32_t got = 0;
+        while (adc_continuous_read(s_adc, raw, sizeof(raw), &got, 0) == ESP_OK) {
+            size_t n = 0;
+            for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES) {
+                const adc_digi_output_data_t *p = (const adc_digi_output_data_t *) &raw[i];
+                if (p->type2.channel == CONFIG_PQ_ADC_CHANNEL) {
+                    samples[n++] = (int16_t) ((int32_t) p->type2.data - CONFIG_PQ_ADC_BIAS);
+                }
+            }
+            feed(samples, n);
+        }
+        if (s_overflows != overflows) {
+            // Dropped frames shift the cycle phase until the next window
+            ESP_LOGW(TAG, "ADC pool overflow: %u frame(s) lost", (unsigned) (s_overflows - overflows));
+            overflows = s_overflows;
+        }
+    }
+}
+
+#else // CONFIG_PQ_SOURCE_SYNTHETIC
+
+// On average one disturbance per SYNTH_EVENT_CYCLES cycles (~10 min at 60 Hz)
+#define SYNTH_EVENT_CYCLES 36000u
+
+static int16_t s_wave[SPC];
+
+static int source_init(void) {
+    // Nominal voltage with 3 % of third harmonic
+    const double peak = CONFIG_PQ_NOMINAL_VOLTAGE * sqrt(2.0) * 1000.0 / CONFIG_PQ_SCALE_MV_PER_COUNT;
+    for (int i = 0; i < SPC; i++) {
+        const double w = 2.0 * M_PI * i / SPC;
+        s_wave[i] = (int16_t) lrint(peak * (sin(w) + 0.03 * sin(3.0 * w)));
+    }
+    return 0;
+}
+
+// Paced by esp_timer: every wake-up generates the samples due since start
+static void source_run(void) {
+    static int16_t samples[BLOCK];
+    const int64_t start_us = esp_timer_get_time();
+    uint64_t generated = 0;
+    uint16_t phase = 0;
+    int32_t level_q15 = 32768;
+    uint32_t disturbed_halves = 0;
+    while (1) {
+        vTaskDelay(1);
+        const uint64_t due = (uint64_t) (esp_timer_get_time() - start_us) * SAMPLE_RATE_HZ / 1000000;
+        while (generated + BLOCK <= due) {
+            for (int i = 0; i < BLOCK; i++) {
+                samples[i] = (int16_t) ((s_wave[phase] * level_q15) >> 15);
+                phase = (uint16_t) ((phase + 1) % SPC);
+            }
+            generated += BLOCK;
+            feed(samples, BLOCK);
+            if (disturbed_halves && --disturbed_halves == 0) {
+                level_q15 = 32768;
+            } else if (!disturbed_halves && esp_random() % (2 * SYNTH_EVENT_CYCLES) == 0) {
+                // 2..40 half cycles of sag (50-85 %), swell (112-125 %) or no voltage
+                static const int32_t levels[] = { 16384, 27853, 36700, 40960, 0 };
+                level_q15 = levels[esp_random() % (sizeof(levels) / sizeof(levels[0]))];
+                disturbed_halves = 2 + esp_random() % 39;
+            }
+        }
+    }
+}
+
+#endif // CONFIG_PQ_SOURCE_ADC
+
+static void pq_capture_task(void *arg) {
+    if (source_init() != 0) {
+        ESP_LOGE(TAG, "Could not start the sample source");
+        s_task = NULL;
+        vTaskDelete(NULL);
+    }
+    ESP_LOGI(TAG, "Sampling at %u Hz (%u per cycle), %u/%u cycle(s) around each event",
+             (unsigned) SAMPLE_RATE_HZ, (unsigned) SPC, CONFIG_PQ_PRE_CYCLES, CONFIG_PQ_POST_CYCLES);
+    source_run();
+}
+
+int pq_capture_start(void) {
+    if (s_task) {
+        return 0;
+    }
+    const pq_config_t cfg = {
+        .samples_per_cycle = SPC,
+        .nominal_hz = CONFIG_PQ_NOMINAL_FREQUENCY,
+        .volts_per_count = CONFIG_PQ_SCALE_MV_PER_COUNT / 1000.0f,
+        .nominal_v = CONFIG_PQ_NOMINAL_VOLTAGE,
+        .sag_pct = CONFIG_PQ_SAG_PCT,
+        .swell_pct = CONFIG_PQ_SWELL_PCT,
+        .interruption_pct = CONFIG_PQ_INTERRUPTION_PCT,
+        .hysteresis_pct = CONFIG_PQ_HYSTERESIS_PCT,
+        .pre_cycles = CONFIG_PQ_PRE_CYCLES,
+        .post_cycles = CONFIG_PQ_POST_CYCLES,
+        .aggregate_cycles = CONFIG_PQ_NOMINAL_FREQUENCY == 50 ? 10 : 12,
+    };
+    s_record_size = pq_record_size(&cfg);
+    s_ring = malloc((size_t) CONFIG_PQ_PRE_CYCLES * SPC * sizeof(int16_t));
+    s_capture = malloc((size_t) (CONFIG_PQ_PRE_CYCLES + CONFIG_PQ_POST_CYCLES) * SPC * sizeof(int16_t));
+    s_slots = malloc(CONFIG_PQ_EVENT_SLOTS * s_record_size);
+    s_slots_mutex = xSemaphoreCreateMutex();
+    if (!s_ring || !s_capture || !s_slots || !s_slots_mutex) {
+        ESP_LOGE(TAG, "Could not allocate capture buffers");
+        goto fail;
+    }
+    if (pq_detect_init(&s_det, &cfg, s_ring, s_capture, on_event, NULL) != 0) {
+        ESP_LOGE(TAG, "Bad power-quality configuration");
+        goto fail;
+    }
+    // Above the LwM2M task: a late read loses samples, a late notification does not
+    if (xTaskCreate(pq_capture_task, "pq_capture", 4096, NULL, CONFIG_PQ_TASK_PRIORITY, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Could not create capture task");
+        s_task = NULL;
+        goto fail;
+    }
+    return 0;
+
+fail:
+    free(s_ring);
+    free(s_capture);
+    free(s_slots);
+    s_ring = s_capture = NULL;
+    s_slots = NULL;
+    if (s_slots_mutex) {
+        vSemaphoreDelete(s_slots_mutex);
+        s_slots_mutex = NULL;
+    }
+    return -1;
+}
+
+bool pq_capture_latest(pq_aggregate_t *out) {
+    portENTER_CRITICAL(&s_lock);
+    const bool fresh = s_latest.windows
+        && (xTaskGetTickCount() - s_latest_at) <= pdMS_TO_TICKS(AGGREGATE_STALE_MS);
+    if (fresh) {
+        *out = s_latest;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return fresh;
+}
+
+uint32_t pq_capture_seq(void) {
+    if (!s_slots_mutex) {
+        return 0;
+    }
+    xSemaphoreTake(s_slots_mutex, portMAX_DELAY);
+    const uint32_t seq = s_seq;
+    xSemaphoreGive(s_slots_mutex);
+    return seq;
+}
+
+size_t pq_capture_records(uint8_t **buf, size_t *len, uint32_t *seq, uint64_t *newest_ms) {
+    *buf = NULL;
+    *len = 0;
+    if (!s_slots_mutex) {
+        return 0;
+    }
+    xSemaphoreTake(s_slots_mutex, portMAX_DELAY);
+    const size_t count = s_count;
+    if (count) {
+        *buf = malloc(count * s_record_size);
+    }
+    if (*buf) {
+        for (size_t i = 0; i < count; i++) {
+            const size_t slot = (s_head + i) % CONFIG_PQ_EVENT_SLOTS;
+            memcpy(*buf + i * s_record_size, s_slots + slot * s_record_size, s_record_size);
+        }
+        const size_t newest = (s_head + count - 1) % CONFIG_PQ_EVENT_SLOTS;
+        *len = count * s_record_size;
+        *seq = s_slot_seq[newest];
+        *newest_ms = s_slot_ms[newest];
+    }
+    xSemaphoreGive(s_slots_mutex);
+    return *buf ? count : 0;
+}
+
+void pq_capture_ack(uint32_t seq) {
+    if (!s_slots_mutex) {
+        return;
+    }
+    xSemaphoreTake(s_slots_mutex, portMAX_DELAY);
+    while (s_count && (int32_t) (seq - s_slot_seq[s_head]) >= 0) {
+        s_head = (s_head + 1) % CONFIG_PQ_EVENT_SLOTS;
+        s_count--;
+    }
+    xSemaphoreGive(s_slots_mutex);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Power-quality capture: one task samples the line voltage at
+// CONFIG_PQ_SAMPLES_PER_CYCLE per nominal cycle (ADC continuous mode with
+// DMA, or a synthetic waveform on boards without an analog front end) and
+// runs pq_detect over every sample. Finished sag/swell/interruption events
+// are encoded as pq_detect records into CONFIG_PQ_EVENT_SLOTS RAM slots
+// (oldest overwritten when full) and kept until the server acknowledges
+// them. The task only shares short locks with the LwM2M task, which reads
+// the records for Object 19 and the aggregates for Object 10243.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pq_detect.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Starts the capture task (idempotent). Returns 0 on success, -1 on error.
+int pq_capture_start(void);
+
+// Latest aggregation window (RMS, THD); false before the first one or when
+// the task stopped producing them
+bool pq_capture_latest(pq_aggregate_t *out);
+
+// Sequence number of the newest stored event (events since boot)
+uint32_t pq_capture_seq(void);
+
+// Copies the stored records, oldest first, into a malloc'd buffer (*buf is
+// NULL when there are none; the caller frees it). *seq is the sequence
+// number of the newest record copied and *newest_ms its start time in
+// record units (see pq_record_encode). Returns the number of records.
+size_t pq_capture_records(uint8_t **buf, size_t *len, uint32_t *seq, uint64_t *newest_ms);
+
+// Drops the records up to and including sequence number seq
+void pq_capture_ack(uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
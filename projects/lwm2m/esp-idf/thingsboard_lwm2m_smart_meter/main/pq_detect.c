@@ -0,0 +1,213 @@
+#include "pq_detect.h"
+
+#include <math.h>
+#include <string.h>
+
+// Threshold of pct % of nominal as a sum of squared counts over one cycle
+static int64_t cycle_sumsq(const pq_config_t *cfg, double pct) {
+    const double counts = cfg->nominal_v * pct / 100.0 / cfg->volts_per_count;
+    return (int64_t) (counts * counts * cfg->samples_per_cycle);
+}
+
+static float sumsq_to_v(const pq_config_t *cfg, int64_t sumsq, uint32_t n) {
+    return n ? (float) (sqrt((double) sumsq / n) * cfg->volts_per_count) : 0.0f;
+}
+
+int pq_detect_init(pq_detect_t *d, const pq_config_t *cfg, int16_t *ring, int16_t *capture,
+                   pq_event_cb_t *cb, void *arg) {
+    if (!cfg->samples_per_cycle || (cfg->samples_per_cycle & 1)
+            || cfg->samples_per_cycle > PQ_MAX_SAMPLES_PER_CYCLE
+            || !cfg->pre_cycles || !cfg->post_cycles || !cfg->aggregate_cycles
+            || !(cfg->volts_per_count > 0.0f) || !(cfg->nominal_v > 0.0f)
+            || cfg->interruption_pct >= cfg->sag_pct || cfg->swell_pct <= 100 || cfg->sag_pct >= 100) {
+        return -1;
+    }
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    d->cb = cb;
+    d->cb_arg = arg;
+    d->ring = ring;
+    d->ring_len = (size_t) cfg->pre_cycles * cfg->samples_per_cycle;
+    d->capture = capture;
+    d->capture_len = (size_t) (cfg->pre_cycles + cfg->post_cycles) * cfg->samples_per_cycle;
+    memset(ring, 0, d->ring_len * sizeof(*ring));
+    const double w = 2.0 * M_PI / cfg->samples_per_cycle;
+    for (uint16_t i = 0; i < cfg->samples_per_cycle; i++) {
+        d->cos_q15[i] = (int16_t) lrint(32767.0 * cos(w * i));
+        d->sin_q15[i] = (int16_t) lrint(32767.0 * sin(w * i));
+    }
+    d->sag_sumsq = cycle_sumsq(cfg, cfg->sag_pct);
+    d->swell_sumsq = cycle_sumsq(cfg, cfg->swell_pct);
+    d->interruption_sumsq = cycle_sumsq(cfg, cfg->interruption_pct);
+    d->sag_end_sumsq = cycle_sumsq(cfg, cfg->sag_pct + cfg->hysteresis_pct);
+    d->swell_end_sumsq = cycle_sumsq(cfg, cfg->swell_pct - cfg->hysteresis_pct);
+    return 0;
+}
+
+// Folds one Urms(1/2) of an excursion into the record: an excursion below the
+// interruption threshold makes it an interruption, the extreme follows the
+// direction of the record's kind
+static void note_level(pq_detect_t *d, bool swell, int64_t sumsq) {
+    if (!swell && sumsq < d->interruption_sumsq && d->event.type != PQ_EVENT_INTERRUPTION) {
+        if (d->event.type == PQ_EVENT_SWELL) {
+            d->extreme_sumsq = sumsq;
+        }
+        d->event.type = PQ_EVENT_INTERRUPTION;
+    }
+    if (swell != (d->event.type == PQ_EVENT_SWELL)) {
+        return;
+    }
+    if (swell ? sumsq > d->extreme_sumsq : sumsq < d->extreme_sumsq) {
+        d->extreme_sumsq = sumsq;
+    }
+}
+
+static void start_event(pq_detect_t *d, bool swell, int64_t sumsq) {
+    d->active = true;
+    d->active_swell = swell;
+    if (!d->pending) {
+        d->pending = true;
+        d->event.type = swell ? PQ_EVENT_SWELL : PQ_EVENT_SAG;
+        d->event.start_sample = d->samples - d->cfg.samples_per_cycle / 2;
+        d->event.duration_half_cycles = 0;
+        d->extreme_sumsq = sumsq;
+        // Freeze the pre-trigger cycles, oldest first
+        const size_t tail = d->ring_len - d->ring_pos;
+        memcpy(d->capture, d->ring + d->ring_pos, tail * sizeof(int16_t));
+        memcpy(d->capture + tail, d->ring, d->ring_pos * sizeof(int16_t));
+        d->captured = d->ring_len;
+    }
+    // else: restarted before the previous record's post-trigger window was
+    // full, it becomes one longer event
+    d->event.duration_half_cycles++;
+    note_level(d, swell, sumsq);
+}
+
+static void half_cycle(pq_detect_t *d) {
+    const int64_t sumsq = d->prev_half_sumsq + d->half_sumsq;
+    d->prev_half_sumsq = d->half_sumsq;
+    d->half_sumsq = 0;
+    d->half_n = 0;
+    d->halves++;
+    d->aggregate.urms_half_v = sumsq_to_v(&d->cfg, sumsq, d->cfg.samples_per_cycle);
+    // Needs a full pre-trigger ring (and so a full first cycle) to judge
+    if (d->samples < d->ring_len) {
+        return;
+    }
+    if (!d->active) {
+        if (sumsq < d->sag_sumsq) {
+            start_event(d, false, sumsq);
+        } else if (sumsq > d->swell_sumsq) {
+            start_event(d, true, sumsq);
+        }
+        return;
+    }
+    if (d->active_swell ? sumsq < d->swell_end_sumsq : sumsq > d->sag_end_sumsq) {
+        d->active = false;
+        return;
+    }
+    d->event.duration_half_cycles++;
+    note_level(d, d->active_swell, sumsq);
+}
+
+static void close_window(pq_detect_t *d) {
+    const double n = (double) d->agg_halves * d->cfg.samples_per_cycle / 2;
+    const double ms = (double) d->agg_sumsq / n;
+    const double dc = (double) d->agg_sum / n;
+    // Fundamental over a whole number of cycles: amplitude 2|X|/n, RMS^2 = 2|X|^2/n^2
+    const double c = (double) d->agg_c / 32767.0;
+    const double s = (double) d->agg_s / 32767.0;
+    const double fund_ms = 2.0 * (c * c + s * s) / (n * n);
+    const double rest_ms = ms - dc * dc - fund_ms;
+    d->aggregate.rms_v = (float) (sqrt(ms) * d->cfg.volts_per_count);
+    d->aggregate.thd = fund_ms > 0.0 ? (float) sqrt(rest_ms > 0.0 ? rest_ms / fund_ms : 0.0) : 0.0f;
+    d->aggregate.windows++;
+    d->agg_halves = 0;
+    d->agg_sum = d->agg_sumsq = d->agg_c = d->agg_s = 0;
+}
+
+void pq_detect_feed(pq_detect_t *d, const int16_t *samples, size_t n) {
+    const uint16_t spc = d->cfg.samples_per_cycle;
+    const uint16_t half = spc / 2;
+    for (size_t i = 0; i < n; i++) {
+        const int32_t x = samples[i];
+        const int32_t sq = x * x;
+        d->ring[d->ring_pos] = (int16_t) x;
+        if (++d->ring_pos == d->ring_len) {
+            d->ring_pos = 0;
+        }
+        if (d->pending && d->captured < d->capture_len) {
+            d->capture[d->captured++] = (int16_t) x;
+        }
+        d->half_sumsq += sq;
+        d->agg_sum += x;
+        d->agg_sumsq += sq;
+        d->agg_c += x * d->cos_q15[d->phase];
+        d->agg_s += x * d->sin_q15[d->phase];
+        if (++d->phase == spc) {
+            d->phase = 0;
+        }
+        d->samples++;
+        if (++d->half_n < half) {
+            continue;
+        }
+        half_cycle(d);
+        if (d->pending && !d->active && d->captured == d->capture_len) {
+            d->pending = false;
+            d->event.extreme_v = sumsq_to_v(&d->cfg, d->extreme_sumsq, spc);
+            d->event.waveform = d->capture;
+            d->event.waveform_len = d->capture_len;
+            if (d->cb) {
+                d->cb(&d->event, d->cb_arg);
+            }
+        }
+        if (++d->agg_halves == 2u * d->cfg.aggregate_cycles) {
+            close_window(d);
+        }
+    }
+}
+
+bool pq_detect_aggregate(const pq_detect_t *d, pq_aggregate_t *out) {
+    *out = d->aggregate;
+    return d->aggregate.windows > 0;
+}
+
+size_t pq_record_size(const pq_config_t *cfg) {
+    return PQ_RECORD_HEADER_SIZE
+        + (size_t) (cfg->pre_cycles + cfg->post_cycles) * cfg->samples_per_cycle * sizeof(int16_t);
+}
+
+static uint8_t *put_le(uint8_t *p, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        *p++ = (uint8_t) (v >> (8 * i));
+    }
+    return p;
+}
+
+size_t pq_record_encode(const pq_config_t *cfg, const pq_event_t *event, uint64_t start_ms,
+                        bool uptime, uint8_t *buf, size_t size) {
+    const size_t len = PQ_RECORD_HEADER_SIZE + event->waveform_len * sizeof(int16_t);
+    if (size < len) {
+        return 0;
+    }
+    const double cv = event->extreme_v * 100.0 + 0.5;
+    uint32_t scale;
+    memcpy(&scale, &cfg->volts_per_count, sizeof(scale));
+    uint8_t *p = buf;
+    *p++ = PQ_RECORD_VERSION;
+    *p++ = (uint8_t) event->type;
+    *p++ = cfg->pre_cycles;
+    *p++ = cfg->post_cycles;
+    p = put_le(p, cfg->samples_per_cycle, 2);
+    p = put_le(p, (uint32_t) cfg->samples_per_cycle * cfg->nominal_hz, 2);
+    p = put_le(p, start_ms, 8);
+    p = put_le(p, event->duration_half_cycles, 4);
+    p = put_le(p, cv > 65535.0 ? 65535u : (uint16_t) cv, 2);
+    *p++ = uptime ? 1u : 0u;
+    *p++ = 0;
+    p = put_le(p, scale, 4);
+    for (size_t i = 0; i < event->waveform_len; i++) {
+        p = put_le(p, (uint16_t) event->waveform[i], 2);
+    }
+    return len;
+}
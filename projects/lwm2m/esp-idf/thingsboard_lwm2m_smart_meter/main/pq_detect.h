@@ -0,0 +1,129 @@
+#pragma once
+
+// Power-quality event detection on a sampled voltage waveform.
+// Samples arrive at a fixed rate of samples_per_cycle per nominal cycle (bias
+// already removed, in ADC counts). Every half cycle the RMS over the last full
+// cycle is refreshed (Urms(1/2), IEC 61000-4-30) and compared against the
+// sag, swell and interruption thresholds. A circular buffer always holds the
+// last pre_cycles cycles; when an event starts it is frozen and followed by
+// post_cycles more cycles, and the event is reported once it has ended and
+// the post-trigger window is full. The per-sample work is integer only (the
+// ESP32-C6 has no FPU): square sums for the RMS and Q15 sine/cosine products
+// for the fundamental used by the THD of the aggregation window.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PQ_MAX_SAMPLES_PER_CYCLE 128
+#define PQ_RECORD_VERSION 1
+#define PQ_RECORD_HEADER_SIZE 28
+
+typedef enum {
+    PQ_EVENT_SAG = 1,
+    PQ_EVENT_SWELL = 2,
+    PQ_EVENT_INTERRUPTION = 3,
+} pq_event_type_t;
+
+typedef struct {
+    uint16_t samples_per_cycle; // even, <= PQ_MAX_SAMPLES_PER_CYCLE
+    uint16_t nominal_hz;
+    float volts_per_count;
+    float nominal_v;            // declared input voltage (RMS)
+    uint8_t sag_pct;            // event below this % of nominal_v (e.g. 90)
+    uint8_t swell_pct;          // event above this % (e.g. 110)
+    uint8_t interruption_pct;   // an event dipping below this % is an interruption (e.g. 5)
+    uint8_t hysteresis_pct;     // the event ends this % past its threshold (e.g. 2)
+    uint8_t pre_cycles;         // >= 1
+    uint8_t post_cycles;        // >= 1
+    uint8_t aggregate_cycles;   // RMS/THD window (10 at 50 Hz, 12 at 60 Hz)
+} pq_config_t;
+
+typedef struct {
+    pq_event_type_t type;
+    uint64_t start_sample;         // first sample of the half cycle that triggered
+    uint32_t duration_half_cycles;
+    float extreme_v;               // lowest (sag/interruption) or highest (swell) Urms(1/2)
+    const int16_t *waveform;       // (pre + post) cycles; the triggering half cycle ends
+    size_t waveform_len;           // at sample pre_cycles * samples_per_cycle
+} pq_event_t;
+
+typedef void pq_event_cb_t(const pq_event_t *event, void *arg);
+
+typedef struct {
+    float rms_v;   // over the aggregation window
+    float thd;     // fraction: RMS of everything but DC and fundamental / fundamental
+    float urms_half_v; // latest Urms(1/2)
+    uint32_t windows; // completed aggregation windows
+} pq_aggregate_t;
+
+typedef struct {
+    pq_config_t cfg;
+    pq_event_cb_t *cb;
+    void *cb_arg;
+    int16_t cos_q15[PQ_MAX_SAMPLES_PER_CYCLE];
+    int16_t sin_q15[PQ_MAX_SAMPLES_PER_CYCLE];
+    // Thresholds, in squared counts summed over one cycle
+    int64_t sag_sumsq, swell_sumsq, interruption_sumsq, sag_end_sumsq, swell_end_sumsq;
+    // Pre-trigger ring (pre_cycles cycles) and capture (pre + post cycles)
+    int16_t *ring;
+    size_t ring_len;
+    size_t ring_pos;
+    int16_t *capture;
+    size_t capture_len;
+    size_t captured;
+    uint64_t samples;
+    uint16_t phase;
+    // Half cycles
+    uint16_t half_n;
+    int64_t half_sumsq;
+    int64_t prev_half_sumsq;
+    uint32_t halves;
+    // Event in progress / record waiting for its post-trigger window
+    bool active;
+    bool active_swell;
+    bool pending;
+    pq_event_t event;
+    int64_t extreme_sumsq;
+    // Aggregation window
+    uint32_t agg_halves;
+    int64_t agg_sum;
+    int64_t agg_sumsq;
+    int64_t agg_c;
+    int64_t agg_s;
+    pq_aggregate_t aggregate;
+} pq_detect_t;
+
+// ring holds pre_cycles * samples_per_cycle samples, capture
+// (pre_cycles + post_cycles) * samples_per_cycle. Returns -1 on a bad config.
+int pq_detect_init(pq_detect_t *d, const pq_config_t *cfg, int16_t *ring, int16_t *capture,
+                   pq_event_cb_t *cb, void *arg);
+
+// Processes samples; cb is called from here when an event record is complete.
+// Events starting before the previous one's post-trigger window is full are
+// merged into it (the record keeps its first kind, unless an interruption).
+void pq_detect_feed(pq_detect_t *d, const int16_t *samples, size_t n);
+
+// Latest aggregation window; false before the first one completes
+bool pq_detect_aggregate(const pq_detect_t *d, pq_aggregate_t *out);
+
+// Size of one encoded record for this configuration
+size_t pq_record_size(const pq_config_t *cfg);
+
+// Compact little-endian record (Object 19 payload):
+//   0 u8 version, 1 u8 type, 2 u8 pre_cycles, 3 u8 post_cycles,
+//   4 u16 samples_per_cycle, 6 u16 sample rate (Hz), 8 u64 start time (ms),
+//   16 u32 duration (half cycles), 20 u16 extreme Urms(1/2) (0.01 V),
+//   22 u8 flags (bit 0: start time is uptime, not Unix time), 23 u8 reserved,
+//   24 f32 volts per count, 28 i16 samples[waveform_len]
+// Returns the bytes written, 0 if size is too small.
+size_t pq_record_encode(const pq_config_t *cfg, const pq_event_t *event, uint64_t start_ms,
+                        bool uptime, uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,134 @@
+#include "reset_button.h"
+
+#include <stdbool.h>
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include "sdkconfig.h"
+
+#include "led_status.h"
+
+static const char *TAG = "reset_button";
+
+static const gpio_num_t s_btn = (gpio_num_t) CONFIG_BOARD_BOOT_BUTTON_GPIO;
+static esp_timer_handle_t s_hold_timer;
+static TaskHandle_t s_task;
+
+// On ESP32-C6, only RTC-capable (LP) GPIOs can wake from deep sleep. These map to GPIO0..GPIO7.
+static inline bool is_deep_sleep_wake_capable_gpio(gpio_num_t gpio)
+{
+    return (gpio >= GPIO_NUM_0 && gpio <= GPIO_NUM_7);
+}
+
+static void arm_hold_timer(void)
+{
+    // Restart on every press edge: contact bounce only delays the deadline
+    esp_timer_stop(s_hold_timer);
+    esp_timer_start_once(s_hold_timer, (uint64_t) CONFIG_FACTORY_RESET_HOLD_MS * 1000);
+}
+
+static void button_isr(void *arg)
+{
+    (void) arg;
+    if (gpio_get_level(s_btn) == 0) {
+        arm_hold_timer();
+    } else {
+        esp_timer_stop(s_hold_timer);
+    }
+}
+
+static void hold_timer_cb(void *arg)
+{
+    (void) arg;
+    // A release edge stops the timer; check the level anyway in case it was missed
+    if (gpio_get_level(s_btn) == 0) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void factory_reset_task(void *arg)
+{
+    (void) arg;
+    // Sleeps until the button has been held long enough
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // Reached target hold time: show red blink and perform factory reset
+    gpio_isr_handler_remove(s_btn);
+    led_status_set_mode(LED_MODE_FACTORY_RESET);
+    vTaskDelay(pdMS_TO_TICKS(600));
+    nvs_flash_deinit();
+    nvs_flash_erase();
+    // Optional: re-init not required before deep sleep
+    vTaskDelay(pdMS_TO_TICKS(50));
+    // Turn off LED before sleep (synchronous)
+    led_status_force_off();
+    vTaskDelay(pdMS_TO_TICKS(20));
+    // Configure deep-sleep input pulls to keep line high when not pressed
+    gpio_sleep_set_direction(s_btn, GPIO_MODE_INPUT);
+    gpio_sleep_set_pull_mode(s_btn, GPIO_PULLUP_ONLY);
+    // Enable wakeup on the same button (active-low) if RTC-capable
+    if (is_deep_sleep_wake_capable_gpio(s_btn)) {
+        esp_err_t werr = esp_sleep_enable_ext1_wakeup(1ULL << s_btn, ESP_EXT1_WAKEUP_ANY_LOW);
+        if (werr != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to enable ext1 wake on GPIO %d: %s", s_btn, esp_err_to_name(werr));
+        } else {
+            ESP_LOGW(TAG, "Entering deep sleep after factory reset. Press BOOT to wake.");
+        }
+    } else {
+        ESP_LOGE(TAG, "GPIO %d cannot wake from deep sleep on ESP32-C6 (needs RTC GPIO 0..7). Use a valid RTC pin or RESET.", s_btn);
+        ESP_LOGW(TAG, "Entering deep sleep. Wake with RESET/EN or reconfigure wake GPIO to 0..7.");
+    }
+    // Start deep sleep
+    esp_deep_sleep_start();
+}
+
+int reset_button_init(void)
+{
+    if (s_task) {
+        return 0;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = hold_timer_cb,
+        .name = "reset_hold",
+    };
+    if (esp_timer_create(&args, &s_hold_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not create hold timer");
+        return -1;
+    }
+    if (xTaskCreate(factory_reset_task, "factory_reset", 3072, NULL, 6, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Could not create factory reset task");
+        s_task = NULL;
+        return -1;
+    }
+
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << s_btn,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = true,
+        .pull_down_en = false,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    gpio_config(&io);
+    // Another module may already have installed the shared ISR service
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "gpio_install_isr_service failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    err = gpio_isr_handler_add(s_btn, button_isr, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "gpio_isr_handler_add failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    // Held since boot: no press edge will come
+    if (gpio_get_level(s_btn) == 0) {
+        arm_hold_timer();
+    }
+    ESP_LOGI(TAG, "Factory reset on GPIO %d after %d ms hold", s_btn, CONFIG_FACTORY_RESET_HOLD_MS);
+    return 0;
+}
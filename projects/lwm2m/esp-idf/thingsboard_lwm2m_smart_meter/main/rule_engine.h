@@ -0,0 +1,75 @@
+#pragma once
+
+// Threshold rules evaluated on the device, in the sampling path.
+// Rules are declared as (signal, above/below, threshold, hysteresis, hold) and
+// compiled into a flat table grouped by signal: evaluating a sample only walks
+// the conditions of its own signal, each one a multiply and two compares, so
+// the cost per sample is bounded by RULE_ENGINE_MAX_RULES whatever the rules
+// are. A rule becomes active after `hold` consecutive samples past the
+// threshold and clears once the value is back past threshold -/+ hysteresis.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rules and signals are indexed in 32-bit masks
+#define RULE_ENGINE_MAX_RULES 16
+#define RULE_ENGINE_MAX_SIGNALS 16
+
+typedef enum {
+    RULE_ABOVE = 0, // active while value > threshold
+    RULE_BELOW = 1, // active while value < threshold
+} rule_op_t;
+
+typedef struct {
+    bool enabled;
+    uint8_t signal;   // input index chosen by the caller (< RULE_ENGINE_MAX_SIGNALS)
+    uint8_t op;       // rule_op_t
+    uint8_t hold;     // consecutive samples past the threshold before it fires (>= 1)
+    float threshold;
+    float hysteresis; // >= 0
+} rule_def_t;
+
+typedef struct {
+    // Conditions of signal s are [first[s], first[s + 1])
+    uint8_t first[RULE_ENGINE_MAX_SIGNALS + 1];
+    uint8_t count;
+    // One entry per condition, values pre-multiplied by the sign of the operator
+    float sign[RULE_ENGINE_MAX_RULES];
+    float enter[RULE_ENGINE_MAX_RULES]; // sign * threshold
+    float leave[RULE_ENGINE_MAX_RULES]; // sign * threshold - hysteresis
+    uint8_t hold[RULE_ENGINE_MAX_RULES];
+    uint8_t run[RULE_ENGINE_MAX_RULES]; // consecutive samples past the threshold
+    uint8_t rule[RULE_ENGINE_MAX_RULES]; // index in the definitions
+    uint32_t active; // bit per definition index
+} rule_table_t;
+
+// Compiles defs[0..n) (n <= RULE_ENGINE_MAX_RULES); disabled or invalid
+// definitions are left out. All rules start inactive. Returns the number of
+// compiled conditions, -1 if n is too large.
+int rule_engine_compile(rule_table_t *t, const rule_def_t *defs, size_t n);
+
+// After compiling t, copies from old (the previous table) the state of the
+// rules in the keep mask: active bit and samples counted towards hold. Rules
+// outside keep, or not compiled in one of the tables, stay inactive.
+void rule_engine_carry_state(rule_table_t *t, const rule_table_t *old, uint32_t keep);
+
+// True if def would be compiled (enabled, valid signal/op/hold/hysteresis)
+bool rule_engine_valid(const rule_def_t *def);
+
+// Evaluates one sample of a signal. Returns a mask (bit per definition index)
+// of the rules whose state changed; the new states are in t->active. NaN
+// samples neither fire nor clear a rule.
+uint32_t rule_engine_eval(rule_table_t *t, uint8_t signal, float value);
+
+static inline bool rule_engine_active(const rule_table_t *t, size_t rule) {
+    return (t->active & (1u << rule)) != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
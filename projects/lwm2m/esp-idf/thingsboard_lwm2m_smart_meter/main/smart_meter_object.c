@@ -12,6 +12,14 @@
 #include <freertos/task.h>
 #include <anjay/attr_storage.h>
 #include "sdkconfig.h"
+#include "notify_filter.h"
+#include "rule_object.h"
+#if CONFIG_DLMS_METER_ENABLE
+#include "dlms_meter.h"
+#endif
+#if CONFIG_PQ_CAPTURE_ENABLE
+#include "pq_capture.h"
+#endif
 
 #define OID_SMART_METER 10243
 // Resource IDs per provided table
@@ -37,6 +45,19 @@
 #define RID_SIM_MODE                     60000 // int: 0=periodic,1=dynamic
 #define RID_UPDATE_PERIOD                60001 // int: seconds (1..3600)
 
+// Measurements the Threshold Rules object can evaluate
+typedef enum {
+    SM_RULE_VOLTAGE,
+    SM_RULE_CURRENT,
+    SM_RULE_ACTIVE_POWER,
+    SM_RULE_APPARENT_POWER,
+    SM_RULE_POWER_FACTOR,
+    SM_RULE_THD_V,
+    SM_RULE_THD_A,
+    SM_RULE_FREQUENCY,
+    SM_RULE_COUNT
+} sm_rule_input_t;
+
 typedef struct {
     const anjay_dm_object_def_t *def;
     // Identification
@@ -68,29 +89,32 @@ typedef struct {
     uint32_t update_period_sec; // integration/notification period
     TickType_t last_dyn_notify; // last fast notify tick (dynamic mode)
     bool attrs_initialized; // if initial pmin/pmax sync done
-    // Delta notification state
+    // Delta notification state (server gt/lt/st, SM_DELTA_* when none set)
     bool first_notify_done;
-    float ln_voltage_v;
-    float ln_current_a;
-    float ln_active_power_kw;
-    float ln_reactive_power_kvar;
-    float ln_inductive_reactive_power_kvar;
-    float ln_capacitive_reactive_power_kvar;
-    float ln_apparent_power_kva;
-    float ln_power_factor;
-    float ln_thd_v;
-    float ln_thd_a;
-    float ln_frequency_hz;
-    float ln_active_energy_kwh;
-    float ln_reactive_energy_kvarh;
-    float ln_apparent_energy_kvah;
+    notify_filter_t nf_voltage_v;
+    notify_filter_t nf_current_a;
+    notify_filter_t nf_active_power_kw;
+    notify_filter_t nf_reactive_power_kvar;
+    notify_filter_t nf_inductive_reactive_power_kvar;
+    notify_filter_t nf_capacitive_reactive_power_kvar;
+    notify_filter_t nf_apparent_power_kva;
+    notify_filter_t nf_power_factor;
+    notify_filter_t nf_thd_v;
+    notify_filter_t nf_thd_a;
+    notify_filter_t nf_frequency_hz;
+    notify_filter_t nf_active_energy_kwh;
+    notify_filter_t nf_reactive_energy_kvarh;
+    notify_filter_t nf_apparent_energy_kvah;
+    // Threshold rules: signal index per input, last meter poll evaluated
+    uint8_t rule_signal[SM_RULE_COUNT];
+    uint32_t rule_polls;
 } sm_ctx_t;
 
 static const char *TAG_SM = "sm_obj";
 
 static sm_ctx_t g_sm;
 
-// Delta thresholds for notifications
+// Fallback delta thresholds for notifications (used until the server writes gt/lt/st)
 #define SM_DELTA_VOLTAGE      0.15f
 #define SM_DELTA_CURRENT      0.02f
 #define SM_DELTA_POWER        0.01f
@@ -99,6 +123,10 @@ static sm_ctx_t g_sm;
 #define SM_DELTA_FREQ         0.01f
 #define SM_DELTA_ENERGY       0.0005f
 
+// Snapshot for lock-free readers: odd sequence while the LwM2M task writes it
+static uint32_t s_snap_seq;
+static sm_snapshot_t s_snap;
+
 // Forward decl for attribute sync
 static void sm_sync_attrs(anjay_t *anjay);
 
@@ -116,16 +144,21 @@ static void sm_sync_attrs(anjay_t *anjay) {
     int32_t pmin_per = (int32_t) up;
     int32_t pmax_per = (int32_t) (up * 2);
     const anjay_rid_t inst_rids[] = { RID_TENSION, RID_CURRENT, RID_ACTIVE_POWER, RID_REACTIVE_POWER, RID_APPARENT_POWER, RID_POWER_FACTOR, RID_THD_V, RID_THD_A, RID_FREQUENCY };
-    anjay_dm_r_attributes_t attrs = ANJAY_DM_R_ATTRIBUTES_EMPTY;
-    attrs.common.min_period = dyn ? pmin_dyn : pmin_per;
-    attrs.common.max_period = dyn ? pmax_dyn : pmax_per;
-    for (size_t i = 0; i < sizeof(inst_rids)/sizeof(inst_rids[0]); ++i) {
 #ifdef CONFIG_LWM2M_SERVER_SHORT_ID
-        (void) anjay_attr_storage_set_resource_attrs(anjay, (anjay_ssid_t) CONFIG_LWM2M_SERVER_SHORT_ID, OID_SMART_METER, 0, inst_rids[i], &attrs);
+    const anjay_ssid_t ssid = (anjay_ssid_t) CONFIG_LWM2M_SERVER_SHORT_ID;
 #else
-        (void) anjay_attr_storage_set_resource_attrs(anjay, (anjay_ssid_t) 123, OID_SMART_METER, 0, inst_rids[i], &attrs);
+    const anjay_ssid_t ssid = (anjay_ssid_t) 123;
 #endif
+    for (size_t i = 0; i < sizeof(inst_rids)/sizeof(inst_rids[0]); ++i) {
+        // Only touch pmin/pmax: keep any gt/lt/st the server wrote on this resource
+        anjay_dm_r_attributes_t attrs = ANJAY_DM_R_ATTRIBUTES_EMPTY;
+        (void) anjay_attr_storage_get_resource_attrs(anjay, ssid, OID_SMART_METER, 0, inst_rids[i], &attrs);
+        attrs.common.min_period = dyn ? pmin_dyn : pmin_per;
+        attrs.common.max_period = dyn ? pmax_dyn : pmax_per;
+        (void) anjay_attr_storage_set_resource_attrs(anjay, ssid, OID_SMART_METER, 0, inst_rids[i], &attrs);
     }
+    // Our own writes count as attribute changes too; reload cached gt/lt/st
+    notify_filter_invalidate_all();
     ESP_LOGI(TAG_SM, "Synced attrs (%s): dyn(pmin=%d pmax=%d) periodic(pmin=%d pmax=%d)", dyn?"dynamic":"periodic", (int) pmin_dyn, (int) pmax_dyn, (int) pmin_per, (int) pmax_per);
     g_sm.attrs_initialized = true;
 #else
@@ -147,6 +180,42 @@ static inline float clampf(float x, float lo, float hi) {
     return fminf(hi, fmaxf(lo, x));
 }
 
+static void sm_eval_rule(anjay_t *anjay, sm_rule_input_t input, float value) {
+    rule_object_eval(anjay, g_sm.rule_signal[input], value);
+}
+
+// Published sample (simulation): every input the rules know
+static void sm_eval_rules(anjay_t *anjay) {
+    sm_eval_rule(anjay, SM_RULE_VOLTAGE, g_sm.voltage_v);
+    sm_eval_rule(anjay, SM_RULE_CURRENT, g_sm.current_a);
+    sm_eval_rule(anjay, SM_RULE_ACTIVE_POWER, g_sm.active_power_kw);
+    sm_eval_rule(anjay, SM_RULE_APPARENT_POWER, g_sm.apparent_power_kva);
+    sm_eval_rule(anjay, SM_RULE_POWER_FACTOR, g_sm.power_factor);
+    sm_eval_rule(anjay, SM_RULE_THD_V, g_sm.thd_v);
+    sm_eval_rule(anjay, SM_RULE_THD_A, g_sm.thd_a);
+    sm_eval_rule(anjay, SM_RULE_FREQUENCY, g_sm.frequency_hz);
+}
+
+#if CONFIG_DLMS_METER_ENABLE
+// Every meter poll, not only the samples published on the update period:
+// only the registers the meter returned
+static void sm_eval_meter_rules(anjay_t *anjay, const dlms_meter_readings_t *m) {
+    static const struct { dlms_meter_quantity_t q; sm_rule_input_t input; } map[] = {
+        { DLMS_METER_VOLTAGE, SM_RULE_VOLTAGE },
+        { DLMS_METER_CURRENT, SM_RULE_CURRENT },
+        { DLMS_METER_ACTIVE_POWER, SM_RULE_ACTIVE_POWER },
+        { DLMS_METER_APPARENT_POWER, SM_RULE_APPARENT_POWER },
+        { DLMS_METER_POWER_FACTOR, SM_RULE_POWER_FACTOR },
+        { DLMS_METER_FREQUENCY, SM_RULE_FREQUENCY },
+    };
+    for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); ++i) {
+        if (dlms_meter_has(m, map[i].q)) {
+            sm_eval_rule(anjay, map[i].input, m->value[map[i].q]);
+        }
+    }
+}
+#endif
+
 static int list_instances(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                           anjay_dm_list_ctx_t *ctx) {
     (void) anjay; (void) def;
@@ -291,6 +360,44 @@ static const anjay_dm_object_def_t OBJ_DEF = {
     }
 };
 
+// Single writer (LwM2M task)
+static void sm_publish_snapshot(void) {
+    uint32_t seq = s_snap_seq;
+    __atomic_store_n(&s_snap_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s_snap.voltage_v = g_sm.voltage_v;
+    s_snap.current_a = g_sm.current_a;
+    s_snap.active_power_kw = g_sm.active_power_kw;
+    s_snap.reactive_power_kvar = g_sm.reactive_power_kvar;
+    s_snap.inductive_reactive_power_kvar = g_sm.inductive_reactive_power_kvar;
+    s_snap.capacitive_reactive_power_kvar = g_sm.capacitive_reactive_power_kvar;
+    s_snap.apparent_power_kva = g_sm.apparent_power_kva;
+    s_snap.power_factor = g_sm.power_factor;
+    s_snap.thd_v = g_sm.thd_v;
+    s_snap.thd_a = g_sm.thd_a;
+    s_snap.frequency_hz = g_sm.frequency_hz;
+    s_snap.active_energy_kwh = g_sm.active_energy_kwh;
+    s_snap.reactive_energy_kvarh = g_sm.reactive_energy_kvarh;
+    s_snap.apparent_energy_kvah = g_sm.apparent_energy_kvah;
+    s_snap.update_count++;
+    __atomic_store_n(&s_snap_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+bool smart_meter_snapshot(sm_snapshot_t *out) {
+    for (;;) {
+        uint32_t begin = __atomic_load_n(&s_snap_seq, __ATOMIC_ACQUIRE);
+        if (!(begin & 1u)) {
+            memcpy(out, &s_snap, sizeof(*out));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&s_snap_seq, __ATOMIC_RELAXED) == begin) {
+                return begin != 0;
+            }
+        }
+        // Overlapped an update: let the writer finish even if it has a lower priority
+        vTaskDelay(1);
+    }
+}
+
 const anjay_dm_object_def_t *const *smart_meter_object_create(void) {
     memset(&g_sm, 0, sizeof(g_sm));
     g_sm.def = &OBJ_DEF;
@@ -329,9 +436,32 @@ const anjay_dm_object_def_t *const *smart_meter_object_create(void) {
     g_sm.last_dyn_notify = g_sm.last_update;
     g_sm.attrs_initialized = false;
     g_sm.first_notify_done = false;
+    notify_filter_init(&g_sm.nf_voltage_v, OID_SMART_METER, 0, RID_TENSION, SM_DELTA_VOLTAGE);
+    notify_filter_init(&g_sm.nf_current_a, OID_SMART_METER, 0, RID_CURRENT, SM_DELTA_CURRENT);
+    notify_filter_init(&g_sm.nf_active_power_kw, OID_SMART_METER, 0, RID_ACTIVE_POWER, SM_DELTA_POWER);
+    notify_filter_init(&g_sm.nf_reactive_power_kvar, OID_SMART_METER, 0, RID_REACTIVE_POWER, SM_DELTA_POWER);
+    notify_filter_init(&g_sm.nf_inductive_reactive_power_kvar, OID_SMART_METER, 0, RID_INDUCTIVE_REACTIVE_POWER, SM_DELTA_POWER);
+    notify_filter_init(&g_sm.nf_capacitive_reactive_power_kvar, OID_SMART_METER, 0, RID_CAPACITIVE_REACTIVE_POWER, SM_DELTA_POWER);
+    notify_filter_init(&g_sm.nf_apparent_power_kva, OID_SMART_METER, 0, RID_APPARENT_POWER, SM_DELTA_POWER);
+    notify_filter_init(&g_sm.nf_power_factor, OID_SMART_METER, 0, RID_POWER_FACTOR, SM_DELTA_PF);
+    notify_filter_init(&g_sm.nf_thd_v, OID_SMART_METER, 0, RID_THD_V, SM_DELTA_THD);
+    notify_filter_init(&g_sm.nf_thd_a, OID_SMART_METER, 0, RID_THD_A, SM_DELTA_THD);
+    notify_filter_init(&g_sm.nf_frequency_hz, OID_SMART_METER, 0, RID_FREQUENCY, SM_DELTA_FREQ);
+    notify_filter_init(&g_sm.nf_active_energy_kwh, OID_SMART_METER, 0, RID_ACTIVE_ENERGY, SM_DELTA_ENERGY);
+    notify_filter_init(&g_sm.nf_reactive_energy_kvarh, OID_SMART_METER, 0, RID_REACTIVE_ENERGY, SM_DELTA_ENERGY);
+    notify_filter_init(&g_sm.nf_apparent_energy_kvah, OID_SMART_METER, 0, RID_APPARENT_ENERGY, SM_DELTA_ENERGY);
+    g_sm.rule_signal[SM_RULE_VOLTAGE] = rule_object_add_signal(OID_SMART_METER, 0, RID_TENSION);
+    g_sm.rule_signal[SM_RULE_CURRENT] = rule_object_add_signal(OID_SMART_METER, 0, RID_CURRENT);
+    g_sm.rule_signal[SM_RULE_ACTIVE_POWER] = rule_object_add_signal(OID_SMART_METER, 0, RID_ACTIVE_POWER);
+    g_sm.rule_signal[SM_RULE_APPARENT_POWER] = rule_object_add_signal(OID_SMART_METER, 0, RID_APPARENT_POWER);
+    g_sm.rule_signal[SM_RULE_POWER_FACTOR] = rule_object_add_signal(OID_SMART_METER, 0, RID_POWER_FACTOR);
+    g_sm.rule_signal[SM_RULE_THD_V] = rule_object_add_signal(OID_SMART_METER, 0, RID_THD_V);
+    g_sm.rule_signal[SM_RULE_THD_A] = rule_object_add_signal(OID_SMART_METER, 0, RID_THD_A);
+    g_sm.rule_signal[SM_RULE_FREQUENCY] = rule_object_add_signal(OID_SMART_METER, 0, RID_FREQUENCY);
     // runtime init: default to periodic mode; update period 60s (attributes may adjust cadence)
     g_sm.dynamic_mode = false;
     g_sm.update_period_sec = 60;
+    sm_publish_snapshot();
     ESP_LOGI(TAG_SM, "Smart Meter(10243) created");
     return &g_sm.def;
 }
@@ -346,6 +476,16 @@ void smart_meter_object_update(anjay_t *anjay, const anjay_dm_object_def_t *cons
     if (!g_sm.attrs_initialized) {
         sm_sync_attrs(anjay);
     }
+#if CONFIG_DLMS_METER_ENABLE
+    dlms_meter_readings_t polled;
+    const bool from_meter = dlms_meter_latest(&polled);
+    if (from_meter && polled.polls != g_sm.rule_polls) {
+        g_sm.rule_polls = polled.polls;
+        sm_eval_meter_rules(anjay, &polled);
+    }
+#else
+    const bool from_meter = false;
+#endif
     const TickType_t now = xTaskGetTickCount();
     const uint32_t period_ticks = pdMS_TO_TICKS(g_sm.update_period_sec * 1000ULL);
     TickType_t dt_ticks = (g_sm.last_update == 0) ? 0 : (now - g_sm.last_update);
@@ -395,10 +535,19 @@ void smart_meter_object_update(anjay_t *anjay, const anjay_dm_object_def_t *cons
     float new_current = rw_current;
     float new_pf = rw_pf;
     float new_freq = rw_freq;
+#if CONFIG_PQ_CAPTURE_ENABLE
+    // Sampled voltage waveform: RMS and THD of the last 10/12-cycle window
+    // (the current is not sampled, so THD A stays simulated)
+    pq_aggregate_t pq;
+    const bool have_pq = pq_capture_latest(&pq);
+    if (have_pq) {
+        new_voltage = pq.rms_v;
+    }
+#endif
 
     // Apparent power (kVA), Active (kW), Reactive (kvar)
-    const float s_kva = (new_voltage * new_current) / 1000.0f;
-    const float p_kw = s_kva * new_pf;
+    float s_kva = (new_voltage * new_current) / 1000.0f;
+    float p_kw = s_kva * new_pf;
     const float q_kvar_mag = s_kva * sqrtf(fmaxf(0.0f, 1.0f - new_pf * new_pf));
     bool inductive = (esp_random() & 1u) != 0u; // random inductive/capacitive
     float new_q_kvar = q_kvar_mag * (inductive ? 1.0f : -1.0f);
@@ -413,6 +562,48 @@ void smart_meter_object_update(anjay_t *anjay, const anjay_dm_object_def_t *cons
     // THD variations (fractions)
     float new_thd_v = clampf(frand_range(0.010f, 0.040f), 0.0f, 1.0f);
     float new_thd_a = clampf(frand_range(0.015f, 0.060f), 0.0f, 1.0f);
+#if CONFIG_PQ_CAPTURE_ENABLE
+    if (have_pq) {
+        new_thd_v = clampf(pq.thd, 0.0f, 1.0f);
+    }
+#endif
+
+#if CONFIG_DLMS_METER_ENABLE
+    // Real meter: measured registers replace the simulation, missing powers
+    // are derived from V, I and PF, energies are the meter's own counters
+    dlms_meter_readings_t m;
+    if (dlms_meter_latest(&m)) {
+        if (dlms_meter_has(&m, DLMS_METER_VOLTAGE)) { new_voltage = m.value[DLMS_METER_VOLTAGE]; }
+        if (dlms_meter_has(&m, DLMS_METER_CURRENT)) { new_current = m.value[DLMS_METER_CURRENT]; }
+        if (dlms_meter_has(&m, DLMS_METER_FREQUENCY)) { new_freq = m.value[DLMS_METER_FREQUENCY]; }
+        if (dlms_meter_has(&m, DLMS_METER_POWER_FACTOR)) { new_pf = m.value[DLMS_METER_POWER_FACTOR]; }
+        s_kva = dlms_meter_has(&m, DLMS_METER_APPARENT_POWER) ? m.value[DLMS_METER_APPARENT_POWER]
+                                                               : new_voltage * new_current / 1000.0f;
+        p_kw = dlms_meter_has(&m, DLMS_METER_ACTIVE_POWER) ? m.value[DLMS_METER_ACTIVE_POWER] : s_kva * fabsf(new_pf);
+        if (dlms_meter_has(&m, DLMS_METER_REACTIVE_POWER)) {
+            new_q_kvar = m.value[DLMS_METER_REACTIVE_POWER];
+        } else {
+            new_q_kvar = sqrtf(fmaxf(0.0f, s_kva * s_kva - p_kw * p_kw));
+        }
+        new_q_ind_kvar = new_q_kvar > 0.0f ? new_q_kvar : 0.0f;
+        new_q_cap_kvar = new_q_kvar < 0.0f ? -new_q_kvar : 0.0f;
+        if (!dlms_meter_has(&m, DLMS_METER_POWER_FACTOR) && s_kva > 0.0f) {
+            new_pf = p_kw / s_kva;
+        }
+        if (dlms_meter_has(&m, DLMS_METER_ACTIVE_ENERGY)) { new_e_kwh = m.value[DLMS_METER_ACTIVE_ENERGY]; }
+        if (dlms_meter_has(&m, DLMS_METER_REACTIVE_ENERGY)) { new_e_kvarh = m.value[DLMS_METER_REACTIVE_ENERGY]; }
+        if (dlms_meter_has(&m, DLMS_METER_APPARENT_ENERGY)) { new_e_kvah = m.value[DLMS_METER_APPARENT_ENERGY]; }
+        // Not read from the meter
+#if CONFIG_PQ_CAPTURE_ENABLE
+        if (!have_pq) {
+            new_thd_v = 0.0f;
+        }
+#else
+        new_thd_v = 0.0f;
+#endif
+        new_thd_a = 0.0f;
+    }
+#endif
 
     bool update_instantaneous = do_periodic || (g_sm.dynamic_mode && do_fast_dyn);
     if (update_instantaneous) {
@@ -427,6 +618,9 @@ void smart_meter_object_update(anjay_t *anjay, const anjay_dm_object_def_t *cons
         g_sm.apparent_power_kva = s_kva;
         g_sm.thd_v = new_thd_v;
         g_sm.thd_a = new_thd_a;
+        if (!from_meter) {
+            sm_eval_rules(anjay);
+        }
     }
     if (do_periodic) {
         // Integrate energies sólo en el periodo principal
@@ -438,25 +632,29 @@ void smart_meter_object_update(anjay_t *anjay, const anjay_dm_object_def_t *cons
         ESP_LOGD(TAG_SM, "dyn update V=%.1f I=%.2f P=%.3f PF=%.3f", (double) g_sm.voltage_v, (double) g_sm.current_a, (double) g_sm.active_power_kw, (double) g_sm.power_factor);
     }
 
+    sm_publish_snapshot();
+
     if (do_periodic || (g_sm.dynamic_mode && do_fast_dyn)) {
         bool first = !g_sm.first_notify_done;
-#define SM_MAYBE_NOTIFY(RID_, CURR, LAST, DELTA) \
-    do { float _c = (CURR); if (first || fabsf(_c - (LAST)) >= (DELTA)) { (LAST) = _c; anjay_notify_changed(anjay, OID_SMART_METER, 0, (RID_)); } } while(0)
-        SM_MAYBE_NOTIFY(RID_TENSION, g_sm.voltage_v, g_sm.ln_voltage_v, SM_DELTA_VOLTAGE);
-        SM_MAYBE_NOTIFY(RID_CURRENT, g_sm.current_a, g_sm.ln_current_a, SM_DELTA_CURRENT);
-        SM_MAYBE_NOTIFY(RID_ACTIVE_POWER, g_sm.active_power_kw, g_sm.ln_active_power_kw, SM_DELTA_POWER);
-        SM_MAYBE_NOTIFY(RID_REACTIVE_POWER, g_sm.reactive_power_kvar, g_sm.ln_reactive_power_kvar, SM_DELTA_POWER);
-        SM_MAYBE_NOTIFY(RID_INDUCTIVE_REACTIVE_POWER, g_sm.inductive_reactive_power_kvar, g_sm.ln_inductive_reactive_power_kvar, SM_DELTA_POWER);
-        SM_MAYBE_NOTIFY(RID_CAPACITIVE_REACTIVE_POWER, g_sm.capacitive_reactive_power_kvar, g_sm.ln_capacitive_reactive_power_kvar, SM_DELTA_POWER);
-        SM_MAYBE_NOTIFY(RID_APPARENT_POWER, g_sm.apparent_power_kva, g_sm.ln_apparent_power_kva, SM_DELTA_POWER);
-        SM_MAYBE_NOTIFY(RID_POWER_FACTOR, g_sm.power_factor, g_sm.ln_power_factor, SM_DELTA_PF);
-        SM_MAYBE_NOTIFY(RID_THD_V, g_sm.thd_v, g_sm.ln_thd_v, SM_DELTA_THD);
-        SM_MAYBE_NOTIFY(RID_THD_A, g_sm.thd_a, g_sm.ln_thd_a, SM_DELTA_THD);
-        SM_MAYBE_NOTIFY(RID_FREQUENCY, g_sm.frequency_hz, g_sm.ln_frequency_hz, SM_DELTA_FREQ);
+#define SM_MAYBE_NOTIFY(RID_, CURR, FILTER) \
+    do { float _c = (CURR); \
+         if (first) { notify_filter_mark(&(FILTER), _c); } \
+         if (first || notify_filter_should_notify(anjay, &(FILTER), _c)) { anjay_notify_changed(anjay, OID_SMART_METER, 0, (RID_)); } } while(0)
+        SM_MAYBE_NOTIFY(RID_TENSION, g_sm.voltage_v, g_sm.nf_voltage_v);
+        SM_MAYBE_NOTIFY(RID_CURRENT, g_sm.current_a, g_sm.nf_current_a);
+        SM_MAYBE_NOTIFY(RID_ACTIVE_POWER, g_sm.active_power_kw, g_sm.nf_active_power_kw);
+        SM_MAYBE_NOTIFY(RID_REACTIVE_POWER, g_sm.reactive_power_kvar, g_sm.nf_reactive_power_kvar);
+        SM_MAYBE_NOTIFY(RID_INDUCTIVE_REACTIVE_POWER, g_sm.inductive_reactive_power_kvar, g_sm.nf_inductive_reactive_power_kvar);
+        SM_MAYBE_NOTIFY(RID_CAPACITIVE_REACTIVE_POWER, g_sm.capacitive_reactive_power_kvar, g_sm.nf_capacitive_reactive_power_kvar);
+        SM_MAYBE_NOTIFY(RID_APPARENT_POWER, g_sm.apparent_power_kva, g_sm.nf_apparent_power_kva);
+        SM_MAYBE_NOTIFY(RID_POWER_FACTOR, g_sm.power_factor, g_sm.nf_power_factor);
+        SM_MAYBE_NOTIFY(RID_THD_V, g_sm.thd_v, g_sm.nf_thd_v);
+        SM_MAYBE_NOTIFY(RID_THD_A, g_sm.thd_a, g_sm.nf_thd_a);
+        SM_MAYBE_NOTIFY(RID_FREQUENCY, g_sm.frequency_hz, g_sm.nf_frequency_hz);
         if (do_periodic) {
-            SM_MAYBE_NOTIFY(RID_ACTIVE_ENERGY, g_sm.active_energy_kwh, g_sm.ln_active_energy_kwh, SM_DELTA_ENERGY);
-            SM_MAYBE_NOTIFY(RID_REACTIVE_ENERGY, g_sm.reactive_energy_kvarh, g_sm.ln_reactive_energy_kvarh, SM_DELTA_ENERGY);
-            SM_MAYBE_NOTIFY(RID_APPARENT_ENERGY, g_sm.apparent_energy_kvah, g_sm.ln_apparent_energy_kvah, SM_DELTA_ENERGY);
+            SM_MAYBE_NOTIFY(RID_ACTIVE_ENERGY, g_sm.active_energy_kwh, g_sm.nf_active_energy_kwh);
+            SM_MAYBE_NOTIFY(RID_REACTIVE_ENERGY, g_sm.reactive_energy_kvarh, g_sm.nf_reactive_energy_kvarh);
+            SM_MAYBE_NOTIFY(RID_APPARENT_ENERGY, g_sm.apparent_energy_kvah, g_sm.nf_apparent_energy_kvah);
         }
         if (first) { g_sm.first_notify_done = true; }
 #undef SM_MAYBE_NOTIFY
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <anjay/anjay.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,6 +24,31 @@ const anjay_dm_object_def_t *const *smart_meter_object_create(void);
 void smart_meter_object_release(const anjay_dm_object_def_t *const *obj);
 void smart_meter_object_update(anjay_t *anjay, const anjay_dm_object_def_t *const *obj);
 
+// Copy of the measurements for readers outside the LwM2M task (Modbus TCP).
+// Published by the LwM2M task after every update under a sequence counter
+// (seqlock): readers never take a lock and never delay the writer; they retry
+// if an update overlapped their copy.
+typedef struct {
+    float voltage_v;
+    float current_a;
+    float active_power_kw;
+    float reactive_power_kvar;
+    float inductive_reactive_power_kvar;
+    float capacitive_reactive_power_kvar;
+    float apparent_power_kva;
+    float power_factor;
+    float thd_v;
+    float thd_a;
+    float frequency_hz;
+    float active_energy_kwh;
+    float reactive_energy_kvarh;
+    float apparent_energy_kvah;
+    uint32_t update_count; // increments with every published update
+} sm_snapshot_t;
+
+// Returns false if no snapshot has been published yet
+bool smart_meter_snapshot(sm_snapshot_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,25 @@
+#pragma once
+
+// Harness shared by the host tests: CHECK() reports a failed condition and
+// keeps going, check_report() prints the summary and is main()'s exit code.
+
+#include <stdio.h>
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                  \
+        }                                                                  \
+    } while (0)
+
+static inline int check_report(const char *suite) {
+    if (g_failures) {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All %s host tests passed\n", suite);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "i2c_stub.h"
+
+#include <string.h>
+
+static int stub_write(void *ctx, uint8_t addr, const uint8_t *data, size_t len) {
+    i2c_stub_t *stub = (i2c_stub_t *) ctx;
+    if (len > I2C_STUB_MAX_FRAME) {
+        return -1;
+    }
+    memcpy(stub->last_write, data, len);
+    stub->last_write_len = len;
+    stub->last_addr = addr;
+    stub->writes++;
+    return 0;
+}
+
+static int stub_read(void *ctx, uint8_t addr, uint8_t *data, size_t len) {
+    i2c_stub_t *stub = (i2c_stub_t *) ctx;
+    stub->last_addr = addr;
+    stub->reads++;
+    if (stub->rx_count == 0) {
+        return -1; // nothing scripted: behave like a NACK
+    }
+    i2c_stub_frame_t *frame = &stub->rx[stub->rx_head];
+    stub->rx_head = (stub->rx_head + 1) % I2C_STUB_MAX_QUEUE;
+    stub->rx_count--;
+    if (frame->nack || frame->len < len) {
+        return -1;
+    }
+    memcpy(data, frame->data, len);
+    return 0;
+}
+
+void i2c_stub_init(i2c_stub_t *stub, th_i2c_bus_t *bus) {
+    memset(stub, 0, sizeof(*stub));
+    bus->write = stub_write;
+    bus->read = stub_read;
+    bus->ctx = stub;
+}
+
+void i2c_stub_push(i2c_stub_t *stub, const uint8_t *data, size_t len, int nack) {
+    if (stub->rx_count == I2C_STUB_MAX_QUEUE || len > I2C_STUB_MAX_FRAME) {
+        return;
+    }
+    i2c_stub_frame_t *frame = &stub->rx[(stub->rx_head + stub->rx_count) % I2C_STUB_MAX_QUEUE];
+    if (data) {
+        memcpy(frame->data, data, len);
+    }
+    frame->len = len;
+    frame->nack = nack;
+    stub->rx_count++;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Scripted I2C bus for host-side tests of th_sensor.c: records every write and
+// answers reads from a FIFO of canned responses (or NACKs when empty).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "th_sensor.h"
+
+#define I2C_STUB_MAX_FRAME 16
+#define I2C_STUB_MAX_QUEUE 8
+
+typedef struct {
+    uint8_t data[I2C_STUB_MAX_FRAME];
+    size_t len;
+    int nack;
+} i2c_stub_frame_t;
+
+typedef struct {
+    // Last transaction written by the driver
+    uint8_t last_write[I2C_STUB_MAX_FRAME];
+    size_t last_write_len;
+    uint8_t last_addr;
+    unsigned writes;
+    unsigned reads;
+    // Responses consumed by successive reads
+    i2c_stub_frame_t rx[I2C_STUB_MAX_QUEUE];
+    size_t rx_head;
+    size_t rx_count;
+} i2c_stub_t;
+
+// Initializes the stub and fills *bus with callbacks bound to it
+void i2c_stub_init(i2c_stub_t *stub, th_i2c_bus_t *bus);
+
+// Queues one read response; nack != 0 makes that read fail
+void i2c_stub_push(i2c_stub_t *stub, const uint8_t *data, size_t len, int nack);
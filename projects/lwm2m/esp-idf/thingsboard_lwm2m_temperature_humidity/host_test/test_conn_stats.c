@@ -0,0 +1,99 @@
+// Host-side tests for conn_stats.c (Object 7 accumulation).
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "conn_stats.h"
+
+static conn_stats_raw_t raw_with(uint32_t tx_bytes, uint32_t drops, uint32_t max_packet) {
+    conn_stats_raw_t raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.raw[CONN_STATS_TX_BYTES] = tx_bytes;
+    raw.raw[CONN_STATS_LINK_DROPS] = drops;
+    raw.max_packet = max_packet;
+    return raw;
+}
+
+static void test_start_stop(void) {
+    conn_stats_t s;
+    conn_stats_init(&s, NULL);
+    conn_stats_raw_t raw = raw_with(1000, 0, 0);
+    conn_stats_sample(&s, &raw, 0); // prime: pre-existing traffic is not counted
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 0);
+
+    raw = raw_with(1500, 0, 200);
+    conn_stats_sample(&s, &raw, 100);
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 0); // not started yet
+    CHECK(s.max_packet == 0);
+
+    conn_stats_start(&s, 100);
+    raw = raw_with(2500, 0, 300);
+    conn_stats_sample(&s, &raw, 200);
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 1000);
+    CHECK(s.max_packet == 300);
+
+    conn_stats_stop(&s);
+    raw = raw_with(9000, 0, 1400);
+    conn_stats_sample(&s, &raw, 300);
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 1000); // frozen at Stop
+    CHECK(s.max_packet == 300);
+    CHECK(s.total[CONN_STATS_TX_BYTES] == 8000);            // totals keep running
+
+    conn_stats_start(&s, 300); // restart zeroes the reported values
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 0);
+    CHECK(s.max_packet == 0);
+}
+
+static void test_wrap(void) {
+    uint32_t mask[CONN_STATS_COUNT];
+    for (int i = 0; i < CONN_STATS_COUNT; i++) {
+        mask[i] = UINT32_MAX;
+    }
+    mask[CONN_STATS_LINK_DROPS] = 0xFFFF; // 16-bit lwIP STAT_COUNTER
+    conn_stats_t s;
+    conn_stats_init(&s, mask);
+
+    conn_stats_raw_t raw = raw_with(0xFFFFFF00u, 0xFFF0, 0);
+    conn_stats_sample(&s, &raw, 0);
+    conn_stats_start(&s, 0);
+    raw = raw_with(0x00000100u, 0x0010, 0);
+    conn_stats_sample(&s, &raw, 1000);
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 0x200);
+    CHECK(conn_stats_get(&s, CONN_STATS_LINK_DROPS) == 0x20);
+
+    // Many wraps of a 32-bit source accumulate past 4 GiB without loss
+    uint32_t v = 0x00000100u;
+    for (int i = 0; i < 10; i++) {
+        v += 0x80000000u;
+        raw = raw_with(v, 0x0010, 0);
+        conn_stats_sample(&s, &raw, 1000);
+    }
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 0x200 + 10ull * 0x80000000u);
+}
+
+static void test_period(void) {
+    conn_stats_t s;
+    conn_stats_init(&s, NULL);
+    conn_stats_raw_t raw = raw_with(0, 0, 0);
+    conn_stats_sample(&s, &raw, 0xFFFFF000u);
+    s.period_s = 10;
+    conn_stats_start(&s, 0xFFFFF000u); // ms clock wraps during the period
+
+    raw = raw_with(100, 0, 0);
+    conn_stats_sample(&s, &raw, 0xFFFFF000u + 9999u);
+    CHECK(s.running);
+    raw = raw_with(250, 0, 0);
+    conn_stats_sample(&s, &raw, 0xFFFFF000u + 10000u);
+    CHECK(!s.running);
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 250);
+    raw = raw_with(400, 0, 0);
+    conn_stats_sample(&s, &raw, 0xFFFFF000u + 11000u);
+    CHECK(conn_stats_get(&s, CONN_STATS_TX_BYTES) == 250);
+}
+
+int main(void) {
+    test_start_stop();
+    test_wrap();
+    test_period();
+    return check_report("conn_stats");
+}
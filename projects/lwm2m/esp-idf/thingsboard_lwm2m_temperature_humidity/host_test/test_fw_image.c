@@ -0,0 +1,152 @@
+// Host-side tests for fw_image.c (streaming app image parser).
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "fw_image.h"
+
+static uint8_t g_img[512];
+static size_t g_img_len;
+static size_t g_hashed_len;
+
+static void put_le32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t) (v >> (8 * i));
+    }
+}
+
+// Header + segments of the given sizes + checksum padding, then optionally the
+// 32-byte digest (filled with 0xD1) and a manifest carrying sig_len bytes
+static void build_image(const uint32_t *segs, int nsegs, bool hash_appended, size_t sig_len) {
+    memset(g_img, 0, sizeof(g_img));
+    g_img[0] = 0xE9;
+    g_img[1] = (uint8_t) nsegs;
+    g_img[23] = hash_appended ? 1 : 0;
+    size_t off = FW_IMAGE_HEADER_SIZE;
+    for (int i = 0; i < nsegs; i++) {
+        put_le32(&g_img[off], 0x42000000u + (uint32_t) i);
+        put_le32(&g_img[off + 4], segs[i]);
+        off += FW_IMAGE_SEGMENT_HEADER_SIZE;
+        memset(&g_img[off], 0xA0 + i, segs[i]);
+        off += segs[i];
+    }
+    g_hashed_len = (off + 1 + 15) & ~(size_t) 15;
+    off = g_hashed_len;
+    if (hash_appended) {
+        memset(&g_img[off], 0xD1, FW_IMAGE_DIGEST_SIZE);
+        off += FW_IMAGE_DIGEST_SIZE;
+    }
+    if (sig_len) {
+        memcpy(&g_img[off], FW_IMAGE_MANIFEST_MAGIC, 4);
+        g_img[off + 4] = FW_IMAGE_MANIFEST_VERSION;
+        g_img[off + 5] = (uint8_t) sig_len;
+        g_img[off + 6] = (uint8_t) (sig_len >> 8);
+        off += FW_IMAGE_MANIFEST_HEADER_SIZE;
+        memset(&g_img[off], 0x5A, sig_len);
+        off += sig_len;
+    }
+    g_img_len = off;
+}
+
+// Feeds g_img in chunks of the given size (0: one call); returns the total of
+// hashed bytes reported, or -1 on a parse error
+static long feed(fw_image_parser_t *p, size_t chunk) {
+    long hashed = 0;
+    fw_image_init(p);
+    for (size_t off = 0; off < g_img_len; off += chunk ? chunk : g_img_len) {
+        size_t n = chunk && g_img_len - off > chunk ? chunk : g_img_len - off;
+        int r = fw_image_feed(p, &g_img[off], n);
+        if (r < 0) {
+            return -1;
+        }
+        // Hashed bytes are always a prefix of the chunk
+        CHECK((size_t) r <= n);
+        CHECK(r == 0 || off + (size_t) r <= g_hashed_len);
+        hashed += r;
+    }
+    return hashed;
+}
+
+static void test_layout(void) {
+    const uint32_t segs[] = { 40, 3, 0, 101 };
+    build_image(segs, 4, true, 0);
+    for (size_t chunk = 0; chunk <= 9; chunk++) {
+        fw_image_parser_t p;
+        CHECK(feed(&p, chunk) == (long) g_hashed_len);
+        CHECK(fw_image_hashed_complete(&p));
+        CHECK(fw_image_digest_complete(&p));
+        CHECK(p.digest[0] == 0xD1 && p.digest[FW_IMAGE_DIGEST_SIZE - 1] == 0xD1);
+    }
+
+    // Without an appended hash the stream ends with the padding
+    build_image(segs, 4, false, 0);
+    fw_image_parser_t p;
+    CHECK(feed(&p, 7) == (long) g_hashed_len);
+    CHECK(fw_image_hashed_complete(&p));
+    CHECK(!fw_image_digest_complete(&p));
+
+    // Truncated inside a segment
+    build_image(segs, 4, true, 0);
+    g_img_len = FW_IMAGE_HEADER_SIZE + 20;
+    CHECK(feed(&p, 0) == (long) g_img_len);
+    CHECK(!fw_image_hashed_complete(&p));
+}
+
+static void test_malformed(void) {
+    const uint32_t segs[] = { 16 };
+    fw_image_parser_t p;
+    build_image(segs, 1, true, 0);
+    g_img[0] = 0xEA;
+    CHECK(feed(&p, 5) == -1);
+    // Stays failed after the first error
+    CHECK(fw_image_feed(&p, g_img, 1) == -1);
+
+    build_image(segs, 1, true, 0);
+    g_img[1] = 0; // no segments
+    CHECK(feed(&p, 0) == -1);
+    g_img[1] = FW_IMAGE_MAX_SEGMENTS + 1;
+    CHECK(feed(&p, 0) == -1);
+
+    build_image(segs, 1, true, 0);
+    put_le32(&g_img[FW_IMAGE_HEADER_SIZE + 4], 0x7FFFFFFF); // absurd segment length
+    CHECK(feed(&p, 3) == -1);
+}
+
+static void test_manifest(void) {
+    const uint32_t segs[] = { 30, 2 };
+    const uint8_t *sig = NULL;
+    size_t sig_len = 0;
+    fw_image_parser_t p;
+
+    build_image(segs, 2, true, 72);
+    for (size_t chunk = 0; chunk <= 5; chunk++) {
+        CHECK(feed(&p, chunk) == (long) g_hashed_len);
+        CHECK(fw_image_manifest_signature(&p, &sig, &sig_len) == 0);
+        CHECK(sig_len == 72 && sig[0] == 0x5A && sig[71] == 0x5A);
+    }
+
+    // Manifest directly after the padding when there is no appended hash
+    build_image(segs, 2, false, 8);
+    CHECK(feed(&p, 0) == (long) g_hashed_len);
+    CHECK(fw_image_manifest_signature(&p, &sig, &sig_len) == 0 && sig_len == 8);
+
+    // No manifest, truncated manifest, wrong magic
+    build_image(segs, 2, true, 0);
+    feed(&p, 0);
+    CHECK(fw_image_manifest_signature(&p, &sig, &sig_len) == -1);
+    build_image(segs, 2, true, 72);
+    g_img_len -= 1;
+    feed(&p, 0);
+    CHECK(fw_image_manifest_signature(&p, &sig, &sig_len) == -1);
+    build_image(segs, 2, true, 72);
+    g_img[g_hashed_len + FW_IMAGE_DIGEST_SIZE] = 'X';
+    feed(&p, 0);
+    CHECK(fw_image_manifest_signature(&p, &sig, &sig_len) == -1);
+}
+
+int main(void) {
+    test_layout();
+    test_malformed();
+    test_manifest();
+    return check_report("fw_image");
+}
@@ -0,0 +1,175 @@
+// Host-side tests for fw_package.c (compressed/delta firmware decoding).
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "fw_package.h"
+
+static uint8_t g_out[1024];
+static size_t g_out_len;
+static const char *g_base;
+
+static int sink(void *ctx, const uint8_t *data, size_t len) {
+    (void) ctx;
+    memcpy(&g_out[g_out_len], data, len);
+    g_out_len += len;
+    return 0;
+}
+
+static int base_read(void *ctx, uint32_t offset, void *dst, size_t len) {
+    (void) ctx;
+    if (offset + len > strlen(g_base)) {
+        return -1;
+    }
+    memcpy(dst, g_base + offset, len);
+    return 0;
+}
+
+static void make_header(uint8_t *hdr, uint8_t flags, uint32_t image_size, uint32_t base_size) {
+    memset(hdr, 0, FW_PKG_HEADER_SIZE);
+    memcpy(hdr, FW_PKG_MAGIC, 4);
+    hdr[4] = FW_PKG_VERSION;
+    hdr[5] = flags;
+    hdr[6] = 4; // window_bits
+    hdr[7] = 3; // lookahead_bits
+    for (int i = 0; i < 4; i++) {
+        hdr[8 + i] = (uint8_t) (image_size >> (8 * i));
+        hdr[12 + i] = (uint8_t) (base_size >> (8 * i));
+    }
+}
+
+// MSB-first bit writer, as produced by heatshrink / tools/fw_package.py
+typedef struct {
+    uint8_t buf[256];
+    size_t len;
+    uint32_t acc;
+    int n;
+} bits_t;
+
+static void put_bits(bits_t *b, uint32_t v, int count) {
+    b->acc = (b->acc << count) | v;
+    b->n += count;
+    while (b->n >= 8) {
+        b->n -= 8;
+        b->buf[b->len++] = (uint8_t) (b->acc >> b->n);
+    }
+}
+
+static void put_literal(bits_t *b, uint8_t c) {
+    put_bits(b, 1, 1);
+    put_bits(b, c, 8);
+}
+
+static void finish_bits(bits_t *b) {
+    if (b->n) {
+        b->buf[b->len++] = (uint8_t) (b->acc << (8 - b->n));
+        b->n = 0;
+    }
+}
+
+// Decodes payload split into chunks of the given size (0: one call)
+static int decode(const uint8_t *hdr_bytes, const uint8_t *payload, size_t len, size_t chunk) {
+    fw_pkg_header_t hdr;
+    fw_pkg_decoder_t d;
+    g_out_len = 0;
+    int result = fw_pkg_parse_header(hdr_bytes, &hdr);
+    if (!result) {
+        result = fw_pkg_decoder_init(&d, &hdr, sink, NULL, base_read, NULL);
+    }
+    if (result) {
+        return result;
+    }
+    for (size_t off = 0; !result && off < len; off += chunk ? chunk : len) {
+        size_t n = chunk && len - off > chunk ? chunk : len - off;
+        result = fw_pkg_decoder_feed(&d, payload + off, n);
+    }
+    if (!result) {
+        result = fw_pkg_decoder_finish(&d);
+    }
+    fw_pkg_decoder_free(&d);
+    return result;
+}
+
+static void test_header(void) {
+    uint8_t hdr[FW_PKG_HEADER_SIZE];
+    fw_pkg_header_t h;
+    make_header(hdr, FW_PKG_FLAG_COMPRESSED, 10, 0);
+    CHECK(fw_pkg_parse_header(hdr, &h) == FW_PKG_OK);
+    CHECK(h.image_size == 10 && h.window_bits == 4 && h.lookahead_bits == 3);
+
+    hdr[0] = 0xE9;
+    CHECK(fw_pkg_parse_header(hdr, &h) == FW_PKG_ERR_FORMAT);
+    make_header(hdr, 0x80, 10, 0); // unknown flag
+    CHECK(fw_pkg_parse_header(hdr, &h) == FW_PKG_ERR_FORMAT);
+    make_header(hdr, FW_PKG_FLAG_COMPRESSED, 10, 0);
+    hdr[6] = FW_PKG_MAX_WINDOW_BITS + 1;
+    CHECK(fw_pkg_parse_header(hdr, &h) == FW_PKG_ERR_FORMAT);
+    make_header(hdr, FW_PKG_FLAG_DELTA, 10, 0); // delta without a base
+    CHECK(fw_pkg_parse_header(hdr, &h) == FW_PKG_ERR_FORMAT);
+}
+
+static void test_lzss(void) {
+    // "abc" + backref(distance 3, length 9) + "X"
+    bits_t b = { 0 };
+    put_literal(&b, 'a');
+    put_literal(&b, 'b');
+    put_literal(&b, 'c');
+    put_bits(&b, 0, 1);
+    put_bits(&b, 3 - 1, 4);
+    put_bits(&b, 8 - 1, 3); // lookahead_bits = 3 caps a reference at 8 bytes
+    put_bits(&b, 0, 1);
+    put_bits(&b, 3 - 1, 4);
+    put_bits(&b, 1 - 1, 3);
+    put_literal(&b, 'X');
+    finish_bits(&b);
+
+    uint8_t hdr[FW_PKG_HEADER_SIZE];
+    make_header(hdr, FW_PKG_FLAG_COMPRESSED, 13, 0);
+    for (size_t chunk = 0; chunk <= 3; chunk++) {
+        CHECK(decode(hdr, b.buf, b.len, chunk) == FW_PKG_OK);
+        CHECK(g_out_len == 13 && memcmp(g_out, "abcabcabcabcX", 13) == 0);
+    }
+    // Truncated stream: finish reports a short image
+    CHECK(decode(hdr, b.buf, b.len - 2, 0) == FW_PKG_ERR_FORMAT);
+    // More output than announced
+    make_header(hdr, FW_PKG_FLAG_COMPRESSED, 12, 0);
+    CHECK(decode(hdr, b.buf, b.len, 0) == FW_PKG_ERR_FORMAT);
+}
+
+// seek +2, diff "\0\0\0\0" -> "2345", extra "XY"; seek +1, diff +1 x3 -> "89:"
+static const uint8_t DELTA_PATCH[] = { 4, 4, 2, 0, 0, 0, 0, 'X', 'Y', 2, 3, 0, 1, 1, 1 };
+
+static void test_delta(void) {
+    uint8_t hdr[FW_PKG_HEADER_SIZE];
+    g_base = "0123456789";
+    make_header(hdr, FW_PKG_FLAG_DELTA, 9, 10);
+    for (size_t chunk = 0; chunk <= 2; chunk++) {
+        CHECK(decode(hdr, DELTA_PATCH, sizeof(DELTA_PATCH), chunk) == FW_PKG_OK);
+        CHECK(g_out_len == 9 && memcmp(g_out, "2345XY89:", 9) == 0);
+    }
+
+    // Same patch, LZSS-wrapped with literals only
+    bits_t b = { 0 };
+    for (size_t i = 0; i < sizeof(DELTA_PATCH); i++) {
+        put_literal(&b, DELTA_PATCH[i]);
+    }
+    finish_bits(&b);
+    make_header(hdr, FW_PKG_FLAG_DELTA | FW_PKG_FLAG_COMPRESSED, 9, 10);
+    CHECK(decode(hdr, b.buf, b.len, 1) == FW_PKG_OK);
+    CHECK(g_out_len == 9 && memcmp(g_out, "2345XY89:", 9) == 0);
+
+    // Seeking past the base is rejected, not read out of bounds
+    const uint8_t past_end[] = { 20, 1, 0, 0 };
+    make_header(hdr, FW_PKG_FLAG_DELTA, 1, 10);
+    CHECK(decode(hdr, past_end, sizeof(past_end), 0) == FW_PKG_ERR_BASE);
+    // Negative seek (zigzag 3 = -2) from the start
+    const uint8_t before_start[] = { 3, 1, 0, 0 };
+    CHECK(decode(hdr, before_start, sizeof(before_start), 0) == FW_PKG_ERR_BASE);
+}
+
+int main(void) {
+    test_header();
+    test_lzss();
+    test_delta();
+    return check_report("fw_package");
+}
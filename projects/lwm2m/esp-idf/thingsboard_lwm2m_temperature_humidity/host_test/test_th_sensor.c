@@ -0,0 +1,128 @@
+// Host-side tests for the portable sensor code (th_sensor.c, sensor_cache.c).
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "i2c_stub.h"
+#include "sensor_cache.h"
+#include "th_sensor.h"
+
+#define CHECK_NEAR(a, b, eps) CHECK(fabsf((a) - (b)) <= (eps))
+
+static void test_crc8(void) {
+    // Sensirion datasheet example: CRC(0xBEEF) = 0x92
+    const uint8_t data[] = { 0xBE, 0xEF };
+    CHECK(th_sensor_crc8(data, sizeof(data)) == 0x92);
+}
+
+static void sht3x_frame(uint16_t raw_t, uint16_t raw_rh, uint8_t out[6]) {
+    out[0] = (uint8_t) (raw_t >> 8);
+    out[1] = (uint8_t) raw_t;
+    out[2] = th_sensor_crc8(&out[0], 2);
+    out[3] = (uint8_t) (raw_rh >> 8);
+    out[4] = (uint8_t) raw_rh;
+    out[5] = th_sensor_crc8(&out[3], 2);
+}
+
+static void test_sht3x(void) {
+    i2c_stub_t stub;
+    th_i2c_bus_t bus;
+    i2c_stub_init(&stub, &bus);
+    th_sensor_t dev = { .model = TH_SENSOR_SHT3X, .addr = 0x44, .bus = &bus };
+
+    CHECK(th_sensor_init(&dev) == TH_SENSOR_OK);
+    CHECK(th_sensor_trigger(&dev) == TH_SENSOR_OK);
+    CHECK(stub.last_write_len == 2 && stub.last_write[0] == 0x24 && stub.last_write[1] == 0x00);
+    CHECK(stub.last_addr == 0x44);
+    CHECK(th_sensor_conversion_ms(&dev) >= 15);
+
+    float t = 0.0f, rh = 0.0f;
+    // Read NACK while converting -> busy, not an error
+    i2c_stub_push(&stub, NULL, 0, 1);
+    CHECK(th_sensor_collect(&dev, &t, &rh) == TH_SENSOR_BUSY);
+
+    uint8_t frame[6];
+    sht3x_frame(0x6666, 0x8000, frame); // 25.0 C, 50.0 %RH
+    i2c_stub_push(&stub, frame, sizeof(frame), 0);
+    CHECK(th_sensor_collect(&dev, &t, &rh) == TH_SENSOR_OK);
+    CHECK_NEAR(t, 25.0f, 0.01f);
+    CHECK_NEAR(rh, 50.0f, 0.01f);
+
+    frame[5] ^= 0x01; // corrupt humidity CRC
+    i2c_stub_push(&stub, frame, sizeof(frame), 0);
+    CHECK(th_sensor_collect(&dev, &t, &rh) == TH_SENSOR_ERR);
+}
+
+static void aht20_frame(uint8_t status, uint32_t raw_rh, uint32_t raw_t, uint8_t out[7]) {
+    out[0] = status;
+    out[1] = (uint8_t) (raw_rh >> 12);
+    out[2] = (uint8_t) (raw_rh >> 4);
+    out[3] = (uint8_t) (((raw_rh & 0x0F) << 4) | ((raw_t >> 16) & 0x0F));
+    out[4] = (uint8_t) (raw_t >> 8);
+    out[5] = (uint8_t) raw_t;
+    out[6] = th_sensor_crc8(out, 6);
+}
+
+static void test_aht20(void) {
+    i2c_stub_t stub;
+    th_i2c_bus_t bus;
+    i2c_stub_init(&stub, &bus);
+    th_sensor_t dev = { .model = TH_SENSOR_AHT20, .addr = 0x38, .bus = &bus };
+
+    // Not calibrated -> init command is sent
+    const uint8_t uncal = 0x00;
+    i2c_stub_push(&stub, &uncal, 1, 0);
+    CHECK(th_sensor_init(&dev) == TH_SENSOR_OK);
+    CHECK(stub.last_write_len == 3 && stub.last_write[0] == 0xBE);
+
+    CHECK(th_sensor_trigger(&dev) == TH_SENSOR_OK);
+    CHECK(stub.last_write_len == 3 && stub.last_write[0] == 0xAC && stub.last_write[1] == 0x33);
+
+    float t = 0.0f, rh = 0.0f;
+    uint8_t frame[7];
+    aht20_frame(0x80 | 0x08, 0, 0, frame); // busy bit set
+    i2c_stub_push(&stub, frame, sizeof(frame), 0);
+    CHECK(th_sensor_collect(&dev, &t, &rh) == TH_SENSOR_BUSY);
+
+    aht20_frame(0x08, 0x80000, 0x60000, frame); // 50 %RH, 25 C
+    i2c_stub_push(&stub, frame, sizeof(frame), 0);
+    CHECK(th_sensor_collect(&dev, &t, &rh) == TH_SENSOR_OK);
+    CHECK_NEAR(rh, 50.0f, 0.01f);
+    CHECK_NEAR(t, 25.0f, 0.01f);
+
+    // Bus failure surfaces as an error
+    CHECK(th_sensor_collect(&dev, &t, &rh) == TH_SENSOR_ERR);
+}
+
+static void test_cache(void) {
+    sensor_cache_t cache = SENSOR_CACHE_INITIALIZER;
+    sensor_sample_t s;
+    CHECK(!sensor_cache_read(&cache, &s));
+    CHECK(!sensor_sample_is_fresh(&s, 0, 1000));
+
+    sensor_cache_publish(&cache, 21.5f, 40.0f, 1000);
+    CHECK(sensor_cache_read(&cache, &s));
+    CHECK(s.seq == 1);
+    CHECK_NEAR(s.temperature_c, 21.5f, 0.0001f);
+    CHECK(sensor_sample_is_fresh(&s, 1500, 1000));
+    CHECK(!sensor_sample_is_fresh(&s, 2001, 1000));
+
+    sensor_cache_publish(&cache, 22.0f, 41.0f, 2000);
+    CHECK(sensor_cache_read(&cache, &s));
+    CHECK(s.seq == 2 && s.timestamp_ms == 2000);
+
+    // Millisecond clock wrap must not turn an old sample into a fresh one
+    sensor_cache_publish(&cache, 22.0f, 41.0f, 0xFFFFFF00u);
+    CHECK(sensor_cache_read(&cache, &s));
+    CHECK(sensor_sample_is_fresh(&s, 0x00000010u, 1000));
+    CHECK(!sensor_sample_is_fresh(&s, 0x00001000u, 1000));
+}
+
+int main(void) {
+    test_crc8();
+    test_sht3x();
+    test_aht20();
+    test_cache();
+    return check_report("th_sensor");
+}
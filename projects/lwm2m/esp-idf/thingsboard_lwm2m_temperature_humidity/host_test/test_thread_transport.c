@@ -0,0 +1,118 @@
+// Host-side tests for thread_transport.c (6LoWPAN frame planning, poll periods).
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "thread_transport.h"
+
+static void test_frames(void) {
+    const thread_link_t link = THREAD_LINK_DEFAULT(false, 1);
+    // 106 - 33 bytes fit unfragmented
+    CHECK(thread_transport_frames(&link, 0) == 1);
+    CHECK(thread_transport_frames(&link, 73) == 1);
+    CHECK(thread_transport_frames(&link, 74) == 2);
+    // FRAG1 carries 64 (8-aligned), the last FRAGN up to 101, middle ones 96
+    CHECK(thread_transport_frames(&link, 165) == 2);
+    CHECK(thread_transport_frames(&link, 166) == 3);
+    CHECK(thread_transport_frames(&link, 261) == 3);
+    CHECK(thread_transport_frames(&link, 262) == 4);
+    // A Wi-Fi sized 1024-byte block needs a dozen transmissions
+    CHECK(thread_transport_frames(&link, 24 + 1024) == 12);
+
+    // The planned payload is exactly the frame budget
+    for (uint8_t n = 1; n <= 12; n++) {
+        const thread_link_t l = THREAD_LINK_DEFAULT(false, n);
+        const size_t max = thread_transport_max_udp_payload(&l);
+        CHECK(thread_transport_frames(&l, max) <= n);
+        CHECK(thread_transport_frames(&l, max + 1) > n);
+    }
+    for (size_t p = 1; p < 1200; p++) {
+        CHECK(thread_transport_frames(&link, p) <= thread_transport_frames(&link, p + 1));
+    }
+}
+
+static void test_block_size(void) {
+    const thread_link_t plain1 = THREAD_LINK_DEFAULT(false, 1);
+    const thread_link_t secure1 = THREAD_LINK_DEFAULT(true, 1);
+    const thread_link_t plain2 = THREAD_LINK_DEFAULT(false, 2);
+    const thread_link_t secure2 = THREAD_LINK_DEFAULT(true, 2);
+    const thread_link_t plain12 = THREAD_LINK_DEFAULT(false, 12);
+    // One frame holds a 32-byte block, but never a Register
+    CHECK(thread_transport_block_size(&plain1) == 0);
+    CHECK(thread_transport_block_size(&secure1) == 0);
+    CHECK(thread_transport_block_size(&plain2) == 128);
+    CHECK(thread_transport_block_size(&secure2) == 64);
+    CHECK(thread_transport_block_size(&plain12) == 1024);
+    // The chosen block really fits its frame budget
+    CHECK(thread_transport_frames(&secure2, THREAD_DTLS_OVERHEAD + THREAD_COAP_OVERHEAD + 64) <= 2);
+
+    // MTU as avs_coap sees it: uncompressed headers plus the planned payload
+    CHECK(thread_transport_forced_mtu(&plain1) == 0);
+    CHECK(thread_transport_forced_mtu(&plain2) == 48 + 165);
+
+    // No block fits: the MTU is left alone
+    const thread_link_t tiny = { 60, THREAD_IP_HEADER, THREAD_DTLS_OVERHEAD, THREAD_COAP_OVERHEAD, 1 };
+    CHECK(thread_transport_block_size(&tiny) == 0);
+    CHECK(thread_transport_forced_mtu(&tiny) == 0);
+}
+
+// Encoded size of a CoAP option: header byte, extended delta/length, value
+static size_t coap_option(unsigned delta, size_t len) {
+    return 1 + (delta >= 269 ? 2 : delta >= 13 ? 1 : 0) + (len >= 269 ? 2 : len >= 13 ? 1 : 0) + len;
+}
+
+static void test_register_fits(void) {
+    const char *const queries[] = { "ep=ESP32C6-0123456789AB0123456789AB", "lt=86400", "lwm2m=1.1", "b=U" };
+    size_t header = 4 + 8;            // CoAP header, 8-byte token
+    header += coap_option(11, 2);     // Uri-Path "rd"
+    header += coap_option(1, 1);      // Content-Format 40 (link-format)
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        header += coap_option(i ? 0 : 3, strlen(queries[i])); // Uri-Query (15)
+    }
+    header += coap_option(12, 1);     // Block1 (27)
+    header += 1;                      // payload marker
+    CHECK(header <= THREAD_REGISTER_OVERHEAD);
+
+    // The default budget (2 frames) carries it with a 16-byte Block1 over DTLS
+    const thread_link_t secure2 = THREAD_LINK_DEFAULT(true, 2);
+    CHECK(thread_transport_frames(&secure2, THREAD_DTLS_OVERHEAD + header + 16) <= 2);
+    CHECK(thread_transport_block_size(&secure2) > 0);
+    // ...and one frame does not, so no budget of 1 is ever planned
+    const thread_link_t plain1 = THREAD_LINK_DEFAULT(false, 1);
+    CHECK(thread_transport_frames(&plain1, header + 16) > 1);
+}
+
+static void test_poll_period(void) {
+    CHECK(thread_transport_poll_period_ms(5, 10, 1000, 60000) == 5000);
+    CHECK(thread_transport_poll_period_ms(0, 10, 1000, 60000) == 5000);
+    CHECK(thread_transport_poll_period_ms(0, 0, 1000, 60000) == 1000);
+    CHECK(thread_transport_poll_period_ms(0, 1, 1000, 60000) == 1000);
+    CHECK(thread_transport_poll_period_ms(300, 900, 1000, 60000) == 60000);
+    CHECK(thread_transport_poll_period_ms(UINT32_MAX, UINT32_MAX, 1000, 60000) == 60000);
+}
+
+static void test_frame_ratio(void) {
+    const thread_frame_counters_t prev = { 100, 5, 50, 10, 10 };
+    const thread_frame_counters_t now = { 130, 8, 70, 25, 20 };
+    thread_frame_ratio_t r;
+    thread_transport_frame_ratio(&prev, &now, &r);
+    CHECK(r.tx_messages == 20 && r.rx_messages == 10);
+    CHECK(r.tx_frames_x100 == 150 && r.tx_retries_x100 == 15 && r.rx_frames_x100 == 150);
+
+    // Counters wrap; an idle direction reports 0
+    const thread_frame_counters_t before = { 0xFFFFFFF0u, 0, 0xFFFFFFFFu, 7, 3 };
+    const thread_frame_counters_t after = { 0x0000000Eu, 0, 0x00000002u, 7, 3 };
+    thread_transport_frame_ratio(&before, &after, &r);
+    CHECK(r.tx_messages == 3 && r.tx_frames_x100 == 1000);
+    CHECK(r.rx_messages == 0 && r.rx_frames_x100 == 0);
+}
+
+int main(void) {
+    test_frames();
+    test_block_size();
+    test_register_fits();
+    test_poll_period();
+    test_frame_ratio();
+    return check_report("thread_transport");
+}
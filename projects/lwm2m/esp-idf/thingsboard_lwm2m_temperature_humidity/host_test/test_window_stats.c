@@ -0,0 +1,110 @@
+// Host-side tests for window_stats.c against a brute-force reference.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "window_stats.h"
+
+#define CHECK_NEAR(a, b, eps) CHECK(fabs((double) (a) - (double) (b)) <= (eps))
+
+static window_result_t reference(const float *v, size_t n) {
+    window_result_t r = { 0 };
+    double sum = 0.0;
+    r.min = v[0];
+    r.max = v[0];
+    for (size_t i = 0; i < n; ++i) {
+        sum += v[i];
+        if (v[i] < r.min) r.min = v[i];
+        if (v[i] > r.max) r.max = v[i];
+    }
+    double mean = sum / n, m2 = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        m2 += (v[i] - mean) * (v[i] - mean);
+    }
+    r.mean = (float) mean;
+    r.stddev = (float) sqrt(m2 / n);
+    r.count = (uint32_t) n;
+    return r;
+}
+
+static float sample(unsigned i) {
+    // Sensor-like signal: slow drift plus pseudo-random noise
+    return 22.0f + 3.0f * sinf((float) i / 50.0f) + (float) (rand() % 1000) / 1000.0f;
+}
+
+static void test_sliding(void) {
+    static window_stats_t w;
+    static float hist[5000];
+    const uint16_t len = 60;
+    window_result_t r;
+    window_stats_init(&w, WINDOW_SLIDING, len);
+    CHECK(!window_stats_result(&w, &r));
+    for (unsigned i = 0; i < 5000; ++i) {
+        hist[i] = sample(i);
+        CHECK(window_stats_add(&w, hist[i]));
+        size_t n = i + 1 < len ? i + 1 : len;
+        window_result_t ref = reference(&hist[i + 1 - n], n);
+        CHECK(window_stats_result(&w, &r));
+        CHECK(r.count == ref.count);
+        CHECK_NEAR(r.mean, ref.mean, 1e-3);
+        CHECK_NEAR(r.stddev, ref.stddev, 1e-3);
+        CHECK(r.min == ref.min);
+        CHECK(r.max == ref.max);
+    }
+}
+
+static void test_sliding_monotonic(void) {
+    // Strictly increasing then decreasing input exercises both deques' evictions
+    static window_stats_t w;
+    window_result_t r;
+    window_stats_init(&w, WINDOW_SLIDING, 5);
+    for (int i = 0; i < 10; ++i) {
+        window_stats_add(&w, (float) i);
+    }
+    CHECK(window_stats_result(&w, &r));
+    CHECK(r.min == 5.0f && r.max == 9.0f && r.count == 5);
+    for (int i = 10; i > 0; --i) {
+        window_stats_add(&w, (float) i);
+    }
+    CHECK(window_stats_result(&w, &r));
+    CHECK(r.min == 1.0f && r.max == 5.0f);
+}
+
+static void test_tumbling(void) {
+    static window_stats_t w;
+    float hist[30];
+    window_result_t r;
+    window_stats_init(&w, WINDOW_TUMBLING, 30);
+    for (unsigned round = 0; round < 3; ++round) {
+        for (unsigned i = 0; i < 30; ++i) {
+            hist[i] = sample(round * 30 + i);
+            bool closed = window_stats_add(&w, hist[i]);
+            CHECK(closed == (i == 29));
+            CHECK(window_stats_result(&w, &r) == (round > 0 || i == 29));
+        }
+        window_result_t ref = reference(hist, 30);
+        CHECK(window_stats_result(&w, &r));
+        CHECK(r.count == 30);
+        CHECK_NEAR(r.mean, ref.mean, 1e-4);
+        CHECK_NEAR(r.stddev, ref.stddev, 1e-4);
+        CHECK(r.min == ref.min && r.max == ref.max);
+    }
+}
+
+static void test_length_clamp(void) {
+    static window_stats_t w;
+    window_stats_init(&w, WINDOW_SLIDING, 0);
+    CHECK(w.length == 1);
+    window_stats_init(&w, WINDOW_SLIDING, 60000);
+    CHECK(w.length == WINDOW_STATS_CAPACITY);
+}
+
+int main(void) {
+    srand(1234);
+    test_sliding();
+    test_sliding_monotonic();
+    test_tumbling();
+    test_length_clamp();
+    return check_report("window_stats");
+}
@@ -4,6 +4,8 @@
 #include <esp_log.h>
 #include <anjay/io.h>
 #include <stdint.h>
+#include "sdkconfig.h"
+#include "blob_store.h"
 
 #define OID_BAC 19
 #define RID_DATA 0
@@ -15,6 +17,19 @@
 #define IID_FW 65533
 #define IID_SW 65534
 
+#define BAC_PARTITION_LABEL "bac19"
+
+#ifndef CONFIG_BAC19_FW_DATA_MAX_KB
+#define CONFIG_BAC19_FW_DATA_MAX_KB 60
+#endif
+#ifndef CONFIG_BAC19_SW_DATA_MAX_KB
+#define CONFIG_BAC19_SW_DATA_MAX_KB 60
+#endif
+
+#ifndef ANJAY_ERR_REQUEST_ENTITY_TOO_LARGE
+#define ANJAY_ERR_REQUEST_ENTITY_TOO_LARGE (-((4 << 5) + 13)) // CoAP 4.13
+#endif
+
 static const char *TAG_BAC = "bac19";
 
 typedef struct blob_buf_s {
@@ -25,7 +40,9 @@ typedef struct blob_buf_s {
 
 typedef struct entry_s {
     anjay_iid_t iid;
-    blob_buf_t data;
+    blob_slot_t slot;   // Data in the flash partition
+    blob_buf_t data;    // Data in RAM, only without the partition
+    uint32_t max_size;
     char *desc;
     char *fmt;
     char *appid;
@@ -75,6 +92,12 @@ static int bac_read(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
     if (!e) return ANJAY_ERR_NOT_FOUND;
     switch (rid) {
     case RID_DATA: {
+        size_t len = 0;
+        // Straight from the flash mapping, no copy on the heap
+        const uint8_t *data = blob_store_data(&e->slot, &len);
+        if (data) {
+            return anjay_ret_bytes(ctx, data, len);
+        }
         if (e->data.ptr && e->data.size > 0) {
             return anjay_ret_bytes(ctx, e->data.ptr, e->data.size);
         }
@@ -93,6 +116,86 @@ static int bac_read(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
     }
 }
 
+// Streams the payload into the instance's flash slot in 512-byte chunks
+static int write_data_flash(entry_t *e, anjay_input_ctx_t *ctx) {
+    if (blob_store_begin(&e->slot)) {
+        return ANJAY_ERR_INTERNAL;
+    }
+    uint8_t buf[512];
+    bool finished = false;
+    do {
+        size_t bytes_read = 0;
+        int res = anjay_get_bytes(ctx, &bytes_read, &finished, buf, sizeof(buf));
+        if (res) {
+            return res;
+        }
+        if (bytes_read > 0) {
+            res = blob_store_append(&e->slot, buf, bytes_read);
+            if (res == BLOB_STORE_ERR_FULL) {
+                ESP_LOGW(TAG_BAC, "BAC19[%u]: data exceeds %u bytes", (unsigned) e->iid, (unsigned) e->slot.capacity);
+                return ANJAY_ERR_REQUEST_ENTITY_TOO_LARGE;
+            }
+            if (res) {
+                return ANJAY_ERR_INTERNAL;
+            }
+        }
+    } while (!finished);
+    if (blob_store_commit(&e->slot)) {
+        return ANJAY_ERR_INTERNAL;
+    }
+    ESP_LOGI(TAG_BAC, "BAC19[%u]: stored %u bytes in flash", (unsigned) e->iid, (unsigned) e->slot.size);
+    return 0;
+}
+
+// Fallback for partition tables without the bac19 partition
+static int write_data_ram(entry_t *e, anjay_input_ctx_t *ctx) {
+    // reset buffer
+    if (e->data.ptr) {
+        free(e->data.ptr);
+        e->data.ptr = NULL;
+        e->data.size = 0;
+        e->data.capacity = 0;
+    }
+    uint8_t buf[512];
+    bool finished = false;
+    do {
+        size_t bytes_read = 0;
+        int res = anjay_get_bytes(ctx, &bytes_read, &finished, buf, sizeof(buf));
+        if (res) {
+            return res;
+        }
+        if (bytes_read > 0) {
+            if (e->data.size + bytes_read > e->max_size) {
+                ESP_LOGW(TAG_BAC, "BAC19[%u]: data exceeds %u bytes", (unsigned) e->iid, (unsigned) e->max_size);
+                free(e->data.ptr);
+                e->data.ptr = NULL;
+                e->data.size = e->data.capacity = 0;
+                return ANJAY_ERR_REQUEST_ENTITY_TOO_LARGE;
+            }
+            // ensure capacity
+            if (e->data.size + bytes_read > e->data.capacity) {
+                size_t new_cap = e->data.capacity ? e->data.capacity : 512;
+                while (new_cap < e->data.size + bytes_read) {
+                    new_cap *= 2;
+                }
+                if (new_cap > e->max_size) {
+                    new_cap = e->max_size;
+                }
+                void *np = realloc(e->data.ptr, new_cap);
+                if (!np) {
+                    return ANJAY_ERR_INTERNAL;
+                }
+                e->data.ptr = (uint8_t *) np;
+                e->data.capacity = new_cap;
+            }
+            memcpy(e->data.ptr + e->data.size, buf, bytes_read);
+            e->data.size += bytes_read;
+        }
+    } while (!finished);
+    ESP_LOGI(TAG_BAC, "BAC19[%u]: received %zu bytes", (unsigned) e->iid, (size_t) e->data.size);
+    return 0;
+}
+
 static int bac_write(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                  anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
                  anjay_input_ctx_t *ctx) {
@@ -101,43 +204,8 @@ static int bac_write(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
     entry_t *e = find_entry(obj, iid);
     if (!e) return ANJAY_ERR_NOT_FOUND;
     switch (rid) {
-    case RID_DATA: {
-        // reset buffer
-        if (e->data.ptr) {
-            free(e->data.ptr);
-            e->data.ptr = NULL;
-            e->data.size = 0;
-            e->data.capacity = 0;
-        }
-        uint8_t buf[512];
-        bool finished = false;
-        do {
-            size_t bytes_read = 0;
-            int res = anjay_get_bytes(ctx, &bytes_read, &finished, buf, sizeof(buf));
-            if (res) {
-                return res;
-            }
-            if (bytes_read > 0) {
-                // ensure capacity
-                if (e->data.size + bytes_read > e->data.capacity) {
-                    size_t new_cap = e->data.capacity ? e->data.capacity : 512;
-                    while (new_cap < e->data.size + bytes_read) {
-                        new_cap *= 2;
-                    }
-                    void *np = realloc(e->data.ptr, new_cap);
-                    if (!np) {
-                        return ANJAY_ERR_INTERNAL;
-                    }
-                    e->data.ptr = (uint8_t *) np;
-                    e->data.capacity = new_cap;
-                }
-                memcpy(e->data.ptr + e->data.size, buf, bytes_read);
-                e->data.size += bytes_read;
-            }
-        } while (!finished);
-        ESP_LOGI(TAG_BAC, "BAC19[%u]: received %zu bytes", (unsigned) iid, (size_t) e->data.size);
-        return 0;
-    }
+    case RID_DATA:
+        return blob_store_ready() ? write_data_flash(e, ctx) : write_data_ram(e, ctx);
     case RID_DATA_CT: {
         int64_t v = 0;
         int res = anjay_get_i64(ctx, &v);
@@ -189,11 +257,22 @@ static const anjay_dm_object_def_t OBJ_DEF = {
 
 static bac_ctx_t g_bac = {
     .def = &OBJ_DEF,
-    .fw = { .iid = IID_FW, .data = { .ptr = NULL, .size = 0, .capacity = 0 }, .desc = NULL, .fmt = NULL, .appid = NULL, .ctime = 0 },
-    .sw = { .iid = IID_SW, .data = { .ptr = NULL, .size = 0, .capacity = 0 }, .desc = NULL, .fmt = NULL, .appid = NULL, .ctime = 0 }
+    .fw = { .iid = IID_FW, .data = { .ptr = NULL, .size = 0, .capacity = 0 }, .max_size = CONFIG_BAC19_FW_DATA_MAX_KB * 1024, .desc = NULL, .fmt = NULL, .appid = NULL, .ctime = 0 },
+    .sw = { .iid = IID_SW, .data = { .ptr = NULL, .size = 0, .capacity = 0 }, .max_size = CONFIG_BAC19_SW_DATA_MAX_KB * 1024, .desc = NULL, .fmt = NULL, .appid = NULL, .ctime = 0 }
 };
 
 const anjay_dm_object_def_t **bac19_object_create(void) {
+    // One flash slot per instance; Data written earlier survives a reboot
+    if (blob_store_init(BAC_PARTITION_LABEL) == 0
+            && blob_store_slot(&g_bac.fw.slot, 0, 2, g_bac.fw.max_size) == 0
+            && blob_store_slot(&g_bac.sw.slot, 1, 2, g_bac.sw.max_size) == 0) {
+        ESP_LOGI(TAG_BAC, "BAC19 data in flash: %u/%u and %u/%u bytes used",
+                 (unsigned) g_bac.fw.slot.size, (unsigned) g_bac.fw.slot.capacity,
+                 (unsigned) g_bac.sw.slot.size, (unsigned) g_bac.sw.slot.capacity);
+    } else {
+        blob_store_deinit();
+        ESP_LOGW(TAG_BAC, "BAC19 data kept in RAM (no '%s' partition)", BAC_PARTITION_LABEL);
+    }
     ESP_LOGI(TAG_BAC, "BAC(19) created with instances %u and %u", (unsigned) IID_FW, (unsigned) IID_SW);
     return &g_bac.def;
 }
@@ -208,4 +287,7 @@ void bac19_object_release(const anjay_dm_object_def_t **def) {
     free(g_bac.sw.fmt); g_bac.sw.fmt = NULL;
     free(g_bac.fw.appid); g_bac.fw.appid = NULL;
     free(g_bac.sw.appid); g_bac.sw.appid = NULL;
+    blob_store_deinit();
+    memset(&g_bac.fw.slot, 0, sizeof(g_bac.fw.slot));
+    memset(&g_bac.sw.slot, 0, sizeof(g_bac.sw.slot));
 }
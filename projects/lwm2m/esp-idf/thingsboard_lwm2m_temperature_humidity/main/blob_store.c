@@ -0,0 +1,153 @@
+#include "blob_store.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#define BLOB_MAGIC 0x424F4C42u // "BLOB"
+#define BLOB_HEADER_SIZE 16
+
+// Written last: the slot is empty until all data is programmed
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t size_inv;
+    uint32_t reserved;
+} blob_header_t;
+
+static const char *TAG = "blob_store";
+
+static const esp_partition_t *s_part;
+static const uint8_t *s_map;
+static esp_partition_mmap_handle_t s_map_handle;
+
+int blob_store_init(const char *label) {
+    if (s_part) {
+        return 0;
+    }
+    const esp_partition_t *part =
+            esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        ESP_LOGW(TAG, "No '%s' data partition in the partition table", label);
+        return -1;
+    }
+    const void *map = NULL;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &s_map_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot map '%s': %s", label, esp_err_to_name(err));
+        return -1;
+    }
+    s_part = part;
+    s_map = (const uint8_t *) map;
+    ESP_LOGI(TAG, "'%s' mapped: %u KB at 0x%06x", label, (unsigned) (part->size / 1024), (unsigned) part->address);
+    return 0;
+}
+
+bool blob_store_ready(void) {
+    return s_part != NULL;
+}
+
+void blob_store_deinit(void) {
+    if (s_part) {
+        esp_partition_munmap(s_map_handle);
+        s_part = NULL;
+        s_map = NULL;
+    }
+}
+
+int blob_store_slot(blob_slot_t *slot, unsigned index, unsigned count, uint32_t limit) {
+    memset(slot, 0, sizeof(*slot));
+    if (!s_part || index >= count) {
+        return -1;
+    }
+    uint32_t slot_size = (uint32_t) (s_part->size / count) & ~(s_part->erase_size - 1);
+    if (slot_size < s_part->erase_size) {
+        return -1;
+    }
+    slot->offset = index * slot_size;
+    slot->capacity = slot_size - BLOB_HEADER_SIZE;
+    if (limit && limit < slot->capacity) {
+        slot->capacity = limit;
+    }
+    blob_header_t hdr;
+    memcpy(&hdr, &s_map[slot->offset], sizeof(hdr));
+    if (hdr.magic == BLOB_MAGIC && hdr.size == ~hdr.size_inv && hdr.size <= slot_size - BLOB_HEADER_SIZE) {
+        slot->size = hdr.size;
+    }
+    return 0;
+}
+
+int blob_store_begin(blob_slot_t *slot) {
+    if (!s_part) {
+        return -1;
+    }
+    // Erasing the first sector also invalidates the header of the previous blob
+    slot->size = 0;
+    slot->written = 0;
+    slot->erased = 0;
+    slot->open = false;
+    esp_err_t err = esp_partition_erase_range(s_part, slot->offset, s_part->erase_size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase at 0x%x failed: %s", (unsigned) slot->offset, esp_err_to_name(err));
+        return -1;
+    }
+    slot->erased = s_part->erase_size;
+    slot->open = true;
+    return 0;
+}
+
+int blob_store_append(blob_slot_t *slot, const void *data, size_t len) {
+    if (!slot->open) {
+        return -1;
+    }
+    if (len > slot->capacity - slot->written) {
+        return BLOB_STORE_ERR_FULL;
+    }
+    uint32_t end = BLOB_HEADER_SIZE + slot->written + (uint32_t) len;
+    while (slot->erased < end) {
+        esp_err_t err = esp_partition_erase_range(s_part, slot->offset + slot->erased, s_part->erase_size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Erase at 0x%x failed: %s", (unsigned) (slot->offset + slot->erased), esp_err_to_name(err));
+            slot->open = false;
+            return -1;
+        }
+        slot->erased += s_part->erase_size;
+    }
+    esp_err_t err = esp_partition_write(s_part, slot->offset + BLOB_HEADER_SIZE + slot->written, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+        slot->open = false;
+        return -1;
+    }
+    slot->written += (uint32_t) len;
+    return 0;
+}
+
+int blob_store_commit(blob_slot_t *slot) {
+    if (!slot->open) {
+        return -1;
+    }
+    slot->open = false;
+    blob_header_t hdr = {
+        .magic = BLOB_MAGIC,
+        .size = slot->written,
+        .size_inv = ~slot->written,
+        .reserved = 0xFFFFFFFFu,
+    };
+    esp_err_t err = esp_partition_write(s_part, slot->offset, &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Header write failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    slot->size = slot->written;
+    return 0;
+}
+
+const uint8_t *blob_store_data(const blob_slot_t *slot, size_t *len) {
+    *len = slot->size;
+    if (!s_map || !slot->size) {
+        return NULL;
+    }
+    return &s_map[slot->offset + BLOB_HEADER_SIZE];
+}
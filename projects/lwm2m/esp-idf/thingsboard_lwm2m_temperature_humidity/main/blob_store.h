@@ -0,0 +1,49 @@
+#pragma once
+
+// Flash-backed blob slots in a dedicated data partition (see partitions.csv).
+// The partition is split into equal, sector-aligned slots. A write streams into
+// the slot sector by sector and only becomes visible when blob_store_commit()
+// writes the slot header, so an interrupted write leaves an empty slot rather
+// than a torn one. Committed data is read through a memory mapping of the
+// partition: readers get a pointer into flash, no heap copy is made.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOB_STORE_ERR_FULL (-2)
+
+typedef struct {
+    uint32_t offset;   // slot start in the partition
+    uint32_t capacity; // max data bytes (slot size minus header, capped by limit)
+    uint32_t size;     // committed data bytes, 0 if empty
+    uint32_t written;  // data bytes of the write in progress
+    uint32_t erased;   // slot bytes erased for the write in progress
+    bool open;
+} blob_slot_t;
+
+// Finds and maps the data partition with the given label. Returns 0 on success.
+int blob_store_init(const char *label);
+bool blob_store_ready(void);
+void blob_store_deinit(void);
+
+// Binds slot index of count slots and loads its committed size. limit caps the
+// data bytes (0: the whole slot).
+int blob_store_slot(blob_slot_t *slot, unsigned index, unsigned count, uint32_t limit);
+
+// Drops the committed data and starts a new write
+int blob_store_begin(blob_slot_t *slot);
+// Returns BLOB_STORE_ERR_FULL if the data would exceed the slot capacity
+int blob_store_append(blob_slot_t *slot, const void *data, size_t len);
+int blob_store_commit(blob_slot_t *slot);
+
+// Committed data, memory-mapped (valid until the next begin); NULL if empty
+const uint8_t *blob_store_data(const blob_slot_t *slot, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,55 @@
+#include "conn_stats.h"
+
+#include <string.h>
+
+void conn_stats_init(conn_stats_t *s, const uint32_t mask[CONN_STATS_COUNT]) {
+    memset(s, 0, sizeof(*s));
+    for (int i = 0; i < CONN_STATS_COUNT; i++) {
+        s->mask[i] = mask ? mask[i] : UINT32_MAX;
+    }
+}
+
+void conn_stats_sample(conn_stats_t *s, const conn_stats_raw_t *raw, uint32_t now_ms) {
+    if (!s->primed) {
+        memcpy(s->last_raw, raw->raw, sizeof(s->last_raw));
+        s->primed = true;
+    } else {
+        for (int i = 0; i < CONN_STATS_COUNT; i++) {
+            // Unsigned difference modulo the counter width handles wrap-around
+            s->total[i] += (uint32_t) (raw->raw[i] - s->last_raw[i]) & s->mask[i];
+            s->last_raw[i] = raw->raw[i];
+        }
+    }
+    if (!s->running) {
+        return;
+    }
+    if (raw->max_packet > s->max_packet) {
+        s->max_packet = raw->max_packet;
+    }
+    if (s->period_s && (uint32_t) (now_ms - s->started_ms) >= s->period_s * 1000u) {
+        conn_stats_stop(s);
+    }
+}
+
+void conn_stats_start(conn_stats_t *s, uint32_t now_ms) {
+    memcpy(s->base, s->total, sizeof(s->base));
+    s->max_packet = 0;
+    s->started_ms = now_ms;
+    s->running = true;
+}
+
+void conn_stats_stop(conn_stats_t *s) {
+    if (!s->running) {
+        return;
+    }
+    memcpy(s->end, s->total, sizeof(s->end));
+    s->running = false;
+}
+
+uint64_t conn_stats_get(const conn_stats_t *s, conn_stats_counter_t counter) {
+    if ((unsigned) counter >= CONN_STATS_COUNT) {
+        return 0;
+    }
+    uint64_t upto = s->running ? s->total[counter] : s->end[counter];
+    return upto - s->base[counter];
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// Snapshot-and-delta accumulation for Connectivity Statistics (Object 7).
+// Raw driver/stack counters are free-running and may be 16 or 32 bits wide; each
+// sample adds the wrapped delta into 64-bit totals, so the sources are never reset.
+// Start/Stop only move baselines.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CONN_STATS_TX_BYTES = 0,
+    CONN_STATS_RX_BYTES,
+    CONN_STATS_TX_PACKETS,
+    CONN_STATS_RX_PACKETS,
+    CONN_STATS_LINK_DROPS,
+    CONN_STATS_IP_DROPS,
+    CONN_STATS_UDP_DROPS,
+    CONN_STATS_COUNT
+} conn_stats_counter_t;
+
+typedef struct {
+    uint32_t raw[CONN_STATS_COUNT];   // source counter values
+    uint32_t max_packet;              // largest packet seen since the previous sample
+} conn_stats_raw_t;
+
+typedef struct {
+    uint32_t mask[CONN_STATS_COUNT];     // width of each source counter (e.g. 0xFFFF)
+    uint32_t last_raw[CONN_STATS_COUNT];
+    uint64_t total[CONN_STATS_COUNT];    // since conn_stats_init, never reset
+    uint64_t base[CONN_STATS_COUNT];     // totals at Start
+    uint64_t end[CONN_STATS_COUNT];      // totals at Stop (valid while stopped)
+    uint32_t max_packet;                 // largest packet since Start
+    uint32_t period_s;                   // Collection Period, 0 = until Stop
+    uint32_t started_ms;
+    bool primed;
+    bool running;
+} conn_stats_t;
+
+// mask: per-counter width, NULL for all 32-bit. Totals start at zero, collection stopped.
+void conn_stats_init(conn_stats_t *s, const uint32_t mask[CONN_STATS_COUNT]);
+
+// Folds a snapshot of the raw counters into the totals. The first call only primes
+// the baselines. Stops collection once the Collection Period has elapsed.
+void conn_stats_sample(conn_stats_t *s, const conn_stats_raw_t *raw, uint32_t now_ms);
+
+// Start: zero the reported values and collect until Stop or period expiry
+void conn_stats_start(conn_stats_t *s, uint32_t now_ms);
+void conn_stats_stop(conn_stats_t *s);
+
+// Value accumulated between Start and Stop (or now, while running)
+uint64_t conn_stats_get(const conn_stats_t *s, conn_stats_counter_t counter);
+
+#ifdef __cplusplus
+}
+#endif
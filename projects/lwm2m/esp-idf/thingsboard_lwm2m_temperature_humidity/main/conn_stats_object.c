@@ -0,0 +1,290 @@
+// Connectivity Statistics Object (7) implementation
+// Byte/packet counters come from thin wrappers around the Wi-Fi STA netif input and
+// linkoutput hooks (one atomic add per frame); drop counters come from lwIP stats.
+// The LwM2M task folds snapshots of those free-running counters into 64-bit totals
+// (conn_stats.c), so Start/Stop never reset anything in the driver or the stack.
+
+#include "conn_stats_object.h"
+
+#include <anjay/io.h>
+
+#include "sdkconfig.h"
+#include <esp_log.h>
+#include <esp_netif.h>
+#include <esp_timer.h>
+
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/tcpip.h"
+
+#include "conn_stats.h"
+
+#ifndef CONFIG_LWM2M_CONN_STATS_AUTOSTART
+#define CONFIG_LWM2M_CONN_STATS_AUTOSTART 1
+#endif
+
+#define OID_CONN_STATS 7
+#define RID_TX_DATA 2           // kB
+#define RID_RX_DATA 3           // kB
+#define RID_MAX_MESSAGE_SIZE 4  // bytes
+#define RID_AVG_MESSAGE_SIZE 5  // bytes
+#define RID_START 6
+#define RID_STOP 7
+#define RID_COLLECTION_PERIOD 8 // s, 0 = until Stop
+// Vendor-specific extensions (custom range)
+#define RID_TX_PACKETS 60000
+#define RID_RX_PACKETS 60001
+#define RID_DROPPED_PACKETS 60002
+
+// Raw counters are folded into 64-bit totals at least this often, well before a
+// 16-bit lwIP counter could wrap twice.
+#define CONN_STATS_SAMPLE_PERIOD_MS 1000
+
+static const char *TAG = "conn_stats";
+
+// Written per frame from the Wi-Fi RX / tcpip contexts, read by the LwM2M task
+static uint32_t s_tx_bytes;
+static uint32_t s_rx_bytes;
+static uint32_t s_tx_packets;
+static uint32_t s_rx_packets;
+static uint32_t s_max_packet;
+
+static netif_input_fn s_orig_input;
+static netif_linkoutput_fn s_orig_linkoutput;
+
+static conn_stats_t s_stats;
+static uint32_t s_last_sample_ms;
+static bool s_started;
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t) (esp_timer_get_time() / 1000);
+}
+
+static inline void count_frame(const struct pbuf *p, uint32_t *bytes, uint32_t *packets) {
+    uint32_t len = p->tot_len;
+    __atomic_fetch_add(bytes, len, __ATOMIC_RELAXED);
+    __atomic_fetch_add(packets, 1, __ATOMIC_RELAXED);
+    uint32_t max = __atomic_load_n(&s_max_packet, __ATOMIC_RELAXED);
+    while (len > max
+           && !__atomic_compare_exchange_n(&s_max_packet, &max, len, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static err_t counting_input(struct pbuf *p, struct netif *inp) {
+    count_frame(p, &s_rx_bytes, &s_rx_packets);
+    return s_orig_input(p, inp);
+}
+
+static err_t counting_linkoutput(struct netif *netif, struct pbuf *p) {
+    count_frame(p, &s_tx_bytes, &s_tx_packets);
+    return s_orig_linkoutput(netif, p);
+}
+
+// Runs in the tcpip thread so the swap cannot race a frame in flight
+static void install_hooks(void *arg) {
+    struct netif *netif = (struct netif *) arg;
+    if (!s_orig_input && netif->input) {
+        s_orig_input = netif->input;
+        netif->input = counting_input;
+    }
+    if (!s_orig_linkoutput && netif->linkoutput) {
+        s_orig_linkoutput = netif->linkoutput;
+        netif->linkoutput = counting_linkoutput;
+    }
+}
+
+static void read_raw(conn_stats_raw_t *raw) {
+    raw->raw[CONN_STATS_TX_BYTES] = __atomic_load_n(&s_tx_bytes, __ATOMIC_RELAXED);
+    raw->raw[CONN_STATS_RX_BYTES] = __atomic_load_n(&s_rx_bytes, __ATOMIC_RELAXED);
+    raw->raw[CONN_STATS_TX_PACKETS] = __atomic_load_n(&s_tx_packets, __ATOMIC_RELAXED);
+    raw->raw[CONN_STATS_RX_PACKETS] = __atomic_load_n(&s_rx_packets, __ATOMIC_RELAXED);
+#if LWIP_STATS && LINK_STATS
+    raw->raw[CONN_STATS_LINK_DROPS] = lwip_stats.link.drop;
+#else
+    raw->raw[CONN_STATS_LINK_DROPS] = 0;
+#endif
+#if LWIP_STATS && IP_STATS
+    raw->raw[CONN_STATS_IP_DROPS] = lwip_stats.ip.drop;
+#else
+    raw->raw[CONN_STATS_IP_DROPS] = 0;
+#endif
+#if LWIP_STATS && UDP_STATS
+    raw->raw[CONN_STATS_UDP_DROPS] = lwip_stats.udp.drop;
+#else
+    raw->raw[CONN_STATS_UDP_DROPS] = 0;
+#endif
+    raw->max_packet = __atomic_exchange_n(&s_max_packet, 0, __ATOMIC_RELAXED);
+}
+
+static void sample_now(void) {
+    conn_stats_raw_t raw;
+    read_raw(&raw);
+    bool was_running = s_stats.running;
+    s_last_sample_ms = now_ms();
+    conn_stats_sample(&s_stats, &raw, s_last_sample_ms);
+    if (was_running && !s_stats.running) {
+        ESP_LOGI(TAG, "Collection period of %u s elapsed; statistics frozen", (unsigned) s_stats.period_s);
+    }
+}
+
+static int64_t kilobytes(uint64_t bytes) {
+    return (int64_t) ((bytes + 512) / 1024);
+}
+
+static int list_instances(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                          anjay_dm_list_ctx_t *ctx) {
+    (void) anjay;
+    (void) def;
+    anjay_dm_emit(ctx, 0);
+    return 0;
+}
+
+static int list_resources(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                          anjay_iid_t iid, anjay_dm_resource_list_ctx_t *ctx) {
+    (void) anjay;
+    (void) def;
+    (void) iid;
+    anjay_dm_emit_res(ctx, RID_TX_DATA, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_RX_DATA, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_MAX_MESSAGE_SIZE, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_AVG_MESSAGE_SIZE, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_START, ANJAY_DM_RES_E, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_STOP, ANJAY_DM_RES_E, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_COLLECTION_PERIOD, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_TX_PACKETS, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_RX_PACKETS, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_DROPPED_PACKETS, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    return 0;
+}
+
+static int resource_read(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                         anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
+                         anjay_output_ctx_t *ctx) {
+    (void) anjay;
+    (void) def;
+    (void) iid;
+    (void) riid;
+    // Reads are rare; fold in the latest deltas so values are exact
+    sample_now();
+    switch (rid) {
+    case RID_TX_DATA:
+        return anjay_ret_i64(ctx, kilobytes(conn_stats_get(&s_stats, CONN_STATS_TX_BYTES)));
+    case RID_RX_DATA:
+        return anjay_ret_i64(ctx, kilobytes(conn_stats_get(&s_stats, CONN_STATS_RX_BYTES)));
+    case RID_MAX_MESSAGE_SIZE:
+        return anjay_ret_i64(ctx, (int64_t) s_stats.max_packet);
+    case RID_AVG_MESSAGE_SIZE: {
+        uint64_t bytes = conn_stats_get(&s_stats, CONN_STATS_TX_BYTES) + conn_stats_get(&s_stats, CONN_STATS_RX_BYTES);
+        uint64_t packets = conn_stats_get(&s_stats, CONN_STATS_TX_PACKETS) + conn_stats_get(&s_stats, CONN_STATS_RX_PACKETS);
+        return anjay_ret_i64(ctx, packets ? (int64_t) (bytes / packets) : 0);
+    }
+    case RID_COLLECTION_PERIOD:
+        return anjay_ret_i64(ctx, (int64_t) s_stats.period_s);
+    case RID_TX_PACKETS:
+        return anjay_ret_i64(ctx, (int64_t) conn_stats_get(&s_stats, CONN_STATS_TX_PACKETS));
+    case RID_RX_PACKETS:
+        return anjay_ret_i64(ctx, (int64_t) conn_stats_get(&s_stats, CONN_STATS_RX_PACKETS));
+    case RID_DROPPED_PACKETS:
+        return anjay_ret_i64(ctx, (int64_t) (conn_stats_get(&s_stats, CONN_STATS_LINK_DROPS)
+                                             + conn_stats_get(&s_stats, CONN_STATS_IP_DROPS)
+                                             + conn_stats_get(&s_stats, CONN_STATS_UDP_DROPS)));
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+}
+
+static int resource_write(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                          anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
+                          anjay_input_ctx_t *in_ctx) {
+    (void) anjay; (void) def; (void) iid; (void) riid;
+    switch (rid) {
+    case RID_COLLECTION_PERIOD: {
+        int64_t v = 0;
+        int res = anjay_get_i64(in_ctx, &v);
+        if (res) return res;
+        if (v < 0 || v > UINT32_MAX / 1000) return ANJAY_ERR_BAD_REQUEST;
+        s_stats.period_s = (uint32_t) v;
+        ESP_LOGI(TAG, "Collection period set to %u s", (unsigned) s_stats.period_s);
+        return 0;
+    }
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+}
+
+static int resource_execute(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                            anjay_iid_t iid, anjay_rid_t rid, anjay_execute_ctx_t *arg_ctx) {
+    (void) anjay; (void) def; (void) iid; (void) arg_ctx;
+    switch (rid) {
+    case RID_START:
+        sample_now();
+        conn_stats_start(&s_stats, s_last_sample_ms);
+        ESP_LOGI(TAG, "Collection started (period %u s)", (unsigned) s_stats.period_s);
+        return 0;
+    case RID_STOP:
+        sample_now();
+        conn_stats_stop(&s_stats);
+        ESP_LOGI(TAG, "Collection stopped");
+        return 0;
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+}
+
+static const anjay_dm_object_def_t OBJ_DEF = {
+    .oid = OID_CONN_STATS,
+    .version = "1.0",
+    .handlers = {
+        .list_instances = list_instances,
+        .list_resources = list_resources,
+        .resource_read = resource_read,
+        .resource_write = resource_write,
+        .resource_execute = resource_execute,
+    }
+};
+
+static const anjay_dm_object_def_t *const OBJ_DEF_PTR = &OBJ_DEF;
+
+void conn_stats_object_start(void) {
+    if (s_started) {
+        return;
+    }
+    s_started = true;
+
+    uint32_t mask[CONN_STATS_COUNT];
+    for (int i = 0; i < CONN_STATS_COUNT; i++) {
+        mask[i] = UINT32_MAX;
+    }
+#if LWIP_STATS
+    // STAT_COUNTER is 16-bit unless LWIP_STATS_LARGE
+    mask[CONN_STATS_LINK_DROPS] = (uint32_t) (STAT_COUNTER) -1;
+    mask[CONN_STATS_IP_DROPS] = (uint32_t) (STAT_COUNTER) -1;
+    mask[CONN_STATS_UDP_DROPS] = (uint32_t) (STAT_COUNTER) -1;
+#else
+    ESP_LOGW(TAG, "CONFIG_LWIP_STATS disabled; Dropped Packets will read 0");
+#endif
+    conn_stats_init(&s_stats, mask);
+
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    struct netif *lwip_netif = netif ? (struct netif *) esp_netif_get_netif_impl(netif) : NULL;
+    if (!lwip_netif || tcpip_callback(install_hooks, lwip_netif) != ERR_OK) {
+        ESP_LOGW(TAG, "No WIFI_STA_DEF netif; byte/packet counters unavailable");
+    }
+
+    sample_now(); // primes the baselines
+#if CONFIG_LWM2M_CONN_STATS_AUTOSTART
+    conn_stats_start(&s_stats, s_last_sample_ms);
+#endif
+}
+
+const anjay_dm_object_def_t *const *conn_stats_object_def(void) {
+    return &OBJ_DEF_PTR;
+}
+
+void conn_stats_object_update(anjay_t *anjay) {
+    (void) anjay;
+    if (s_started && (uint32_t) (now_ms() - s_last_sample_ms) >= CONN_STATS_SAMPLE_PERIOD_MS) {
+        sample_now();
+    }
+}
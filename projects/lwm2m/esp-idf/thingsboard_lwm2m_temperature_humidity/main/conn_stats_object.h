@@ -0,0 +1,17 @@
+#pragma once
+
+#include <anjay/anjay.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hooks the Wi-Fi STA netif counters and primes the statistics (idempotent)
+void conn_stats_object_start(void);
+const anjay_dm_object_def_t *const *conn_stats_object_def(void);
+// Folds raw counter deltas into the 64-bit totals about once per second
+void conn_stats_object_update(anjay_t *anjay);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,20 +1,29 @@
 // Connectivity Monitoring Object (4) implementation
-// Clean file rewrite to remove any stray CR/LF escape sequences that produced
-// "extra tokens at end of #include" warnings in earlier builds.
+// Event-driven: IP/gateway come from IP_EVENT handlers and RSSI is sampled by a
+// low-rate esp_timer. Addresses are kept in binary form and only formatted when
+// the server reads them; the 100 ms loop just turns change flags into notifies.
 
 #include "connectivity_object.h"
 
-#include <string.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <anjay/io.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include "sdkconfig.h"
+#include <esp_event.h>
 #include <esp_log.h>
-#include <esp_wifi.h>
 #include <esp_netif.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+#ifndef CONFIG_LWM2M_CONN_RSSI_PERIOD_MS
+#define CONFIG_LWM2M_CONN_RSSI_PERIOD_MS 5000
+#endif
 
 #define OID_CONNECTIVITY 4
 #define RID_NETWORK_BEARER 0
@@ -26,18 +35,31 @@
 #define RID_IP_ADDRESSES 4
 #define RID_ROUTER_IP_ADDRESSES 5
 
+// Change flags raised by the event/timer callbacks, consumed by connectivity_object_update()
+#define CONN_DIRTY_IP (1u << 0)
+#define CONN_DIRTY_GW (1u << 1)
+#define CONN_DIRTY_RSSI (1u << 2)
+#define CONN_DIRTY_QUALITY (1u << 3)
+
 static const char *TAG_CONN = "conn_obj"; // used in update logging
 
 typedef struct {
     const anjay_dm_object_def_t *def;
+    // Written by the esp_timer / event loop tasks, read by the LwM2M task.
+    // All fields are 32-bit and accessed atomically; no lock needed.
     int32_t signal_strength_dbm;
     int32_t link_quality_pct;
-    // Cached copies of IPs so we can detect change and notify
-    char ip_addr[16];      // IPv4 dotted
-    char gw_addr[16];      // Gateway IPv4 dotted
-    // Smoothing for RSSI
+    uint32_t ip_addr; // esp_ip4_addr_t.addr (network order), 0 = none
+    uint32_t gw_addr;
+    uint32_t dirty;
+    // Smoothing for RSSI, updated by the timer callback and reset by the IP
+    // handler; esp_timer_stop() does not wait for a running callback, so both
+    // go through ema_lock
+    portMUX_TYPE ema_lock;
     bool ema_initialized;
     float ema_rssi;
+    esp_timer_handle_t rssi_timer;
+    bool started;
 } connectivity_ctx_t;
 
 static inline int32_t clamp_i32(int32_t value, int32_t min, int32_t max) {
@@ -50,31 +72,56 @@ static inline int32_t clamp_i32(int32_t value, int32_t min, int32_t max) {
     return value;
 }
 
-static bool update_from_wifi(connectivity_ctx_t *ctx) {
+static inline void store_u32(uint32_t *field, uint32_t value, uint32_t flag, uint32_t *dirty) {
+    if (__atomic_exchange_n(field, value, __ATOMIC_RELAXED) != value) {
+        __atomic_fetch_or(dirty, flag, __ATOMIC_RELEASE);
+    }
+}
+
+static int format_ip4(uint32_t addr, char out[16]) {
+    esp_ip4_addr_t ip = { .addr = addr };
+    return snprintf(out, 16, IPSTR, IP2STR(&ip));
+}
+
+static void set_addresses(connectivity_ctx_t *ctx, uint32_t ip, uint32_t gw) {
+    store_u32(&ctx->ip_addr, ip, CONN_DIRTY_IP, &ctx->dirty);
+    store_u32(&ctx->gw_addr, gw, CONN_DIRTY_GW, &ctx->dirty);
+}
+
+static void update_from_wifi(connectivity_ctx_t *ctx) {
     wifi_ap_record_t ap = (wifi_ap_record_t){ 0 };
+    int32_t rssi;
+    int32_t quality;
     if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
         // Exponential moving average for stability
         const float alpha = 0.25f; // smoothing factor
+        float ema;
+        portENTER_CRITICAL(&ctx->ema_lock);
         if (!ctx->ema_initialized) {
             ctx->ema_rssi = (float) ap.rssi;
             ctx->ema_initialized = true;
         } else {
             ctx->ema_rssi = alpha * (float) ap.rssi + (1.0f - alpha) * ctx->ema_rssi;
         }
-        ctx->signal_strength_dbm = (int32_t) lroundf(ctx->ema_rssi);
+        ema = ctx->ema_rssi;
+        portEXIT_CRITICAL(&ctx->ema_lock);
+        rssi = (int32_t) lroundf(ema);
         // Map averaged RSSI to link quality percentage
-        int32_t q;
-        if (ctx->signal_strength_dbm <= -100) {
-            q = 0;
-        } else if (ctx->signal_strength_dbm >= -50) {
-            q = 100;
+        if (rssi <= -100) {
+            quality = 0;
+        } else if (rssi >= -50) {
+            quality = 100;
         } else {
-            q = 2 * (ctx->signal_strength_dbm + 100); // linear map -100..-50 => 0..100
+            quality = 2 * (rssi + 100); // linear map -100..-50 => 0..100
         }
-        ctx->link_quality_pct = clamp_i32(q, 0, 100);
-        return true;
+        quality = clamp_i32(quality, 0, 100);
+    } else {
+        // Decay values slowly if disconnected
+        rssi = clamp_i32(__atomic_load_n(&ctx->signal_strength_dbm, __ATOMIC_RELAXED) - 1, -110, -40);
+        quality = clamp_i32(__atomic_load_n(&ctx->link_quality_pct, __ATOMIC_RELAXED) - 2, 0, 100);
     }
-    return false;
+    store_u32((uint32_t *) &ctx->signal_strength_dbm, (uint32_t) rssi, CONN_DIRTY_RSSI, &ctx->dirty);
+    store_u32((uint32_t *) &ctx->link_quality_pct, (uint32_t) quality, CONN_DIRTY_QUALITY, &ctx->dirty);
 }
 
 static int list_instances(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
@@ -119,64 +166,29 @@ static int list_resource_instances(anjay_t *anjay, const anjay_dm_object_def_t *
 static int resource_read(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
                          anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
                          anjay_output_ctx_t *ctx) {
+    (void) anjay;
     (void) iid;
-    (void) riid;
     connectivity_ctx_t *obj = AVS_CONTAINER_OF(def, connectivity_ctx_t, def);
-
-    // Live refresh for IP + gateway before serving those resources.
-    if (anjay && (rid == RID_IP_ADDRESSES || rid == RID_ROUTER_IP_ADDRESSES)) {
-        esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-        if (netif) {
-            esp_netif_ip_info_t info = (esp_netif_ip_info_t){ 0 };
-            if (esp_netif_get_ip_info(netif, &info) == ESP_OK) {
-                char new_ip[16] = "0.0.0.0";
-                char new_gw[16] = "0.0.0.0";
-                if (info.ip.addr) {
-                    snprintf(new_ip, sizeof(new_ip), IPSTR, IP2STR(&info.ip));
-                }
-                if (info.gw.addr) {
-                    snprintf(new_gw, sizeof(new_gw), IPSTR, IP2STR(&info.gw));
-                }
-                bool ip_changed = strcmp(new_ip, obj->ip_addr) != 0;
-                bool gw_changed = strcmp(new_gw, obj->gw_addr) != 0;
-                if (ip_changed) {
-                    ESP_LOGI(TAG_CONN, "IP updated on read: %s -> %s", obj->ip_addr, new_ip);
-                    strlcpy(obj->ip_addr, new_ip, sizeof(obj->ip_addr));
-                    anjay_notify_changed(anjay, OID_CONNECTIVITY, 0, RID_IP_ADDRESSES);
-                }
-                if (gw_changed) {
-                    ESP_LOGI(TAG_CONN, "GW updated on read: %s -> %s", obj->gw_addr, new_gw);
-                    strlcpy(obj->gw_addr, new_gw, sizeof(obj->gw_addr));
-                    anjay_notify_changed(anjay, OID_CONNECTIVITY, 0, RID_ROUTER_IP_ADDRESSES);
-                }
-            }
-        }
-    }
+    char buf[16];
 
     switch (rid) {
     case RID_NETWORK_BEARER:
         // 41 = WLAN (per LwM2M Network Bearer registry)
         return anjay_ret_i32(ctx, 41);
     case RID_SIGNAL_STRENGTH:
-        // Live refresh if possible
-        if (update_from_wifi(obj)) {
-            // notify link quality if changed by RSSI smoothing effect
-            // (No notify here to avoid recursion; periodic update handles it)
-        }
-        return anjay_ret_i32(ctx, obj->signal_strength_dbm);
+        return anjay_ret_i32(ctx, __atomic_load_n(&obj->signal_strength_dbm, __ATOMIC_RELAXED));
     case RID_LINK_QUALITY:
-        if (update_from_wifi(obj)) {
-            // recompute already done in update_from_wifi
-        }
-        return anjay_ret_i32(ctx, obj->link_quality_pct);
+        return anjay_ret_i32(ctx, __atomic_load_n(&obj->link_quality_pct, __ATOMIC_RELAXED));
     case RID_IP_ADDRESSES:
         if (riid == ANJAY_ID_INVALID || riid == 0) {
-            return anjay_ret_string(ctx, obj->ip_addr[0] ? obj->ip_addr : "0.0.0.0");
+            format_ip4(__atomic_load_n(&obj->ip_addr, __ATOMIC_RELAXED), buf);
+            return anjay_ret_string(ctx, buf);
         }
         return ANJAY_ERR_NOT_FOUND;
     case RID_ROUTER_IP_ADDRESSES:
         if (riid == ANJAY_ID_INVALID || riid == 0) {
-            return anjay_ret_string(ctx, obj->gw_addr[0] ? obj->gw_addr : "0.0.0.0");
+            format_ip4(__atomic_load_n(&obj->gw_addr, __ATOMIC_RELAXED), buf);
+            return anjay_ret_string(ctx, buf);
         }
         return ANJAY_ERR_NOT_FOUND;
     default:
@@ -199,61 +211,87 @@ static connectivity_ctx_t g_ctx = {
     .def = &OBJ_DEF,
     .signal_strength_dbm = -60,
     .link_quality_pct = 85,
-    .ip_addr = "0.0.0.0",
-    .gw_addr = "0.0.0.0",
+    .ema_lock = portMUX_INITIALIZER_UNLOCKED,
 };
 
-const anjay_dm_object_def_t *const *connectivity_object_def(void) {
-    return &g_ctx.def;
+static void conn_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    connectivity_ctx_t *ctx = (connectivity_ctx_t *) arg;
+    if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP && event_data) {
+        const ip_event_got_ip_t *ev = (const ip_event_got_ip_t *) event_data;
+        set_addresses(ctx, ev->ip_info.ip.addr, ev->ip_info.gw.addr);
+        // New association: restart the average with a fresh sample instead of waiting a
+        // full period
+        portENTER_CRITICAL(&ctx->ema_lock);
+        ctx->ema_initialized = false;
+        portEXIT_CRITICAL(&ctx->ema_lock);
+        update_from_wifi(ctx);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP) {
+        set_addresses(ctx, 0, 0);
+    }
 }
 
-void connectivity_object_update(anjay_t *anjay) {
-    if (!anjay) {
+static void rssi_timer_cb(void *arg) {
+    update_from_wifi((connectivity_ctx_t *) arg);
+}
+
+void connectivity_object_start(void) {
+    if (g_ctx.started) {
         return;
     }
+    g_ctx.started = true;
 
+    // Seed from the current netif state: Wi-Fi is usually up before the LwM2M task starts
     esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    char new_ip[16] = "0.0.0.0";
-    char new_gw[16] = "0.0.0.0";
-    if (netif) {
-        esp_netif_ip_info_t info = (esp_netif_ip_info_t){ 0 };
-        if (esp_netif_get_ip_info(netif, &info) == ESP_OK) {
-            if (info.ip.addr) {
-                snprintf(new_ip, sizeof(new_ip), IPSTR, IP2STR(&info.ip));
-            }
-            if (info.gw.addr) {
-                snprintf(new_gw, sizeof(new_gw), IPSTR, IP2STR(&info.gw));
-            }
-        }
+    esp_netif_ip_info_t info = (esp_netif_ip_info_t){ 0 };
+    if (netif && esp_netif_get_ip_info(netif, &info) == ESP_OK) {
+        set_addresses(&g_ctx, info.ip.addr, info.gw.addr);
     } else {
         ESP_LOGW(TAG_CONN, "No WIFI_STA_DEF netif yet");
     }
+    update_from_wifi(&g_ctx);
+
+    (void) esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &conn_event_handler, &g_ctx, NULL);
+    (void) esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_LOST_IP, &conn_event_handler, &g_ctx, NULL);
+
+    const esp_timer_create_args_t args = {
+        .callback = rssi_timer_cb,
+        .arg = &g_ctx,
+        .name = "conn_rssi",
+    };
+    if (esp_timer_create(&args, &g_ctx.rssi_timer) != ESP_OK
+        || esp_timer_start_periodic(g_ctx.rssi_timer, (uint64_t) CONFIG_LWM2M_CONN_RSSI_PERIOD_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG_CONN, "Could not start RSSI timer; Signal Strength will not refresh");
+    }
+}
+
+const anjay_dm_object_def_t *const *connectivity_object_def(void) {
+    return &g_ctx.def;
+}
 
-    bool ip_changed = strcmp(new_ip, g_ctx.ip_addr) != 0;
-    bool gw_changed = strcmp(new_gw, g_ctx.gw_addr) != 0;
-    if (ip_changed) {
-        ESP_LOGI(TAG_CONN, "Station IP changed: %s -> %s", g_ctx.ip_addr, new_ip);
-        strlcpy(g_ctx.ip_addr, new_ip, sizeof(g_ctx.ip_addr));
+void connectivity_object_update(anjay_t *anjay) {
+    if (!anjay) {
+        return;
+    }
+    uint32_t dirty = __atomic_exchange_n(&g_ctx.dirty, 0, __ATOMIC_ACQUIRE);
+    if (!dirty) {
+        return;
+    }
+    if (dirty & (CONN_DIRTY_IP | CONN_DIRTY_GW)) {
+        char ip[16], gw[16];
+        format_ip4(__atomic_load_n(&g_ctx.ip_addr, __ATOMIC_RELAXED), ip);
+        format_ip4(__atomic_load_n(&g_ctx.gw_addr, __ATOMIC_RELAXED), gw);
+        ESP_LOGI(TAG_CONN, "Station IP %s, gateway %s", ip, gw);
+    }
+    if (dirty & CONN_DIRTY_IP) {
         anjay_notify_changed(anjay, OID_CONNECTIVITY, 0, RID_IP_ADDRESSES);
     }
-    if (gw_changed) {
-        ESP_LOGI(TAG_CONN, "Gateway IP changed: %s -> %s", g_ctx.gw_addr, new_gw);
-        strlcpy(g_ctx.gw_addr, new_gw, sizeof(g_ctx.gw_addr));
+    if (dirty & CONN_DIRTY_GW) {
         anjay_notify_changed(anjay, OID_CONNECTIVITY, 0, RID_ROUTER_IP_ADDRESSES);
     }
-
-    int32_t old_rssi = g_ctx.signal_strength_dbm;
-    int32_t old_quality = g_ctx.link_quality_pct;
-    if (!update_from_wifi(&g_ctx)) {
-        // Decay values slowly if disconnected
-        g_ctx.signal_strength_dbm = clamp_i32(g_ctx.signal_strength_dbm - 1, -110, -40);
-        g_ctx.link_quality_pct = clamp_i32(g_ctx.link_quality_pct - 2, 0, 100);
-    }
-    if (g_ctx.signal_strength_dbm != old_rssi) {
+    if (dirty & CONN_DIRTY_RSSI) {
         anjay_notify_changed(anjay, OID_CONNECTIVITY, 0, RID_SIGNAL_STRENGTH);
     }
-    if (g_ctx.link_quality_pct != old_quality) {
+    if (dirty & CONN_DIRTY_QUALITY) {
         anjay_notify_changed(anjay, OID_CONNECTIVITY, 0, RID_LINK_QUALITY);
     }
 }
-
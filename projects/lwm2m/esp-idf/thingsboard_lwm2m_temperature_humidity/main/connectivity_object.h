@@ -6,7 +6,10 @@
 extern "C" {
 #endif
 
+// Registers the IP_EVENT handlers and starts the RSSI sampling timer (idempotent)
+void connectivity_object_start(void);
 const anjay_dm_object_def_t *const *connectivity_object_def(void);
+// Emits notifications for values the event handlers/timer flagged as changed
 void connectivity_object_update(anjay_t *anjay);
 
 #ifdef __cplusplus
@@ -7,6 +7,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
@@ -14,12 +15,13 @@
 #include <freertos/task.h>
 
 #include <esp_system.h>
-#include <esp_random.h>
 #include <esp_log.h>
 #include <esp_timer.h>
 #include <esp_heap_caps.h>
 #include <esp_idf_version.h>
 
+#include "notify_filter.h"
+
 #define RID_MANUFACTURER 0
 #define RID_MODEL_NUMBER 1
 #define RID_SERIAL_NUMBER 2
@@ -33,14 +35,33 @@
 #define RID_DEVICE_TYPE 17
 #define RID_HARDWARE_VERSION 18
 #define RID_SOFTWARE_VERSION 19
-#define RID_BATTERY_STATUS 20
 #define RID_MEMORY_TOTAL 21
-#define RID_BATTERY_LEVEL 9
 #define RID_MEMORY_FREE 10
-#define RID_POWER_SOURCE_VOLTAGE 7
-#define RID_POWER_SOURCE_CURRENT 8
+// Vendor-specific health metrics (custom range)
+#define RID_CPU_LOAD 60000          // % of CPU time not spent in the idle task(s)
+#define RID_MIN_FREE_HEAP 60001     // kB, lowest free heap since boot
+#define RID_LARGEST_FREE_BLOCK 60002 // kB
+#define RID_HEAP_FRAGMENTATION 60003 // %, 100 - largest block / free heap
+#define RID_TASK_NAME 60004         // multi-instance, one instance per task
+#define RID_TASK_CPU 60005          // multi-instance, %, same instance IDs as 60004
+#define RID_TASK_STACK_FREE 60006   // multi-instance, bytes, stack high-water mark
 
+#define OID_DEVICE 3
 #define DEVICE_UPDATE_PERIOD_MS 5000
+// Change needed before a metric is notified (used unless the server set gt/lt/st)
+#define DEVICE_MEMORY_STEP_KB 4
+#define DEVICE_CPU_STEP_PCT 5
+#define DEVICE_STACK_STEP_BYTES 64
+// Task instances reported in /3/0/60004-60006; the snapshot itself is sized at run time
+#define DEVICE_MAX_TASKS 24
+// Spare TaskStatus_t slots for tasks created between sizing and the snapshot
+#define DEVICE_TASK_SNAPSHOT_MARGIN 4
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+#define DEVICE_HAVE_TASK_STATS 1
+#else
+#define DEVICE_HAVE_TASK_STATS 0
+#endif
 #define DEVICE_MANUFACTURER "Espressif"
 #ifndef CONFIG_IDF_TARGET
 #define CONFIG_IDF_TARGET "esp32"
@@ -50,17 +71,42 @@
 
 static const char *TAG = "device_obj";
 
+typedef struct {
+    TaskHandle_t handle;          // NULL = free slot; slot index is the resource instance ID
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t last_runtime;        // run-time counter at the previous snapshot
+    int32_t cpu_pct;
+    int32_t stack_free_bytes;
+    int32_t notified_cpu_pct;
+    int32_t notified_stack_free;
+    bool seen;
+} device_task_stat_t;
+
 typedef struct device_object_struct {
     const anjay_dm_object_def_t *def;
     char serial_number[64];
     char utc_offset[16];
     char timezone[32];
-    int32_t battery_level;
-    int32_t battery_status;
     uint32_t memory_free_kb;
     uint32_t memory_total_kb;
-    int32_t power_voltage_mv;
-    int32_t power_current_ma;
+    uint32_t min_free_heap_kb;
+    uint32_t largest_free_block_kb;
+    int32_t heap_fragmentation_pct;
+    int32_t cpu_load_pct; // -1 until two snapshots were taken
+    notify_filter_t nf_memory_free;
+    notify_filter_t nf_min_free_heap;
+    notify_filter_t nf_largest_block;
+    notify_filter_t nf_fragmentation;
+    notify_filter_t nf_cpu_load;
+    device_task_stat_t tasks[DEVICE_MAX_TASKS];
+#if DEVICE_HAVE_TASK_STATS
+    TaskStatus_t *scratch; // heap, grown to uxTaskGetNumberOfTasks() + margin
+    UBaseType_t scratch_len;
+    uint32_t last_total_runtime;
+    uint32_t last_idle_runtime;
+    bool have_runtime;
+    bool tasks_truncated; // last snapshot had more tasks than instance slots
+#endif
     bool do_reboot;
     TickType_t last_update_tick;
 } device_object_t;
@@ -81,9 +127,6 @@ static int list_resources(anjay_t *anjay,
     anjay_dm_emit_res(ctx, RID_SERIAL_NUMBER,             ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 2
     anjay_dm_emit_res(ctx, RID_FIRMWARE_VERSION,          ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 3
     anjay_dm_emit_res(ctx, RID_REBOOT,                    ANJAY_DM_RES_E,  ANJAY_DM_RES_PRESENT); // 4
-    anjay_dm_emit_res(ctx, RID_POWER_SOURCE_VOLTAGE,      ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 7
-    anjay_dm_emit_res(ctx, RID_POWER_SOURCE_CURRENT,      ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 8
-    anjay_dm_emit_res(ctx, RID_BATTERY_LEVEL,             ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 9
     anjay_dm_emit_res(ctx, RID_MEMORY_FREE,               ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 10
     anjay_dm_emit_res(ctx, RID_ERROR_CODE,                ANJAY_DM_RES_RM, ANJAY_DM_RES_PRESENT); // 11 (multi-instance)
     anjay_dm_emit_res(ctx, RID_CURRENT_TIME,              ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 13
@@ -93,8 +136,15 @@ static int list_resources(anjay_t *anjay,
     anjay_dm_emit_res(ctx, RID_DEVICE_TYPE,               ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 17
     anjay_dm_emit_res(ctx, RID_HARDWARE_VERSION,          ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 18
     anjay_dm_emit_res(ctx, RID_SOFTWARE_VERSION,          ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 19
-    anjay_dm_emit_res(ctx, RID_BATTERY_STATUS,            ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 20
     anjay_dm_emit_res(ctx, RID_MEMORY_TOTAL,              ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT); // 21
+    const anjay_dm_resource_presence_t task_stats = DEVICE_HAVE_TASK_STATS ? ANJAY_DM_RES_PRESENT : ANJAY_DM_RES_ABSENT;
+    anjay_dm_emit_res(ctx, RID_CPU_LOAD,                  ANJAY_DM_RES_R,  task_stats);
+    anjay_dm_emit_res(ctx, RID_MIN_FREE_HEAP,             ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_LARGEST_FREE_BLOCK,        ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_HEAP_FRAGMENTATION,        ANJAY_DM_RES_R,  ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_TASK_NAME,                 ANJAY_DM_RES_RM, task_stats);
+    anjay_dm_emit_res(ctx, RID_TASK_CPU,                  ANJAY_DM_RES_RM, task_stats);
+    anjay_dm_emit_res(ctx, RID_TASK_STACK_FREE,           ANJAY_DM_RES_RM, task_stats);
     return 0;
 }
 
@@ -103,11 +153,22 @@ static int list_resource_instances(anjay_t *anjay,
                                    anjay_iid_t iid,
                                    anjay_rid_t rid,
                                    anjay_dm_list_ctx_t *ctx) {
-    (void) anjay; (void) obj_ptr; (void) iid;
+    (void) anjay; (void) iid;
     switch (rid) {
     case RID_ERROR_CODE:
         anjay_dm_emit(ctx, 0);
         return 0;
+    case RID_TASK_NAME:
+    case RID_TASK_CPU:
+    case RID_TASK_STACK_FREE: {
+        const device_object_t *obj = get_obj(obj_ptr);
+        for (anjay_riid_t i = 0; i < DEVICE_MAX_TASKS; i++) {
+            if (obj->tasks[i].handle) {
+                anjay_dm_emit(ctx, i);
+            }
+        }
+        return 0;
+    }
     default:
         return ANJAY_ERR_METHOD_NOT_ALLOWED;
     }
@@ -121,34 +182,140 @@ static int64_t get_current_time_seconds(void) {
     return (int64_t) (esp_timer_get_time() / 1000000ULL);
 }
 
-static int32_t clamp_i32(int32_t value, int32_t min, int32_t max) {
-    if (value < min) {
-        return min;
+static void refresh_heap_metrics(device_object_t *obj) {
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    obj->memory_free_kb = free_bytes / 1024;
+    obj->min_free_heap_kb = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT) / 1024;
+    obj->largest_free_block_kb = largest / 1024;
+    obj->heap_fragmentation_pct = free_bytes ? (int32_t) (100 - (uint64_t) largest * 100 / free_bytes) : 0;
+}
+
+#if DEVICE_HAVE_TASK_STATS
+static device_task_stat_t *find_task_slot(device_object_t *obj, TaskHandle_t handle, bool *is_new) {
+    device_task_stat_t *free_slot = NULL;
+    for (int i = 0; i < DEVICE_MAX_TASKS; i++) {
+        if (obj->tasks[i].handle == handle) {
+            *is_new = false;
+            return &obj->tasks[i];
+        }
+        if (!obj->tasks[i].handle && !free_slot) {
+            free_slot = &obj->tasks[i];
+        }
     }
-    if (value > max) {
-        return max;
+    *is_new = true;
+    return free_slot;
+}
+
+// uxTaskGetSystemState() returns 0 when the array is smaller than the task
+// count, so size it from the current count and retry once if a task was
+// created in between. Returns the number of entries filled (0 on failure).
+static UBaseType_t take_task_snapshot(device_object_t *obj, uint32_t *total_runtime) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        UBaseType_t want = uxTaskGetNumberOfTasks() + DEVICE_TASK_SNAPSHOT_MARGIN;
+        if (want > obj->scratch_len) {
+            TaskStatus_t *grown = (TaskStatus_t *) avs_realloc(obj->scratch, want * sizeof(TaskStatus_t));
+            if (!grown) {
+                ESP_LOGW(TAG, "No memory for %u task records; per-task stats skipped", (unsigned) want);
+                return 0;
+            }
+            obj->scratch = grown;
+            obj->scratch_len = want;
+        }
+        UBaseType_t n = uxTaskGetSystemState(obj->scratch, obj->scratch_len, total_runtime);
+        if (n > 0) {
+            return n;
+        }
     }
-    return value;
+    ESP_LOGW(TAG, "Task count kept growing past %u; per-task stats skipped", (unsigned) obj->scratch_len);
+    return 0;
 }
 
-static void refresh_dynamic_metrics(device_object_t *obj) {
-    int32_t delta = (int32_t) (esp_random() % 11) - 5;
-    obj->battery_level = clamp_i32(obj->battery_level + delta, 5, 100);
-    if (obj->battery_level > 80) {
-        obj->battery_status = 0; // NORMAL
-    } else if (obj->battery_level > 40) {
-        obj->battery_status = (delta < 0) ? 2 : 1; // DISCHARGING / CHARGING
-    } else {
-        obj->battery_status = 4; // NEED_REPLACEMENT
+// Run time of the idle task(s), whether or not they fit in the listed instances
+static uint32_t idle_runtime(void) {
+#if portNUM_PROCESSORS > 1
+    uint32_t sum = 0;
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+        sum += ulTaskGetIdleRunTimeCounterForCore(core);
     }
+    return sum;
+#else
+    return ulTaskGetIdleRunTimeCounter();
+#endif
+}
 
-    obj->memory_free_kb = heap_caps_get_free_size(MALLOC_CAP_8BIT) / 1024;
+// One uxTaskGetSystemState() snapshot per period; CPU shares come from the delta of
+// each task's run-time counter against the previous snapshot (unsigned, wrap-safe).
+// Returns true if the set of tasks changed.
+static bool refresh_task_metrics(device_object_t *obj) {
+    uint32_t total_runtime = 0;
+    UBaseType_t n = take_task_snapshot(obj, &total_runtime);
+    if (n == 0) {
+        return false;
+    }
+    uint32_t idle_now = idle_runtime();
+    uint64_t elapsed = (uint64_t) (uint32_t) (total_runtime - obj->last_total_runtime) * portNUM_PROCESSORS;
+    bool valid = obj->have_runtime && elapsed > 0;
+    bool set_changed = false;
+    UBaseType_t unlisted = 0;
 
-    int32_t volt_delta = (int32_t) (esp_random() % 101) - 50;
-    obj->power_voltage_mv = clamp_i32(obj->power_voltage_mv + volt_delta, 3600, 4200);
+    for (int i = 0; i < DEVICE_MAX_TASKS; i++) {
+        obj->tasks[i].seen = false;
+    }
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *ts = &obj->scratch[i];
+        bool is_new;
+        device_task_stat_t *slot = find_task_slot(obj, ts->xHandle, &is_new);
+        if (!slot) {
+            unlisted++; // table full; the task shows up once another one is deleted
+            continue;
+        }
+        if (is_new) {
+            memset(slot, 0, sizeof(*slot));
+            slot->handle = ts->xHandle;
+            strlcpy(slot->name, ts->pcTaskName, sizeof(slot->name));
+            slot->notified_cpu_pct = -1;
+            slot->notified_stack_free = -1;
+            set_changed = true;
+        } else if (valid) {
+            uint32_t delta = (uint32_t) (ts->ulRunTimeCounter - slot->last_runtime);
+            slot->cpu_pct = (int32_t) (((uint64_t) delta * 100 + elapsed / 2) / elapsed);
+        }
+        slot->last_runtime = ts->ulRunTimeCounter;
+        // ESP-IDF StackType_t is a byte, so the high-water mark is already in bytes
+        slot->stack_free_bytes = (int32_t) ts->usStackHighWaterMark;
+        slot->seen = true;
+    }
+    for (int i = 0; i < DEVICE_MAX_TASKS; i++) {
+        if (obj->tasks[i].handle && !obj->tasks[i].seen) {
+            obj->tasks[i].handle = NULL; // task was deleted
+            set_changed = true;
+        }
+    }
+    if ((unlisted > 0) != obj->tasks_truncated) {
+        obj->tasks_truncated = unlisted > 0;
+        if (unlisted > 0) {
+            ESP_LOGW(TAG, "%u of %u tasks not listed (max %d instances)", (unsigned) unlisted, (unsigned) n,
+                     DEVICE_MAX_TASKS);
+        }
+    }
+    if (valid) {
+        uint32_t idle_delta = idle_now - obj->last_idle_runtime;
+        int32_t idle_pct = (int32_t) (((uint64_t) idle_delta * 100 + elapsed / 2) / elapsed);
+        obj->cpu_load_pct = idle_pct >= 100 ? 0 : 100 - idle_pct;
+    }
+    obj->last_idle_runtime = idle_now;
+    obj->last_total_runtime = total_runtime;
+    obj->have_runtime = true;
+    return set_changed;
+}
+#endif // DEVICE_HAVE_TASK_STATS
 
-    int32_t curr_delta = (int32_t) (esp_random() % 23) - 11;
-    obj->power_current_ma = clamp_i32(obj->power_current_ma + curr_delta, 50, 220);
+static const device_task_stat_t *get_task(const device_object_t *obj, anjay_riid_t riid) {
+    if (riid >= DEVICE_MAX_TASKS || !obj->tasks[riid].handle) {
+        return NULL;
+    }
+    return &obj->tasks[riid];
 }
 
 static int resource_read(anjay_t *anjay,
@@ -189,9 +356,6 @@ static int resource_read(anjay_t *anjay,
     case RID_HARDWARE_VERSION:
         assert(riid == ANJAY_ID_INVALID);
         return anjay_ret_string(ctx, DEVICE_MODEL);
-    case RID_BATTERY_LEVEL:
-        assert(riid == ANJAY_ID_INVALID);
-        return anjay_ret_i32(ctx, obj->battery_level);
     case RID_MEMORY_FREE:
         assert(riid == ANJAY_ID_INVALID);
         return anjay_ret_i64(ctx, (int64_t) obj->memory_free_kb);
@@ -204,18 +368,36 @@ static int resource_read(anjay_t *anjay,
     case RID_TIMEZONE:
         assert(riid == ANJAY_ID_INVALID);
         return anjay_ret_string(ctx, obj->timezone);
-    case RID_BATTERY_STATUS:
-        assert(riid == ANJAY_ID_INVALID);
-        return anjay_ret_i32(ctx, obj->battery_status);
     case RID_MEMORY_TOTAL:
         assert(riid == ANJAY_ID_INVALID);
         return anjay_ret_i64(ctx, (int64_t) obj->memory_total_kb);
-    case RID_POWER_SOURCE_VOLTAGE:
+    case RID_CPU_LOAD:
+        assert(riid == ANJAY_ID_INVALID);
+        if (obj->cpu_load_pct < 0) {
+            return ANJAY_ERR_SERVICE_UNAVAILABLE; // needs two snapshots
+        }
+        return anjay_ret_i32(ctx, obj->cpu_load_pct);
+    case RID_MIN_FREE_HEAP:
         assert(riid == ANJAY_ID_INVALID);
-        return anjay_ret_i32(ctx, obj->power_voltage_mv);
-    case RID_POWER_SOURCE_CURRENT:
+        return anjay_ret_i64(ctx, (int64_t) obj->min_free_heap_kb);
+    case RID_LARGEST_FREE_BLOCK:
         assert(riid == ANJAY_ID_INVALID);
-        return anjay_ret_i32(ctx, obj->power_current_ma);
+        return anjay_ret_i64(ctx, (int64_t) obj->largest_free_block_kb);
+    case RID_HEAP_FRAGMENTATION:
+        assert(riid == ANJAY_ID_INVALID);
+        return anjay_ret_i32(ctx, obj->heap_fragmentation_pct);
+    case RID_TASK_NAME:
+    case RID_TASK_CPU:
+    case RID_TASK_STACK_FREE: {
+        const device_task_stat_t *task = get_task(obj, riid);
+        if (!task) {
+            return ANJAY_ERR_NOT_FOUND;
+        }
+        if (rid == RID_TASK_NAME) {
+            return anjay_ret_string(ctx, task->name);
+        }
+        return anjay_ret_i32(ctx, rid == RID_TASK_CPU ? task->cpu_pct : task->stack_free_bytes);
+    }
     default:
         ESP_LOGW(TAG, "Unhandled Device resource read RID=%d", rid);
         return ANJAY_ERR_NOT_FOUND;
@@ -272,7 +454,7 @@ static int resource_execute(anjay_t *anjay,
 }
 
 static const anjay_dm_object_def_t OBJ_DEF = {
-    .oid = 3,
+    .oid = OID_DEVICE,
     .version = "1.3",
     .handlers = {
         .list_instances = anjay_dm_list_instances_SINGLE,
@@ -301,12 +483,19 @@ const anjay_dm_object_def_t **device_object_create(const char *endpoint_name) {
     }
     strlcpy(obj->utc_offset, "+00:00", sizeof(obj->utc_offset));
     strlcpy(obj->timezone, "UTC", sizeof(obj->timezone));
-    obj->battery_level = 95;
-    obj->battery_status = 0;
     obj->memory_total_kb = heap_caps_get_total_size(MALLOC_CAP_8BIT) / 1024;
-    obj->memory_free_kb = heap_caps_get_free_size(MALLOC_CAP_8BIT) / 1024;
-    obj->power_voltage_mv = 3900;
-    obj->power_current_ma = 120;
+    obj->cpu_load_pct = -1;
+    notify_filter_init(&obj->nf_memory_free, OID_DEVICE, 0, RID_MEMORY_FREE, DEVICE_MEMORY_STEP_KB);
+    notify_filter_init(&obj->nf_min_free_heap, OID_DEVICE, 0, RID_MIN_FREE_HEAP, 1);
+    notify_filter_init(&obj->nf_largest_block, OID_DEVICE, 0, RID_LARGEST_FREE_BLOCK, DEVICE_MEMORY_STEP_KB);
+    notify_filter_init(&obj->nf_fragmentation, OID_DEVICE, 0, RID_HEAP_FRAGMENTATION, DEVICE_CPU_STEP_PCT);
+    notify_filter_init(&obj->nf_cpu_load, OID_DEVICE, 0, RID_CPU_LOAD, DEVICE_CPU_STEP_PCT);
+    refresh_heap_metrics(obj);
+#if DEVICE_HAVE_TASK_STATS
+    (void) refresh_task_metrics(obj); // baseline for the first CPU shares
+#else
+    ESP_LOGW(TAG, "FreeRTOS run-time stats disabled; CPU/task resources absent");
+#endif
     obj->last_update_tick = xTaskGetTickCount();
     ESP_LOGI(TAG, "Device(3) instance initialized");
     return &obj->def;
@@ -315,6 +504,9 @@ const anjay_dm_object_def_t **device_object_create(const char *endpoint_name) {
 void device_object_release(const anjay_dm_object_def_t **def) {
     if (def) {
         device_object_t *obj = get_obj(def);
+#if DEVICE_HAVE_TASK_STATS
+        avs_free(obj->scratch);
+#endif
         avs_free(obj);
     }
 }
@@ -329,14 +521,57 @@ void device_object_update(anjay_t *anjay, const anjay_dm_object_def_t *const *de
         esp_system_abort("Rebooting ...");
     }
     TickType_t now = xTaskGetTickCount();
-    if ((now - obj->last_update_tick) >= pdMS_TO_TICKS(DEVICE_UPDATE_PERIOD_MS)) {
-        obj->last_update_tick = now;
-        refresh_dynamic_metrics(obj);
-        anjay_notify_changed(anjay, 3, 0, RID_BATTERY_LEVEL);
-        anjay_notify_changed(anjay, 3, 0, RID_MEMORY_FREE);
-        anjay_notify_changed(anjay, 3, 0, RID_BATTERY_STATUS);
-        anjay_notify_changed(anjay, 3, 0, RID_CURRENT_TIME);
-        anjay_notify_changed(anjay, 3, 0, RID_POWER_SOURCE_VOLTAGE);
-        anjay_notify_changed(anjay, 3, 0, RID_POWER_SOURCE_CURRENT);
+    if ((now - obj->last_update_tick) < pdMS_TO_TICKS(DEVICE_UPDATE_PERIOD_MS)) {
+        return;
     }
+    obj->last_update_tick = now;
+
+    // Notify only on meaningful change: server gt/lt/st if set, otherwise the steps above
+    refresh_heap_metrics(obj);
+    if (notify_filter_should_notify(anjay, &obj->nf_memory_free, (double) obj->memory_free_kb)) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_MEMORY_FREE);
+    }
+    if (notify_filter_should_notify(anjay, &obj->nf_min_free_heap, (double) obj->min_free_heap_kb)) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_MIN_FREE_HEAP);
+    }
+    if (notify_filter_should_notify(anjay, &obj->nf_largest_block, (double) obj->largest_free_block_kb)) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_LARGEST_FREE_BLOCK);
+    }
+    if (notify_filter_should_notify(anjay, &obj->nf_fragmentation, (double) obj->heap_fragmentation_pct)) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_HEAP_FRAGMENTATION);
+    }
+
+#if DEVICE_HAVE_TASK_STATS
+    bool set_changed = refresh_task_metrics(obj);
+    if (obj->cpu_load_pct >= 0
+        && notify_filter_should_notify(anjay, &obj->nf_cpu_load, (double) obj->cpu_load_pct)) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_CPU_LOAD);
+    }
+    bool cpu_changed = false;
+    bool stack_changed = false;
+    for (int i = 0; i < DEVICE_MAX_TASKS; i++) {
+        device_task_stat_t *t = &obj->tasks[i];
+        if (!t->handle) {
+            continue;
+        }
+        if (t->notified_cpu_pct < 0 || abs(t->cpu_pct - t->notified_cpu_pct) >= DEVICE_CPU_STEP_PCT) {
+            t->notified_cpu_pct = t->cpu_pct;
+            cpu_changed = true;
+        }
+        // High-water marks only shrink; report once a task ate another step of its headroom
+        if (t->notified_stack_free < 0 || t->notified_stack_free - t->stack_free_bytes >= DEVICE_STACK_STEP_BYTES) {
+            t->notified_stack_free = t->stack_free_bytes;
+            stack_changed = true;
+        }
+    }
+    if (set_changed) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_TASK_NAME);
+    }
+    if (set_changed || cpu_changed) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_TASK_CPU);
+    }
+    if (set_changed || stack_changed) {
+        anjay_notify_changed(anjay, OID_DEVICE, 0, RID_TASK_STACK_FREE);
+    }
+#endif
 }
@@ -7,6 +7,10 @@
 // Returns 0 on success, negative value on error.
 int fw_update_install(anjay_t *anjay);
 
+// Holds an ongoing pull download while the network link is down and continues it
+// once the link is back. Call from the LwM2M task after each event loop pass.
+void fw_update_poll(anjay_t *anjay);
+
 // Returns true if a firmware update has been requested and device should reboot.
 bool fw_update_requested(void);
 
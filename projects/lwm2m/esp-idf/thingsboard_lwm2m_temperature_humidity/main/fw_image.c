@@ -0,0 +1,136 @@
+#include "fw_image.h"
+
+#include <string.h>
+
+// ESP_IMAGE_HEADER_MAGIC and the esp_image_header_t.hash_appended offset
+#define IMG_MAGIC 0xE9
+#define IMG_HASH_APPENDED_OFFSET 23
+// Sanity bound for a single segment (larger than any app partition)
+#define IMG_MAX_SEGMENT_LEN (16u * 1024 * 1024)
+
+enum { IMG_HEADER, IMG_SEG_HDR, IMG_SEG_DATA, IMG_PAD, IMG_DIGEST, IMG_TRAILER, IMG_ERROR };
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+void fw_image_init(fw_image_parser_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->state = IMG_HEADER;
+}
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// After the last segment: one checksum byte, padded so the region ends on 16 bytes
+static void after_segment(fw_image_parser_t *p) {
+    if (p->segments_left) {
+        p->state = IMG_SEG_HDR;
+        return;
+    }
+    p->hashed_len = (p->offset + 1 + 15) & ~15u;
+    p->state = IMG_PAD;
+}
+
+static bool collect(fw_image_parser_t *p, const uint8_t *data, size_t avail, size_t want, size_t *used) {
+    size_t n = min_size(avail, want - p->buf_len);
+    memcpy(&p->buf[p->buf_len], data, n);
+    p->buf_len += (uint8_t) n;
+    *used = n;
+    return p->buf_len == want;
+}
+
+int fw_image_feed(fw_image_parser_t *p, const uint8_t *data, size_t len) {
+    size_t hashed = 0;
+    size_t i = 0;
+    while (i < len) {
+        size_t avail = len - i;
+        size_t n = 0;
+        switch (p->state) {
+        case IMG_HEADER:
+            if (collect(p, &data[i], avail, FW_IMAGE_HEADER_SIZE, &n)) {
+                if (p->buf[0] != IMG_MAGIC || p->buf[1] == 0 || p->buf[1] > FW_IMAGE_MAX_SEGMENTS) {
+                    p->state = IMG_ERROR;
+                    return -1;
+                }
+                p->segments_left = p->buf[1];
+                p->hash_appended = p->buf[IMG_HASH_APPENDED_OFFSET] == 1;
+                p->buf_len = 0;
+                p->state = IMG_SEG_HDR;
+            }
+            hashed += n;
+            break;
+        case IMG_SEG_HDR:
+            if (collect(p, &data[i], avail, FW_IMAGE_SEGMENT_HEADER_SIZE, &n)) {
+                uint32_t data_len = get_le32(&p->buf[4]);
+                if (data_len > IMG_MAX_SEGMENT_LEN) {
+                    p->state = IMG_ERROR;
+                    return -1;
+                }
+                p->buf_len = 0;
+                p->segments_left--;
+                p->seg_end = p->offset + (uint32_t) n + data_len;
+                p->state = IMG_SEG_DATA;
+            }
+            hashed += n;
+            break;
+        case IMG_SEG_DATA:
+            n = min_size(avail, p->seg_end - p->offset);
+            hashed += n;
+            break;
+        case IMG_PAD:
+            n = min_size(avail, p->hashed_len - p->offset);
+            hashed += n;
+            break;
+        case IMG_DIGEST:
+            n = min_size(avail, FW_IMAGE_DIGEST_SIZE - p->digest_len);
+            memcpy(&p->digest[p->digest_len], &data[i], n);
+            p->digest_len += (uint8_t) n;
+            if (p->digest_len == FW_IMAGE_DIGEST_SIZE) {
+                p->state = IMG_TRAILER;
+            }
+            break;
+        case IMG_TRAILER: {
+            size_t keep = min_size(avail, FW_IMAGE_TRAILER_MAX - p->trailer_len);
+            memcpy(&p->trailer[p->trailer_len], &data[i], keep);
+            p->trailer_len += (uint16_t) keep;
+            n = avail; // anything beyond the manifest is ignored
+            break;
+        }
+        default:
+            return -1;
+        }
+        i += n;
+        p->offset += (uint32_t) n;
+        if (p->state == IMG_SEG_DATA && p->offset == p->seg_end) {
+            after_segment(p);
+        } else if (p->state == IMG_PAD && p->offset == p->hashed_len) {
+            p->state = p->hash_appended ? IMG_DIGEST : IMG_TRAILER;
+        }
+    }
+    return (int) hashed;
+}
+
+bool fw_image_hashed_complete(const fw_image_parser_t *p) {
+    return p->hashed_len != 0 && p->offset >= p->hashed_len;
+}
+
+bool fw_image_digest_complete(const fw_image_parser_t *p) {
+    return p->hash_appended && p->digest_len == FW_IMAGE_DIGEST_SIZE;
+}
+
+int fw_image_manifest_signature(const fw_image_parser_t *p, const uint8_t **sig, size_t *sig_len) {
+    if (p->state != IMG_TRAILER || p->trailer_len < FW_IMAGE_MANIFEST_HEADER_SIZE
+            || memcmp(p->trailer, FW_IMAGE_MANIFEST_MAGIC, 4) != 0
+            || p->trailer[4] != FW_IMAGE_MANIFEST_VERSION) {
+        return -1;
+    }
+    size_t len = (size_t) p->trailer[5] | ((size_t) p->trailer[6] << 8);
+    if (len == 0 || len > (size_t) p->trailer_len - FW_IMAGE_MANIFEST_HEADER_SIZE) {
+        return -1;
+    }
+    *sig = &p->trailer[FW_IMAGE_MANIFEST_HEADER_SIZE];
+    *sig_len = len;
+    return 0;
+}
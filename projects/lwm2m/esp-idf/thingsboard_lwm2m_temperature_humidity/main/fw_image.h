@@ -0,0 +1,63 @@
+#pragma once
+
+// Streaming parser for ESP-IDF app images as they are written to flash.
+// It follows the header and segment table to find where the hashed part of the
+// image ends (segments + checksum padding), then collects the appended SHA-256
+// and anything that follows it (the signed manifest, see tools/fw_package.py).
+// The caller hashes exactly the bytes reported by fw_image_feed(), so the digest
+// is ready when the last block arrives, without reading the partition back.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FW_IMAGE_HEADER_SIZE 24
+#define FW_IMAGE_SEGMENT_HEADER_SIZE 8
+#define FW_IMAGE_MAX_SEGMENTS 16
+#define FW_IMAGE_DIGEST_SIZE 32
+#define FW_IMAGE_TRAILER_MAX 264
+
+// Signed manifest after the image: "FWSG", u8 version, u16 LE signature length,
+// DER signature of the image SHA-256 (ECDSA or RSA)
+#define FW_IMAGE_MANIFEST_MAGIC "FWSG"
+#define FW_IMAGE_MANIFEST_VERSION 1
+#define FW_IMAGE_MANIFEST_HEADER_SIZE 7
+
+typedef struct {
+    uint32_t offset;       // bytes consumed
+    uint32_t hashed_len;   // end of the hashed region, 0 until the segment table is parsed
+    uint32_t seg_end;      // end of the current segment's data
+    uint8_t state;
+    uint8_t segments_left;
+    bool hash_appended;
+    uint8_t buf[FW_IMAGE_HEADER_SIZE];
+    uint8_t buf_len;
+    uint8_t digest[FW_IMAGE_DIGEST_SIZE];
+    uint8_t digest_len;
+    uint8_t trailer[FW_IMAGE_TRAILER_MAX];
+    uint16_t trailer_len;
+} fw_image_parser_t;
+
+void fw_image_init(fw_image_parser_t *p);
+
+// Consumes len bytes. Returns how many leading bytes of data belong to the hashed
+// region, or -1 if the stream is not a well-formed app image.
+int fw_image_feed(fw_image_parser_t *p, const uint8_t *data, size_t len);
+
+// True once the whole hashed region has been seen
+bool fw_image_hashed_complete(const fw_image_parser_t *p);
+
+// True once the appended SHA-256 has been received completely
+bool fw_image_digest_complete(const fw_image_parser_t *p);
+
+// Finds the signature in the manifest trailer. Returns 0 and sets sig/sig_len on
+// success, -1 if there is no well-formed manifest.
+int fw_image_manifest_signature(const fw_image_parser_t *p, const uint8_t **sig, size_t *sig_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+// Streaming decoder for compressed and delta firmware packages (tools/fw_package.py).
+//
+// Layout (little endian):
+//   0  "FWPK"            magic
+//   4  u8  version       FW_PKG_VERSION
+//   5  u8  flags         FW_PKG_FLAG_*
+//   6  u8  window_bits   LZSS window, 2^window_bits bytes of RAM in the decoder
+//   7  u8  lookahead_bits
+//   8  u32 image_size    size of the reconstructed app image
+//   12 u32 base_size     delta: bytes of the running image the patch applies to
+//   16 u8  base_sha256[32]
+//   48 payload
+//
+// The payload is heatshrink-compatible LZSS when COMPRESSED is set. With DELTA the
+// (decompressed) payload is a sequence of records
+//   zigzag varint seek, varint diff_len, varint extra_len, diff bytes, extra bytes
+// where seek moves the base pointer, each diff byte is added to the next base byte
+// and extra bytes are copied verbatim. Everything is decoded as it arrives, with
+// the LZSS window and two small chunk buffers as the only state.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FW_PKG_MAGIC "FWPK"
+#define FW_PKG_VERSION 1
+#define FW_PKG_HEADER_SIZE 48
+
+#define FW_PKG_FLAG_COMPRESSED 0x01
+#define FW_PKG_FLAG_DELTA 0x02
+
+#define FW_PKG_MIN_WINDOW_BITS 4
+#define FW_PKG_MAX_WINDOW_BITS 14
+#define FW_PKG_CHUNK 256
+
+enum {
+    FW_PKG_OK = 0,
+    FW_PKG_ERR_FORMAT = -1, // malformed header or payload
+    FW_PKG_ERR_SINK = -2,   // output callback failed
+    FW_PKG_ERR_BASE = -3,   // base read failed or out of range
+    FW_PKG_ERR_NOMEM = -4,
+};
+
+typedef struct {
+    uint8_t flags;
+    uint8_t window_bits;
+    uint8_t lookahead_bits;
+    uint32_t image_size;
+    uint32_t base_size;
+    uint8_t base_sha256[32];
+} fw_pkg_header_t;
+
+// Receives decoded image bytes in order. Returns 0 on success.
+typedef int fw_pkg_sink_fn(void *ctx, const uint8_t *data, size_t len);
+// Reads len bytes of the base image at offset. Returns 0 on success.
+typedef int fw_pkg_base_read_fn(void *ctx, uint32_t offset, void *dst, size_t len);
+
+typedef struct {
+    fw_pkg_header_t hdr;
+    fw_pkg_sink_fn *sink;
+    void *sink_ctx;
+    fw_pkg_base_read_fn *base_read;
+    void *base_ctx;
+    uint32_t produced;
+    // LZSS
+    uint8_t *window;
+    uint16_t head;
+    uint32_t bits;
+    uint8_t bit_count;
+    uint8_t lz_state;
+    uint16_t lz_index;
+    // Delta records
+    uint8_t d_state;
+    uint8_t d_shift;
+    uint32_t d_value;
+    uint32_t diff_left;
+    uint32_t extra_left;
+    uint32_t base_pos;
+    uint32_t base_buf_pos;
+    uint16_t base_buf_len;
+    uint8_t base_buf[FW_PKG_CHUNK];
+    // Output batching
+    uint16_t out_len;
+    uint8_t out[FW_PKG_CHUNK];
+} fw_pkg_decoder_t;
+
+// Parses a FW_PKG_HEADER_SIZE byte header. Returns FW_PKG_OK or FW_PKG_ERR_FORMAT.
+int fw_pkg_parse_header(const uint8_t *buf, fw_pkg_header_t *out);
+
+// base_read may be NULL unless the package is a delta
+int fw_pkg_decoder_init(fw_pkg_decoder_t *d, const fw_pkg_header_t *hdr,
+                        fw_pkg_sink_fn *sink, void *sink_ctx,
+                        fw_pkg_base_read_fn *base_read, void *base_ctx);
+// Decodes payload bytes (everything after the header), in any split
+int fw_pkg_decoder_feed(fw_pkg_decoder_t *d, const uint8_t *data, size_t len);
+// Flushes output and checks that exactly image_size bytes were produced
+int fw_pkg_decoder_finish(fw_pkg_decoder_t *d);
+void fw_pkg_decoder_free(fw_pkg_decoder_t *d);
+
+#ifdef __cplusplus
+}
+#endif
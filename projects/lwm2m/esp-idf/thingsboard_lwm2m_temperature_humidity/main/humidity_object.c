@@ -9,6 +9,11 @@
 #include <anjay/io.h>
 #include <esp_log.h>
 
+#include "sensor_driver.h"
+#include "window_stats.h"
+#include "notify_filter.h"
+#include "rule_object.h"
+
 #define OID_HUMIDITY 3304
 #define IID_DEFAULT 0
 #define RID_SENSOR_VALUE 5700
@@ -16,21 +21,44 @@
 #define RID_MIN_MEASURED 5601
 #define RID_MAX_MEASURED 5602
 #define RID_RESET_MIN_MAX 5605
+// Windowed aggregates (custom RIDs, same range as the smart meter's control resources)
+#define RID_WINDOW_LENGTH 60000 // int: window length in seconds (RW)
+#define RID_WINDOW_MODE   60001 // int: 0=sliding,1=tumbling (RW)
+#define RID_WINDOW_AVG    60002 // float: mean over the window
+#define RID_WINDOW_STDDEV 60003 // float: population std deviation over the window
+#define RID_WINDOW_MIN    60004 // float: min over the window
+#define RID_WINDOW_MAX    60005 // float: max over the window
+#define RID_WINDOW_COUNT  60006 // int: samples aggregated in the result
+
+#ifndef CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS
+#define CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS 1000
+#endif
+#ifndef CONFIG_TH_SENSOR_WINDOW_DEFAULT_S
+#define CONFIG_TH_SENSOR_WINDOW_DEFAULT_S 60
+#endif
+#ifdef CONFIG_TH_SENSOR_WINDOW_TUMBLING
+#define WINDOW_DEFAULT_MODE WINDOW_TUMBLING
+#else
+#define WINDOW_DEFAULT_MODE WINDOW_SLIDING
+#endif
+// Longest window the ring can hold at the configured sample period
+#define WINDOW_MAX_SECONDS ((int32_t) ((uint64_t) WINDOW_STATS_CAPACITY * CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS / 1000))
 
-#define HUM_SAMPLE_INTERVAL_MS 1000
+// Fallback change threshold when the server set no gt/lt/st on 5700
 #define HUM_DELTA_EPS 0.01f
 
 static const char *TAG = "humid_obj";
 
-static float read_humidity_sensor(void) {
-    TickType_t ticks = xTaskGetTickCount();
-    float base = 55.0f;
-    // Adjust phase so adjacent samples a few seconds apart differ
-    float phase = (float) (ticks % 12000) / 300.0f;
-    float delta = 10.0f * sinf(phase);
-    // Deterministic small dither (sawtooth ~ +/-0.2 %RH)
-    float saw = ((float) (ticks & 63) / 63.0f - 0.5f) * 0.40f;
-    return base + delta + saw;
+// Latest cached conversion from sensor_driver: O(1), never touches the I2C bus.
+// Returns false when no sample exists yet or the newest one exceeded its max age.
+static bool cached_humidity(float *value, uint32_t *seq) {
+    sensor_sample_t sample;
+    if (sensor_driver_get(&sample) != SENSOR_SAMPLE_FRESH) {
+        return false;
+    }
+    *value = sample.humidity_pct;
+    *seq = sample.seq;
+    return true;
 }
 
 static bool g_have_value = false;
@@ -39,7 +67,29 @@ static float g_min_measured = 0.0f;
 static float g_max_measured = 0.0f;
 static float g_last_notified = 0.0f;
 static TickType_t g_last_notify_tick = 0;
-static TickType_t g_last_sample_tick = 0;
+static uint32_t g_last_seq = 0; // sensor_cache sequence of the last recorded sample
+static uint8_t g_rule_signal = RULE_SIGNAL_NONE;
+static notify_filter_t g_value_filter = NOTIFY_FILTER_INIT(OID_HUMIDITY, IID_DEFAULT, RID_SENSOR_VALUE, HUM_DELTA_EPS);
+
+static window_stats_t g_window;
+static bool g_window_initialized = false;
+static int32_t g_window_length_s = CONFIG_TH_SENSOR_WINDOW_DEFAULT_S;
+static window_mode_t g_window_mode = WINDOW_DEFAULT_MODE;
+
+static void window_reset(void) {
+    int32_t samples = (int32_t) ((int64_t) g_window_length_s * 1000 / CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS);
+    window_stats_init(&g_window, g_window_mode, (uint16_t) (samples < 1 ? 1 : samples > WINDOW_STATS_CAPACITY ? WINDOW_STATS_CAPACITY : samples));
+    g_window_initialized = true;
+}
+
+static void notify_window(anjay_t *anjay) {
+    static const anjay_rid_t rids[] = {
+        RID_WINDOW_AVG, RID_WINDOW_STDDEV, RID_WINDOW_MIN, RID_WINDOW_MAX, RID_WINDOW_COUNT
+    };
+    for (size_t i = 0; i < sizeof(rids) / sizeof(rids[0]); ++i) {
+        (void) anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, rids[i]);
+    }
+}
 
 static bool record_sample(float value, bool *min_changed, bool *max_changed) {
     if (min_changed) { *min_changed = false; }
@@ -67,9 +117,14 @@ static bool record_sample(float value, bool *min_changed, bool *max_changed) {
     return first;
 }
 
+// Seeds the current value for reads before the first update. Does not
+// consume the sample: *_object_update() still feeds it to the window
+// statistics, the notify filter and the rules.
 static void ensure_sample(void) {
-    if (!g_have_value) {
-        (void) record_sample(read_humidity_sensor(), NULL, NULL);
+    float value;
+    uint32_t seq;
+    if (!g_have_value && cached_humidity(&value, &seq)) {
+        (void) record_sample(value, NULL, NULL);
         g_last_notified = g_current_value;
         g_last_notify_tick = xTaskGetTickCount();
         ESP_LOGD(TAG, "init sample: value=%.3f%%RH min=%.3f max=%.3f", g_current_value, g_min_measured, g_max_measured);
@@ -94,6 +149,13 @@ static int hum_list_resources(anjay_t *anjay,
     anjay_dm_emit_res(ctx, RID_RESET_MIN_MAX, ANJAY_DM_RES_E, ANJAY_DM_RES_PRESENT);
     anjay_dm_emit_res(ctx, RID_SENSOR_VALUE, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
     anjay_dm_emit_res(ctx, RID_SENSOR_UNITS, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_LENGTH, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_MODE, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_AVG, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_STDDEV, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_MIN, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_MAX, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_WINDOW_COUNT, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
     return 0;
 }
 
@@ -106,24 +168,94 @@ static int hum_read(anjay_t *anjay,
     (void) anjay; (void) def; (void) iid; (void) riid;
     ensure_sample();
     switch (rid) {
-    case RID_SENSOR_VALUE:
-        // Fresh sample on read to ensure pmax-driven notifies include new data
-        {
-            bool dummy_min = false, dummy_max = false;
-            float value = read_humidity_sensor();
-            (void) record_sample(value, &dummy_min, &dummy_max);
-            ESP_LOGD(TAG, "READ /3304/0/5700 -> %.3f%%RH (fresh)", g_current_value);
-            return anjay_ret_float(ctx, g_current_value);
+    case RID_SENSOR_VALUE: {
+        // Serve the cached conversion: pmax-driven notifies still carry the newest
+        // data, but no I2C transaction ever runs on the CoAP response path
+        float value;
+        uint32_t seq;
+        if (!cached_humidity(&value, &seq)) {
+            ESP_LOGW(TAG, "READ /3304/0/5700 -> no fresh sample");
+            return ANJAY_ERR_SERVICE_UNAVAILABLE;
         }
+        ESP_LOGD(TAG, "READ /3304/0/5700 -> %.3f%%RH (cached #%u)", value, (unsigned) seq);
+        return anjay_ret_float(ctx, value);
+    }
     case RID_SENSOR_UNITS:
         ESP_LOGD(TAG, "READ /3304/0/5701 -> '%%RH'");
         return anjay_ret_string(ctx, "%RH");
     case RID_MIN_MEASURED:
+        if (!g_have_value) {
+            return ANJAY_ERR_SERVICE_UNAVAILABLE;
+        }
         ESP_LOGD(TAG, "READ /3304/0/5601 -> %.3f%%RH", g_min_measured);
         return anjay_ret_float(ctx, g_min_measured);
     case RID_MAX_MEASURED:
+        if (!g_have_value) {
+            return ANJAY_ERR_SERVICE_UNAVAILABLE;
+        }
         ESP_LOGD(TAG, "READ /3304/0/5602 -> %.3f%%RH", g_max_measured);
         return anjay_ret_float(ctx, g_max_measured);
+    case RID_WINDOW_LENGTH:
+        return anjay_ret_i32(ctx, g_window_length_s);
+    case RID_WINDOW_MODE:
+        return anjay_ret_i32(ctx, (int32_t) g_window_mode);
+    case RID_WINDOW_COUNT: {
+        window_result_t r;
+        return anjay_ret_i32(ctx, window_stats_result(&g_window, &r) ? (int32_t) r.count : 0);
+    }
+    case RID_WINDOW_AVG:
+    case RID_WINDOW_STDDEV:
+    case RID_WINDOW_MIN:
+    case RID_WINDOW_MAX: {
+        window_result_t r;
+        if (!window_stats_result(&g_window, &r)) {
+            // Tumbling window not closed yet (or no samples)
+            return ANJAY_ERR_SERVICE_UNAVAILABLE;
+        }
+        float v = rid == RID_WINDOW_AVG ? r.mean
+                : rid == RID_WINDOW_STDDEV ? r.stddev
+                : rid == RID_WINDOW_MIN ? r.min : r.max;
+        ESP_LOGD(TAG, "READ /3304/0/%u -> %.3f%%RH (n=%u)", (unsigned) rid, v, (unsigned) r.count);
+        return anjay_ret_float(ctx, v);
+    }
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+}
+
+static int hum_write(anjay_t *anjay,
+                     const anjay_dm_object_def_t *const *def,
+                     anjay_iid_t iid,
+                     anjay_rid_t rid,
+                     anjay_riid_t riid,
+                     anjay_input_ctx_t *in_ctx) {
+    (void) def; (void) iid; (void) riid;
+    int32_t v = 0;
+    switch (rid) {
+    case RID_WINDOW_LENGTH: {
+        int res = anjay_get_i32(in_ctx, &v);
+        if (res) return res;
+        if (v < 1 || v > WINDOW_MAX_SECONDS) return ANJAY_ERR_BAD_REQUEST;
+        if (v != g_window_length_s) {
+            g_window_length_s = v;
+            window_reset();
+            ESP_LOGI(TAG, "Window length changed to %ld s", (long) v);
+            anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_WINDOW_LENGTH);
+        }
+        return 0;
+    }
+    case RID_WINDOW_MODE: {
+        int res = anjay_get_i32(in_ctx, &v);
+        if (res) return res;
+        if (v != WINDOW_SLIDING && v != WINDOW_TUMBLING) return ANJAY_ERR_BAD_REQUEST;
+        if ((window_mode_t) v != g_window_mode) {
+            g_window_mode = (window_mode_t) v;
+            window_reset();
+            ESP_LOGI(TAG, "Window mode changed to %s", v == WINDOW_TUMBLING ? "tumbling" : "sliding");
+            anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_WINDOW_MODE);
+        }
+        return 0;
+    }
     default:
         return ANJAY_ERR_METHOD_NOT_ALLOWED;
     }
@@ -137,11 +269,15 @@ static int hum_execute(anjay_t *anjay,
     (void) def; (void) iid; (void) arg_ctx;
     switch (rid) {
     case RID_RESET_MIN_MAX: {
-        float value = read_humidity_sensor();
+        // Restart the range from the newest cached sample (or the last recorded one)
+        float value = g_current_value;
+        uint32_t seq;
+        (void) cached_humidity(&value, &seq);
         g_have_value = false;
         (void) record_sample(value, NULL, NULL);
         g_last_notified = value;
         g_last_notify_tick = xTaskGetTickCount();
+        notify_filter_mark(&g_value_filter, value);
         anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_MIN_MEASURED);
         anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_MAX_MEASURED);
         anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_SENSOR_VALUE);
@@ -159,6 +295,7 @@ static const anjay_dm_object_def_t OBJ_DEF = {
         .list_instances = hum_list_instances,
         .list_resources = hum_list_resources,
         .resource_read = hum_read,
+        .resource_write = hum_write,
         .resource_execute = hum_execute
     }
 };
@@ -167,6 +304,7 @@ static const anjay_dm_object_def_t *const OBJ_DEF_PTR = &OBJ_DEF;
 
 const anjay_dm_object_def_t *const *humidity_object_def(void) {
     ensure_sample();
+    g_rule_signal = rule_object_add_signal(OID_HUMIDITY, IID_DEFAULT, RID_SENSOR_VALUE);
     return &OBJ_DEF_PTR;
 }
 
@@ -174,44 +312,61 @@ void humidity_object_update(anjay_t *anjay) {
     if (!anjay) {
         return;
     }
+    // New conversions arrive from sensor_driver's timer; act once per sample
+    float value;
+    uint32_t seq;
+    if (!cached_humidity(&value, &seq) || seq == g_last_seq) {
+        return;
+    }
+    g_last_seq = seq;
     TickType_t now = xTaskGetTickCount();
-    if (g_last_sample_tick == 0 || (now - g_last_sample_tick) >= pdMS_TO_TICKS(HUM_SAMPLE_INTERVAL_MS)) {
-        g_last_sample_tick = now;
-        bool min_changed = false;
-        bool max_changed = false;
-        float value = read_humidity_sensor();
-        bool first = record_sample(value, &min_changed, &max_changed);
-        float delta = fabsf(value - g_last_notified);
-        bool notify_delta = first || delta >= HUM_DELTA_EPS;
-
-        ESP_LOGD(TAG, "update: val=%.3f%%RH delta=%.3f first=%d min=%.3f max=%.3f",
-                 value, delta, (int) first, g_min_measured, g_max_measured);
-
-        if (first || notify_delta) {
-            g_last_notify_tick = now;
-            g_last_notified = value;
-            int err = anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_SENSOR_VALUE);
-            if (err < 0) {
-                ESP_LOGW(TAG, "notify_changed /3304/0/5700 failed: %d", err);
-            } else {
-                ESP_LOGD(TAG, "notify_changed /3304/0/5700 queued");
-            }
+    if (!g_window_initialized) {
+        window_reset();
+    }
+    // Aggregates change every sample (sliding) or once per closed window (tumbling);
+    // servers can observe them with a long pmin instead of the raw value
+    if (window_stats_add(&g_window, value)) {
+        notify_window(anjay);
+    }
+    bool min_changed = false;
+    bool max_changed = false;
+    bool first = record_sample(value, &min_changed, &max_changed);
+    // Alarm rules see every sample, whatever gt/lt/st let through to 5700
+    rule_object_eval(anjay, g_rule_signal, value);
+    float delta = fabsf(value - g_last_notified);
+    // Server gt/lt/st are checked here, before Anjay evaluates any observation
+    bool notify_delta = notify_filter_should_notify(anjay, &g_value_filter, value);
+    if (first && !notify_delta) {
+        notify_filter_mark(&g_value_filter, value);
+    }
+
+    ESP_LOGD(TAG, "update: val=%.3f%%RH delta=%.3f first=%d min=%.3f max=%.3f",
+             value, delta, (int) first, g_min_measured, g_max_measured);
+
+    if (first || notify_delta) {
+        g_last_notify_tick = now;
+        g_last_notified = value;
+        int err = anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_SENSOR_VALUE);
+        if (err < 0) {
+            ESP_LOGW(TAG, "notify_changed /3304/0/5700 failed: %d", err);
+        } else {
+            ESP_LOGD(TAG, "notify_changed /3304/0/5700 queued");
         }
-        if (min_changed) {
-            int err = anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_MIN_MEASURED);
-            if (err < 0) {
-                ESP_LOGW(TAG, "notify_changed /3304/0/5601 failed: %d", err);
-            } else {
-                ESP_LOGD(TAG, "notify_changed /3304/0/5601 queued");
-            }
+    }
+    if (min_changed) {
+        int err = anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_MIN_MEASURED);
+        if (err < 0) {
+            ESP_LOGW(TAG, "notify_changed /3304/0/5601 failed: %d", err);
+        } else {
+            ESP_LOGD(TAG, "notify_changed /3304/0/5601 queued");
         }
-        if (max_changed) {
-            int err = anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_MAX_MEASURED);
-            if (err < 0) {
-                ESP_LOGW(TAG, "notify_changed /3304/0/5602 failed: %d", err);
-            } else {
-                ESP_LOGD(TAG, "notify_changed /3304/0/5602 queued");
-            }
+    }
+    if (max_changed) {
+        int err = anjay_notify_changed(anjay, OID_HUMIDITY, IID_DEFAULT, RID_MAX_MEASURED);
+        if (err < 0) {
+            ESP_LOGW(TAG, "notify_changed /3304/0/5602 failed: %d", err);
+        } else {
+            ESP_LOGD(TAG, "notify_changed /3304/0/5602 queued");
         }
     }
 }
@@ -1,7 +1,8 @@
 #include "led_status.h"
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 
 #if CONFIG_BOARD_HAS_WS2812
@@ -16,7 +17,9 @@ static led_mode_t s_mode = LED_MODE_OFF;
 static led_strip_handle_t s_strip = NULL;
 #endif
 
-static TaskHandle_t s_anim_task = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_step_timer = NULL;
+static size_t s_step = 0;
 
 static inline void set_rgb(uint8_t r, uint8_t g, uint8_t b)
 {
@@ -62,49 +65,72 @@ void led_status_get_color(uint8_t* r, uint8_t* g, uint8_t* b)
     }
 }
 
-static void animator_task(void* arg)
+// Each mode is a looped sequence of colour steps. A one-shot esp_timer fires
+// only at the next colour change, so solid modes cost no wakeups at all.
+typedef struct {
+    uint8_t r, g, b;
+    uint16_t ms; // 0: hold this colour until the mode changes
+} led_step_t;
+
+static const led_step_t k_off[] = { { 0, 0, 0, 0 } };
+static const led_step_t k_factory_reset[] = { { 255, 0, 0, 100 }, { 0, 0, 0, 100 } };
+// Blue breathing in coarse steps (set_rgb caps at 96 anyway)
+static const led_step_t k_prov_ble[] = {
+    { 0, 0, 12, 150 }, { 0, 0, 32, 150 }, { 0, 0, 60, 150 }, { 0, 0, 96, 300 },
+    { 0, 0, 60, 150 }, { 0, 0, 32, 150 }, { 0, 0, 12, 150 }, { 0, 0, 0, 300 },
+};
+static const led_step_t k_wifi_connected[] = { { 0, 255, 0, 0 } };
+// Amber blink 200ms
+static const led_step_t k_wifi_fail[] = { { 255, 180, 0, 200 }, { 0, 0, 0, 200 } };
+
+#define PATTERN(steps) { steps, sizeof(steps) / sizeof(steps[0]) }
+static const struct {
+    const led_step_t *steps;
+    size_t count;
+} k_patterns[] = {
+    [LED_MODE_OFF] = PATTERN(k_off),
+    [LED_MODE_FACTORY_RESET] = PATTERN(k_factory_reset),
+    [LED_MODE_PROV_BLE] = PATTERN(k_prov_ble),
+    [LED_MODE_WIFI_CONNECTED] = PATTERN(k_wifi_connected),
+    [LED_MODE_WIFI_FAIL] = PATTERN(k_wifi_fail),
+};
+
+// Shows the current step and schedules the next one. Caller holds s_lock.
+static void play_step(void)
+{
+    const led_step_t *step = &k_patterns[s_mode].steps[s_step];
+    set_rgb(step->r, step->g, step->b);
+    if (step->ms && s_step_timer) {
+        esp_timer_start_once(s_step_timer, (uint64_t) step->ms * 1000);
+    }
+}
+
+static void step_timer_cb(void* arg)
 {
     (void)arg;
-    static int val = 0;
-    static int dir = 1;
-    for (;;) {
-        switch (s_mode) {
-        case LED_MODE_OFF:
-            set_rgb(0,0,0);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            break;
-        case LED_MODE_FACTORY_RESET: {
-            static bool on = false; on = !on;
-            set_rgb(on ? 255 : 0, 0, 0);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            break;
-        }
-        case LED_MODE_PROV_BLE:
-            // blue breathing
-            set_rgb(0, 0, (uint8_t)val);
-            val += dir * 10;
-            if (val >= 255) { val = 255; dir = -1; }
-            if (val <= 0)   { val = 0;   dir =  1; }
-            vTaskDelay(pdMS_TO_TICKS(25));
-            break;
-        case LED_MODE_WIFI_CONNECTED:
-            set_rgb(0, 255, 0);
-            vTaskDelay(pdMS_TO_TICKS(400));
-            break;
-        case LED_MODE_WIFI_FAIL: {
-            static bool on2 = false; on2 = !on2;
-            // amber blink 200ms
-            set_rgb(on2 ? 255 : 0, on2 ? 180 : 0, 0);
-            vTaskDelay(pdMS_TO_TICKS(200));
-            break;
-        }
-        }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Re-armed by a mode change while this callback was pending
+    if (!esp_timer_is_active(s_step_timer)) {
+        s_step = (s_step + 1) % k_patterns[s_mode].count;
+        play_step();
     }
+    xSemaphoreGive(s_lock);
 }
 
 void led_status_set_mode(led_mode_t mode)
 {
-    s_mode = mode;
+    if (!s_lock) {
+        s_mode = mode;
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (mode != s_mode) {
+        esp_timer_stop(s_step_timer);
+        s_mode = mode;
+        s_step = 0;
+        play_step();
+    }
+    xSemaphoreGive(s_lock);
 }
 
 void led_status_init(void)
@@ -130,15 +156,27 @@ void led_status_init(void)
         }
     }
 #endif
-    if (!s_anim_task) {
-        xTaskCreatePinnedToCore(animator_task, "led_anim", 3072, NULL, 5, &s_anim_task, tskNO_AFFINITY);
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        const esp_timer_create_args_t args = {
+            .callback = step_timer_cb,
+            .name = "led_step",
+        };
+        if (esp_timer_create(&args, &s_step_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Could not create LED timer; patterns stay on their first step");
+            s_step_timer = NULL;
+        }
     }
-    set_rgb(0,0,0);
+    // Show whatever mode was requested before init
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_step = 0;
+    play_step();
+    xSemaphoreGive(s_lock);
     ESP_LOGI(TAG, "LED status initialized (WS2812 GPIO %d)", CONFIG_BOARD_WS2812_GPIO);
 }
 
 void led_status_force_off(void)
 {
-    s_mode = LED_MODE_OFF;
+    led_status_set_mode(LED_MODE_OFF);
     set_rgb(0,0,0);
 }
@@ -1,4 +1,5 @@
 // LED status driver for a single WS2812 (NeoPixel) RGB LED
+// Patterns are played by a one-shot esp_timer that fires only on colour changes.
 #pragma once
 #include <stdint.h>
 
@@ -6,12 +6,11 @@
 #include <esp_sntp.h>
 #include <time.h>
 #include <sys/time.h>
-#include <nvs_flash.h>
-#include <nvs.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <anjay/io.h>
 #include "sdkconfig.h"
+#include "cfg_store.h"
 #if CONFIG_GEOLOC_ENABLE
 #include <esp_http_client.h>
 #include <cJSON.h>
@@ -190,20 +189,13 @@ const anjay_dm_object_def_t **location_object_create(void) {
     g_loc.next_refresh_ticks = xTaskGetTickCount();
     g_loc.loaded_from_nvs = false;
 #if CONFIG_GEOLOC_PERSIST_NVS
-    // Attempt to load last stored lat/lon from NVS
-    nvs_handle_t h;
-    if (nvs_open("loc", NVS_READONLY, &h) == ESP_OK) {
-        float lat = 0, lon = 0; size_t sz = sizeof(float);
-        if (nvs_get_blob(h, "lat", &lat, &sz) == ESP_OK && sz == sizeof(float)) {
-            sz = sizeof(float);
-            if (nvs_get_blob(h, "lon", &lon, &sz) == ESP_OK && sz == sizeof(float)) {
-                g_loc.latitude = lat;
-                g_loc.longitude = lon;
-                g_loc.loaded_from_nvs = true;
-                ESP_LOGI(TAG_LOC, "Loaded persisted location lat=%.6f lon=%.6f", (double)lat, (double)lon);
-            }
-        }
-        nvs_close(h);
+    // Attempt to load last stored lat/lon
+    float lat = 0, lon = 0;
+    if (cfg_store_get_f32(CFG_KEY_LOC_LAT, &lat) == 0 && cfg_store_get_f32(CFG_KEY_LOC_LON, &lon) == 0) {
+        g_loc.latitude = lat;
+        g_loc.longitude = lon;
+        g_loc.loaded_from_nvs = true;
+        ESP_LOGI(TAG_LOC, "Loaded persisted location lat=%.6f lon=%.6f", (double)lat, (double)lon);
     }
 #endif
 #endif
@@ -307,14 +299,10 @@ void location_object_update(anjay_t *anjay, const anjay_dm_object_def_t **def) {
             g_loc.latitude = new_lat;
             g_loc.longitude = new_lon;
 #if CONFIG_GEOLOC_PERSIST_NVS
-            // Persist new coordinates
-            nvs_handle_t h;
-            if (nvs_open("loc", NVS_READWRITE, &h) == ESP_OK) {
-                (void)nvs_set_blob(h, "lat", &g_loc.latitude, sizeof(float));
-                (void)nvs_set_blob(h, "lon", &g_loc.longitude, sizeof(float));
-                (void)nvs_commit(h);
-                nvs_close(h);
-            }
+            // Persist new coordinates (no flash write if unchanged)
+            (void)cfg_store_set_f32(CFG_KEY_LOC_LAT, g_loc.latitude);
+            (void)cfg_store_set_f32(CFG_KEY_LOC_LON, g_loc.longitude);
+            (void)cfg_store_commit();
 #endif
         }
         g_loc.timestamp = new_ts;
@@ -22,9 +22,18 @@
 #include "humidity_object.h"
 #include "onoff_object.h"
 #include "connectivity_object.h"
+#include "conn_stats_object.h"
+#include "rule_object.h"
 #include "location_object.h"
 #include "bac19_object.h"
 #include "thingsboard_provision.h"
+#include "sleep_mode.h"
+#include "sensor_driver.h"
+#include "notify_filter.h"
+#include "mem_budget.h"
+#include "cfg_store.h"
+#include "thread_prov.h"
+#include "net_common.h"
 
 #include <anjay/anjay.h>
 #include <anjay/security.h>
@@ -37,8 +46,6 @@
 // AVSystem stream helpers used to persist/restore attribute storage
 #include <avsystem/commons/avs_stream_membuf.h>
 #include <avsystem/commons/avs_stream_inbuf.h>
-// NVS for non-volatile storage of attributes
-#include "nvs.h"
 
 // NOTE: keep includes minimal; remove unused dependencies
 
@@ -79,6 +86,18 @@
 #define CONFIG_LWM2M_SERVER_LIFETIME 300
 #endif
 
+// In deep-sleep reporting mode the registration must outlive at least two sleep
+// periods, otherwise every timer wake would have to Register again
+#if CONFIG_LWM2M_DEEP_SLEEP_ENABLE && (CONFIG_LWM2M_SERVER_LIFETIME < 2 * CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S + 60)
+#define LWM2M_EFFECTIVE_LIFETIME (2 * CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S + 60)
+#else
+#define LWM2M_EFFECTIVE_LIFETIME CONFIG_LWM2M_SERVER_LIFETIME
+#endif
+
+// Server (1) default pmin/pmax; the server overrides them via Write-Attributes
+#define LWM2M_DEFAULT_PMIN_S 5
+#define LWM2M_DEFAULT_PMAX_S 10
+
 // Fallback observe notification period if server does not set pmax (seconds)
 #ifndef CONFIG_LWM2M_OBS_FALLBACK_PERIOD_S
 #define CONFIG_LWM2M_OBS_FALLBACK_PERIOD_S 30
@@ -475,9 +494,9 @@ static int setup_server(anjay_t *anjay) {
     anjay_server_object_purge(anjay);
     anjay_server_instance_t srv = {
         .ssid = CONFIG_LWM2M_SERVER_SHORT_ID,
-        .lifetime = 300,
-        .default_min_period = 5, // let server set pmin via Write-Attributes
-        .default_max_period = 10, // let server set pmax via Write-Attributes
+        .lifetime = LWM2M_EFFECTIVE_LIFETIME,
+        .default_min_period = LWM2M_DEFAULT_PMIN_S, // let server set pmin via Write-Attributes
+        .default_max_period = LWM2M_DEFAULT_PMAX_S, // let server set pmax via Write-Attributes
         .disable_timeout = -1,
         .binding = "U",
     };
@@ -492,28 +511,142 @@ static int setup_server(anjay_t *anjay) {
 #endif
 }
 
-// Handle Wi‑Fi/IP events to toggle Anjay offline/online for faster recovery
-static void lwm2m_net_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+// Follow the default route chosen by net_common: offline while no interface has
+// an IP, reconnect as soon as one (the same or a standby) takes over
+static void lwm2m_net_changed(net_if_t active, net_if_t previous, void *arg) {
     anjay_t *anjay = (anjay_t *) arg;
     if (!anjay) {
         return;
     }
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGW(TAG, "WiFi disconnected -> entering LwM2M offline");
+    if (active == NET_IF_NONE) {
+        ESP_LOGW(TAG, "Network down -> entering LwM2M offline");
         (void) anjay_transport_enter_offline(anjay, ANJAY_TRANSPORT_SET_ALL);
-    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        ESP_LOGI(TAG, "Got IP -> exiting LwM2M offline and scheduling reconnect");
+    } else {
+        ESP_LOGI(TAG, "Route %d -> %d: exiting LwM2M offline and scheduling reconnect", (int) previous,
+                 (int) active);
         ensure_dns_gateway();
         log_dns_servers();
         (void) anjay_transport_exit_offline(anjay, ANJAY_TRANSPORT_SET_ALL);
         (void) anjay_transport_schedule_reconnect(anjay, ANJAY_TRANSPORT_SET_ALL);
         (void) anjay_notify_instances_changed(anjay, 3303); // Temperature
         (void) anjay_notify_instances_changed(anjay, 3304); // Humidity
-        // Immediate connectivity update so IP/GW are ready before any server Read
-        connectivity_object_update(anjay);
     }
 }
 
+// A Register/Update acknowledged by the server is the first traffic that made it
+// through the new route; closes net_common's failover measurement
+static void lwm2m_conn_status_changed(void *arg, anjay_t *anjay, anjay_ssid_t ssid,
+                                      anjay_server_conn_status_t status) {
+    (void) arg;
+    (void) anjay;
+    (void) ssid;
+    if (status == ANJAY_SERV_CONN_STATUS_REGISTERED) {
+        net_common_report_traffic(net_common_get_active());
+    }
+}
+
+#if CONFIG_ANJAY_WITH_ATTR_STORAGE
+// Serializes Write-Attributes into the config image; an empty set drops the key
+static void persist_attributes(anjay_t *anjay) {
+    avs_stream_t *membuf = avs_stream_membuf_create();
+    if (!membuf) {
+        return;
+    }
+    if (avs_is_ok(anjay_attr_storage_persist(anjay, membuf))) {
+        void *data_ptr = NULL;
+        size_t data_size = 0;
+        (void) avs_stream_membuf_fit(membuf);
+        if (avs_is_ok(avs_stream_membuf_take_ownership(membuf, &data_ptr, &data_size))) {
+            if (data_ptr && data_size > 0) {
+                (void) cfg_store_set_blob(CFG_KEY_ATTR_STORAGE, data_ptr, data_size);
+            } else {
+                cfg_store_erase(CFG_KEY_ATTR_STORAGE);
+            }
+            if (cfg_store_commit() == 0) {
+                ESP_LOGD(TAG, "Persisted %u bytes of attributes", (unsigned) data_size);
+            } else {
+                ESP_LOGW(TAG, "Failed to persist attributes");
+            }
+            free(data_ptr);
+        }
+    }
+    (void) avs_stream_cleanup(&membuf);
+}
+#endif // CONFIG_ANJAY_WITH_ATTR_STORAGE
+
+#if CONFIG_LWM2M_THREAD_PROFILE
+// Over Thread: messages sized to whole 802.15.4 frames through the socket MTU
+// (avs_coap picks the largest block that fits it) and buffers no larger than
+// the 1280-byte IPv6 MTU of the Thread interface
+static void thread_profile_configure(anjay_configuration_t *cfg) {
+    bool secure = false;
+#if CONFIG_LWM2M_SERVER_SCHEME_COAPS || CONFIG_LWM2M_DNS_DISCOVERY_SECURE
+    secure = true;
+#endif
+    const thread_link_t link = THREAD_LINK_DEFAULT(secure, CONFIG_LWM2M_THREAD_MAX_FRAMES);
+    cfg->socket_config.forced_mtu = thread_transport_forced_mtu(&link);
+    if (!cfg->socket_config.forced_mtu) {
+        ESP_LOGW(TAG, "%u frame(s)/msg cannot carry a Register; socket MTU left unchanged",
+                 (unsigned) CONFIG_LWM2M_THREAD_MAX_FRAMES);
+    }
+    size_t *sizes[3] = { &cfg->in_buffer_size, &cfg->out_buffer_size, &cfg->msg_cache_size };
+    for (int i = 0; i < 3; i++) {
+        if (*sizes[i] > CONFIG_LWM2M_THREAD_BUFFER_SIZE) {
+            *sizes[i] = CONFIG_LWM2M_THREAD_BUFFER_SIZE;
+        }
+    }
+    // Single resources answered in plain text/CBOR take a few bytes where
+    // TLV/SenML would push a notification past one frame
+    cfg->prefer_hierarchical_formats = false;
+    ESP_LOGI(TAG, "Thread profile: MTU %d, CoAP block %u (%u frame(s)/msg), buffers in %u out %u cache %u",
+             cfg->socket_config.forced_mtu, (unsigned) thread_transport_block_size(&link),
+             (unsigned) CONFIG_LWM2M_THREAD_MAX_FRAMES, (unsigned) cfg->in_buffer_size,
+             (unsigned) cfg->out_buffer_size, (unsigned) cfg->msg_cache_size);
+#ifndef ANJAY_WITH_CBOR
+    ESP_LOGW(TAG, "Anjay built without CBOR: Send uses SenML JSON, about twice the frames");
+#endif
+}
+
+// Smallest pmin/pmax over the observed Sensor Values (/3303/0/5700 and
+// /3304/0/5700): resource attributes, else instance, else object, else the
+// Server defaults
+static void observation_periods(anjay_t *anjay, uint32_t *pmin_s, uint32_t *pmax_s) {
+    static const anjay_oid_t oids[] = { 3303, 3304 };
+    *pmin_s = UINT32_MAX;
+    *pmax_s = UINT32_MAX;
+    for (size_t k = 0; k < sizeof(oids) / sizeof(oids[0]); k++) {
+        int32_t pmin = LWM2M_DEFAULT_PMIN_S;
+        int32_t pmax = LWM2M_DEFAULT_PMAX_S;
+#ifdef ANJAY_WITH_ATTR_STORAGE
+        anjay_dm_oi_attributes_t obj = ANJAY_DM_OI_ATTRIBUTES_EMPTY;
+        anjay_dm_oi_attributes_t inst = ANJAY_DM_OI_ATTRIBUTES_EMPTY;
+        anjay_dm_r_attributes_t res = ANJAY_DM_R_ATTRIBUTES_EMPTY;
+        (void) anjay_attr_storage_get_object_attrs(anjay, CONFIG_LWM2M_SERVER_SHORT_ID, oids[k], &obj);
+        (void) anjay_attr_storage_get_instance_attrs(anjay, CONFIG_LWM2M_SERVER_SHORT_ID, oids[k], 0, &inst);
+        (void) anjay_attr_storage_get_resource_attrs(anjay, CONFIG_LWM2M_SERVER_SHORT_ID, oids[k], 0, 5700, &res);
+        const int32_t mins[3] = { res.common.min_period, inst.min_period, obj.min_period };
+        const int32_t maxs[3] = { res.common.max_period, inst.max_period, obj.max_period };
+        for (int level = 2; level >= 0; level--) {
+            if (mins[level] >= 0) {
+                pmin = mins[level];
+            }
+            if (maxs[level] >= 0) {
+                pmax = maxs[level];
+            }
+        }
+#else
+        (void) anjay;
+#endif
+        if ((uint32_t) pmin < *pmin_s) {
+            *pmin_s = (uint32_t) pmin;
+        }
+        if ((uint32_t) pmax < *pmax_s) {
+            *pmax_s = (uint32_t) pmax;
+        }
+    }
+}
+#endif // CONFIG_LWM2M_THREAD_PROFILE
+
 static void lwm2m_client_task(void *arg) {
     // Increase log verbosity for AVSystem/Anjay to aid troubleshooting
     avs_log_set_default_level(AVS_LOG_DEBUG);
@@ -524,17 +657,23 @@ static void lwm2m_client_task(void *arg) {
     const anjay_dm_object_def_t **dev_obj = NULL;
     const anjay_dm_object_def_t **loc_obj = NULL;
     const anjay_dm_object_def_t **bac_obj = NULL;
+    const anjay_dm_object_def_t *const *rule_obj = NULL;
     // Resolve endpoint name (from config or MAC) and log it once
     resolve_endpoint_name();
     ESP_LOGI(TAG, "LwM2M Endpoint: %s", g_endpoint_name);
     // Also dump DNS servers now in case IP was acquired before our event handler registration
     log_dns_servers();
 
+    // Buffers take what the heap can spare (more after BLE memory was released)
+    size_t in_buffer_size, out_buffer_size, msg_cache_size;
+    mem_budget_log("Before Anjay");
+    mem_budget_lwm2m_buffers(&in_buffer_size, &out_buffer_size, &msg_cache_size);
     anjay_configuration_t cfg = {
         .endpoint_name = g_endpoint_name,
-        .in_buffer_size = CONFIG_LWM2M_IN_BUFFER_SIZE,
-        .out_buffer_size = CONFIG_LWM2M_OUT_BUFFER_SIZE,
-        .msg_cache_size = CONFIG_LWM2M_MSG_CACHE_SIZE,
+        .in_buffer_size = in_buffer_size,
+        .out_buffer_size = out_buffer_size,
+        .msg_cache_size = msg_cache_size,
+        .server_connection_status_cb = lwm2m_conn_status_changed,
     };
 
 #ifdef ANJAY_WITH_LWM2M11
@@ -546,12 +685,21 @@ static void lwm2m_client_task(void *arg) {
     };
     cfg.lwm2m_version_config = &LWM2M_VER_11_ONLY;
 #endif // ANJAY_WITH_LWM2M11
+#if CONFIG_LWM2M_THREAD_PROFILE
+    // Only when Thread actually attached; a Wi-Fi fallback keeps the full MTU
+    const bool over_thread = thread_prov_is_attached();
+    if (over_thread) {
+        thread_profile_configure(&cfg);
+    }
+#endif
 
-    anjay_t *anjay = anjay_new(&cfg);
+    // On deep-sleep timer wakes this restores the registration retained in RTC memory
+    anjay_t *anjay = sleep_mode_anjay_new(&cfg);
     if (!anjay) {
         ESP_LOGE(TAG, "Could not create Anjay instance");
         vTaskDelete(NULL);
     }
+    mem_budget_log("After Anjay");
 
 // Note: Attribute Storage no longer requires explicit install in recent Anjay.
 // If compiled with CONFIG_ANJAY_WITH_ATTR_STORAGE, it is auto-installed.
@@ -584,6 +732,10 @@ static void lwm2m_client_task(void *arg) {
     }
 #endif
 
+    // Start timer-driven sensor sampling; 3303/3304 only read its cache
+    if (sensor_driver_start()) {
+        ESP_LOGW(TAG, "Sensor driver failed to start; 3303/3304 will report Service Unavailable");
+    }
     // Register IPSO-compliant Temperature (3303) object with min/max/reset resources
     if (anjay_register_object(anjay, temp_object_def())) {
         ESP_LOGE(TAG, "Could not register Temperature (3303) object");
@@ -594,10 +746,18 @@ static void lwm2m_client_task(void *arg) {
         ESP_LOGE(TAG, "Could not register Humidity (3304) object");
         goto cleanup;
     }
+    // IP/GW come from IP_EVENT handlers and RSSI from a low-rate timer
+    connectivity_object_start();
     if (anjay_register_object(anjay, connectivity_object_def())) {
         ESP_LOGE(TAG, "Could not register Connectivity (4) object");
         goto cleanup;
     }
+    // Connectivity Statistics (7): netif byte/packet counters + lwIP drop counters
+    conn_stats_object_start();
+    if (anjay_register_object(anjay, conn_stats_object_def())) {
+        ESP_LOGE(TAG, "Could not register Connectivity Statistics (7) object");
+        goto cleanup;
+    }
 
     // Register Device (3) object to expose attributes (Manufacturer, Model, Serial, FW)
     dev_obj = device_object_create(g_endpoint_name);
@@ -620,6 +780,15 @@ static void lwm2m_client_task(void *arg) {
         goto cleanup;
     }
 
+#if CONFIG_LWM2M_RULES_ENABLE
+    // Threshold Rules (26241): alarms on 3303/3304 samples, evaluated on the device
+    rule_obj = rule_object_create();
+    if (!rule_obj || anjay_register_object(anjay, rule_obj)) {
+        ESP_LOGE(TAG, "Could not register Threshold Rules (26241) object");
+        goto cleanup;
+    }
+#endif
+
     #if CONFIG_LWM2M_BOOTSTRAP
     ESP_LOGI(TAG, "Starting Anjay event loop (bootstrap mode)");
     #else
@@ -627,52 +796,34 @@ static void lwm2m_client_task(void *arg) {
     #endif
     
 #if CONFIG_ANJAY_WITH_ATTR_STORAGE
-    // --- Restore Attribute Storage from NVS AFTER all objects are registered ---
+    // --- Restore Attribute Storage AFTER all objects are registered ---
     {
-        nvs_handle_t nvs;
-        esp_err_t err = nvs_open("lwm2m", NVS_READONLY, &nvs);
-        if (err == ESP_OK) {
-            size_t blob_size = 0;
-            err = nvs_get_blob(nvs, "attr", NULL, &blob_size);
-            if (err == ESP_OK && blob_size > 0) {
-                void *buf = malloc(blob_size);
-                if (buf) {
-                    err = nvs_get_blob(nvs, "attr", buf, &blob_size);
-                    if (err == ESP_OK) {
-                        avs_stream_inbuf_t in = AVS_STREAM_INBUF_STATIC_INITIALIZER;
-                        avs_stream_inbuf_set_buffer(&in, buf, blob_size);
-                        if (avs_is_err(anjay_attr_storage_restore(anjay, (avs_stream_t *) &in))) {
-                            ESP_LOGW(TAG, "Attr storage restore failed; starting clean");
-                        } else {
-                            ESP_LOGI(TAG, "Restored %u bytes of LwM2M attributes from NVS", (unsigned) blob_size);
-                        }
+        size_t blob_size = 0;
+        if (cfg_store_get_blob(CFG_KEY_ATTR_STORAGE, NULL, 0, &blob_size) == 0 && blob_size > 0) {
+            void *buf = malloc(blob_size);
+            if (buf) {
+                if (cfg_store_get_blob(CFG_KEY_ATTR_STORAGE, buf, blob_size, &blob_size) == 0) {
+                    avs_stream_inbuf_t in = AVS_STREAM_INBUF_STATIC_INITIALIZER;
+                    avs_stream_inbuf_set_buffer(&in, buf, blob_size);
+                    if (avs_is_err(anjay_attr_storage_restore(anjay, (avs_stream_t *) &in))) {
+                        ESP_LOGW(TAG, "Attr storage restore failed; starting clean");
                     } else {
-                        ESP_LOGW(TAG, "nvs_get_blob(attr) failed: %s", esp_err_to_name(err));
+                        ESP_LOGI(TAG, "Restored %u bytes of LwM2M attributes", (unsigned) blob_size);
                     }
-                    free(buf);
-                } else {
-                    ESP_LOGE(TAG, "OOM allocating %u bytes for attr restore", (unsigned) blob_size);
                 }
-            } else if (err == ESP_OK) {
-                ESP_LOGI(TAG, "No stored attributes found (size=0)");
-            } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-                ESP_LOGI(TAG, "No stored attributes in NVS");
+                free(buf);
             } else {
-                ESP_LOGW(TAG, "nvs_get_blob(attr) size failed: %s", esp_err_to_name(err));
+                ESP_LOGE(TAG, "OOM allocating %u bytes for attr restore", (unsigned) blob_size);
             }
-            nvs_close(nvs);
-        } else if (err == ESP_ERR_NVS_NOT_INITIALIZED) {
-            ESP_LOGW(TAG, "NVS not initialized; skipping attr restore");
         } else {
-            ESP_LOGW(TAG, "nvs_open() failed: %s", esp_err_to_name(err));
+            ESP_LOGI(TAG, "No stored attributes");
         }
     }
 #endif // CONFIG_ANJAY_WITH_ATTR_STORAGE
-    // Register network event handlers to manage offline/online
-    esp_event_handler_instance_t inst_wifi = NULL;
-    esp_event_handler_instance_t inst_ip = NULL;
-    (void) esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &lwm2m_net_event_handler, anjay, &inst_wifi);
-    (void) esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &lwm2m_net_event_handler, anjay, &inst_ip);
+    // Offline/online follows net_common's failover (not initialized on the Thread path)
+    if (net_common_subscribe(lwm2m_net_changed, anjay)) {
+        ESP_LOGW(TAG, "Not subscribed to network changes");
+    }
 
     // Since WiFi is already connected when we start Anjay, manually trigger online mode
     ESP_LOGI(TAG, "WiFi already connected, forcing Anjay online mode");
@@ -696,58 +847,55 @@ static void lwm2m_client_task(void *arg) {
 
     const avs_time_duration_t max_wait = avs_time_duration_from_scalar(100, AVS_TIME_MS);
     uint32_t attr_persist_ticks = 0; // ~periodic persistence timer
+#if CONFIG_LWM2M_THREAD_PROFILE
+    uint32_t thread_period_ticks = 0;
+#endif
+    bool sleep_requested = false;
     while (1) {
         (void) anjay_event_loop_run(anjay, max_wait);
+        // Pick up Write-Attributes (gt/lt/st) before objects decide what to notify
+        notify_filter_poll(anjay);
+        // Hold or continue a firmware download as the link goes down and comes back
+        fw_update_poll(anjay);
         // Process Device(3) executes (e.g., Reboot) under server control
         device_object_update(anjay, dev_obj);
         // Refresh simulated Temperature (3303) values and emit observe notifications
         temp_object_update(anjay);
         // Refresh simulated Humidity (3304) values and emit observe notifications
         humidity_object_update(anjay);
+        // Recompile/persist rules written by the server
+        rule_object_update(anjay);
         onoff_object_update(anjay);
         connectivity_object_update(anjay);
-        location_object_update(anjay, loc_obj);
+        conn_stats_object_update(anjay);
+#if CONFIG_LWM2M_THREAD_PROFILE
+        if (over_thread) {
+            thread_prov_update();
+        }
+#endif
+        // GeoIP refresh is skipped on timer wakes; the persisted location is reused
+        if (!sleep_mode_is_timer_wake()) {
+            location_object_update(anjay, loc_obj);
+        }
+        // Deep-sleep reporting: once 3303/3304 were reported, persist and go to sleep
+        if (sleep_mode_cycle_poll(anjay, CONFIG_LWM2M_SERVER_SHORT_ID)) {
+            sleep_requested = true;
+            break;
+        }
+#if CONFIG_LWM2M_THREAD_PROFILE
+        // Follow Write-Attributes on pmin/pmax with the poll period (~5 s)
+        if (over_thread && thread_period_ticks++ % 50 == 0) {
+            uint32_t pmin_s, pmax_s;
+            observation_periods(anjay, &pmin_s, &pmax_s);
+            thread_prov_set_observation_periods(pmin_s, pmax_s);
+        }
+#endif
 #if CONFIG_ANJAY_WITH_ATTR_STORAGE
         // Periodically persist attributes if modified (about every 5 seconds)
         if (++attr_persist_ticks >= 50) { // 50 * 100ms ~ 5s
             attr_persist_ticks = 0;
             if (anjay_attr_storage_is_modified(anjay)) {
-                nvs_handle_t nvs;
-                esp_err_t err = nvs_open("lwm2m", NVS_READWRITE, &nvs);
-                if (err == ESP_OK) {
-                    avs_stream_t *membuf = avs_stream_membuf_create();
-                    if (membuf) {
-                        if (avs_is_ok(anjay_attr_storage_persist(anjay, membuf))) {
-                            // Get buffer ownership to write to NVS
-                            void *data_ptr = NULL;
-                            size_t data_size = 0;
-                            (void) avs_stream_membuf_fit(membuf);
-                            if (avs_is_ok(avs_stream_membuf_take_ownership(membuf, &data_ptr, &data_size))) {
-                                if (data_ptr && data_size > 0) {
-                                    err = nvs_set_blob(nvs, "attr", data_ptr, data_size);
-                                    if (err == ESP_OK) {
-                                        err = nvs_commit(nvs);
-                                    }
-                                    if (err == ESP_OK) {
-                                        ESP_LOGD(TAG, "Persisted %u bytes of attributes to NVS", (unsigned) data_size);
-                                    } else {
-                                        ESP_LOGW(TAG, "Failed to persist attr to NVS: %s", esp_err_to_name(err));
-                                    }
-                                } else {
-                                    // No attributes -> erase key
-                                    (void) nvs_erase_key(nvs, "attr");
-                                    (void) nvs_commit(nvs);
-                                    ESP_LOGD(TAG, "Attributes empty; NVS key erased");
-                                }
-                                if (data_ptr) {
-                                    free(data_ptr);
-                                }
-                            }
-                        }
-                        (void) avs_stream_cleanup(&membuf);
-                    }
-                    nvs_close(nvs);
-                }
+                persist_attributes(anjay);
             }
         }
 #endif // CONFIG_ANJAY_WITH_ATTR_STORAGE
@@ -762,37 +910,18 @@ cleanup:
 #if CONFIG_ANJAY_WITH_ATTR_STORAGE
     // Final persistence on exit if modified
     if (anjay && anjay_attr_storage_is_modified(anjay)) {
-        nvs_handle_t nvs;
-        if (nvs_open("lwm2m", NVS_READWRITE, &nvs) == ESP_OK) {
-            avs_stream_t *membuf = avs_stream_membuf_create();
-            if (membuf) {
-                if (avs_is_ok(anjay_attr_storage_persist(anjay, membuf))) {
-                    void *data_ptr = NULL;
-                    size_t data_size = 0;
-                    (void) avs_stream_membuf_fit(membuf);
-                    if (avs_is_ok(avs_stream_membuf_take_ownership(membuf, &data_ptr, &data_size))) {
-                        if (data_ptr && data_size > 0) {
-                            if (nvs_set_blob(nvs, "attr", data_ptr, data_size) == ESP_OK) {
-                                (void) nvs_commit(nvs);
-                            }
-                        } else {
-                            (void) nvs_erase_key(nvs, "attr");
-                            (void) nvs_commit(nvs);
-                        }
-                        if (data_ptr) {
-                            free(data_ptr);
-                        }
-                    }
-                }
-                (void) avs_stream_cleanup(&membuf);
-            }
-            nvs_close(nvs);
-        }
+        persist_attributes(anjay);
     }
 #endif // CONFIG_ANJAY_WITH_ATTR_STORAGE
+    if (sleep_requested && !fw_update_requested()) {
+        // Objects must stay registered while Anjay serializes its state; does not return
+        sleep_mode_enter(anjay);
+    }
+    net_common_unsubscribe(lwm2m_net_changed, anjay);
     device_object_release(dev_obj);
     location_object_release(loc_obj);
     bac19_object_release(bac_obj);
+    rule_object_release(rule_obj);
     anjay_delete(anjay);
     if (fw_update_requested()) {
         fw_update_reboot();
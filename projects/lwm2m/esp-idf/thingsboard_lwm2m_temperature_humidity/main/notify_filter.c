@@ -0,0 +1,93 @@
+#include "notify_filter.h"
+
+#include <math.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+
+#include <anjay/attr_storage.h>
+
+#include "notify_generation.h"
+
+#ifndef CONFIG_LWM2M_SERVER_SHORT_ID
+#define CONFIG_LWM2M_SERVER_SHORT_ID 123
+#endif
+
+static const char *TAG = "notify_filter";
+
+static notify_generation_t s_generation = NOTIFY_GENERATION_INIT;
+static anjay_ssid_t s_ssid = CONFIG_LWM2M_SERVER_SHORT_ID;
+
+void notify_filter_init(notify_filter_t *f, anjay_oid_t oid, anjay_iid_t iid, anjay_rid_t rid, double fallback_step) {
+    *f = (notify_filter_t) NOTIFY_FILTER_INIT(oid, iid, rid, fallback_step);
+}
+
+void notify_filter_set_ssid(anjay_ssid_t ssid) {
+    if (ssid != s_ssid) {
+        s_ssid = ssid;
+        notify_filter_invalidate_all();
+    }
+}
+
+void notify_filter_invalidate_all(void) {
+    notify_generation_bump(&s_generation);
+}
+
+void notify_filter_poll(anjay_t *anjay) {
+#ifdef ANJAY_WITH_ATTR_STORAGE
+    if (anjay) {
+        (void) notify_generation_poll(&s_generation, anjay_attr_storage_is_modified(anjay));
+    }
+#else
+    (void) anjay;
+#endif
+}
+
+static void load_attrs(anjay_t *anjay, notify_filter_t *f) {
+    f->gt = NAN;
+    f->lt = NAN;
+    f->st = NAN;
+#ifdef ANJAY_WITH_ATTR_STORAGE
+    anjay_dm_r_attributes_t attrs = ANJAY_DM_R_ATTRIBUTES_EMPTY;
+    if (!anjay_attr_storage_get_resource_attrs(anjay, s_ssid, f->oid, f->iid, f->rid, &attrs)) {
+        f->gt = attrs.greater_than;
+        f->lt = attrs.less_than;
+        f->st = attrs.step;
+    }
+#else
+    (void) anjay;
+#endif
+    f->generation = s_generation.value;
+    ESP_LOGD(TAG, "/%u/%u/%u attrs: gt=%f lt=%f st=%f", (unsigned) f->oid, (unsigned) f->iid,
+             (unsigned) f->rid, f->gt, f->lt, f->st);
+}
+
+static inline bool crossed(double threshold, double prev, double value) {
+    return !isnan(threshold) && ((prev <= threshold) != (value <= threshold));
+}
+
+bool notify_filter_should_notify(anjay_t *anjay, notify_filter_t *f, double value) {
+    if (f->generation != s_generation.value) {
+        load_attrs(anjay, f);
+    }
+    bool notify;
+    if (!f->have_last) {
+        notify = true;
+    } else if (isnan(f->gt) && isnan(f->lt) && isnan(f->st)) {
+        notify = fabs(value - f->last) >= f->fallback_step;
+    } else {
+        // Attributes are OR'ed: any satisfied condition lets the value through
+        notify = crossed(f->gt, f->last, value)
+                 || crossed(f->lt, f->last, value)
+                 || (!isnan(f->st) && fabs(value - f->last) >= f->st);
+    }
+    if (notify) {
+        notify_filter_mark(f, value);
+    }
+    return notify;
+}
+
+void notify_filter_mark(notify_filter_t *f, double value) {
+    f->have_last = true;
+    f->last = value;
+}
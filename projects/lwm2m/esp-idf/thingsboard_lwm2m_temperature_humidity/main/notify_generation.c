@@ -0,0 +1,16 @@
+#include "notify_generation.h"
+
+void notify_generation_bump(notify_generation_t *g) {
+    if (++g->value == 0) {
+        g->value = 1;
+    }
+}
+
+bool notify_generation_poll(notify_generation_t *g, bool storage_modified) {
+    if (storage_modified == g->storage_modified) {
+        return false;
+    }
+    g->storage_modified = storage_modified;
+    notify_generation_bump(g);
+    return true;
+}
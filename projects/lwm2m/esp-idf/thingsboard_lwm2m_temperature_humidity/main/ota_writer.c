@@ -0,0 +1,298 @@
+#include "ota_writer.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#ifndef CONFIG_OTA_WRITER_PREERASE_KB
+#define CONFIG_OTA_WRITER_PREERASE_KB 64
+#endif
+#ifndef CONFIG_OTA_WRITER_STALL_TIMEOUT_MS
+#define CONFIG_OTA_WRITER_STALL_TIMEOUT_MS 10000
+#endif
+
+#define OTA_WRITER_BUFFERS 2
+#define OTA_WRITER_PROGRESS_BYTES (256 * 1024)
+
+static const char *TAG = "ota_writer";
+
+typedef struct {
+    uint32_t offset; // partition offset of data[0]
+    size_t len;
+    uint8_t data[OTA_WRITER_SECTOR_SIZE];
+} ota_buf_t;
+
+static struct {
+    const esp_partition_t *part;
+    ota_writer_program_fn *program;
+    void *program_ctx;
+    ota_buf_t *bufs;
+    ota_buf_t *fill;          // buffer being filled by the caller, NULL if none held
+    QueueHandle_t free_q;
+    QueueHandle_t full_q;
+    SemaphoreHandle_t exited;
+    TaskHandle_t task;
+    uint32_t start_offset;
+    uint32_t accepted;        // next partition offset the caller writes to
+    uint32_t committed;       // written by the task
+    uint32_t erased_upto;     // task only; sectors below are erased
+    bool failed;              // set by the task, read by the caller
+    bool aborting;
+    // Statistics
+    int64_t start_us;
+    int64_t stall_us;
+    uint32_t stalls;
+    uint32_t preerased_sectors;
+    uint32_t next_progress;
+} s_w;
+
+static inline uint32_t align_up(uint32_t v) {
+    return (v + OTA_WRITER_SECTOR_SIZE - 1) & ~(uint32_t) (OTA_WRITER_SECTOR_SIZE - 1);
+}
+
+static bool erase_until(uint32_t end) {
+    end = align_up(end);
+    if (end > s_w.part->size) {
+        ESP_LOGE(TAG, "Image exceeds partition (%u > %u bytes)", (unsigned) end, (unsigned) s_w.part->size);
+        return false;
+    }
+    if (end <= s_w.erased_upto) {
+        return true;
+    }
+    esp_err_t err = esp_partition_erase_range(s_w.part, s_w.erased_upto, end - s_w.erased_upto);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase at 0x%x failed: %s", (unsigned) s_w.erased_upto, esp_err_to_name(err));
+        return false;
+    }
+    s_w.erased_upto = end;
+    return true;
+}
+
+static bool preerase_pending(void) {
+    uint32_t limit = __atomic_load_n(&s_w.committed, __ATOMIC_RELAXED) + CONFIG_OTA_WRITER_PREERASE_KB * 1024;
+    if (limit > s_w.part->size) {
+        limit = s_w.part->size;
+    }
+    return !s_w.failed && !s_w.aborting && s_w.erased_upto < limit;
+}
+
+static void program_buffer(ota_buf_t *b) {
+    uint32_t end = b->offset + b->len;
+    if (!erase_until(end) || s_w.program(s_w.program_ctx, b->offset, b->data, b->len) != 0) {
+        __atomic_store_n(&s_w.failed, true, __ATOMIC_RELEASE);
+        return;
+    }
+    __atomic_store_n(&s_w.committed, end, __ATOMIC_RELEASE);
+    if (end >= s_w.next_progress) {
+        s_w.next_progress = end + OTA_WRITER_PROGRESS_BYTES;
+        int64_t elapsed_us = esp_timer_get_time() - s_w.start_us;
+        uint32_t done = end - s_w.start_offset;
+        ESP_LOGI(TAG, "%u KB written, %u KB/s", (unsigned) (done / 1024),
+                 elapsed_us > 0 ? (unsigned) ((uint64_t) done * 1000000 / 1024 / elapsed_us) : 0);
+    }
+}
+
+static void writer_task(void *arg) {
+    (void) arg;
+    for (;;) {
+        ota_buf_t *b = NULL;
+        // Block for work unless there are sectors left to pre-erase
+        TickType_t wait = preerase_pending() ? 0 : portMAX_DELAY;
+        if (xQueueReceive(s_w.full_q, &b, wait) == pdTRUE) {
+            if (!b) {
+                break; // stop request
+            }
+            if (!s_w.failed && !s_w.aborting) {
+                program_buffer(b);
+            }
+            xQueueSend(s_w.free_q, &b, portMAX_DELAY);
+        } else if (erase_until(s_w.erased_upto + OTA_WRITER_SECTOR_SIZE)) {
+            // Idle: one sector at a time so a newly filled buffer waits at most one erase
+            s_w.preerased_sectors++;
+        } else {
+            __atomic_store_n(&s_w.failed, true, __ATOMIC_RELEASE);
+        }
+    }
+    xSemaphoreGive(s_w.exited);
+    vTaskDelete(NULL);
+}
+
+static void release_resources(void) {
+    if (s_w.free_q) {
+        vQueueDelete(s_w.free_q);
+    }
+    if (s_w.full_q) {
+        vQueueDelete(s_w.full_q);
+    }
+    if (s_w.exited) {
+        vSemaphoreDelete(s_w.exited);
+    }
+    free(s_w.bufs);
+    s_w.free_q = NULL;
+    s_w.full_q = NULL;
+    s_w.exited = NULL;
+    s_w.bufs = NULL;
+    s_w.fill = NULL;
+    s_w.part = NULL;
+}
+
+int ota_writer_start(const esp_partition_t *part, uint32_t start_offset,
+                     ota_writer_program_fn *program, void *program_ctx) {
+    if (s_w.task || !part || !program) {
+        return -1;
+    }
+    s_w.part = part;
+    s_w.program = program;
+    s_w.program_ctx = program_ctx;
+    s_w.start_offset = start_offset;
+    s_w.accepted = start_offset;
+    s_w.committed = start_offset;
+    // A partially written sector (resume) is already erased and must not be erased again
+    s_w.erased_upto = align_up(start_offset);
+    s_w.failed = false;
+    s_w.aborting = false;
+    s_w.start_us = esp_timer_get_time();
+    s_w.stall_us = 0;
+    s_w.stalls = 0;
+    s_w.preerased_sectors = 0;
+    s_w.next_progress = start_offset + OTA_WRITER_PROGRESS_BYTES;
+
+    s_w.bufs = (ota_buf_t *) malloc(OTA_WRITER_BUFFERS * sizeof(ota_buf_t));
+    s_w.free_q = xQueueCreate(OTA_WRITER_BUFFERS, sizeof(ota_buf_t *));
+    s_w.full_q = xQueueCreate(OTA_WRITER_BUFFERS + 1, sizeof(ota_buf_t *)); // + stop sentinel
+    s_w.exited = xSemaphoreCreateBinary();
+    if (!s_w.bufs || !s_w.free_q || !s_w.full_q || !s_w.exited) {
+        ESP_LOGE(TAG, "Out of memory for staging buffers");
+        release_resources();
+        return -1;
+    }
+    for (int i = 0; i < OTA_WRITER_BUFFERS; i++) {
+        ota_buf_t *b = &s_w.bufs[i];
+        xQueueSend(s_w.free_q, &b, 0);
+    }
+    // Same priority as the LwM2M task: flash work interleaves with network handling
+    if (xTaskCreate(writer_task, "ota_writer", 3072, NULL, uxTaskPriorityGet(NULL), &s_w.task) != pdPASS) {
+        ESP_LOGE(TAG, "Could not create writer task");
+        s_w.task = NULL;
+        release_resources();
+        return -1;
+    }
+    ESP_LOGI(TAG, "Writer started at offset 0x%x (pre-erase %d KB ahead)", (unsigned) start_offset,
+             CONFIG_OTA_WRITER_PREERASE_KB);
+    return 0;
+}
+
+static int submit_fill(void) {
+    ota_buf_t *b = s_w.fill;
+    s_w.fill = NULL;
+    return xQueueSend(s_w.full_q, &b, portMAX_DELAY) == pdTRUE ? 0 : -1;
+}
+
+// Waits for a free staging buffer. This is the flow-control point: while flash is
+// behind, the caller (and with it the block-wise download) is held here.
+static int acquire_fill(void) {
+    ota_buf_t *b = NULL;
+    if (xQueueReceive(s_w.free_q, &b, 0) != pdTRUE) {
+        int64_t t0 = esp_timer_get_time();
+        s_w.stalls++;
+        if (xQueueReceive(s_w.free_q, &b, pdMS_TO_TICKS(CONFIG_OTA_WRITER_STALL_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "Flash writer stalled for %d ms", CONFIG_OTA_WRITER_STALL_TIMEOUT_MS);
+            return -1;
+        }
+        s_w.stall_us += esp_timer_get_time() - t0;
+    }
+    b->offset = s_w.accepted;
+    b->len = 0;
+    s_w.fill = b;
+    return 0;
+}
+
+int ota_writer_write(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *) data;
+    if (!s_w.task) {
+        return -1;
+    }
+    while (len > 0) {
+        if (__atomic_load_n(&s_w.failed, __ATOMIC_ACQUIRE)) {
+            return -1;
+        }
+        if (!s_w.fill && acquire_fill()) {
+            return -1;
+        }
+        ota_buf_t *b = s_w.fill;
+        // Fill up to the next sector boundary so every program call is sector-aligned
+        size_t room = OTA_WRITER_SECTOR_SIZE - ((b->offset + b->len) % OTA_WRITER_SECTOR_SIZE);
+        size_t n = len < room ? len : room;
+        memcpy(&b->data[b->len], p, n);
+        b->len += n;
+        s_w.accepted += n;
+        p += n;
+        len -= n;
+        if (n == room && submit_fill()) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int ota_writer_finish(void) {
+    if (!s_w.task) {
+        return -1;
+    }
+    if (s_w.fill && s_w.fill->len > 0 && submit_fill()) {
+        return -1;
+    }
+    // Drained once every staging buffer is back (the one held by us, if any, counts)
+    int held = s_w.fill ? 1 : 0;
+    ota_buf_t *b;
+    ota_buf_t *back[OTA_WRITER_BUFFERS];
+    int got = 0;
+    while (got + held < OTA_WRITER_BUFFERS) {
+        if (xQueueReceive(s_w.free_q, &b, pdMS_TO_TICKS(CONFIG_OTA_WRITER_STALL_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "Timed out draining staging buffers");
+            return -1;
+        }
+        back[got++] = b;
+    }
+    for (int i = 0; i < got; i++) {
+        xQueueSend(s_w.free_q, &back[i], 0);
+    }
+    if (__atomic_load_n(&s_w.failed, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - s_w.start_us;
+    uint32_t bytes = s_w.committed - s_w.start_offset;
+    ESP_LOGI(TAG, "%u bytes in %u ms: %u KB/s; %u flow-control stalls (%u ms), %u sectors pre-erased",
+             (unsigned) bytes, (unsigned) (elapsed_us / 1000),
+             elapsed_us > 0 ? (unsigned) ((uint64_t) bytes * 1000000 / 1024 / elapsed_us) : 0,
+             (unsigned) s_w.stalls, (unsigned) (s_w.stall_us / 1000), (unsigned) s_w.preerased_sectors);
+    return 0;
+}
+
+void ota_writer_stop(void) {
+    if (!s_w.task) {
+        return;
+    }
+    __atomic_store_n(&s_w.aborting, true, __ATOMIC_RELEASE);
+    ota_buf_t *stop = NULL;
+    xQueueSend(s_w.full_q, &stop, portMAX_DELAY);
+    xSemaphoreTake(s_w.exited, portMAX_DELAY);
+    s_w.task = NULL;
+    release_resources();
+}
+
+uint32_t ota_writer_accepted(void) {
+    return s_w.accepted;
+}
+
+uint32_t ota_writer_committed(void) {
+    return __atomic_load_n(&s_w.committed, __ATOMIC_ACQUIRE);
+}
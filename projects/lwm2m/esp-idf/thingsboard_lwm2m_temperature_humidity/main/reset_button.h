@@ -0,0 +1,17 @@
+#pragma once
+
+// Factory-reset button (BOOT GPIO, active low).
+// Edge interrupt + one-shot esp_timer: a press arms the timer, a release
+// cancels it, so nothing runs while the button is idle. Holding it for
+// CONFIG_FACTORY_RESET_HOLD_MS erases NVS and enters deep sleep.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns 0 on success, -1 on error
+int reset_button_init(void);
+
+#ifdef __cplusplus
+}
+#endif
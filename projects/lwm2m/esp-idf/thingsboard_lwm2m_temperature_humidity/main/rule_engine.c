@@ -0,0 +1,91 @@
+#include "rule_engine.h"
+
+#include <math.h>
+#include <string.h>
+
+bool rule_engine_valid(const rule_def_t *def) {
+    return def->enabled
+        && def->signal < RULE_ENGINE_MAX_SIGNALS
+        && (def->op == RULE_ABOVE || def->op == RULE_BELOW)
+        && def->hold >= 1
+        && isfinite(def->threshold)
+        && isfinite(def->hysteresis) && def->hysteresis >= 0.0f;
+}
+
+int rule_engine_compile(rule_table_t *t, const rule_def_t *defs, size_t n) {
+    if (n > RULE_ENGINE_MAX_RULES) {
+        return -1;
+    }
+    memset(t, 0, sizeof(*t));
+    // Counting sort by signal keeps the conditions of one signal contiguous
+    uint8_t per_signal[RULE_ENGINE_MAX_SIGNALS] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        if (rule_engine_valid(&defs[i])) {
+            per_signal[defs[i].signal]++;
+        }
+    }
+    for (size_t s = 0; s < RULE_ENGINE_MAX_SIGNALS; s++) {
+        t->first[s + 1] = (uint8_t) (t->first[s] + per_signal[s]);
+    }
+    uint8_t next[RULE_ENGINE_MAX_SIGNALS];
+    memcpy(next, t->first, sizeof(next));
+    for (size_t i = 0; i < n; i++) {
+        const rule_def_t *d = &defs[i];
+        if (!rule_engine_valid(d)) {
+            continue;
+        }
+        const uint8_t c = next[d->signal]++;
+        const float sign = d->op == RULE_ABOVE ? 1.0f : -1.0f;
+        t->sign[c] = sign;
+        t->enter[c] = sign * d->threshold;
+        t->leave[c] = sign * d->threshold - d->hysteresis;
+        t->hold[c] = d->hold;
+        t->rule[c] = (uint8_t) i;
+    }
+    t->count = t->first[RULE_ENGINE_MAX_SIGNALS];
+    return t->count;
+}
+
+void rule_engine_carry_state(rule_table_t *t, const rule_table_t *old, uint32_t keep) {
+    uint8_t old_cond[RULE_ENGINE_MAX_RULES];
+    memset(old_cond, 0xFF, sizeof(old_cond));
+    for (uint8_t c = 0; c < old->count; c++) {
+        old_cond[old->rule[c]] = c;
+    }
+    for (uint8_t c = 0; c < t->count; c++) {
+        const uint8_t r = t->rule[c];
+        const uint32_t bit = 1u << r;
+        if ((keep & bit) && old_cond[r] != 0xFF) {
+            t->run[c] = old->run[old_cond[r]];
+            t->active |= old->active & bit;
+        }
+    }
+}
+
+uint32_t rule_engine_eval(rule_table_t *t, uint8_t signal, float value) {
+    if (signal >= RULE_ENGINE_MAX_SIGNALS) {
+        return 0;
+    }
+    uint32_t changed = 0;
+    const uint8_t end = t->first[signal + 1];
+    for (uint8_t c = t->first[signal]; c < end; c++) {
+        const float v = t->sign[c] * value;
+        const uint32_t bit = 1u << t->rule[c];
+        if (!(t->active & bit)) {
+            // NaN compares false: resets the run, never fires
+            if (v > t->enter[c]) {
+                if (++t->run[c] >= t->hold[c]) {
+                    t->active |= bit;
+                    changed |= bit;
+                }
+            } else {
+                t->run[c] = 0;
+            }
+        } else if (v < t->leave[c]) {
+            t->active &= ~bit;
+            t->run[c] = 0;
+            changed |= bit;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,500 @@
+#include "rule_object.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <anjay/attr_storage.h>
+#include <anjay/dm.h>
+#include <anjay/io.h>
+#include <esp_cpu.h>
+#include <esp_log.h>
+
+#include "cfg_store.h"
+#include "notify_filter.h"
+#include "sdkconfig.h"
+
+// Private object ID range (26241..32768)
+#define OID_RULES 26241
+#define RID_SOURCE        0 // string: "/oid/iid/rid"
+#define RID_OPERATOR      1 // int: rule_op_t
+#define RID_THRESHOLD     2 // float
+#define RID_HYSTERESIS    3 // float
+#define RID_HOLD          4 // int: samples
+#define RID_ENABLED       5 // bool
+#define RID_ACTIVE        6 // bool (R)
+#define RID_TRIGGER_COUNT 7 // int (R)
+#define RID_TRIGGER_VALUE 8 // float (R)
+
+#define RULE_SOURCE_MAX 24
+#define RULES_BLOB_VERSION 1
+
+#ifndef CONFIG_LWM2M_SERVER_SHORT_ID
+#define CONFIG_LWM2M_SERVER_SHORT_ID 123
+#endif
+
+typedef struct {
+    anjay_oid_t oid;
+    anjay_iid_t iid;
+    anjay_rid_t rid;
+} rule_signal_t;
+
+typedef struct {
+    bool used;
+    bool attrs_set; // con/pmin applied to the Active resource
+    anjay_iid_t iid;
+    char source[RULE_SOURCE_MAX];
+    rule_def_t def; // def.signal is resolved from source when compiling
+    rule_def_t compiled; // as passed to the last compile; zeroed for new or reset slots
+    uint32_t trigger_count;
+    float trigger_value;
+} rule_slot_t;
+
+// Config store image: header + one record per instance
+typedef struct {
+    uint16_t iid;
+    uint8_t op;
+    uint8_t hold;
+    uint8_t enabled;
+    uint8_t reserved[3];
+    float threshold;
+    float hysteresis;
+    char source[RULE_SOURCE_MAX];
+} rule_record_t;
+
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    uint8_t reserved[2];
+    rule_record_t rule[RULE_ENGINE_MAX_RULES];
+} rule_blob_t;
+
+typedef struct {
+    const anjay_dm_object_def_t *def;
+    bool created;
+    bool dirty; // definitions changed since the last compile
+    rule_slot_t slot[RULE_ENGINE_MAX_RULES]; // slot index = rule index in the table
+    rule_table_t table;
+    rule_signal_t signal[RULE_ENGINE_MAX_SIGNALS];
+    uint8_t signal_count;
+    uint32_t eval_cycles_max;
+} rules_ctx_t;
+
+static const char *TAG = "rules";
+
+static rules_ctx_t g_rules;
+
+uint8_t rule_object_add_signal(anjay_oid_t oid, anjay_iid_t iid, anjay_rid_t rid) {
+    for (uint8_t i = 0; i < g_rules.signal_count; i++) {
+        const rule_signal_t *s = &g_rules.signal[i];
+        if (s->oid == oid && s->iid == iid && s->rid == rid) {
+            return i;
+        }
+    }
+    if (g_rules.signal_count >= RULE_ENGINE_MAX_SIGNALS) {
+        ESP_LOGW(TAG, "No room for signal /%u/%u/%u", (unsigned) oid, (unsigned) iid, (unsigned) rid);
+        return RULE_SIGNAL_NONE;
+    }
+    g_rules.signal[g_rules.signal_count] = (rule_signal_t) { oid, iid, rid };
+    g_rules.dirty = true;
+    return g_rules.signal_count++;
+}
+
+// "/oid/iid/rid" of a declared signal, RULE_SIGNAL_NONE otherwise
+static uint8_t resolve_source(const char *source) {
+    unsigned oid, iid, rid;
+    int end = 0;
+    if (sscanf(source, "/%u/%u/%u%n", &oid, &iid, &rid, &end) != 3 || source[end] != '\0') {
+        return RULE_SIGNAL_NONE;
+    }
+    for (uint8_t i = 0; i < g_rules.signal_count; i++) {
+        const rule_signal_t *s = &g_rules.signal[i];
+        if (s->oid == oid && s->iid == iid && s->rid == rid) {
+            return i;
+        }
+    }
+    return RULE_SIGNAL_NONE;
+}
+
+static rule_slot_t *find_slot(anjay_iid_t iid) {
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        if (g_rules.slot[i].used && g_rules.slot[i].iid == iid) {
+            return &g_rules.slot[i];
+        }
+    }
+    return NULL;
+}
+
+static void slot_defaults(rule_slot_t *s, anjay_iid_t iid) {
+    memset(s, 0, sizeof(*s));
+    s->used = true;
+    s->iid = iid;
+    s->def.enabled = true;
+    s->def.op = RULE_ABOVE;
+    s->def.hold = 1;
+}
+
+static void persist(void) {
+    rule_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = RULES_BLOB_VERSION;
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        const rule_slot_t *s = &g_rules.slot[i];
+        if (!s->used) {
+            continue;
+        }
+        rule_record_t *r = &blob.rule[blob.count++];
+        r->iid = s->iid;
+        r->op = s->def.op;
+        r->hold = s->def.hold;
+        r->enabled = s->def.enabled;
+        r->threshold = s->def.threshold;
+        r->hysteresis = s->def.hysteresis;
+        memcpy(r->source, s->source, sizeof(r->source));
+    }
+    if (blob.count) {
+        (void) cfg_store_set_blob(CFG_KEY_RULES, &blob,
+                                  offsetof(rule_blob_t, rule) + blob.count * sizeof(rule_record_t));
+    } else {
+        cfg_store_erase(CFG_KEY_RULES);
+    }
+    if (cfg_store_commit()) {
+        ESP_LOGW(TAG, "Failed to persist rules");
+    }
+}
+
+static void load(void) {
+    rule_blob_t blob;
+    size_t len = 0;
+    if (cfg_store_get_blob(CFG_KEY_RULES, &blob, sizeof(blob), &len)
+            || len < offsetof(rule_blob_t, rule) || blob.version != RULES_BLOB_VERSION
+            || blob.count > RULE_ENGINE_MAX_RULES
+            || len != offsetof(rule_blob_t, rule) + blob.count * sizeof(rule_record_t)) {
+        return;
+    }
+    for (size_t i = 0; i < blob.count; i++) {
+        const rule_record_t *r = &blob.rule[i];
+        rule_slot_t *s = &g_rules.slot[i];
+        slot_defaults(s, r->iid);
+        s->def.op = r->op;
+        s->def.hold = r->hold;
+        s->def.enabled = r->enabled != 0;
+        s->def.threshold = r->threshold;
+        s->def.hysteresis = r->hysteresis;
+        memcpy(s->source, r->source, sizeof(s->source));
+        s->source[sizeof(s->source) - 1] = '\0';
+    }
+    ESP_LOGI(TAG, "Loaded %u rule(s)", (unsigned) blob.count);
+}
+
+// Rule state changes go out as soon as possible and are acknowledged:
+// pmin 0 and con 1 on Active, unless the server chose its own
+static void set_active_attrs(anjay_t *anjay, rule_slot_t *s) {
+#if defined(ANJAY_WITH_ATTR_STORAGE) && CONFIG_LWM2M_RULES_CONFIRMABLE
+    const anjay_ssid_t ssid = (anjay_ssid_t) CONFIG_LWM2M_SERVER_SHORT_ID;
+    anjay_dm_r_attributes_t attrs = ANJAY_DM_R_ATTRIBUTES_EMPTY;
+    (void) anjay_attr_storage_get_resource_attrs(anjay, ssid, OID_RULES, s->iid, RID_ACTIVE, &attrs);
+    bool change = false;
+    if (attrs.common.min_period < 0) {
+        attrs.common.min_period = 0;
+        change = true;
+    }
+#ifdef ANJAY_WITH_CON_ATTR
+    if (attrs.common.con == ANJAY_DM_CON_ATTR_DEFAULT) {
+        attrs.common.con = ANJAY_DM_CON_ATTR_CON;
+        change = true;
+    }
+#endif
+    if (change) {
+        if (anjay_attr_storage_set_resource_attrs(anjay, ssid, OID_RULES, s->iid, RID_ACTIVE, &attrs)) {
+            ESP_LOGW(TAG, "Could not set attributes of /%d/%u/%d", OID_RULES, (unsigned) s->iid, RID_ACTIVE);
+            return;
+        }
+        notify_filter_invalidate_all();
+    }
+#else
+    (void) anjay;
+#endif
+    s->attrs_set = true;
+}
+
+static void compile(anjay_t *anjay) {
+    const rule_table_t old = g_rules.table;
+    rule_def_t defs[RULE_ENGINE_MAX_RULES];
+    uint32_t unchanged = 0;
+    size_t rules = 0;
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        rule_slot_t *s = &g_rules.slot[i];
+        defs[i] = s->def;
+        defs[i].enabled = s->used && s->def.enabled;
+        if (!s->used) {
+            continue;
+        }
+        rules++;
+        defs[i].signal = resolve_source(s->source);
+        if (!memcmp(&defs[i], &s->compiled, sizeof(defs[i]))) {
+            unchanged |= 1u << i;
+        }
+        s->compiled = defs[i];
+        if (defs[i].enabled && !rule_engine_valid(&defs[i])) {
+            ESP_LOGW(TAG, "Rule %u skipped: source '%s' not sampled or invalid definition",
+                     (unsigned) s->iid, s->source);
+        }
+    }
+    const int conditions = rule_engine_compile(&g_rules.table, defs, RULE_ENGINE_MAX_RULES);
+    // Untouched rules keep their state, so an edit does not re-fire the others;
+    // edited ones restart inactive: tell observers of those that were active
+    rule_engine_carry_state(&g_rules.table, &old, unchanged);
+    const uint32_t cleared = old.active & ~g_rules.table.active;
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        if ((cleared & (1u << i)) && g_rules.slot[i].used) {
+            (void) anjay_notify_changed(anjay, OID_RULES, g_rules.slot[i].iid, RID_ACTIVE);
+        }
+    }
+    ESP_LOGI(TAG, "Compiled %d condition(s) from %u rule(s) over %u signal(s), worst eval so far %u cycles",
+             conditions, (unsigned) rules, (unsigned) g_rules.signal_count, (unsigned) g_rules.eval_cycles_max);
+}
+
+void rule_object_eval(anjay_t *anjay, uint8_t signal, float value) {
+    if (!g_rules.created || signal == RULE_SIGNAL_NONE) {
+        return;
+    }
+    const uint32_t start = esp_cpu_get_cycle_count();
+    const uint32_t changed = rule_engine_eval(&g_rules.table, signal, value);
+    const uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    if (cycles > g_rules.eval_cycles_max) {
+        g_rules.eval_cycles_max = cycles;
+    }
+    if (!changed) {
+        return;
+    }
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        if (!(changed & (1u << i))) {
+            continue;
+        }
+        rule_slot_t *s = &g_rules.slot[i];
+        if (rule_engine_active(&g_rules.table, i)) {
+            s->trigger_count++;
+            s->trigger_value = value;
+            ESP_LOGW(TAG, "Rule %u fired: %s %s %.3f (value %.3f)", (unsigned) s->iid, s->source,
+                     s->def.op == RULE_ABOVE ? ">" : "<", (double) s->def.threshold, (double) value);
+            (void) anjay_notify_changed(anjay, OID_RULES, s->iid, RID_TRIGGER_COUNT);
+            (void) anjay_notify_changed(anjay, OID_RULES, s->iid, RID_TRIGGER_VALUE);
+        } else {
+            ESP_LOGI(TAG, "Rule %u cleared (value %.3f)", (unsigned) s->iid, (double) value);
+        }
+        (void) anjay_notify_changed(anjay, OID_RULES, s->iid, RID_ACTIVE);
+    }
+}
+
+void rule_object_update(anjay_t *anjay) {
+    if (!g_rules.created || !anjay) {
+        return;
+    }
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        if (g_rules.slot[i].used && !g_rules.slot[i].attrs_set) {
+            set_active_attrs(anjay, &g_rules.slot[i]);
+        }
+    }
+    if (!g_rules.dirty) {
+        return;
+    }
+    g_rules.dirty = false;
+    compile(anjay);
+    persist();
+}
+
+static int list_instances(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                          anjay_dm_list_ctx_t *ctx) {
+    (void) anjay; (void) def;
+    // Ascending IID order
+    int32_t prev = -1;
+    for (;;) {
+        int32_t next = -1;
+        for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+            const rule_slot_t *s = &g_rules.slot[i];
+            if (s->used && (int32_t) s->iid > prev && (next < 0 || (int32_t) s->iid < next)) {
+                next = s->iid;
+            }
+        }
+        if (next < 0) {
+            return 0;
+        }
+        anjay_dm_emit(ctx, (anjay_iid_t) next);
+        prev = next;
+    }
+}
+
+static int instance_create(anjay_t *anjay, const anjay_dm_object_def_t *const *def, anjay_iid_t iid) {
+    (void) anjay; (void) def;
+    for (size_t i = 0; i < RULE_ENGINE_MAX_RULES; i++) {
+        if (!g_rules.slot[i].used) {
+            slot_defaults(&g_rules.slot[i], iid);
+            g_rules.dirty = true;
+            ESP_LOGI(TAG, "Rule %u created", (unsigned) iid);
+            return 0;
+        }
+    }
+    ESP_LOGW(TAG, "Rule %u rejected: %d rules already defined", (unsigned) iid, RULE_ENGINE_MAX_RULES);
+    return ANJAY_ERR_INTERNAL;
+}
+
+static int instance_remove(anjay_t *anjay, const anjay_dm_object_def_t *const *def, anjay_iid_t iid) {
+    (void) anjay; (void) def;
+    rule_slot_t *s = find_slot(iid);
+    if (!s) {
+        return ANJAY_ERR_NOT_FOUND;
+    }
+    s->used = false;
+    g_rules.dirty = true;
+    ESP_LOGI(TAG, "Rule %u removed", (unsigned) iid);
+    return 0;
+}
+
+static int instance_reset(anjay_t *anjay, const anjay_dm_object_def_t *const *def, anjay_iid_t iid) {
+    (void) anjay; (void) def;
+    rule_slot_t *s = find_slot(iid);
+    if (!s) {
+        return ANJAY_ERR_NOT_FOUND;
+    }
+    slot_defaults(s, iid);
+    g_rules.dirty = true;
+    return 0;
+}
+
+static int list_resources(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                          anjay_iid_t iid, anjay_dm_resource_list_ctx_t *ctx) {
+    (void) anjay; (void) def; (void) iid;
+    anjay_dm_emit_res(ctx, RID_SOURCE, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_OPERATOR, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_THRESHOLD, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_HYSTERESIS, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_HOLD, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_ENABLED, ANJAY_DM_RES_RW, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_ACTIVE, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_TRIGGER_COUNT, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    anjay_dm_emit_res(ctx, RID_TRIGGER_VALUE, ANJAY_DM_RES_R, ANJAY_DM_RES_PRESENT);
+    return 0;
+}
+
+static int resource_read(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                         anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
+                         anjay_output_ctx_t *ctx) {
+    (void) anjay; (void) def; (void) riid;
+    const rule_slot_t *s = find_slot(iid);
+    if (!s) {
+        return ANJAY_ERR_NOT_FOUND;
+    }
+    switch (rid) {
+    case RID_SOURCE:
+        return anjay_ret_string(ctx, s->source);
+    case RID_OPERATOR:
+        return anjay_ret_i32(ctx, s->def.op);
+    case RID_THRESHOLD:
+        return anjay_ret_float(ctx, s->def.threshold);
+    case RID_HYSTERESIS:
+        return anjay_ret_float(ctx, s->def.hysteresis);
+    case RID_HOLD:
+        return anjay_ret_i32(ctx, s->def.hold);
+    case RID_ENABLED:
+        return anjay_ret_bool(ctx, s->def.enabled);
+    case RID_ACTIVE:
+        return anjay_ret_bool(ctx, rule_engine_active(&g_rules.table, (size_t) (s - g_rules.slot)));
+    case RID_TRIGGER_COUNT:
+        return anjay_ret_i64(ctx, s->trigger_count);
+    case RID_TRIGGER_VALUE:
+        return anjay_ret_float(ctx, s->trigger_value);
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+}
+
+static int resource_write(anjay_t *anjay, const anjay_dm_object_def_t *const *def,
+                          anjay_iid_t iid, anjay_rid_t rid, anjay_riid_t riid,
+                          anjay_input_ctx_t *in_ctx) {
+    (void) def; (void) riid;
+    rule_slot_t *s = find_slot(iid);
+    if (!s) {
+        return ANJAY_ERR_NOT_FOUND;
+    }
+    rule_def_t d = s->def;
+    char source[RULE_SOURCE_MAX];
+    memcpy(source, s->source, sizeof(source));
+    int32_t i = 0;
+    int res;
+    switch (rid) {
+    case RID_SOURCE:
+        if ((res = anjay_get_string(in_ctx, source, sizeof(source)))) {
+            return res == ANJAY_BUFFER_TOO_SHORT ? ANJAY_ERR_BAD_REQUEST : res;
+        }
+        if (resolve_source(source) == RULE_SIGNAL_NONE) {
+            ESP_LOGW(TAG, "Rule %u: '%s' is not a sampled resource", (unsigned) iid, source);
+            return ANJAY_ERR_BAD_REQUEST;
+        }
+        break;
+    case RID_OPERATOR:
+        if ((res = anjay_get_i32(in_ctx, &i))) return res;
+        if (i != RULE_ABOVE && i != RULE_BELOW) return ANJAY_ERR_BAD_REQUEST;
+        d.op = (uint8_t) i;
+        break;
+    case RID_THRESHOLD:
+        if ((res = anjay_get_float(in_ctx, &d.threshold))) return res;
+        if (!isfinite(d.threshold)) return ANJAY_ERR_BAD_REQUEST;
+        break;
+    case RID_HYSTERESIS:
+        if ((res = anjay_get_float(in_ctx, &d.hysteresis))) return res;
+        if (!isfinite(d.hysteresis) || d.hysteresis < 0.0f) return ANJAY_ERR_BAD_REQUEST;
+        break;
+    case RID_HOLD:
+        if ((res = anjay_get_i32(in_ctx, &i))) return res;
+        if (i < 1 || i > 255) return ANJAY_ERR_BAD_REQUEST;
+        d.hold = (uint8_t) i;
+        break;
+    case RID_ENABLED:
+        if ((res = anjay_get_bool(in_ctx, &d.enabled))) return res;
+        break;
+    default:
+        return ANJAY_ERR_METHOD_NOT_ALLOWED;
+    }
+    if (memcmp(&d, &s->def, sizeof(d)) || strcmp(source, s->source)) {
+        s->def = d;
+        memcpy(s->source, source, sizeof(s->source));
+        g_rules.dirty = true;
+        (void) anjay_notify_changed(anjay, OID_RULES, iid, rid);
+    }
+    return 0;
+}
+
+static const anjay_dm_object_def_t OBJ_DEF = {
+    .oid = OID_RULES,
+    .version = "1.0",
+    .handlers = {
+        .list_instances = list_instances,
+        .instance_create = instance_create,
+        .instance_remove = instance_remove,
+        .instance_reset = instance_reset,
+        .list_resources = list_resources,
+        .resource_read = resource_read,
+        .resource_write = resource_write,
+        .transaction_begin = anjay_dm_transaction_NOOP,
+        .transaction_validate = anjay_dm_transaction_NOOP,
+        .transaction_commit = anjay_dm_transaction_NOOP,
+        .transaction_rollback = anjay_dm_transaction_NOOP
+    }
+};
+
+const anjay_dm_object_def_t *const *rule_object_create(void) {
+    g_rules.def = &OBJ_DEF;
+    memset(g_rules.slot, 0, sizeof(g_rules.slot));
+    memset(&g_rules.table, 0, sizeof(g_rules.table));
+    load();
+    g_rules.created = true;
+    g_rules.dirty = true;
+    ESP_LOGI(TAG, "Threshold Rules(%d) created", OID_RULES);
+    return &g_rules.def;
+}
+
+void rule_object_release(const anjay_dm_object_def_t *const *obj) {
+    (void) obj;
+    g_rules.created = false;
+}
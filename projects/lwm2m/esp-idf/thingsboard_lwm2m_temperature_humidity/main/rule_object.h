@@ -0,0 +1,45 @@
+#pragma once
+
+#include <anjay/anjay.h>
+#include <stdint.h>
+
+#include "rule_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Threshold Rules (custom Object 26241, multi-instance, one rule per instance)
+//  - 0 Source (string RW): sampled resource as "/oid/iid/rid"
+//  - 1 Operator (int RW): 0 = above, 1 = below
+//  - 2 Threshold (float RW)
+//  - 3 Hysteresis (float RW, >= 0)
+//  - 4 Hold (int RW, 1..255): consecutive samples before the rule fires
+//  - 5 Enabled (bool RW)
+//  - 6 Active (bool R): observe it; notified as soon as the state changes
+//  - 7 Trigger Count (int R)
+//  - 8 Trigger Value (float R): sample that last fired the rule
+// Definitions are compiled into a rule_table_t from the main loop after a
+// Create/Write/Delete and persisted in the config store.
+
+#define RULE_SIGNAL_NONE 0xFF
+
+// Declares a resource whose samples are passed to rule_object_eval(). Returns
+// its signal index (the same one for a path declared twice), or
+// RULE_SIGNAL_NONE if RULE_ENGINE_MAX_SIGNALS are already declared.
+uint8_t rule_object_add_signal(anjay_oid_t oid, anjay_iid_t iid, anjay_rid_t rid);
+
+const anjay_dm_object_def_t *const *rule_object_create(void);
+void rule_object_release(const anjay_dm_object_def_t *const *obj);
+
+// Sampling path: checks value against the rules of signal and notifies the
+// rules that changed state. Walks at most RULE_ENGINE_MAX_RULES conditions;
+// no-op for RULE_SIGNAL_NONE or when the object is not created.
+void rule_object_eval(anjay_t *anjay, uint8_t signal, float value);
+
+// Main loop: recompiles and persists the rules after they were modified
+void rule_object_update(anjay_t *anjay);
+
+#ifdef __cplusplus
+}
+#endif
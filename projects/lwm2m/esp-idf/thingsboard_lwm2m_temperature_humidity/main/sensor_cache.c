@@ -0,0 +1,33 @@
+#include "sensor_cache.h"
+
+void sensor_cache_publish(sensor_cache_t *cache, float temperature_c, float humidity_pct, uint32_t now_ms) {
+    uint32_t lock = __atomic_load_n(&cache->lock, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->lock, lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    cache->sample.temperature_c = temperature_c;
+    cache->sample.humidity_pct = humidity_pct;
+    cache->sample.timestamp_ms = now_ms;
+    cache->sample.seq++;
+    if (cache->sample.seq == 0) {
+        cache->sample.seq = 1; // keep 0 reserved for "no sample"
+    }
+    __atomic_store_n(&cache->lock, lock + 2, __ATOMIC_RELEASE);
+}
+
+bool sensor_cache_read(const sensor_cache_t *cache, sensor_sample_t *out) {
+    uint32_t before, after;
+    do {
+        before = __atomic_load_n(&cache->lock, __ATOMIC_ACQUIRE);
+        if (before & 1u) {
+            continue; // writer in progress, retry
+        }
+        *out = cache->sample;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&cache->lock, __ATOMIC_RELAXED);
+    } while ((before & 1u) || before != after);
+    return out->seq != 0;
+}
+
+bool sensor_sample_is_fresh(const sensor_sample_t *sample, uint32_t now_ms, uint32_t max_age_ms) {
+    return sample->seq != 0 && (uint32_t) (now_ms - sample->timestamp_ms) <= max_age_ms;
+}
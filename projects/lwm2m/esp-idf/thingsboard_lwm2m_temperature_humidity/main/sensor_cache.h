@@ -0,0 +1,39 @@
+#pragma once
+
+// Single-writer sample cache shared by the sensor task and the LwM2M task.
+// A sequence counter (seqlock) lets readers copy the latest sample in O(1)
+// without taking a mutex on the CoAP response path. Portable C, host-testable.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float temperature_c;
+    float humidity_pct;
+    uint32_t timestamp_ms; // time of conversion (caller's monotonic clock)
+    uint32_t seq;          // increments once per published sample, 0 = none yet
+} sensor_sample_t;
+
+typedef struct {
+    volatile uint32_t lock; // odd while a write is in progress
+    sensor_sample_t sample;
+} sensor_cache_t;
+
+#define SENSOR_CACHE_INITIALIZER { 0, { 0.0f, 0.0f, 0, 0 } }
+
+// Writer side (one task only)
+void sensor_cache_publish(sensor_cache_t *cache, float temperature_c, float humidity_pct, uint32_t now_ms);
+
+// Reader side; returns false if nothing has been published yet
+bool sensor_cache_read(const sensor_cache_t *cache, sensor_sample_t *out);
+
+// True if the sample is younger than max_age_ms at now_ms (wrap-safe)
+bool sensor_sample_is_fresh(const sensor_sample_t *sample, uint32_t now_ms, uint32_t max_age_ms);
+
+#ifdef __cplusplus
+}
+#endif
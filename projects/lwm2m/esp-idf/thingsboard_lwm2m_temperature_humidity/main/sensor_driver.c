@@ -0,0 +1,199 @@
+// Timer-driven temperature/humidity sampling into a shared cache.
+// An esp_timer kicks a low-priority task that triggers a conversion, sleeps for the
+// chip's conversion time (the I2C driver is interrupt-driven, the task only blocks
+// itself) and publishes the result. LwM2M reads only copy from the cache.
+#include "sensor_driver.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "th_sensor.h"
+
+// Fallback defaults if sdkconfig hasn't yet picked up new Kconfig symbols
+#if !defined(CONFIG_TH_SENSOR_SHT3X) && !defined(CONFIG_TH_SENSOR_AHT20) && !defined(CONFIG_TH_SENSOR_SIMULATED)
+#define CONFIG_TH_SENSOR_SIMULATED 1
+#endif
+#ifndef CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS
+#define CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS 1000
+#endif
+#ifndef CONFIG_TH_SENSOR_MAX_AGE_MS
+#define CONFIG_TH_SENSOR_MAX_AGE_MS 5000
+#endif
+#ifndef CONFIG_TH_SENSOR_I2C_SDA_GPIO
+#define CONFIG_TH_SENSOR_I2C_SDA_GPIO 6
+#endif
+#ifndef CONFIG_TH_SENSOR_I2C_SCL_GPIO
+#define CONFIG_TH_SENSOR_I2C_SCL_GPIO 7
+#endif
+#ifndef CONFIG_TH_SENSOR_I2C_ADDR
+#define CONFIG_TH_SENSOR_I2C_ADDR 0x44
+#endif
+
+#if !CONFIG_TH_SENSOR_SIMULATED
+#include "driver/i2c_master.h"
+#endif
+
+#define SENSOR_I2C_TIMEOUT_MS 20
+#define SENSOR_I2C_SPEED_HZ 100000
+
+static const char *TAG = "th_sensor";
+
+static sensor_cache_t s_cache = SENSOR_CACHE_INITIALIZER;
+static TaskHandle_t s_task = NULL;
+static esp_timer_handle_t s_timer = NULL;
+static uint32_t s_errors = 0;
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t) (esp_timer_get_time() / 1000);
+}
+
+#if CONFIG_TH_SENSOR_SIMULATED
+// Placeholder waveforms used when no physical sensor is fitted
+static void simulate(float *temperature_c, float *humidity_pct) {
+    TickType_t ticks = xTaskGetTickCount();
+    // Faster phase to ensure noticeable change across a few seconds
+    float t_phase = (float) (ticks % 8192) / 128.0f;
+    // Deterministic small dither (sawtooth) to guarantee change between close samples
+    float t_saw = ((float) (ticks & 63) / 63.0f - 0.5f) * 0.10f;
+    *temperature_c = 25.0f + 2.5f * sinf(t_phase) + t_saw;
+    float h_phase = (float) (ticks % 12000) / 300.0f;
+    float h_saw = ((float) (ticks & 63) / 63.0f - 0.5f) * 0.40f;
+    *humidity_pct = 55.0f + 10.0f * sinf(h_phase) + h_saw;
+}
+#else
+static i2c_master_bus_handle_t s_bus = NULL;
+static i2c_master_dev_handle_t s_dev = NULL;
+
+static int esp_i2c_write(void *ctx, uint8_t addr, const uint8_t *data, size_t len) {
+    (void) ctx; (void) addr; // address is bound to the device handle
+    return i2c_master_transmit(s_dev, data, len, SENSOR_I2C_TIMEOUT_MS) == ESP_OK ? 0 : -1;
+}
+
+static int esp_i2c_read(void *ctx, uint8_t addr, uint8_t *data, size_t len) {
+    (void) ctx; (void) addr;
+    return i2c_master_receive(s_dev, data, len, SENSOR_I2C_TIMEOUT_MS) == ESP_OK ? 0 : -1;
+}
+
+static const th_i2c_bus_t s_i2c_ops = {
+    .write = esp_i2c_write,
+    .read = esp_i2c_read,
+    .ctx = NULL,
+};
+
+static th_sensor_t s_sensor = {
+#if CONFIG_TH_SENSOR_AHT20
+    .model = TH_SENSOR_AHT20,
+#else
+    .model = TH_SENSOR_SHT3X,
+#endif
+    .addr = CONFIG_TH_SENSOR_I2C_ADDR,
+    .bus = &s_i2c_ops,
+};
+
+static esp_err_t i2c_setup(void) {
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port = -1, // auto-select
+        .sda_io_num = CONFIG_TH_SENSOR_I2C_SDA_GPIO,
+        .scl_io_num = CONFIG_TH_SENSOR_I2C_SCL_GPIO,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&bus_cfg, &s_bus);
+    if (err != ESP_OK) {
+        return err;
+    }
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = CONFIG_TH_SENSOR_I2C_ADDR,
+        .scl_speed_hz = SENSOR_I2C_SPEED_HZ,
+    };
+    return i2c_master_bus_add_device(s_bus, &dev_cfg, &s_dev);
+}
+
+static bool measure(float *temperature_c, float *humidity_pct) {
+    if (th_sensor_trigger(&s_sensor) != TH_SENSOR_OK) {
+        return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(th_sensor_conversion_ms(&s_sensor)));
+    int rc = th_sensor_collect(&s_sensor, temperature_c, humidity_pct);
+    if (rc == TH_SENSOR_BUSY) {
+        // Slow part or cold start: one extra conversion slot before giving up
+        vTaskDelay(pdMS_TO_TICKS(th_sensor_conversion_ms(&s_sensor)));
+        rc = th_sensor_collect(&s_sensor, temperature_c, humidity_pct);
+    }
+    return rc == TH_SENSOR_OK;
+}
+#endif // CONFIG_TH_SENSOR_SIMULATED
+
+static void sensor_task(void *arg) {
+    (void) arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        float t = 0.0f, rh = 0.0f;
+#if CONFIG_TH_SENSOR_SIMULATED
+        simulate(&t, &rh);
+#else
+        if (!measure(&t, &rh)) {
+            if ((s_errors++ % 30) == 0) {
+                ESP_LOGW(TAG, "Conversion failed (addr 0x%02x, errors=%u)", s_sensor.addr, (unsigned) s_errors);
+            }
+            continue;
+        }
+#endif
+        sensor_cache_publish(&s_cache, t, rh, now_ms());
+    }
+}
+
+static void sample_timer_cb(void *arg) {
+    (void) arg;
+    xTaskNotifyGive(s_task);
+}
+
+int sensor_driver_start(void) {
+    if (s_task) {
+        return 0;
+    }
+#if !CONFIG_TH_SENSOR_SIMULATED
+    esp_err_t err = i2c_setup();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "I2C bus setup failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    if (th_sensor_init(&s_sensor) != TH_SENSOR_OK) {
+        // Keep going: the timer retries every period and the cache reports NONE/STALE
+        ESP_LOGW(TAG, "Sensor did not answer at 0x%02x; will keep retrying", s_sensor.addr);
+    }
+#endif
+    if (xTaskCreate(sensor_task, "th_sensor", 3072, NULL, tskIDLE_PRIORITY + 1, &s_task) != pdPASS) {
+        ESP_LOGE(TAG, "Could not create sensor task");
+        s_task = NULL;
+        return -1;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = sample_timer_cb,
+        .name = "th_sample",
+    };
+    if (esp_timer_create(&args, &s_timer) != ESP_OK
+        || esp_timer_start_periodic(s_timer, (uint64_t) CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not start sample timer");
+        return -1;
+    }
+    // First conversion right away so the first Register/Send has data
+    xTaskNotifyGive(s_task);
+    ESP_LOGI(TAG, "Sampling every %d ms (max age %d ms)", CONFIG_TH_SENSOR_SAMPLE_PERIOD_MS, CONFIG_TH_SENSOR_MAX_AGE_MS);
+    return 0;
+}
+
+sensor_sample_state_t sensor_driver_get(sensor_sample_t *out) {
+    if (!sensor_cache_read(&s_cache, out)) {
+        return SENSOR_SAMPLE_NONE;
+    }
+    return sensor_sample_is_fresh(out, now_ms(), CONFIG_TH_SENSOR_MAX_AGE_MS) ? SENSOR_SAMPLE_FRESH : SENSOR_SAMPLE_STALE;
+}
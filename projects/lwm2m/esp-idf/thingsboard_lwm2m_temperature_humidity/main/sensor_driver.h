@@ -0,0 +1,23 @@
+#pragma once
+
+#include "sensor_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SENSOR_SAMPLE_NONE = 0, // no conversion finished yet
+    SENSOR_SAMPLE_STALE,    // older than CONFIG_TH_SENSOR_MAX_AGE_MS
+    SENSOR_SAMPLE_FRESH
+} sensor_sample_state_t;
+
+// Starts the timer-driven sampling task (idempotent). Returns 0 on success, -1 on error.
+int sensor_driver_start(void);
+
+// O(1) copy of the latest cached sample; never touches the I2C bus.
+sensor_sample_state_t sensor_driver_get(sensor_sample_t *out);
+
+#ifdef __cplusplus
+}
+#endif
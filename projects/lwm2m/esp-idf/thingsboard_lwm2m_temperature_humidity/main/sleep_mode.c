@@ -0,0 +1,246 @@
+// Duty-cycled deep-sleep reporting: wake on RTC timer, report 3303/3304, sleep again.
+#include "sleep_mode.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+#include <anjay/core.h>
+#include <avsystem/commons/avs_stream_inbuf.h>
+#include <avsystem/commons/avs_stream_outbuf.h>
+
+// Fallback defaults if sdkconfig hasn't yet picked up new Kconfig symbols
+#ifndef CONFIG_LWM2M_DEEP_SLEEP_ENABLE
+#define CONFIG_LWM2M_DEEP_SLEEP_ENABLE 0
+#endif
+#ifndef CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S
+#define CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S 300
+#endif
+#ifndef CONFIG_LWM2M_DEEP_SLEEP_AWAKE_TIMEOUT_MS
+#define CONFIG_LWM2M_DEEP_SLEEP_AWAKE_TIMEOUT_MS 15000
+#endif
+#ifndef CONFIG_LWM2M_DEEP_SLEEP_LINGER_MS
+#define CONFIG_LWM2M_DEEP_SLEEP_LINGER_MS 500
+#endif
+#ifndef CONFIG_LWM2M_DEEP_SLEEP_ACTIVE_CURRENT_MA
+#define CONFIG_LWM2M_DEEP_SLEEP_ACTIVE_CURRENT_MA 80
+#endif
+#ifndef CONFIG_LWM2M_DEEP_SLEEP_SLEEP_CURRENT_UA
+#define CONFIG_LWM2M_DEEP_SLEEP_SLEEP_CURRENT_UA 10
+#endif
+
+// Room for Anjay core persistence (registration + observations). RTC slow memory
+// on the C6 is 16 KB, so 2 KB leaves plenty for the rest of the RTC data.
+#define SLEEP_PERSIST_MAX 2048
+#define SLEEP_RTC_MAGIC 0x534C5031u // "SLP1"
+
+static const char *TAG = "sleep_mode";
+
+// Survives deep sleep; re-initialized from the image on a cold boot
+typedef struct {
+    uint32_t magic;
+    uint32_t cycles;
+    uint32_t last_awake_ms;
+    uint32_t last_charge_uc;  // awake charge of last cycle (microcoulombs)
+    uint64_t total_awake_ms;
+    uint32_t persisted_len;   // 0 = nothing usable retained
+    uint8_t persisted[SLEEP_PERSIST_MAX];
+} sleep_retained_t;
+
+static RTC_DATA_ATTR sleep_retained_t s_rtc;
+
+typedef enum {
+    CYCLE_WAIT_REGISTERED = 0,
+    CYCLE_REPORTING,
+    CYCLE_LINGER,
+    CYCLE_DONE
+} cycle_state_t;
+
+static cycle_state_t s_state = CYCLE_WAIT_REGISTERED;
+static uint32_t s_polls = 0;
+static int64_t s_linger_until_us = 0;
+static bool s_restored = false;
+// Start of the awake budget: first poll on a timer wake, first registration
+// on a cold boot (provisioning and Wi-Fi association are not part of a cycle)
+static int64_t s_budget_start_us = -1;
+
+bool sleep_mode_enabled(void) {
+    return CONFIG_LWM2M_DEEP_SLEEP_ENABLE;
+}
+
+bool sleep_mode_is_timer_wake(void) {
+    return sleep_mode_enabled()
+           && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER
+           && s_rtc.magic == SLEEP_RTC_MAGIC;
+}
+
+void sleep_mode_log_wake(void) {
+    if (!sleep_mode_enabled()) {
+        return;
+    }
+    if (!sleep_mode_is_timer_wake()) {
+        // Cold boot (power-on, reset, factory reset wake): start statistics from scratch
+        memset(&s_rtc, 0, sizeof(s_rtc));
+        s_rtc.magic = SLEEP_RTC_MAGIC;
+        ESP_LOGI(TAG, "Cold boot; deep-sleep reporting every %d s", CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S);
+        return;
+    }
+    uint32_t avg_awake = s_rtc.cycles ? (uint32_t) (s_rtc.total_awake_ms / s_rtc.cycles) : 0;
+    ESP_LOGI(TAG, "Timer wake #%" PRIu32 ": last cycle awake=%" PRIu32 " ms charge=%" PRIu32 " uC, avg awake=%" PRIu32 " ms, retained=%" PRIu32 " B",
+             s_rtc.cycles + 1, s_rtc.last_awake_ms, s_rtc.last_charge_uc, avg_awake, s_rtc.persisted_len);
+}
+
+anjay_t *sleep_mode_anjay_new(const anjay_configuration_t *cfg) {
+#ifdef ANJAY_WITH_CORE_PERSISTENCE
+    if (sleep_mode_is_timer_wake() && s_rtc.persisted_len > 0) {
+        avs_stream_inbuf_t in = AVS_STREAM_INBUF_STATIC_INITIALIZER;
+        avs_stream_inbuf_set_buffer(&in, s_rtc.persisted, s_rtc.persisted_len);
+        anjay_t *anjay = anjay_new_from_core_persistence(cfg, (avs_stream_t *) &in);
+        // Consume the blob: if this cycle crashes, the next wake registers from scratch
+        s_rtc.persisted_len = 0;
+        if (anjay) {
+            s_restored = true;
+            ESP_LOGI(TAG, "Restored registration state from RTC memory");
+            return anjay;
+        }
+        ESP_LOGW(TAG, "Core persistence restore failed; doing a full Register");
+    }
+#endif // ANJAY_WITH_CORE_PERSISTENCE
+    return anjay_new(cfg);
+}
+
+#ifdef ANJAY_WITH_SEND
+static void send_finished(anjay_t *anjay, anjay_ssid_t ssid, const anjay_send_batch_t *batch,
+                          int result, void *data) {
+    (void) anjay; (void) batch; (void) data;
+    if (result == ANJAY_SEND_SUCCESS) {
+        ESP_LOGI(TAG, "Send to SSID %u acknowledged", (unsigned) ssid);
+    } else {
+        ESP_LOGW(TAG, "Send to SSID %u finished with %d", (unsigned) ssid, result);
+    }
+    s_linger_until_us = esp_timer_get_time() + (int64_t) CONFIG_LWM2M_DEEP_SLEEP_LINGER_MS * 1000;
+    s_state = CYCLE_LINGER;
+}
+
+static bool send_sensor_values(anjay_t *anjay, anjay_ssid_t ssid) {
+    anjay_send_batch_builder_t *builder = anjay_send_batch_builder_new();
+    if (!builder) {
+        return false;
+    }
+    bool ok = !anjay_send_batch_data_add_current(builder, anjay, 3303, 0, 5700)
+              && !anjay_send_batch_data_add_current(builder, anjay, 3304, 0, 5700);
+    anjay_send_batch_t *batch = anjay_send_batch_builder_compile(&builder);
+    anjay_send_batch_builder_cleanup(&builder);
+    if (!ok || !batch) {
+        anjay_send_batch_release(&batch);
+        return false;
+    }
+    anjay_send_result_t res = anjay_send(anjay, ssid, batch, send_finished, NULL);
+    anjay_send_batch_release(&batch);
+    if (res != ANJAY_SEND_OK) {
+        ESP_LOGW(TAG, "anjay_send() rejected: %d; relying on Observe notifications", (int) res);
+        return false;
+    }
+    return true;
+}
+#endif // ANJAY_WITH_SEND
+
+bool sleep_mode_cycle_poll(anjay_t *anjay, anjay_ssid_t ssid) {
+    if (!sleep_mode_enabled() || !anjay) {
+        return false;
+    }
+    int64_t now_us = esp_timer_get_time();
+    if (s_budget_start_us < 0 && sleep_mode_is_timer_wake()) {
+        s_budget_start_us = now_us;
+    }
+    if (s_budget_start_us >= 0
+            && now_us - s_budget_start_us >= (int64_t) CONFIG_LWM2M_DEEP_SLEEP_AWAKE_TIMEOUT_MS * 1000) {
+        if (s_state != CYCLE_DONE) {
+            ESP_LOGW(TAG, "Awake timeout reached (state=%d); sleeping anyway", (int) s_state);
+            s_state = CYCLE_DONE;
+        }
+        return true;
+    }
+    ++s_polls;
+    switch (s_state) {
+    case CYCLE_WAIT_REGISTERED:
+        // First pass only schedules the (re)connect jobs; wait one more loop run
+        if (s_polls < 2 || anjay_ongoing_registration_exists(anjay)) {
+            return false;
+        }
+        ESP_LOGI(TAG, "%s after %" PRId64 " ms; reporting sensor values",
+                 s_restored ? "Session resumed" : "Registered", now_us / 1000);
+        if (s_budget_start_us < 0) {
+            s_budget_start_us = now_us;
+        }
+        s_state = CYCLE_REPORTING;
+#ifdef ANJAY_WITH_SEND
+        if (send_sensor_values(anjay, ssid)) {
+            return false; // wait for send_finished()
+        }
+#else
+        (void) ssid;
+#endif // ANJAY_WITH_SEND
+        // Without Send, the sensor objects' first update already queued notifications
+        // for any observation restored from RTC; give them the linger window to go out.
+        s_linger_until_us = now_us + (int64_t) CONFIG_LWM2M_DEEP_SLEEP_LINGER_MS * 1000;
+        s_state = CYCLE_LINGER;
+        return false;
+    case CYCLE_REPORTING:
+        return false;
+    case CYCLE_LINGER:
+        if (now_us < s_linger_until_us) {
+            return false;
+        }
+        s_state = CYCLE_DONE;
+        return true;
+    case CYCLE_DONE:
+    default:
+        return true;
+    }
+}
+
+void sleep_mode_enter(anjay_t *anjay) {
+#ifdef ANJAY_WITH_CORE_PERSISTENCE
+    avs_stream_outbuf_t out = AVS_STREAM_OUTBUF_STATIC_INITIALIZER;
+    avs_stream_outbuf_set_buffer(&out, s_rtc.persisted, sizeof(s_rtc.persisted));
+    if (avs_is_ok(anjay_delete_with_core_persistence(anjay, (avs_stream_t *) &out))) {
+        s_rtc.persisted_len = (uint32_t) avs_stream_outbuf_offset(&out);
+    } else {
+        ESP_LOGW(TAG, "Core persistence failed (blob > %d B?); next wake will Register", SLEEP_PERSIST_MAX);
+        s_rtc.persisted_len = 0;
+    }
+#else
+    anjay_delete(anjay);
+    s_rtc.persisted_len = 0;
+#endif // ANJAY_WITH_CORE_PERSISTENCE
+
+    // Wake-to-sleep time is measured from the start of the app (after the ROM and
+    // second-stage bootloader), which dominates only for very short cycles.
+    uint32_t awake_ms = (uint32_t) (esp_timer_get_time() / 1000);
+    uint32_t awake_uc = awake_ms * CONFIG_LWM2M_DEEP_SLEEP_ACTIVE_CURRENT_MA; // mA * ms = uC
+    uint32_t sleep_uc = (uint32_t) CONFIG_LWM2M_DEEP_SLEEP_SLEEP_CURRENT_UA * CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S;
+    uint32_t cycle_ms = awake_ms + CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S * 1000u;
+    uint32_t avg_ua = (uint32_t) (((uint64_t) (awake_uc + sleep_uc) * 1000u) / cycle_ms);
+
+    s_rtc.magic = SLEEP_RTC_MAGIC;
+    s_rtc.cycles++;
+    s_rtc.last_awake_ms = awake_ms;
+    s_rtc.last_charge_uc = awake_uc;
+    s_rtc.total_awake_ms += awake_ms;
+
+    ESP_LOGI(TAG, "Cycle %" PRIu32 ": awake %" PRIu32 " ms, charge awake=%" PRIu32 " uC sleep=%" PRIu32 " uC, avg current ~%" PRIu32 " uA; retained %" PRIu32 " B",
+             s_rtc.cycles, awake_ms, awake_uc, sleep_uc, avg_ua, s_rtc.persisted_len);
+    ESP_LOGI(TAG, "Entering deep sleep for %d s", CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S);
+    // Give the UART a moment to flush the log lines above
+    vTaskDelay(pdMS_TO_TICKS(10));
+    esp_sleep_enable_timer_wakeup((uint64_t) CONFIG_LWM2M_DEEP_SLEEP_PERIOD_S * 1000000ULL);
+    esp_deep_sleep_start();
+}
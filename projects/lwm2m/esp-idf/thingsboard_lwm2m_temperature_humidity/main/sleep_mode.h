@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <anjay/anjay.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// True when the firmware was built with duty-cycled deep-sleep reporting
+bool sleep_mode_enabled(void);
+
+// True when this boot is an RTC timer wake-up from a previous reporting cycle
+bool sleep_mode_is_timer_wake(void);
+
+// Logs wake cause and the statistics of the previous cycle (call early in app_main)
+void sleep_mode_log_wake(void);
+
+// Creates the Anjay instance, restoring registration state retained in RTC memory
+// on timer wake-ups. Falls back to a plain anjay_new() when nothing usable is retained.
+anjay_t *sleep_mode_anjay_new(const anjay_configuration_t *cfg);
+
+// Drives one reporting cycle; call after every anjay_event_loop_run().
+// Returns true once the report is done (or timed out) and the node may sleep.
+bool sleep_mode_cycle_poll(anjay_t *anjay, anjay_ssid_t ssid);
+
+// Persists registration state to RTC memory, deletes the Anjay instance, reports
+// wake-to-sleep time and charge, and enters deep sleep. Does not return.
+void sleep_mode_enter(anjay_t *anjay);
+
+#ifdef __cplusplus
+}
+#endif
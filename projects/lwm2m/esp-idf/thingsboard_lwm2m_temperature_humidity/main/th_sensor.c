@@ -0,0 +1,109 @@
+#include "th_sensor.h"
+
+// SHT3x: single shot, high repeatability, no clock stretching (datasheet 4.3)
+#define SHT3X_CMD_MEASURE_HI 0x24
+#define SHT3X_CMD_MEASURE_LO 0x00
+#define SHT3X_CONVERSION_MS 16
+
+// AHT20: trigger measurement / initialize (datasheet 5.4)
+#define AHT20_CMD_TRIGGER 0xAC
+#define AHT20_CMD_INIT 0xBE
+#define AHT20_STATUS_BUSY 0x80
+#define AHT20_STATUS_CALIBRATED 0x08
+#define AHT20_CONVERSION_MS 80
+
+uint8_t th_sensor_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x31) : (uint8_t) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static int bus_write(const th_sensor_t *dev, const uint8_t *data, size_t len) {
+    return dev->bus->write(dev->bus->ctx, dev->addr, data, len) ? TH_SENSOR_ERR : TH_SENSOR_OK;
+}
+
+static int bus_read(const th_sensor_t *dev, uint8_t *data, size_t len) {
+    return dev->bus->read(dev->bus->ctx, dev->addr, data, len) ? TH_SENSOR_ERR : TH_SENSOR_OK;
+}
+
+int th_sensor_init(th_sensor_t *dev) {
+    if (!dev || !dev->bus || !dev->bus->write || !dev->bus->read) {
+        return TH_SENSOR_ERR;
+    }
+    if (dev->model == TH_SENSOR_AHT20) {
+        uint8_t status = 0;
+        if (bus_read(dev, &status, 1)) {
+            return TH_SENSOR_ERR;
+        }
+        if (!(status & AHT20_STATUS_CALIBRATED)) {
+            static const uint8_t init_cmd[] = { AHT20_CMD_INIT, 0x08, 0x00 };
+            return bus_write(dev, init_cmd, sizeof(init_cmd));
+        }
+        return TH_SENSOR_OK;
+    }
+    // SHT3x has no status needed for single shot; a zero-length probe is not portable,
+    // so the first trigger doubles as presence check.
+    return TH_SENSOR_OK;
+}
+
+int th_sensor_trigger(const th_sensor_t *dev) {
+    if (dev->model == TH_SENSOR_AHT20) {
+        static const uint8_t cmd[] = { AHT20_CMD_TRIGGER, 0x33, 0x00 };
+        return bus_write(dev, cmd, sizeof(cmd));
+    }
+    static const uint8_t cmd[] = { SHT3X_CMD_MEASURE_HI, SHT3X_CMD_MEASURE_LO };
+    return bus_write(dev, cmd, sizeof(cmd));
+}
+
+uint32_t th_sensor_conversion_ms(const th_sensor_t *dev) {
+    return dev->model == TH_SENSOR_AHT20 ? AHT20_CONVERSION_MS : SHT3X_CONVERSION_MS;
+}
+
+static int collect_sht3x(const th_sensor_t *dev, float *temperature_c, float *humidity_pct) {
+    uint8_t buf[6];
+    // SHT3x NACKs the read header while the conversion is still running
+    if (bus_read(dev, buf, sizeof(buf))) {
+        return TH_SENSOR_BUSY;
+    }
+    if (th_sensor_crc8(&buf[0], 2) != buf[2] || th_sensor_crc8(&buf[3], 2) != buf[5]) {
+        return TH_SENSOR_ERR;
+    }
+    uint16_t raw_t = (uint16_t) ((buf[0] << 8) | buf[1]);
+    uint16_t raw_rh = (uint16_t) ((buf[3] << 8) | buf[4]);
+    *temperature_c = -45.0f + 175.0f * (float) raw_t / 65535.0f;
+    *humidity_pct = 100.0f * (float) raw_rh / 65535.0f;
+    return TH_SENSOR_OK;
+}
+
+static int collect_aht20(const th_sensor_t *dev, float *temperature_c, float *humidity_pct) {
+    uint8_t buf[7];
+    if (bus_read(dev, buf, sizeof(buf))) {
+        return TH_SENSOR_ERR;
+    }
+    if (buf[0] & AHT20_STATUS_BUSY) {
+        return TH_SENSOR_BUSY;
+    }
+    if (th_sensor_crc8(buf, 6) != buf[6]) {
+        return TH_SENSOR_ERR;
+    }
+    uint32_t raw_rh = ((uint32_t) buf[1] << 12) | ((uint32_t) buf[2] << 4) | (buf[3] >> 4);
+    uint32_t raw_t = ((uint32_t) (buf[3] & 0x0F) << 16) | ((uint32_t) buf[4] << 8) | buf[5];
+    *humidity_pct = (float) raw_rh * 100.0f / 1048576.0f;
+    *temperature_c = (float) raw_t * 200.0f / 1048576.0f - 50.0f;
+    return TH_SENSOR_OK;
+}
+
+int th_sensor_collect(const th_sensor_t *dev, float *temperature_c, float *humidity_pct) {
+    if (!temperature_c || !humidity_pct) {
+        return TH_SENSOR_ERR;
+    }
+    if (dev->model == TH_SENSOR_AHT20) {
+        return collect_aht20(dev, temperature_c, humidity_pct);
+    }
+    return collect_sht3x(dev, temperature_c, humidity_pct);
+}
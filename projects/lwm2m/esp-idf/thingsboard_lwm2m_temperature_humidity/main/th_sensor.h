@@ -0,0 +1,55 @@
+#pragma once
+
+// Portable SHT3x / AHT20 temperature-humidity chip driver.
+// No ESP-IDF dependencies: the I2C bus is reached through th_i2c_bus_t so the same
+// code runs on the target (sensor_driver.c) and on the host against a stub bus.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TH_SENSOR_OK 0
+#define TH_SENSOR_ERR (-1)
+#define TH_SENSOR_BUSY 1 // conversion not finished yet, collect again later
+
+// Raw bus access; both callbacks return 0 on success, negative on NACK/timeout
+typedef struct {
+    int (*write)(void *ctx, uint8_t addr, const uint8_t *data, size_t len);
+    int (*read)(void *ctx, uint8_t addr, uint8_t *data, size_t len);
+    void *ctx;
+} th_i2c_bus_t;
+
+typedef enum {
+    TH_SENSOR_SHT3X = 0,
+    TH_SENSOR_AHT20
+} th_sensor_model_t;
+
+typedef struct {
+    th_sensor_model_t model;
+    uint8_t addr;
+    const th_i2c_bus_t *bus;
+} th_sensor_t;
+
+// Probes the chip (AHT20: loads calibration if needed). Returns TH_SENSOR_OK/ERR.
+int th_sensor_init(th_sensor_t *dev);
+
+// Starts one single-shot conversion; returns immediately.
+int th_sensor_trigger(const th_sensor_t *dev);
+
+// Worst-case conversion time after th_sensor_trigger() (ms).
+uint32_t th_sensor_conversion_ms(const th_sensor_t *dev);
+
+// Reads back the result of the last trigger. Returns TH_SENSOR_OK, TH_SENSOR_BUSY or
+// TH_SENSOR_ERR (bus error or CRC mismatch).
+int th_sensor_collect(const th_sensor_t *dev, float *temperature_c, float *humidity_pct);
+
+// Sensirion/Aosong CRC-8 (poly 0x31, init 0xFF)
+uint8_t th_sensor_crc8(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,19 +7,11 @@
 
 #include <esp_log.h>
 #include <nvs_flash.h>
-#include <nvs.h>
 #include <string.h>
 
-static const char *TAG = "tb_provision";
+#include "cfg_store.h"
 
-// NVS namespace and keys
-#define NVS_NAMESPACE "tb_lwm2m"
-#define NVS_KEY_PROVISIONED "provisioned"
-#define NVS_KEY_SERVER_URI "server_uri"
-#define NVS_KEY_SSID "ssid"
-#define NVS_KEY_PSK_ID "psk_id"
-#define NVS_KEY_PSK_KEY "psk_key"
-#define NVS_KEY_SECURITY_MODE "sec_mode"
+static const char *TAG = "tb_provision";
 
 // Provisioning state
 typedef struct {
@@ -53,6 +45,7 @@ void thingsboard_provision_init(void) {
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    cfg_store_init(); // no-op if app_main already loaded it
     
     memset(&g_provision_state, 0, sizeof(g_provision_state));
     g_provision_state.security_mode = 3;  // NoSec default
@@ -60,18 +53,8 @@ void thingsboard_provision_init(void) {
 }
 
 bool thingsboard_is_provisioned(void) {
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
-    if (err != ESP_OK) {
-        ESP_LOGD(TAG, "No provisioning data found in NVS");
-        return false;
-    }
-    
     uint8_t provisioned = 0;
-    err = nvs_get_u8(nvs, NVS_KEY_PROVISIONED, &provisioned);
-    nvs_close(nvs);
-    
-    if (err == ESP_OK && provisioned == 1) {
+    if (cfg_store_get_u8(CFG_KEY_TB_PROVISIONED, &provisioned) == 0 && provisioned == 1) {
         ESP_LOGI(TAG, "Device is already provisioned");
         g_provision_state.is_provisioned = true;
         return true;
@@ -138,42 +121,33 @@ int thingsboard_get_provisioned_uri(char *uri_buf, size_t buf_size) {
 }
 
 int thingsboard_save_credentials(void) {
-    ESP_LOGI(TAG, "Saving provisioned credentials to NVS");
-    
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for writing: %s", esp_err_to_name(err));
-        return -1;
-    }
+    ESP_LOGI(TAG, "Saving provisioned credentials");
     
     // Mark as provisioned
-    nvs_set_u8(nvs, NVS_KEY_PROVISIONED, 1);
+    int err = cfg_store_set_u8(CFG_KEY_TB_PROVISIONED, 1);
     
     // Save server URI
     if (strlen(g_provision_state.server_uri) > 0) {
-        nvs_set_str(nvs, NVS_KEY_SERVER_URI, g_provision_state.server_uri);
+        err |= cfg_store_set_str(CFG_KEY_TB_SERVER_URI, g_provision_state.server_uri);
     }
     
     // Save SSID
-    nvs_set_u16(nvs, NVS_KEY_SSID, g_provision_state.server_ssid);
+    err |= cfg_store_set_u16(CFG_KEY_TB_SSID, g_provision_state.server_ssid);
     
     // Save security mode
-    nvs_set_i32(nvs, NVS_KEY_SECURITY_MODE, g_provision_state.security_mode);
+    err |= cfg_store_set_i32(CFG_KEY_TB_SEC_MODE, g_provision_state.security_mode);
     
     // Save PSK credentials if available
     if (strlen(g_provision_state.psk_identity) > 0) {
-        nvs_set_str(nvs, NVS_KEY_PSK_ID, g_provision_state.psk_identity);
+        err |= cfg_store_set_str(CFG_KEY_TB_PSK_ID, g_provision_state.psk_identity);
     }
     if (strlen(g_provision_state.psk_key) > 0) {
-        nvs_set_str(nvs, NVS_KEY_PSK_KEY, g_provision_state.psk_key);
+        err |= cfg_store_set_str(CFG_KEY_TB_PSK_KEY, g_provision_state.psk_key);
     }
     
-    err = nvs_commit(nvs);
-    nvs_close(nvs);
-    
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
+    // All keys land in one atomic commit
+    if (err || cfg_store_commit()) {
+        ESP_LOGE(TAG, "Failed to store credentials");
         return -1;
     }
     
@@ -188,42 +162,28 @@ int thingsboard_load_credentials(anjay_t *anjay) {
         return -1;
     }
     
-    ESP_LOGI(TAG, "Loading provisioned credentials from NVS");
-    
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS for reading");
-        return -1;
-    }
+    ESP_LOGI(TAG, "Loading provisioned credentials");
     
     // Load server URI
-    size_t uri_size = sizeof(g_provision_state.server_uri);
-    err = nvs_get_str(nvs, NVS_KEY_SERVER_URI, g_provision_state.server_uri, &uri_size);
-    if (err != ESP_OK) {
+    if (cfg_store_get_str(CFG_KEY_TB_SERVER_URI, g_provision_state.server_uri,
+                          sizeof(g_provision_state.server_uri))) {
         ESP_LOGW(TAG, "Failed to load server URI");
-        nvs_close(nvs);
         return -1;
     }
     
     // Load SSID
     uint16_t ssid = 1;
-    nvs_get_u16(nvs, NVS_KEY_SSID, &ssid);
+    cfg_store_get_u16(CFG_KEY_TB_SSID, &ssid);
     g_provision_state.server_ssid = ssid;
     
     // Load security mode
     int32_t sec_mode = 3;
-    nvs_get_i32(nvs, NVS_KEY_SECURITY_MODE, &sec_mode);
+    cfg_store_get_i32(CFG_KEY_TB_SEC_MODE, &sec_mode);
     g_provision_state.security_mode = sec_mode;
     
     // Load PSK credentials if available
-    size_t psk_id_size = sizeof(g_provision_state.psk_identity);
-    nvs_get_str(nvs, NVS_KEY_PSK_ID, g_provision_state.psk_identity, &psk_id_size);
-    
-    size_t psk_key_size = sizeof(g_provision_state.psk_key);
-    nvs_get_str(nvs, NVS_KEY_PSK_KEY, g_provision_state.psk_key, &psk_key_size);
-    
-    nvs_close(nvs);
+    cfg_store_get_str(CFG_KEY_TB_PSK_ID, g_provision_state.psk_identity, sizeof(g_provision_state.psk_identity));
+    cfg_store_get_str(CFG_KEY_TB_PSK_KEY, g_provision_state.psk_key, sizeof(g_provision_state.psk_key));
     
     ESP_LOGI(TAG, "Loaded credentials - URI: %s, SSID: %d, Security Mode: %d",
              g_provision_state.server_uri, 
@@ -277,19 +237,9 @@ int thingsboard_load_credentials(anjay_t *anjay) {
 int thingsboard_clear_credentials(void) {
     ESP_LOGI(TAG, "Clearing provisioned credentials (factory reset)");
     
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to open NVS for erasing");
-        return -1;
-    }
-    
-    nvs_erase_all(nvs);
-    err = nvs_commit(nvs);
-    nvs_close(nvs);
-    
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to erase NVS");
+    cfg_store_erase_group(CFG_GROUP_TB);
+    if (cfg_store_commit()) {
+        ESP_LOGE(TAG, "Failed to erase stored credentials");
         return -1;
     }
     
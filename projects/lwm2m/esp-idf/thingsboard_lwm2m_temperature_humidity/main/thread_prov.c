@@ -11,22 +11,127 @@
 #include <openthread/joiner.h>
 #include <openthread/thread.h>
 #include <openthread/ip6.h>
+#include <openthread/link.h>
+#include <esp_openthread_lock.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
 #endif
 #include "sdkconfig.h"
 
+#ifndef CONFIG_LWM2M_THREAD_POLL_MIN_MS
+#define CONFIG_LWM2M_THREAD_POLL_MIN_MS 1000
+#endif
+#ifndef CONFIG_LWM2M_THREAD_POLL_MAX_MS
+#define CONFIG_LWM2M_THREAD_POLL_MAX_MS 60000
+#endif
+#ifndef CONFIG_LWM2M_THREAD_FAST_POLL_MS
+#define CONFIG_LWM2M_THREAD_FAST_POLL_MS 100
+#endif
+#ifndef CONFIG_LWM2M_THREAD_FAST_WINDOW_MS
+#define CONFIG_LWM2M_THREAD_FAST_WINDOW_MS 3000
+#endif
+#ifndef CONFIG_LWM2M_THREAD_STATS_PERIOD_S
+#define CONFIG_LWM2M_THREAD_STATS_PERIOD_S 60
+#endif
+
+// Sleepy device types; a plain MED keeps its receiver on and never polls
+#if CONFIG_LWM2M_THREAD_DEVICE_SSED
+#define THREAD_SLEEPY 1
+#define THREAD_PERIOD_NAME "CSL"
+#elif CONFIG_LWM2M_THREAD_DEVICE_SED
+#define THREAD_SLEEPY 1
+#define THREAD_PERIOD_NAME "poll"
+#else
+#define THREAD_SLEEPY 0
+#define THREAD_PERIOD_NAME "poll"
+#endif
+// CSL periods are multiples of ten symbols (160 us), at most 0xFFFF of them
+#define CSL_UNIT_US 160
+#define CSL_MAX_MS (0xFFFFu * CSL_UNIT_US / 1000)
+
 #if CONFIG_OPENTHREAD_ENABLED
 __attribute__((unused)) static const char *TAG = "thread_prov";
 __attribute__((unused)) static bool s_join_started = false;
 __attribute__((unused)) static bool s_attached_logged = false;
+
+// Thread profile state, touched from the LwM2M task only
+__attribute__((unused)) static uint32_t s_idle_poll_ms;    // from the observation periods, 0 until known
+__attribute__((unused)) static uint32_t s_applied_poll_ms; // period currently set in OpenThread
+__attribute__((unused)) static int64_t s_last_tx_us;
+__attribute__((unused)) static bool s_counters_primed;
+__attribute__((unused)) static thread_frame_counters_t s_prev_counters;
+__attribute__((unused)) static thread_frame_counters_t s_report_base;
+__attribute__((unused)) static int64_t s_report_at_us;
+static thread_frame_ratio_t s_last_ratio;
+static bool s_have_ratio;
 #endif // CONFIG_OPENTHREAD_ENABLED
 
 #if CONFIG_OPENTHREAD_ENABLED
 
+// Rx-off-when-idle for SED/SSED; the child timeout outlives the longest poll
+// period so the parent keeps the child between polls
+static void apply_link_mode(otInstance *ins) {
+#if CONFIG_LWM2M_THREAD_PROFILE
+    otLinkModeConfig mode = otThreadGetLinkMode(ins);
+    mode.mRxOnWhenIdle = !THREAD_SLEEPY;
+    mode.mDeviceType = false;
+    mode.mNetworkData = false;
+    otError err = otThreadSetLinkMode(ins, mode);
+    if (err != OT_ERROR_NONE) {
+        ESP_LOGW(TAG, "otThreadSetLinkMode failed: %d", err);
+    }
+#if THREAD_SLEEPY
+    uint32_t timeout_s = 4 * ((CONFIG_LWM2M_THREAD_POLL_MAX_MS + 999) / 1000);
+    if (timeout_s < 240) {
+        timeout_s = 240; // OpenThread default
+    }
+    otThreadSetChildTimeout(ins, timeout_s);
+    ESP_LOGI(TAG, "Link mode sleepy (%s period), child timeout %u s", THREAD_PERIOD_NAME, (unsigned) timeout_s);
+#else
+    ESP_LOGI(TAG, "Link mode MED (receiver always on)");
+#endif
+#else
+    (void) ins;
+#endif
+}
+
+#if CONFIG_LWM2M_THREAD_PROFILE && THREAD_SLEEPY
+// Caller holds the OpenThread lock
+static void apply_poll_period(otInstance *ins, uint32_t ms) {
+#if CONFIG_LWM2M_THREAD_DEVICE_SSED
+    // The parent transmits in our CSL windows: no data polls needed to receive
+    if (ms > CSL_MAX_MS) {
+        ms = CSL_MAX_MS;
+    }
+    otError err = otLinkSetCslPeriod(ins, (ms * 1000 / CSL_UNIT_US) * CSL_UNIT_US);
+#else
+    otError err = otLinkSetPollPeriod(ins, ms);
+#endif
+    if (err != OT_ERROR_NONE) {
+        ESP_LOGW(TAG, "Setting %u ms %s period failed: %d", (unsigned) ms, THREAD_PERIOD_NAME, err);
+        return;
+    }
+    s_applied_poll_ms = ms;
+}
+#endif
+
+__attribute__((unused))
+static void read_counters(otInstance *ins, thread_frame_counters_t *c) {
+    const otMacCounters *mac = otLinkGetCounters(ins);
+    const otIpCounters *ip = otThreadGetIp6Counters(ins);
+    c->tx_frames = mac->mTxData;
+    c->tx_retries = mac->mTxRetry;
+    c->rx_frames = mac->mRxData;
+    c->tx_messages = ip->mTxSuccess + ip->mTxFailure;
+    c->rx_messages = ip->mRxSuccess;
+}
+
 static void joiner_cb(otError error, void *context) {
     (void) context;
     ESP_LOGI(TAG, "Joiner result: %d", error);
     if (error == OT_ERROR_NONE) {
         otInstance *ins = esp_openthread_get_instance();
+        apply_link_mode(ins);
         otError err = otThreadSetEnabled(ins, true);
         if (err != OT_ERROR_NONE) {
             ESP_LOGE(TAG, "Failed to enable Thread after join: %d", err);
@@ -73,6 +178,7 @@ bool thread_prov_start(void) {
         ESP_LOGE(TAG, "No OpenThread instance after init");
         return false;
     }
+    apply_link_mode(ins);
     // If already commissioned (dataset active and enabled), skip joiner
     if (otThreadGetDeviceRole(ins) != OT_DEVICE_ROLE_DISABLED) {
         ESP_LOGI(TAG, "Thread already active (role=%d)", otThreadGetDeviceRole(ins));
@@ -128,8 +234,84 @@ bool thread_prov_get_ip(char *buf, size_t buf_len) {
 #endif
 }
 
+void thread_prov_set_observation_periods(uint32_t pmin_s, uint32_t pmax_s) {
+#if CONFIG_LWM2M_THREAD_PROFILE && THREAD_SLEEPY
+    const uint32_t ms = thread_transport_poll_period_ms(pmin_s, pmax_s, CONFIG_LWM2M_THREAD_POLL_MIN_MS,
+                                                       CONFIG_LWM2M_THREAD_POLL_MAX_MS);
+    if (ms != s_idle_poll_ms) {
+        ESP_LOGI(TAG, "Idle %s period %u ms (pmin %u s, pmax %u s)", THREAD_PERIOD_NAME, (unsigned) ms,
+                 (unsigned) pmin_s, (unsigned) pmax_s);
+        s_idle_poll_ms = ms;
+    }
+#else
+    (void) pmin_s;
+    (void) pmax_s;
+#endif
+}
+
+void thread_prov_update(void) {
+#if CONFIG_LWM2M_THREAD_PROFILE && CONFIG_LWM2M_NETWORK_USE_THREAD
+    otInstance *ins = esp_openthread_get_instance();
+    if (!ins) {
+        return;
+    }
+    thread_frame_counters_t now;
+    const int64_t t = esp_timer_get_time();
+    esp_openthread_lock_acquire(portMAX_DELAY);
+    read_counters(ins, &now);
+#if THREAD_SLEEPY
+    if (s_counters_primed && now.tx_messages != s_prev_counters.tx_messages) {
+        s_last_tx_us = t;
+    }
+    // A response to what we just sent is due within the CoAP ACK timeout
+    const bool fast = s_last_tx_us && t - s_last_tx_us < (int64_t) CONFIG_LWM2M_THREAD_FAST_WINDOW_MS * 1000;
+    uint32_t want = s_idle_poll_ms;
+    if (fast && (!want || CONFIG_LWM2M_THREAD_FAST_POLL_MS < want)) {
+        want = CONFIG_LWM2M_THREAD_FAST_POLL_MS;
+    }
+    if (want && want != s_applied_poll_ms) {
+        apply_poll_period(ins, want);
+    }
+#endif
+    esp_openthread_lock_release();
+
+    s_prev_counters = now;
+    if (!s_counters_primed) {
+        s_counters_primed = true;
+        s_report_base = now;
+        s_report_at_us = t;
+        return;
+    }
+    if (t - s_report_at_us < (int64_t) CONFIG_LWM2M_THREAD_STATS_PERIOD_S * 1000000) {
+        return;
+    }
+    thread_transport_frame_ratio(&s_report_base, &now, &s_last_ratio);
+    s_have_ratio = true;
+    s_report_base = now;
+    s_report_at_us = t;
+    if (s_last_ratio.tx_messages || s_last_ratio.rx_messages) {
+        ESP_LOGI(TAG, "802.15.4 frames/msg: tx %u.%02u (%u msgs, %u.%02u retries/msg), rx %u.%02u (%u msgs)",
+                 (unsigned) (s_last_ratio.tx_frames_x100 / 100), (unsigned) (s_last_ratio.tx_frames_x100 % 100),
+                 (unsigned) s_last_ratio.tx_messages, (unsigned) (s_last_ratio.tx_retries_x100 / 100),
+                 (unsigned) (s_last_ratio.tx_retries_x100 % 100), (unsigned) (s_last_ratio.rx_frames_x100 / 100),
+                 (unsigned) (s_last_ratio.rx_frames_x100 % 100), (unsigned) s_last_ratio.rx_messages);
+    }
+#endif
+}
+
+bool thread_prov_frame_stats(thread_frame_ratio_t *out) {
+    if (!s_have_ratio) {
+        return false;
+    }
+    *out = s_last_ratio;
+    return true;
+}
+
 #else // !CONFIG_OPENTHREAD_ENABLED
 bool thread_prov_start(void){return false;} 
 bool thread_prov_is_attached(void){return false;} 
 bool thread_prov_get_ip(char *b,size_t l){(void)b;(void)l;return false;}
+void thread_prov_set_observation_periods(uint32_t pmin_s, uint32_t pmax_s){(void)pmin_s;(void)pmax_s;}
+void thread_prov_update(void){}
+bool thread_prov_frame_stats(thread_frame_ratio_t *out){(void)out;return false;}
 #endif
@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "thread_transport.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,6 +20,20 @@ bool thread_prov_is_attached(void);
 // Returns false if not yet available.
 bool thread_prov_get_ip(char *buf, size_t buf_len);
 
+// Thread transport profile (CONFIG_LWM2M_THREAD_PROFILE). The link mode (MED,
+// SED or SSED) is applied before the device attaches.
+// Sets the idle poll period (SED) or CSL period (SSED) from the smallest
+// pmin/pmax of the active observations.
+void thread_prov_set_observation_periods(uint32_t pmin_s, uint32_t pmax_s);
+
+// Call from the main loop: polls fast for a while after each transmission so
+// CoAP ACKs and responses are not held at the parent, and logs frames per
+// message every CONFIG_LWM2M_THREAD_STATS_PERIOD_S.
+void thread_prov_update(void);
+
+// Frames per message over the last reporting period; false before the first report
+bool thread_prov_frame_stats(thread_frame_ratio_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,73 @@
+#include "thread_transport.h"
+
+unsigned thread_transport_frames(const thread_link_t *link, size_t udp_payload) {
+    if ((size_t) link->ip_header + udp_payload <= link->frame_payload) {
+        return 1;
+    }
+    // Fragment offsets count 8-byte units of the uncompressed datagram; the
+    // uncompressed headers are 48 bytes, so the data of every fragment but the
+    // last is a multiple of 8 as well
+    const size_t first = (size_t) (link->frame_payload - THREAD_FRAG1_HEADER - link->ip_header) & ~(size_t) 7;
+    const size_t next = (size_t) (link->frame_payload - THREAD_FRAGN_HEADER) & ~(size_t) 7;
+    const size_t last = (size_t) link->frame_payload - THREAD_FRAGN_HEADER;
+    if (udp_payload <= first + last) {
+        return 2;
+    }
+    const size_t rest = udp_payload - first - last;
+    return 2 + (unsigned) ((rest + next - 1) / next);
+}
+
+size_t thread_transport_max_udp_payload(const thread_link_t *link) {
+    const size_t single = link->frame_payload > link->ip_header ? link->frame_payload - link->ip_header : 0;
+    if (link->max_frames <= 1) {
+        return single;
+    }
+    const size_t first = (size_t) (link->frame_payload - THREAD_FRAG1_HEADER - link->ip_header) & ~(size_t) 7;
+    const size_t next = (size_t) (link->frame_payload - THREAD_FRAGN_HEADER) & ~(size_t) 7;
+    const size_t last = (size_t) link->frame_payload - THREAD_FRAGN_HEADER;
+    return first + (size_t) (link->max_frames - 2) * next + last;
+}
+
+uint16_t thread_transport_block_size(const thread_link_t *link) {
+    const size_t room = thread_transport_max_udp_payload(link);
+    const size_t overhead = (size_t) link->security_overhead + link->coap_overhead;
+    if ((size_t) link->security_overhead + THREAD_REGISTER_OVERHEAD + 16 > room) {
+        return 0;
+    }
+    uint16_t block = 0;
+    for (uint16_t size = 16; size <= 1024; size *= 2) {
+        if (overhead + size <= room) {
+            block = size;
+        }
+    }
+    return block;
+}
+
+int thread_transport_forced_mtu(const thread_link_t *link) {
+    if (!thread_transport_block_size(link)) {
+        return 0;
+    }
+    return THREAD_MTU_HEADERS + (int) thread_transport_max_udp_payload(link);
+}
+
+uint32_t thread_transport_poll_period_ms(uint32_t pmin_s, uint32_t pmax_s, uint32_t min_ms, uint32_t max_ms) {
+    const uint64_t base_s = pmin_s ? pmin_s : pmax_s / 2;
+    const uint64_t period = base_s * 1000;
+    if (period < min_ms) {
+        return min_ms;
+    }
+    return period > max_ms ? max_ms : (uint32_t) period;
+}
+
+static uint32_t ratio_x100(uint32_t num, uint32_t den) {
+    return den ? (uint32_t) (((uint64_t) num * 100 + den / 2) / den) : 0;
+}
+
+void thread_transport_frame_ratio(const thread_frame_counters_t *prev, const thread_frame_counters_t *now,
+                                  thread_frame_ratio_t *out) {
+    out->tx_messages = now->tx_messages - prev->tx_messages;
+    out->rx_messages = now->rx_messages - prev->rx_messages;
+    out->tx_frames_x100 = ratio_x100(now->tx_frames - prev->tx_frames, out->tx_messages);
+    out->tx_retries_x100 = ratio_x100(now->tx_retries - prev->tx_retries, out->tx_messages);
+    out->rx_frames_x100 = ratio_x100(now->rx_frames - prev->rx_frames, out->rx_messages);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// Thread (802.15.4 / 6LoWPAN) transport profile for the LwM2M client.
+// A 127-byte radio frame leaves about 100 bytes for 6LoWPAN once the MAC
+// header, security and FCS are taken, so a CoAP message sized for Wi-Fi is
+// split into fragments, each one a separate transmission (and the loss of any
+// one costs the whole datagram). The planner sizes messages by frame count,
+// derives the sleepy end device poll period from the observation periods and
+// turns MAC/IPv6 counter snapshots into frames per message.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 127 - FCS 2 - MAC header 9 (short addresses, PAN ID compression)
+// - auxiliary security header 6 (key id mode 1) - MIC 4
+#define THREAD_FRAME_PAYLOAD 106
+// IPHC 2 + off-mesh destination 16 + source IID 8, NHC UDP 1 + ports 4 + checksum 2
+#define THREAD_IP_HEADER 33
+// DTLS 1.2 record header 13 + explicit nonce 8 + CCM-8 tag 8
+#define THREAD_DTLS_OVERHEAD 29
+// CoAP header 4 + token 8 + Observe, Content-Format, Block2 + payload marker
+#define THREAD_COAP_OVERHEAD 24
+// Register, whose options cannot be split: CoAP header 4 + token 8 + Uri-Path
+// "rd" 3 + Content-Format 2 + Uri-Query ep= (32-char endpoint) 37, lt= 9,
+// lwm2m=1.1 10, b=U 4 + Block1 2 + payload marker 1
+#define THREAD_REGISTER_OVERHEAD 80
+// Uncompressed IPv6 + UDP headers the socket MTU is reduced by
+#define THREAD_MTU_HEADERS 48
+
+#define THREAD_FRAG1_HEADER 4
+#define THREAD_FRAGN_HEADER 5
+
+typedef struct {
+    uint16_t frame_payload;     // 802.15.4 MAC payload per frame
+    uint8_t ip_header;          // compressed IPv6 + UDP headers
+    uint8_t security_overhead;  // DTLS record overhead, 0 for coap://
+    uint8_t coap_overhead;      // CoAP header, token and options around a block
+    uint8_t max_frames;         // frames one message may take (1 = never fragment)
+} thread_link_t;
+
+#define THREAD_LINK_DEFAULT(Secure, MaxFrames) \
+    { THREAD_FRAME_PAYLOAD, THREAD_IP_HEADER, (Secure) ? THREAD_DTLS_OVERHEAD : 0, THREAD_COAP_OVERHEAD, (MaxFrames) }
+
+// 802.15.4 frames carrying a UDP datagram with udp_payload bytes: one if it
+// fits, otherwise FRAG1 + FRAGN fragments with 8-byte aligned offsets
+unsigned thread_transport_frames(const thread_link_t *link, size_t udp_payload);
+
+// Largest UDP payload that still fits in link->max_frames frames
+size_t thread_transport_max_udp_payload(const thread_link_t *link);
+
+// Largest CoAP block size (16..1024) whose message fits in link->max_frames
+// frames, 0 if not even a 16-byte block does or if a Register carrying a
+// 16-byte Block1 would not fit (the node could never register)
+uint16_t thread_transport_block_size(const thread_link_t *link);
+
+// Socket MTU that makes the CoAP layer size its messages to
+// thread_transport_max_udp_payload(); 0 to leave the MTU alone
+int thread_transport_forced_mtu(const thread_link_t *link);
+
+// Idle poll (SED) or CSL (SSED) period for the smallest pmin/pmax of the
+// active observations: server traffic then waits at most one pmin, the
+// latency the server already accepts for notifications. Without pmin, half
+// of pmax. Clamped to [min_ms, max_ms].
+uint32_t thread_transport_poll_period_ms(uint32_t pmin_s, uint32_t pmax_s, uint32_t min_ms, uint32_t max_ms);
+
+// Free-running link and IPv6 counters (OpenThread MAC and IP counters)
+typedef struct {
+    uint32_t tx_frames;   // MAC data frames sent, retries excluded
+    uint32_t tx_retries;  // MAC retransmissions
+    uint32_t tx_messages; // IPv6 datagrams sent (success + failure)
+    uint32_t rx_frames;   // MAC data frames received
+    uint32_t rx_messages; // IPv6 datagrams received
+} thread_frame_counters_t;
+
+typedef struct {
+    uint32_t tx_messages;
+    uint32_t rx_messages;
+    uint32_t tx_frames_x100;  // frames per sent message, x100
+    uint32_t tx_retries_x100; // retransmissions per sent message, x100
+    uint32_t rx_frames_x100;  // frames per received message, x100
+} thread_frame_ratio_t;
+
+// Frames per message between two snapshots (32-bit wrap safe). Ratios are 0
+// when no message went through in that direction.
+void thread_transport_frame_ratio(const thread_frame_counters_t *prev, const thread_frame_counters_t *now,
+                                  thread_frame_ratio_t *out);
+
+#ifdef __cplusplus
+}
+#endif
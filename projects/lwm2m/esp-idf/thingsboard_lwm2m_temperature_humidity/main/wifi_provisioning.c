@@ -23,7 +23,10 @@ static const char *TAG = "wifi_prov";
 
 /* Signal Wi-Fi events on this event-group */
 const int WIFI_CONNECTED_EVENT = BIT0;
+/* Set once the provisioning manager has been de-initialized */
+static const int PROV_DONE_EVENT = BIT1;
 static EventGroupHandle_t wifi_event_group;
+static volatile bool s_prov_running;
 
 #define PROV_QR_VERSION         "v1"
 #define PROV_TRANSPORT_SOFTAP   "softap"
@@ -83,6 +86,8 @@ static void event_handler(void* arg, esp_event_base_t event_base,
             case WIFI_PROV_END:
                 /* De-initialize manager once provisioning is finished */
                 wifi_prov_mgr_deinit();
+                s_prov_running = false;
+                xEventGroupSetBits(wifi_event_group, PROV_DONE_EVENT);
                 break;
             default:
                 break;
@@ -254,7 +259,13 @@ void wifi_prov_mgr_start_provisioning_service(void)
          * wifi_prov_scheme_softap or wifi_prov_scheme_ble */
 #ifdef CONFIG_PROV_TRANSPORT_BLE
         .scheme = wifi_prov_scheme_ble,
+#if CONFIG_PROV_RELEASE_BT_MEM
+        /* BLE memory is returned by mem_budget_release_bt() once provisioning
+         * is over, so the release can be accounted for */
+        .scheme_event_handler = WIFI_PROV_SCHEME_BLE_EVENT_HANDLER_FREE_BT,
+#else
         .scheme_event_handler = WIFI_PROV_SCHEME_BLE_EVENT_HANDLER_FREE_BTDM,
+#endif
 #else
         .scheme = wifi_prov_scheme_softap,
         .scheme_event_handler = WIFI_PROV_EVENT_HANDLER_NONE,
@@ -380,6 +391,7 @@ void wifi_prov_mgr_start_provisioning_service(void)
             pop,
 #endif
             service_name, service_key));
+        s_prov_running = true;
 #ifdef CONFIG_PROV_TRANSPORT_BLE
     log_ble_events();
     led_status_set_mode(LED_MODE_PROV_BLE);
@@ -393,6 +405,7 @@ void wifi_prov_mgr_start_provisioning_service(void)
         /* We don't need the manager as device is already provisioned,
          * so let's release it's resources */
         wifi_prov_mgr_deinit();
+        xEventGroupSetBits(wifi_event_group, PROV_DONE_EVENT);
 
         /* Start Wi-Fi station */
         wifi_init_sta();
@@ -444,6 +457,18 @@ void wifi_provisioning_wait_connected(void)
     xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_EVENT, true, true, portMAX_DELAY);
 }
 
+bool wifi_provisioning_finish(uint32_t timeout_ms)
+{
+    /* With reprovisioning enabled the service keeps running after success */
+    if (s_prov_running) {
+        ESP_LOGI(TAG, "Stopping provisioning service");
+        wifi_prov_mgr_stop_provisioning();
+    }
+    EventBits_t bits = xEventGroupWaitBits(wifi_event_group, PROV_DONE_EVENT, false, true,
+                                           pdMS_TO_TICKS(timeout_ms));
+    return (bits & PROV_DONE_EVENT) != 0;
+}
+
 bool wifi_provisioning_is_connected(void)
 {
     EventBits_t bits = xEventGroupGetBits(wifi_event_group);
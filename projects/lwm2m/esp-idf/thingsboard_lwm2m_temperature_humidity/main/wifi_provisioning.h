@@ -2,6 +2,7 @@
 
 #include <esp_err.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +25,18 @@ void wifi_provisioning_init(void);
  */
 void wifi_provisioning_wait_connected(void);
 
+/**
+ * @brief Finish provisioning for this boot
+ * 
+ * Stops the provisioning service if it is still running (reprovisioning keeps it
+ * alive after success) and waits until the manager has been de-initialized, so
+ * the BLE stack is down and its memory can be released.
+ * 
+ * @param timeout_ms Maximum time to wait for the manager to shut down
+ * @return true once provisioning is no longer active
+ */
+bool wifi_provisioning_finish(uint32_t timeout_ms);
+
 /**
  * @brief Check if WiFi is connected
  * 
@@ -0,0 +1,142 @@
+#include "window_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DQ_AT(dq, front, i) (dq)[((front) + (i)) % WINDOW_STATS_CAPACITY]
+
+static inline void dq_push_back(uint16_t *dq, uint16_t front, uint16_t *len, uint16_t pos) {
+    DQ_AT(dq, front, *len) = pos;
+    (*len)++;
+}
+
+static inline void dq_pop_front(uint16_t *front, uint16_t *len) {
+    *front = (uint16_t) ((*front + 1) % WINDOW_STATS_CAPACITY);
+    (*len)--;
+}
+
+void window_stats_init(window_stats_t *w, window_mode_t mode, uint16_t length) {
+    memset(w, 0, sizeof(*w));
+    if (length < 1) {
+        length = 1;
+    } else if (length > WINDOW_STATS_CAPACITY) {
+        length = WINDOW_STATS_CAPACITY;
+    }
+    w->mode = mode;
+    w->length = length;
+}
+
+// Add+remove updates accumulate rounding error; recompute exactly once per window
+// (O(N) every N samples keeps the amortized cost O(1))
+static void resync(window_stats_t *w) {
+    double sum = 0.0;
+    for (uint16_t i = 0; i < w->count; ++i) {
+        sum += w->ring[i];
+    }
+    double mean = sum / w->count;
+    double m2 = 0.0;
+    for (uint16_t i = 0; i < w->count; ++i) {
+        double d = w->ring[i] - mean;
+        m2 += d * d;
+    }
+    w->mean = mean;
+    w->m2 = m2;
+    w->since_resync = 0;
+}
+
+static bool add_sliding(window_stats_t *w, float value) {
+    uint16_t slot = w->head;
+    if (w->count == w->length) {
+        // Evict the oldest sample (it sits in the slot about to be overwritten)
+        float old = w->ring[slot];
+        if (w->min_len && w->min_dq[w->min_front] == slot) {
+            dq_pop_front(&w->min_front, &w->min_len);
+        }
+        if (w->max_len && w->max_dq[w->max_front] == slot) {
+            dq_pop_front(&w->max_front, &w->max_len);
+        }
+        double old_mean = w->mean;
+        double diff = (double) value - (double) old;
+        w->mean += diff / w->count;
+        w->m2 += diff * (((double) value - w->mean) + ((double) old - old_mean));
+        if (w->m2 < 0.0) {
+            w->m2 = 0.0;
+        }
+        w->since_resync++;
+    } else {
+        w->count++;
+        double d = (double) value - w->mean;
+        w->mean += d / w->count;
+        w->m2 += d * ((double) value - w->mean);
+    }
+    w->ring[slot] = value;
+
+    while (w->min_len && w->ring[DQ_AT(w->min_dq, w->min_front, w->min_len - 1)] > value) {
+        w->min_len--;
+    }
+    dq_push_back(w->min_dq, w->min_front, &w->min_len, slot);
+    while (w->max_len && w->ring[DQ_AT(w->max_dq, w->max_front, w->max_len - 1)] < value) {
+        w->max_len--;
+    }
+    dq_push_back(w->max_dq, w->max_front, &w->max_len, slot);
+
+    w->head = (uint16_t) ((slot + 1) % w->length);
+    if (w->since_resync >= w->length) {
+        resync(w);
+    }
+    return true;
+}
+
+static bool add_tumbling(window_stats_t *w, float value) {
+    if (w->count == 0) {
+        w->run_min = value;
+        w->run_max = value;
+    } else {
+        if (value < w->run_min) {
+            w->run_min = value;
+        }
+        if (value > w->run_max) {
+            w->run_max = value;
+        }
+    }
+    w->count++;
+    double d = (double) value - w->mean;
+    w->mean += d / w->count;
+    w->m2 += d * ((double) value - w->mean);
+    if (w->count < w->length) {
+        return false;
+    }
+    w->closed.mean = (float) w->mean;
+    w->closed.stddev = (float) sqrt(w->m2 / w->count);
+    w->closed.min = w->run_min;
+    w->closed.max = w->run_max;
+    w->closed.count = w->count;
+    w->closed_valid = true;
+    w->count = 0;
+    w->mean = 0.0;
+    w->m2 = 0.0;
+    return true;
+}
+
+bool window_stats_add(window_stats_t *w, float value) {
+    return w->mode == WINDOW_TUMBLING ? add_tumbling(w, value) : add_sliding(w, value);
+}
+
+bool window_stats_result(const window_stats_t *w, window_result_t *out) {
+    if (w->mode == WINDOW_TUMBLING) {
+        if (!w->closed_valid) {
+            return false;
+        }
+        *out = w->closed;
+        return true;
+    }
+    if (w->count == 0) {
+        return false;
+    }
+    out->mean = (float) w->mean;
+    out->stddev = (float) sqrt(w->m2 / w->count);
+    out->min = w->ring[w->min_dq[w->min_front]];
+    out->max = w->ring[w->max_dq[w->max_front]];
+    out->count = w->count;
+    return true;
+}
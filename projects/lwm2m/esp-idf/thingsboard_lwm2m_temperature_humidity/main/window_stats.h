@@ -0,0 +1,72 @@
+#pragma once
+
+// O(1)-per-sample windowed statistics (mean/stddev/min/max) for sensor objects.
+// Sliding windows keep a ring of the last N samples: Welford accumulators are
+// updated with add+remove and min/max come from monotonic deques. Tumbling windows
+// accumulate N samples, publish one result and start over.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef WINDOW_STATS_CAPACITY
+#ifdef CONFIG_TH_SENSOR_WINDOW_MAX_SAMPLES
+#define WINDOW_STATS_CAPACITY CONFIG_TH_SENSOR_WINDOW_MAX_SAMPLES
+#else
+#define WINDOW_STATS_CAPACITY 300
+#endif
+#endif
+
+typedef enum {
+    WINDOW_SLIDING = 0,
+    WINDOW_TUMBLING = 1
+} window_mode_t;
+
+typedef struct {
+    float mean;
+    float stddev; // population standard deviation over the window
+    float min;
+    float max;
+    uint32_t count;
+} window_result_t;
+
+typedef struct {
+    window_mode_t mode;
+    uint16_t length;          // samples per window, 1..WINDOW_STATS_CAPACITY
+    uint16_t count;           // samples currently in the window
+    uint16_t head;            // next ring slot to write (sliding)
+    uint16_t since_resync;    // add+remove updates since the last exact recompute
+    double mean;
+    double m2;
+    float ring[WINDOW_STATS_CAPACITY];
+    // Monotonic deques of ring positions: min_dq values ascending, max_dq descending
+    uint16_t min_dq[WINDOW_STATS_CAPACITY];
+    uint16_t max_dq[WINDOW_STATS_CAPACITY];
+    uint16_t min_front, min_len;
+    uint16_t max_front, max_len;
+    // Tumbling: running extremes of the open window and the last closed one
+    float run_min, run_max;
+    window_result_t closed;
+    bool closed_valid;
+} window_stats_t;
+
+// Resets the window; length is clamped to 1..WINDOW_STATS_CAPACITY
+void window_stats_init(window_stats_t *w, window_mode_t mode, uint16_t length);
+
+// Adds one sample. Returns true if the published result changed: every sample for
+// sliding windows, only when a window closes for tumbling ones.
+bool window_stats_add(window_stats_t *w, float value);
+
+// Current result (sliding) or last closed window (tumbling). False if none yet.
+bool window_stats_result(const window_stats_t *w, window_result_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "bench_stats.h"
+
+static const char *TAG = "bench";
+
+static uint32_t s_rx_bytes;
+static uint32_t s_tx_bytes;
+
+void bench_stats_add_rx(size_t len)
+{
+    __atomic_fetch_add(&s_rx_bytes, (uint32_t)len, __ATOMIC_RELAXED);
+}
+
+void bench_stats_add_tx(size_t len)
+{
+    __atomic_fetch_add(&s_tx_bytes, (uint32_t)len, __ATOMIC_RELAXED);
+}
+
+#if CONFIG_EXAMPLE_BENCH_STATS
+static void stats_task(void *pvParameters)
+{
+    uint32_t last_rx = __atomic_load_n(&s_rx_bytes, __ATOMIC_RELAXED);
+    uint32_t last_tx = __atomic_load_n(&s_tx_bytes, __ATOMIC_RELAXED);
+    int64_t last_us = esp_timer_get_time();
+    configRUN_TIME_COUNTER_TYPE last_idle = ulTaskGetIdleRunTimeCounter();
+    configRUN_TIME_COUNTER_TYPE last_total = portGET_RUN_TIME_COUNTER_VALUE();
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_EXAMPLE_BENCH_STATS_PERIOD_S * 1000));
+        uint32_t rx = __atomic_load_n(&s_rx_bytes, __ATOMIC_RELAXED);
+        uint32_t tx = __atomic_load_n(&s_tx_bytes, __ATOMIC_RELAXED);
+        int64_t now_us = esp_timer_get_time();
+        configRUN_TIME_COUNTER_TYPE idle = ulTaskGetIdleRunTimeCounter();
+        configRUN_TIME_COUNTER_TYPE total = portGET_RUN_TIME_COUNTER_VALUE();
+
+        if (rx != last_rx || tx != last_tx) {
+            // bits per microsecond == Mbit/s
+            double us = (double)(now_us - last_us);
+            unsigned load = total != last_total ? 100 - (unsigned)((idle - last_idle) * 100 / (total - last_total)) : 0;
+            ESP_LOGI(TAG, "rx %.2f Mbit/s, tx %.2f Mbit/s, CPU load %u%%",
+                     (rx - last_rx) * 8.0 / us, (tx - last_tx) * 8.0 / us, load);
+        }
+        last_rx = rx;
+        last_tx = tx;
+        last_us = now_us;
+        last_idle = idle;
+        last_total = total;
+    }
+}
+#endif
+
+void bench_stats_start(void)
+{
+#if CONFIG_EXAMPLE_BENCH_STATS
+    xTaskCreate(stats_task, "bench_stats", 3072, NULL, tskIDLE_PRIORITY + 1, NULL);
+#endif
+}
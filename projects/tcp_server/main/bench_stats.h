@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stddef.h>
+
+// Byte counters shared by both data paths, cheap enough for the hot path
+void bench_stats_add_rx(size_t len);
+void bench_stats_add_tx(size_t len);
+
+// With EXAMPLE_BENCH_STATS, logs rx/tx Mbit/s and CPU load every
+// EXAMPLE_BENCH_STATS_PERIOD_S while there is traffic. No-op otherwise.
+void bench_stats_start(void);
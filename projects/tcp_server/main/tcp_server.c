@@ -26,6 +26,11 @@
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
 #include <lwip/netdb.h>
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include "bench_stats.h"
+#include "tcp_server_raw.h"
 #include <stdio.h>
 
 
@@ -156,46 +161,286 @@ static void start_provisioning_if_needed(void)
     }
 }
 
-static void do_retransmit(const int sock)
+#if CONFIG_EXAMPLE_DATA_PATH_SOCKET
+#define MAX_CONNECTIONS             CONFIG_EXAMPLE_MAX_CONNECTIONS
+#define CONN_BUF_SIZE               CONFIG_EXAMPLE_CONN_BUF_SIZE
+#define IDLE_TIMEOUT_MS             (CONFIG_EXAMPLE_IDLE_TIMEOUT_S * 1000)
+
+// One listener and one select() loop per enabled IP version
+#if defined(CONFIG_EXAMPLE_IPV4) && defined(CONFIG_EXAMPLE_IPV6)
+#define LISTENERS                   2
+#else
+#define LISTENERS                   1
+#endif
+_Static_assert(LISTENERS * (1 + MAX_CONNECTIONS) <= CONFIG_LWIP_MAX_SOCKETS,
+               "LWIP_MAX_SOCKETS too small for the listeners and EXAMPLE_MAX_CONNECTIONS clients");
+
+/* One client. Received bytes wait in a ring buffer until the socket is
+ * writable again, so a slow reader never blocks the other connections; when
+ * the ring is full we stop reading from that client (TCP window back-pressure). */
+typedef struct {
+    int sock;                   // -1: slot free
+    TickType_t last_activity;
+    bool peer_closed;           // FIN received: flush what is buffered, then close
+    size_t head;                // next byte to send
+    size_t len;                 // bytes buffered
+    uint32_t rx_total;
+    uint32_t tx_total;
+    uint8_t buf[CONN_BUF_SIZE];
+} conn_t;
+
+// Contiguous free space after the buffered data
+static size_t ring_write_span(const conn_t *c, uint8_t **p)
+{
+    size_t tail = (c->head + c->len) % CONN_BUF_SIZE;
+    *p = (uint8_t *)c->buf + tail;
+    if (c->len == CONN_BUF_SIZE) {
+        return 0;
+    }
+    return tail >= c->head ? CONN_BUF_SIZE - tail : c->head - tail;
+}
+
+// Contiguous buffered data from head
+static size_t ring_read_span(const conn_t *c, const uint8_t **p)
 {
-    int len;
-    char rx_buffer[128];
+    *p = c->buf + c->head;
+    return MIN(c->len, CONN_BUF_SIZE - c->head);
+}
 
-    do {
-        len = recv(sock, rx_buffer, sizeof(rx_buffer) - 1, 0);
-        if (len < 0) {
+static void conn_close(conn_t *c, const char *reason)
+{
+    ESP_LOGI(TAG, "Socket %d closed (%s): rx %u, tx %u bytes", c->sock, reason,
+             (unsigned)c->rx_total, (unsigned)c->tx_total);
+    shutdown(c->sock, 0);
+    close(c->sock);
+    c->sock = -1;
+}
+
+static void conn_open(conn_t *c, int sock, TickType_t now)
+{
+    c->sock = sock;
+    c->last_activity = now;
+    c->peer_closed = false;
+    c->head = 0;
+    c->len = 0;
+    c->rx_total = 0;
+    c->tx_total = 0;
+}
+
+// Sends what the socket takes now; the rest waits for the next writable event
+static void conn_flush(conn_t *c, TickType_t now)
+{
+    const uint8_t *p;
+    size_t span = ring_read_span(c, &p);
+    int written = send(c->sock, p, span, 0);
+    if (written < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+            conn_close(c, "send error");
+        }
+        return;
+    }
+    c->head = (c->head + written) % CONN_BUF_SIZE;
+    c->len -= written;
+    if (c->len == 0) {
+        c->head = 0; // keep the free space contiguous
+    }
+    c->tx_total += written;
+    bench_stats_add_tx(written);
+    c->last_activity = now;
+}
+
+static void conn_receive(conn_t *c, TickType_t now)
+{
+    uint8_t *p;
+    size_t span = ring_write_span(c, &p);
+    int len = recv(c->sock, p, span, 0);
+    if (len < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
             ESP_LOGE(TAG, "Error occurred during receiving: errno %d", errno);
-        } else if (len == 0) {
-            ESP_LOGW(TAG, "Connection closed");
-        } else {
-            rx_buffer[len] = 0; // Null-terminate whatever is received and treat it like a string
-            ESP_LOGI(TAG, "Received %d bytes: %s", len, rx_buffer);
-
-            // send() can return less bytes than supplied length.
-            // Walk-around for robust implementation.
-            int to_write = len;
-            while (to_write > 0) {
-                int written = send(sock, rx_buffer + (len - to_write), to_write, 0);
-                if (written < 0) {
-                    ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-                    // Failed to retransmit, giving up
-                    return;
-                }
-                to_write -= written;
-            }
+            conn_close(c, "recv error");
         }
-    } while (len > 0);
+        return;
+    }
+    if (len == 0) {
+        c->peer_closed = true;
+        return;
+    }
+#if CONFIG_EXAMPLE_LOG_RX_DATA
+    ESP_LOGI(TAG, "Received %d bytes: %.*s", len, len, (const char *)p);
+#endif
+    c->len += len;
+    c->rx_total += len;
+    bench_stats_add_rx(len);
+    c->last_activity = now;
 }
 
-static void tcp_server_task(void *pvParameters)
+static void accept_clients(int listen_sock, conn_t *conns, int *active, TickType_t now)
 {
-    char addr_str[128];
-    int addr_family = (int)pvParameters;
-    int ip_protocol = 0;
     int keepAlive = 1;
     int keepIdle = KEEPALIVE_IDLE;
     int keepInterval = KEEPALIVE_INTERVAL;
     int keepCount = KEEPALIVE_COUNT;
+    char addr_str[128];
+
+    // Drain the backlog while there are free slots
+    while (*active < MAX_CONNECTIONS) {
+        struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
+        socklen_t addr_len = sizeof(source_addr);
+        int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
+        if (sock < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
+            }
+            return;
+        }
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+        // Set tcp keepalive option
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int));
+        setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(int));
+        setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
+        setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
+        // Convert ip address to string
+        addr_str[0] = '\0';
+#ifdef CONFIG_EXAMPLE_IPV4
+        if (source_addr.ss_family == PF_INET) {
+            inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
+        }
+#endif
+#ifdef CONFIG_EXAMPLE_IPV6
+        if (source_addr.ss_family == PF_INET6) {
+            inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
+        }
+#endif
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            if (conns[i].sock < 0) {
+                conn_open(&conns[i], sock, now);
+                break;
+            }
+        }
+        (*active)++;
+        ESP_LOGI(TAG, "Socket %d accepted ip address: %s (%d/%d)", sock, addr_str, *active, MAX_CONNECTIONS);
+    }
+}
+
+// select() timeout until the next idle deadline, NULL to wait for traffic only
+static struct timeval *idle_timeout(const conn_t *conns, TickType_t now, struct timeval *tv)
+{
+#if CONFIG_EXAMPLE_IDLE_TIMEOUT_S > 0
+    const TickType_t idle = pdMS_TO_TICKS(IDLE_TIMEOUT_MS);
+    TickType_t wait = portMAX_DELAY;
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (conns[i].sock < 0) {
+            continue;
+        }
+        TickType_t elapsed = now - conns[i].last_activity;
+        TickType_t left = elapsed >= idle ? 0 : idle - elapsed;
+        wait = MIN(wait, left);
+    }
+    if (wait != portMAX_DELAY) {
+        uint32_t ms = (uint32_t)wait * portTICK_PERIOD_MS + 1;
+        tv->tv_sec = ms / 1000;
+        tv->tv_usec = (ms % 1000) * 1000;
+        return tv;
+    }
+#endif
+    return NULL;
+}
+
+/* Serves every client from one task: a single select() waits for new
+ * connections, readable sockets with ring space and writable sockets with
+ * pending data, so the task only wakes when there is work. */
+static void serve_clients(int listen_sock)
+{
+    conn_t *conns = calloc(MAX_CONNECTIONS, sizeof(conn_t));
+    if (!conns) {
+        ESP_LOGE(TAG, "No memory for %d connections", MAX_CONNECTIONS);
+        return;
+    }
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        conns[i].sock = -1;
+    }
+    int active = 0;
+
+    ESP_LOGI(TAG, "Socket listening (up to %d clients, %d byte buffers)", MAX_CONNECTIONS, CONN_BUF_SIZE);
+    while (1) {
+        fd_set rfds;
+        fd_set wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        int max_fd = -1;
+        // When all slots are taken new clients wait in the listen backlog
+        if (active < MAX_CONNECTIONS) {
+            FD_SET(listen_sock, &rfds);
+            max_fd = listen_sock;
+        }
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            const conn_t *c = &conns[i];
+            if (c->sock < 0) {
+                continue;
+            }
+            if (!c->peer_closed && c->len < CONN_BUF_SIZE) {
+                FD_SET(c->sock, &rfds);
+            }
+            if (c->len > 0) {
+                FD_SET(c->sock, &wfds);
+            }
+            max_fd = MAX(max_fd, c->sock);
+        }
+
+        struct timeval tv;
+        int ready = select(max_fd + 1, &rfds, &wfds, NULL, idle_timeout(conns, xTaskGetTickCount(), &tv));
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "select() failed: errno %d", errno);
+            break;
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (FD_ISSET(listen_sock, &rfds)) {
+            accept_clients(listen_sock, conns, &active, now);
+        }
+        for (int i = 0; i < MAX_CONNECTIONS; i++) {
+            conn_t *c = &conns[i];
+            // Sockets accepted above are not in the sets, so only the idle check applies
+            if (c->sock < 0) {
+                continue;
+            }
+            if (FD_ISSET(c->sock, &wfds)) {
+                conn_flush(c, now);
+            }
+            if (c->sock >= 0 && FD_ISSET(c->sock, &rfds)) {
+                conn_receive(c, now);
+            }
+            if (c->sock >= 0 && c->peer_closed && c->len == 0) {
+                conn_close(c, "peer closed");
+            }
+#if CONFIG_EXAMPLE_IDLE_TIMEOUT_S > 0
+            if (c->sock >= 0 && now - c->last_activity >= pdMS_TO_TICKS(IDLE_TIMEOUT_MS)) {
+                conn_close(c, "idle timeout");
+            }
+#endif
+            if (c->sock < 0) {
+                active--;
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (conns[i].sock >= 0) {
+            conn_close(&conns[i], "server stopped");
+        }
+    }
+    free(conns);
+}
+
+static void tcp_server_task(void *pvParameters)
+{
+    int addr_family = (int)pvParameters;
+    int ip_protocol = 0;
     struct sockaddr_storage dest_addr;
 
 #ifdef CONFIG_EXAMPLE_IPV4
@@ -231,6 +476,9 @@ static void tcp_server_task(void *pvParameters)
     setsockopt(listen_sock, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
 #endif
 
+    // accept() must not block the event loop
+    fcntl(listen_sock, F_SETFL, fcntl(listen_sock, F_GETFL, 0) | O_NONBLOCK);
+
     ESP_LOGI(TAG, "Socket created");
 
     int err = bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
@@ -241,53 +489,21 @@ static void tcp_server_task(void *pvParameters)
     }
     ESP_LOGI(TAG, "Socket bound, port %d", PORT);
 
-    err = listen(listen_sock, 1);
+    err = listen(listen_sock, MAX_CONNECTIONS);
     if (err != 0) {
         ESP_LOGE(TAG, "Error occurred during listen: errno %d", errno);
         goto CLEAN_UP;
     }
 
-    while (1) {
-
-        ESP_LOGI(TAG, "Socket listening");
-
-        struct sockaddr_storage source_addr; // Large enough for both IPv4 or IPv6
-        socklen_t addr_len = sizeof(source_addr);
-        int sock = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
-        if (sock < 0) {
-            ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
-            break;
-        }
-
-        // Set tcp keepalive option
-        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(int));
-        setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(int));
-        setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(int));
-        setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(int));
-        // Convert ip address to string
-#ifdef CONFIG_EXAMPLE_IPV4
-        if (source_addr.ss_family == PF_INET) {
-            inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
-        }
-#endif
-#ifdef CONFIG_EXAMPLE_IPV6
-        if (source_addr.ss_family == PF_INET6) {
-            inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
-        }
-#endif
-        ESP_LOGI(TAG, "Socket accepted ip address: %s", addr_str);
-
-        do_retransmit(sock);
-
-        shutdown(sock, 0);
-        close(sock);
-    }
+    serve_clients(listen_sock);
 
 CLEAN_UP:
     close(listen_sock);
     vTaskDelete(NULL);
 }
 
+#endif // CONFIG_EXAMPLE_DATA_PATH_SOCKET
+
 void app_main(void)
 {
     // Initialize NVS (erase and re-init if needed)
@@ -320,10 +536,15 @@ void app_main(void)
     // Wait until connected (got IP) before starting the TCP server
     xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
 
+    bench_stats_start();
+#if CONFIG_EXAMPLE_DATA_PATH_RAW
+    tcp_server_raw_start();
+#else
 #ifdef CONFIG_EXAMPLE_IPV4
     xTaskCreate(tcp_server_task, "tcp_server", 4096, (void*)AF_INET, 5, NULL);
 #endif
 #ifdef CONFIG_EXAMPLE_IPV6
     xTaskCreate(tcp_server_task, "tcp_server", 4096, (void*)AF_INET6, 5, NULL);
 #endif
+#endif
 }
@@ -0,0 +1,242 @@
+/* Zero-copy TCP echo on the lwIP raw API.
+
+   Received pbufs are chained per connection and handed back to tcp_write()
+   without TCP_WRITE_FLAG_COPY, so payload bytes are never copied between lwIP
+   and the application. A pbuf is freed only once the peer has acknowledged its
+   echo (sent callback), and only then is the receive window re-opened with
+   tcp_recved(): that is the back-pressure, no extra buffers are needed.
+   The window bounds bytes, not pbufs: on Wi-Fi each received pbuf references
+   a driver RX buffer, so a peer sending tiny segments could pin all of them.
+   A connection therefore holds at most MAX_PBUFS; beyond that new data is
+   refused (lwIP keeps it and retries) and the window stays closed.
+   Nothing is logged per packet; each connection logs a summary on close.
+*/
+#include <string.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
+#include "lwip/sys.h"
+#include "sdkconfig.h"
+
+#include "bench_stats.h"
+#include "tcp_server_raw.h"
+
+#define MAX_CONNECTIONS             CONFIG_EXAMPLE_MAX_CONNECTIONS
+#define IDLE_TIMEOUT_MS             (CONFIG_EXAMPLE_IDLE_TIMEOUT_S * 1000)
+#define MAX_PBUFS                   CONFIG_EXAMPLE_RAW_MAX_PBUFS
+// tcp_poll() interval in coarse TCP timer ticks (500 ms each)
+#define POLL_INTERVAL               2
+
+static const char *TAG = "raw_server";
+
+typedef struct {
+    struct tcp_pcb *pcb;        // NULL: slot free
+    struct pbuf *queue;         // received, echo not yet acknowledged by the peer
+    u32_t queued;               // bytes at the head of queue already passed to tcp_write()
+    u32_t unrecved;             // echoed bytes not yet returned to the window (queue at MAX_PBUFS)
+    bool peer_closed;           // FIN received: close once the echo is acknowledged
+    u32_t last_activity;        // sys_now()
+    u32_t rx_total;
+    u32_t tx_total;
+} raw_conn_t;
+
+static raw_conn_t s_conns[MAX_CONNECTIONS];
+static int s_active;
+
+static void conn_release(raw_conn_t *c)
+{
+    if (c->queue) {
+        pbuf_free(c->queue);
+    }
+    memset(c, 0, sizeof(*c));
+    s_active--;
+}
+
+/* Queued segments reference the pbufs, so a graceful close is only possible
+ * once everything has been acknowledged; otherwise the pcb is aborted first. */
+static err_t conn_close(raw_conn_t *c, const char *reason)
+{
+    struct tcp_pcb *pcb = c->pcb;
+    err_t ret = ERR_OK;
+
+    ESP_LOGI(TAG, "Client closed (%s): rx %u, tx %u bytes", reason,
+             (unsigned)c->rx_total, (unsigned)c->tx_total);
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    if (c->queue || tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        ret = ERR_ABRT;
+    }
+    conn_release(c);
+    return ret;
+}
+
+// Passes the part of the queue not yet written to tcp_write(), by reference
+static void echo_pending(raw_conn_t *c)
+{
+    u32_t skip = c->queued;
+    for (struct pbuf *q = c->queue; q; q = q->next) {
+        if (skip >= q->len) {
+            skip -= q->len;
+            continue;
+        }
+        u16_t left = q->len - skip;
+        u16_t n = LWIP_MIN(left, tcp_sndbuf(c->pcb));
+        if (n == 0) {
+            break;
+        }
+        // ERR_MEM (send queue full) is retried from the sent/poll callbacks
+        if (tcp_write(c->pcb, (const u8_t *)q->payload + skip, n, q->next ? TCP_WRITE_FLAG_MORE : 0) != ERR_OK) {
+            break;
+        }
+        c->queued += n;
+        if (n < left) {
+            break;
+        }
+        skip = 0;
+    }
+    tcp_output(c->pcb);
+}
+
+static err_t on_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    raw_conn_t *c = arg;
+    if (!p) {
+        c->peer_closed = true;
+        return c->queue ? ERR_OK : conn_close(c, "peer closed");
+    }
+    if (err != ERR_OK) {
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    if (c->queue && pbuf_clen(c->queue) + pbuf_clen(p) > MAX_PBUFS) {
+        return ERR_MEM; // lwIP keeps p as refused data and offers it again later
+    }
+    c->rx_total += p->tot_len;
+    bench_stats_add_rx(p->tot_len);
+    c->last_activity = sys_now();
+    if (c->queue) {
+        pbuf_cat(c->queue, p);
+    } else {
+        c->queue = p;
+    }
+    echo_pending(c);
+    return ERR_OK;
+}
+
+static err_t on_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    raw_conn_t *c = arg;
+    c->queued -= len;
+    c->queue = pbuf_free_header(c->queue, len);
+    // Echo delivered: the peer may send as much again, unless it already holds
+    // MAX_PBUFS buffers here (many small segments)
+    c->unrecved += len;
+    while (c->unrecved > 0 && pbuf_clen(c->queue) < MAX_PBUFS) {
+        u16_t n = (u16_t)LWIP_MIN(c->unrecved, 0xffff);
+        tcp_recved(pcb, n);
+        c->unrecved -= n;
+    }
+    c->tx_total += len;
+    bench_stats_add_tx(len);
+    c->last_activity = sys_now();
+    if (c->queue) {
+        echo_pending(c);
+    } else if (c->peer_closed) {
+        return conn_close(c, "peer closed");
+    }
+    return ERR_OK;
+}
+
+static err_t on_poll(void *arg, struct tcp_pcb *pcb)
+{
+    raw_conn_t *c = arg;
+#if CONFIG_EXAMPLE_IDLE_TIMEOUT_S > 0
+    if (sys_now() - c->last_activity >= IDLE_TIMEOUT_MS) {
+        return conn_close(c, "idle timeout");
+    }
+#endif
+    if (c->queue) {
+        echo_pending(c);
+    }
+    return ERR_OK;
+}
+
+// The pcb is already gone (RST or abort by lwIP)
+static void on_err(void *arg, err_t err)
+{
+    raw_conn_t *c = arg;
+    ESP_LOGW(TAG, "Client error %d: rx %u, tx %u bytes", err, (unsigned)c->rx_total, (unsigned)c->tx_total);
+    conn_release(c);
+}
+
+static err_t on_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
+{
+    if (err != ERR_OK || !newpcb) {
+        return ERR_VAL;
+    }
+    raw_conn_t *c = NULL;
+    for (int i = 0; i < MAX_CONNECTIONS; i++) {
+        if (!s_conns[i].pcb) {
+            c = &s_conns[i];
+            break;
+        }
+    }
+    if (!c) {
+        ESP_LOGW(TAG, "Refusing client: %d connections open", MAX_CONNECTIONS);
+        tcp_abort(newpcb);
+        return ERR_ABRT;
+    }
+    c->pcb = newpcb;
+    c->last_activity = sys_now();
+    s_active++;
+
+    tcp_arg(newpcb, c);
+    tcp_recv(newpcb, on_recv);
+    tcp_sent(newpcb, on_sent);
+    tcp_err(newpcb, on_err);
+    tcp_poll(newpcb, on_poll, POLL_INTERVAL);
+    // Same keep-alive settings as the socket path
+    ip_set_option(newpcb, SOF_KEEPALIVE);
+    newpcb->keep_idle = CONFIG_EXAMPLE_KEEPALIVE_IDLE * 1000;
+    newpcb->keep_intvl = CONFIG_EXAMPLE_KEEPALIVE_INTERVAL * 1000;
+    newpcb->keep_cnt = CONFIG_EXAMPLE_KEEPALIVE_COUNT;
+
+    ESP_LOGI(TAG, "Client accepted ip address: %s (%d/%d)", ipaddr_ntoa(&newpcb->remote_ip), s_active, MAX_CONNECTIONS);
+    return ERR_OK;
+}
+
+// Runs in the tcpip thread
+static void raw_server_start_cb(void *arg)
+{
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        ESP_LOGE(TAG, "Unable to create pcb");
+        return;
+    }
+    err_t err = tcp_bind(pcb, IP_ANY_TYPE, CONFIG_EXAMPLE_PORT);
+    if (err != ERR_OK) {
+        ESP_LOGE(TAG, "Unable to bind port %d: err %d", CONFIG_EXAMPLE_PORT, err);
+        tcp_close(pcb);
+        return;
+    }
+    struct tcp_pcb *listen_pcb = tcp_listen_with_backlog(pcb, MAX_CONNECTIONS);
+    if (!listen_pcb) {
+        ESP_LOGE(TAG, "Unable to listen");
+        tcp_close(pcb);
+        return;
+    }
+    tcp_accept(listen_pcb, on_accept);
+    ESP_LOGI(TAG, "Zero-copy echo listening on port %d (up to %d clients)", CONFIG_EXAMPLE_PORT, MAX_CONNECTIONS);
+}
+
+void tcp_server_raw_start(void)
+{
+    if (tcpip_callback(raw_server_start_cb, NULL) != ERR_OK) {
+        ESP_LOGE(TAG, "Unable to start raw server");
+    }
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Echo server on the lwIP raw TCP API (zero-copy data path).
+// Listens on CONFIG_EXAMPLE_PORT for IPv4 and IPv6; runs entirely in the
+// tcpip thread, no task of its own.
+void tcp_server_raw_start(void);
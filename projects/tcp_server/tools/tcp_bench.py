@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Host-side benchmarks for the TCP echo server.
+
+  throughput   N parallel clients each stream BYTES (or for --seconds) and read
+               the echo back; reports per-client and aggregate echo throughput
+               in Mbit/s and checks data.
+  connections  Opens clients one by one and checks which ones are served at the
+               same time (echo within --timeout); the rest sit in the backlog.
+
+Examples:
+  python3 tools/tcp_bench.py 192.168.0.167 throughput --clients 4 --bytes 1000000
+  python3 tools/tcp_bench.py 192.168.0.167 throughput --clients 2 --seconds 30
+  python3 tools/tcp_bench.py 192.168.0.167 connections --max 20
+
+Disable "Log received data" (EXAMPLE_LOG_RX_DATA) for throughput runs: logging
+every chunk over UART is much slower than Wi-Fi.
+"""
+import argparse
+import socket
+import sys
+import threading
+import time
+
+
+_PATTERN = bytes(i % 251 for i in range(251 + 65536))
+
+
+def pattern(offset, size):
+    # Position-dependent bytes so reordered or dropped data is detected
+    start = offset % 251
+    return _PATTERN[start:start + size]
+
+
+def echo_client(host, port, total, seconds, chunk, result):
+    t0 = time.monotonic()
+    sock = socket.create_connection((host, port), timeout=30)
+    connected = time.monotonic()
+    errors = []
+
+    def sender():
+        sent = 0
+        try:
+            # Sustained mode: stream until the deadline
+            deadline = time.monotonic() + seconds if seconds else None
+            while (deadline and time.monotonic() < deadline) or (not deadline and sent < total):
+                n = chunk if deadline else min(chunk, total - sent)
+                sock.sendall(pattern(sent, n))
+                sent += n
+            result['sent'] = sent
+            sock.shutdown(socket.SHUT_WR)
+        except OSError as e:
+            errors.append(f'send: {e}')
+
+    tx = threading.Thread(target=sender)
+    tx.start()
+    received = 0
+    try:
+        while True:
+            data = sock.recv(65536)
+            if not data:
+                break
+            if data != pattern(received, len(data)):
+                errors.append(f'corrupt echo at byte {received}')
+                break
+            received += len(data)
+    except OSError as e:
+        errors.append(f'recv: {e}')
+    tx.join()
+    sock.close()
+    result.update(received=received, connect_s=connected - t0, total_s=time.monotonic() - t0, errors=errors)
+
+
+def run_throughput(args):
+    results = [dict() for _ in range(args.clients)]
+    threads = [threading.Thread(target=echo_client,
+                                args=(args.host, args.port, args.bytes, args.seconds, args.chunk, r))
+               for r in results]
+    t0 = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - t0
+
+    ok = True
+    for i, r in enumerate(results):
+        rate = r['received'] * 8 / r['total_s'] / 1e6 if r['total_s'] else 0
+        complete = r['received'] == r.get('sent', -1)
+        status = 'OK' if complete and not r['errors'] else 'FAIL ' + ('; '.join(r['errors']) or 'short echo')
+        ok &= status == 'OK'
+        print(f'client {i}: {r["received"]} B echoed in {r["total_s"]:.2f} s '
+              f'({rate:.2f} Mbit/s, connect {r["connect_s"] * 1000:.0f} ms) {status}')
+    total = sum(r['received'] for r in results)
+    print(f'aggregate: {args.clients} clients, {total} B in {elapsed:.2f} s = {total * 8 / elapsed / 1e6:.2f} Mbit/s '
+          f'echoed ({total * 16 / elapsed / 1e6:.2f} Mbit/s both directions)')
+    return ok
+
+
+def run_connections(args):
+    socks = []
+    served = 0
+    try:
+        for i in range(args.max):
+            try:
+                s = socket.create_connection((args.host, args.port), timeout=args.timeout)
+            except OSError as e:
+                print(f'client {i}: connect failed ({e})')
+                break
+            socks.append(s)
+            msg = f'ping {i}'.encode()
+            t0 = time.monotonic()
+            try:
+                s.sendall(msg)
+                data = b''
+                while len(data) < len(msg):
+                    part = s.recv(64)
+                    if not part:
+                        break
+                    data += part
+            except socket.timeout:
+                data = b''
+            if data == msg:
+                served += 1
+                print(f'client {i}: served, echo in {(time.monotonic() - t0) * 1000:.1f} ms')
+            else:
+                print(f'client {i}: connected but not served within {args.timeout} s (backlog)')
+        print(f'{served} of {len(socks)} open connections served concurrently')
+        if args.hold:
+            # Idle timeout check: the server should close served clients by itself
+            time.sleep(args.hold)
+            closed = 0
+            for s in socks:
+                s.settimeout(0.5)
+                try:
+                    closed += s.recv(1) == b''
+                except (socket.timeout, OSError):
+                    pass
+            print(f'after {args.hold} s idle: {closed} connections closed by the server')
+    finally:
+        for s in socks:
+            s.close()
+    return served > 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=3333)
+    sub = parser.add_subparsers(dest='mode', required=True)
+    tp = sub.add_parser('throughput')
+    tp.add_argument('--clients', type=int, default=4)
+    tp.add_argument('--bytes', type=int, default=1000000, help='bytes sent by each client')
+    tp.add_argument('--seconds', type=float, default=0, help='stream for this long instead of --bytes')
+    tp.add_argument('--chunk', type=int, default=4096, choices=range(1, 65537), metavar='1..65536')
+    cn = sub.add_parser('connections')
+    cn.add_argument('--max', type=int, default=16, help='clients to open')
+    cn.add_argument('--timeout', type=float, default=2.0)
+    cn.add_argument('--hold', type=float, default=0, help='then stay idle this long and count server closes')
+    args = parser.parse_args()
+    ok = run_throughput(args) if args.mode == 'throughput' else run_connections(args)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,358 @@
+#!/usr/bin/env python3
+"""Genera paquetes de firmware comprimidos y/o delta (formato FWPK).
+
+Uso:
+  # Imagen completa comprimida (LZSS compatible con heatshrink)
+  ./tools/fw_package.py build/app.bin -o app.fwpk
+  # Delta contra la imagen que corre en el dispositivo, comprimido
+  ./tools/fw_package.py build/app.bin --base old/app.bin -o app_delta.fwpk
+  # Comprobar que un paquete reconstruye la imagen
+  ./tools/fw_package.py build/app.bin --base old/app.bin -o app_delta.fwpk --verify
+  # Firmar (manifiesto verificado con CONFIG_FW_MANIFEST_VERIFY; requiere openssl)
+  ./tools/fw_package.py build/app.bin --sign fw_sign_key.pem -o app.fwpk
+
+El formato lo decodifica main/fw_package.c en streaming (ver su cabecera).
+El paquete resultante se sube a ThingsBoard como cualquier otro firmware.
+"""
+
+import argparse
+import hashlib
+import struct
+import subprocess
+import sys
+
+MAGIC = b"FWPK"
+VERSION = 1
+FLAG_COMPRESSED = 0x01
+FLAG_DELTA = 0x02
+HEADER_FMT = "<4sBBBBII32s"  # 48 bytes
+
+# Signed manifest appended after the app image (main/fw_image.h)
+MANIFEST_MAGIC = b"FWSG"
+MANIFEST_VERSION = 1
+
+# Delta matching
+SEED = 12       # bytes hashed to find a candidate match
+SEED_STRIDE = 4  # base positions indexed (every Nth)
+GIVE_UP = 64    # stop extending after this many bytes without improvement
+
+
+# ---------------------------------------------------------------- LZSS ----
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, value, bits):
+        self.acc = (self.acc << bits) | value
+        self.n += bits
+        while self.n >= 8:
+            self.n -= 8
+            self.out.append((self.acc >> self.n) & 0xFF)
+        self.acc &= (1 << self.n) - 1
+
+    def finish(self):
+        if self.n:
+            self.out.append((self.acc << (8 - self.n)) & 0xFF)
+        return bytes(self.out)
+
+
+def lzss_compress(data, window_bits, lookahead_bits, chain=8):
+    """Greedy LZSS producing a heatshrink bit stream."""
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    min_len = (1 + window_bits + lookahead_bits) // 9 + 1  # must beat literals
+    heads = {}
+    w = BitWriter()
+    i = 0
+    n = len(data)
+    while i < n:
+        best_len = 0
+        best_dist = 0
+        if i + 3 <= n:
+            key = data[i:i + 3]
+            cands = heads.get(key)
+            if cands:
+                limit = min(max_len, n - i)
+                for p in reversed(cands):
+                    dist = i - p
+                    if dist > window:
+                        break
+                    # Cheap reject: a longer match must also differ nowhere up to best_len
+                    if best_len and (best_len >= limit or data[p + best_len] != data[i + best_len]):
+                        continue
+                    l = 3
+                    while l + 8 <= limit and data[p + l:p + l + 8] == data[i + l:i + l + 8]:
+                        l += 8
+                    while l < limit and data[p + l] == data[i + l]:
+                        l += 1
+                    if l > best_len:
+                        best_len, best_dist = l, dist
+                        if l == limit:
+                            break
+        step = best_len if best_len >= min_len else 1
+        if step > 1:
+            w.put(0, 1)
+            w.put(best_dist - 1, window_bits)
+            w.put(best_len - 1, lookahead_bits)
+        else:
+            w.put(1, 1)
+            w.put(data[i], 8)
+        for j in range(i, min(i + step, n - 2)):
+            lst = heads.setdefault(data[j:j + 3], [])
+            lst.append(j)
+            if len(lst) > chain:
+                del lst[0]
+        i += step
+    return w.finish()
+
+
+def lzss_decompress(data, window_bits, lookahead_bits, out_size):
+    out = bytearray()
+    acc = 0
+    n = 0
+    pos = 0
+
+    def bits(k):
+        nonlocal acc, n, pos
+        while n < k:
+            if pos >= len(data):
+                return None
+            acc = (acc << 8) | data[pos]
+            pos += 1
+            n += 8
+        n -= k
+        v = acc >> n
+        acc &= (1 << n) - 1
+        return v
+
+    while len(out) < out_size:
+        tag = bits(1)
+        if tag is None:
+            break
+        if tag:
+            c = bits(8)
+            if c is None:
+                break
+            out.append(c)
+        else:
+            idx = bits(window_bits)
+            cnt = bits(lookahead_bits)
+            if idx is None or cnt is None:
+                break
+            for _ in range(cnt + 1):
+                p = len(out) - (idx + 1)
+                out.append(out[p] if p >= 0 else 0)
+    return bytes(out)
+
+
+# --------------------------------------------------------------- Delta ----
+
+def varint(v):
+    out = bytearray()
+    while True:
+        b = v & 0x7F
+        v >>= 7
+        if v:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return out
+
+
+def zigzag(v):
+    return v << 1 if v >= 0 else ((-v - 1) << 1) | 1
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def extend(old, new, b, n):
+    """bsdiff-style approximate extension: length maximizing 2*matches - length."""
+    limit = min(len(old) - b, len(new) - n)
+    s = best_s = best_len = i = since = 0
+    while i < limit:
+        if old[b + i] == new[n + i]:
+            s += 1
+        i += 1
+        if 2 * s - i > 2 * best_s - best_len:
+            best_s, best_len, since = s, i, 0
+        else:
+            since += 1
+            if since > GIVE_UP:
+                break
+    return best_len
+
+
+def delta_encode(old, new):
+    index = {}
+    for p in range(0, len(old) - SEED + 1, SEED_STRIDE):
+        index.setdefault(old[p:p + SEED], p)
+
+    out = bytearray()
+    base_pos = 0     # decoder base pointer after the last record
+    pending_seek = 0  # seek/diff of the record being built
+    diff_new = diff_old = diff_len = 0
+    extra_start = 0
+    n = 0
+    while n + SEED <= len(new):
+        b = index.get(new[n:n + SEED])
+        if b is None:
+            n += 1
+            continue
+        # Grow exact match backwards into the pending literals
+        while n > extra_start and b > 0 and new[n - 1] == old[b - 1]:
+            n -= 1
+            b -= 1
+        length = extend(old, new, b, n)
+        # Close the current record: its extra bytes are everything up to n
+        out += varint(zigzag(pending_seek)) + varint(diff_len) + varint(n - extra_start)
+        out += bytes((new[diff_new + k] - old[diff_old + k]) & 0xFF for k in range(diff_len))
+        out += new[extra_start:n]
+        base_pos += pending_seek + diff_len
+        pending_seek = b - base_pos
+        diff_new, diff_old, diff_len = n, b, length
+        n += length
+        extra_start = n
+    out += varint(zigzag(pending_seek)) + varint(diff_len) + varint(len(new) - extra_start)
+    out += bytes((new[diff_new + k] - old[diff_old + k]) & 0xFF for k in range(diff_len))
+    out += new[extra_start:]
+    return bytes(out)
+
+
+def delta_decode(old, patch, out_size):
+    out = bytearray()
+    pos = 0
+    base = 0
+
+    def read_varint():
+        nonlocal pos
+        v = shift = 0
+        while True:
+            c = patch[pos]
+            pos += 1
+            v |= (c & 0x7F) << shift
+            if not c & 0x80:
+                return v
+            shift += 7
+
+    while len(out) < out_size:
+        base += unzigzag(read_varint())
+        diff_len = read_varint()
+        extra_len = read_varint()
+        for k in range(diff_len):
+            out.append((old[base + k] + patch[pos + k]) & 0xFF)
+        pos += diff_len
+        base += diff_len
+        out += patch[pos:pos + extra_len]
+        pos += extra_len
+    return bytes(out)
+
+
+# ------------------------------------------------------------ Manifest ----
+
+def esp_image_layout(img):
+    """Returns (hashed_len, hash_appended) of an ESP-IDF app image."""
+    if len(img) < 24 or img[0] != 0xE9:
+        raise ValueError("not an ESP-IDF app image")
+    segments = img[1]
+    hash_appended = img[23] == 1
+    off = 24
+    for _ in range(segments):
+        if off + 8 > len(img):
+            raise ValueError("truncated segment table")
+        _, data_len = struct.unpack_from("<II", img, off)
+        off += 8 + data_len
+    hashed_len = (off + 1 + 15) & ~15  # checksum byte, 16-byte padding
+    end = hashed_len + (32 if hash_appended else 0)
+    if end > len(img):
+        raise ValueError("truncated image")
+    if hash_appended and hashlib.sha256(img[:hashed_len]).digest() != img[hashed_len:end]:
+        raise ValueError("appended SHA-256 does not match")
+    return hashed_len, hash_appended
+
+
+def sign_image(img, key):
+    """Appends a manifest with a signature over the image SHA-256 (openssl CLI)."""
+    hashed_len, hash_appended = esp_image_layout(img)
+    end = hashed_len + (32 if hash_appended else 0)
+    sig = subprocess.run(["openssl", "dgst", "-sha256", "-sign", key],
+                         input=img[:hashed_len], capture_output=True, check=True).stdout
+    return img[:end] + MANIFEST_MAGIC + struct.pack("<BH", MANIFEST_VERSION, len(sig)) + sig
+
+
+# ---------------------------------------------------------------- Main ----
+
+def build(new, base, compress, window_bits, lookahead_bits):
+    flags = 0
+    payload = new
+    base_size = 0
+    base_sha = bytes(32)
+    if base is not None:
+        flags |= FLAG_DELTA
+        payload = delta_encode(base, new)
+        base_size = len(base)
+        base_sha = hashlib.sha256(base).digest()
+    if compress:
+        flags |= FLAG_COMPRESSED
+        payload = lzss_compress(payload, window_bits, lookahead_bits)
+    header = struct.pack(HEADER_FMT, MAGIC, VERSION, flags, window_bits, lookahead_bits,
+                         len(new), base_size, base_sha)
+    return header + payload
+
+
+def unpack(pkg, base):
+    magic, version, flags, wb, lb, image_size, base_size, base_sha = \
+        struct.unpack_from(HEADER_FMT, pkg)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a FWPK package")
+    payload = pkg[struct.calcsize(HEADER_FMT):]
+    if flags & FLAG_COMPRESSED:
+        payload = lzss_decompress(payload, wb, lb, 1 << 62)
+    if flags & FLAG_DELTA:
+        if base is None or len(base) != base_size or hashlib.sha256(base).digest() != base_sha:
+            raise ValueError("package does not apply to this base image")
+        payload = delta_decode(base, payload, image_size)
+    return payload[:image_size]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Genera paquetes de firmware FWPK")
+    ap.add_argument("image", help="imagen de aplicación nueva (.bin)")
+    ap.add_argument("-o", "--output", required=True, help="paquete de salida")
+    ap.add_argument("--base", help="imagen que corre en el dispositivo (genera delta)")
+    ap.add_argument("--no-compress", action="store_true", help="no comprimir el payload")
+    ap.add_argument("-w", "--window-bits", type=int, default=12,
+                    help="ventana LZSS 2^w bytes (RAM en el dispositivo), 4..14")
+    ap.add_argument("-l", "--lookahead-bits", type=int, default=5,
+                    help="longitud máxima de coincidencia 2^l, 3..w-1")
+    ap.add_argument("--sign", metavar="KEY", help="clave privada PEM para firmar el manifiesto")
+    ap.add_argument("--verify", action="store_true", help="decodificar y comparar")
+    args = ap.parse_args()
+
+    if not 4 <= args.window_bits <= 14 or not 3 <= args.lookahead_bits < args.window_bits:
+        ap.error("parámetros LZSS fuera de rango")
+    with open(args.image, "rb") as f:
+        new = f.read()
+    if args.sign:
+        new = sign_image(new, args.sign)
+    base = None
+    if args.base:
+        with open(args.base, "rb") as f:
+            base = f.read()
+
+    pkg = build(new, base, not args.no_compress, args.window_bits, args.lookahead_bits)
+    if args.verify and unpack(pkg, base) != new:
+        print("ERROR: el paquete no reconstruye la imagen", file=sys.stderr)
+        return 1
+    with open(args.output, "wb") as f:
+        f.write(pkg)
+    print(f"{args.output}: {len(pkg)} bytes ({100.0 * len(pkg) / len(new):.1f}% de {len(new)})")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Modbus TCP load test for the smart meter (main/modbus_tcp.c).
+
+N concurrent masters poll the register map with Read Holding (0x03) and Read
+Input (0x04) Registers, alternately, for a fixed time; every response is
+checked (transaction id, function, byte count) and latency percentiles and the
+achieved request rate are reported. Standard library only.
+
+  ./modbus_load.py 192.168.1.50 --dump
+  ./modbus_load.py 192.168.1.50 --masters 4 --rate 10 --seconds 60
+  ./modbus_load.py 192.168.1.50 --masters 4 --rate 0 --seconds 10   # as fast as possible
+"""
+import argparse
+import socket
+import struct
+import sys
+import threading
+import time
+
+REGISTERS = [
+    (0, 'voltage_v'), (2, 'current_a'), (4, 'active_power_kw'), (6, 'reactive_power_kvar'),
+    (8, 'inductive_reactive_power_kvar'), (10, 'capacitive_reactive_power_kvar'), (12, 'apparent_power_kva'),
+    (14, 'power_factor'), (16, 'thd_v'), (18, 'thd_a'), (20, 'frequency_hz'), (22, 'active_energy_kwh'),
+    (24, 'reactive_energy_kvarh'), (26, 'apparent_energy_kvah'),
+]
+UPDATE_COUNT = 28
+REG_COUNT = 30
+
+
+class ModbusError(Exception):
+    pass
+
+
+class Master:
+    def __init__(self, host, port, unit, timeout):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.unit = unit
+        self.tid = 0
+
+    def _recv_exact(self, n):
+        buf = b''
+        while len(buf) < n:
+            part = self.sock.recv(n - len(buf))
+            if not part:
+                raise ModbusError('connection closed')
+            buf += part
+        return buf
+
+    def request(self, pdu):
+        self.tid = (self.tid + 1) & 0xFFFF
+        self.sock.sendall(struct.pack('>HHHB', self.tid, 0, len(pdu) + 1, self.unit) + pdu)
+        tid, proto, length, _unit = struct.unpack('>HHHB', self._recv_exact(7))
+        body = self._recv_exact(length - 1)
+        if tid != self.tid or proto != 0:
+            raise ModbusError(f'bad MBAP (tid {tid} != {self.tid} or protocol {proto})')
+        return body
+
+    def read(self, fc, addr, qty):
+        body = self.request(struct.pack('>BHH', fc, addr, qty))
+        if body[0] == fc | 0x80:
+            raise ModbusError(f'exception 0x{body[1]:02x}')
+        if body[0] != fc or body[1] != 2 * qty or len(body) != 2 + 2 * qty:
+            raise ModbusError(f'malformed response {body.hex()}')
+        return struct.unpack(f'>{qty}H', body[2:])
+
+    def close(self):
+        self.sock.close()
+
+
+def decode(regs):
+    values = {name: struct.unpack('>f', struct.pack('>HH', regs[a], regs[a + 1]))[0] for a, name in REGISTERS}
+    values['update_count'] = (regs[UPDATE_COUNT] << 16) | regs[UPDATE_COUNT + 1]
+    return values
+
+
+def poll(args, idx, result):
+    latencies = []
+    errors = []
+    try:
+        m = Master(args.host, args.port, args.unit, args.timeout)
+    except OSError as e:
+        result.update(latencies=latencies, errors=[f'connect: {e}'])
+        return
+    period = 1.0 / args.rate if args.rate else 0
+    deadline = time.monotonic() + args.seconds
+    next_t = time.monotonic()
+    n = 0
+    while time.monotonic() < deadline:
+        fc = 0x03 if n % 2 == 0 else 0x04
+        t0 = time.monotonic()
+        try:
+            m.read(fc, 0, REG_COUNT)
+            latencies.append(time.monotonic() - t0)
+        except (ModbusError, OSError) as e:
+            errors.append(str(e))
+            if isinstance(e, OSError):
+                break
+        n += 1
+        if period:
+            next_t += period
+            time.sleep(max(0.0, next_t - time.monotonic()))
+    m.close()
+    result.update(latencies=latencies, errors=errors)
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return float('nan')
+    k = min(len(sorted_values) - 1, int(round(p / 100 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+def selftest(args):
+    m = Master(args.host, args.port, args.unit, args.timeout)
+    checks = [
+        ('illegal function 0x06', struct.pack('>BHH', 0x06, 0, 1), 0x01),
+        ('address past the map', struct.pack('>BHH', 0x03, REG_COUNT - 1, 2), 0x02),
+        ('quantity 0', struct.pack('>BHH', 0x04, 0, 0), 0x03),
+    ]
+    ok = True
+    for name, pdu, expected in checks:
+        body = m.request(pdu)
+        good = body[0] == pdu[0] | 0x80 and body[1] == expected
+        ok &= good
+        print(f'{name}: {"OK" if good else "FAIL " + body.hex()}')
+    m.close()
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=502)
+    parser.add_argument('--unit', type=int, default=1)
+    parser.add_argument('--timeout', type=float, default=2.0)
+    parser.add_argument('--masters', type=int, default=4)
+    parser.add_argument('--rate', type=float, default=10, help='requests/s per master, 0 = back to back')
+    parser.add_argument('--seconds', type=float, default=10)
+    parser.add_argument('--dump', action='store_true', help='read and print the map once')
+    args = parser.parse_args()
+
+    if args.dump:
+        m = Master(args.host, args.port, args.unit, args.timeout)
+        for name, value in decode(m.read(0x04, 0, REG_COUNT)).items():
+            print(f'{name:32} {value:.6g}' if isinstance(value, float) else f'{name:32} {value}')
+        m.close()
+        return
+    if not selftest(args):
+        sys.exit(1)
+
+    results = [dict() for _ in range(args.masters)]
+    threads = [threading.Thread(target=poll, args=(args, i, r)) for i, r in enumerate(results)]
+    t0 = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - t0
+
+    all_lat = []
+    failed = 0
+    for i, r in enumerate(results):
+        lat = sorted(r['latencies'])
+        all_lat += lat
+        failed += len(r['errors'])
+        print(f'master {i}: {len(lat)} ok, {len(r["errors"])} errors, '
+              f'p50 {percentile(lat, 50) * 1000:.1f} ms, p99 {percentile(lat, 99) * 1000:.1f} ms'
+              + (f' ({r["errors"][0]})' if r['errors'] else ''))
+    all_lat.sort()
+    print(f'total: {len(all_lat)} requests in {elapsed:.1f} s = {len(all_lat) / elapsed:.1f} req/s, {failed} errors')
+    if all_lat:
+        print(f'latency ms: p50 {percentile(all_lat, 50) * 1000:.1f}, p95 {percentile(all_lat, 95) * 1000:.1f}, '
+              f'p99 {percentile(all_lat, 99) * 1000:.1f}, max {all_lat[-1] * 1000:.1f}')
+    sys.exit(1 if failed or not all_lat else 0)
+
+
+if __name__ == '__main__':
+    main()